@@ -949,6 +949,7 @@ func (x *DomainSchedParams) fromC(xc *C.libxl_domain_sched_params) error {
 	x.Extratime = int(xc.extratime)
 	x.Slice = int(xc.slice)
 	x.Latency = int(xc.latency)
+	x.LatencyClass = int(xc.latency_class)
 
 	return nil
 }
@@ -968,6 +969,7 @@ func (x *DomainSchedParams) toC(xc *C.libxl_domain_sched_params) (err error) {
 	xc.extratime = C.int(x.Extratime)
 	xc.slice = C.int(x.Slice)
 	xc.latency = C.int(x.Latency)
+	xc.latency_class = C.int(x.LatencyClass)
 
 	return nil
 }
@@ -1349,6 +1351,7 @@ func (x *DomainBuildInfoTypeUnionHvm) fromC(xc *C.libxl_domain_build_info) error
 	}
 	x.RdmMemBoundaryMemkb = uint64(tmp.rdm_mem_boundary_memkb)
 	x.McaCaps = uint64(tmp.mca_caps)
+	x.HaltPollNs = uint32(tmp.halt_poll_ns)
 	return nil
 }
 
@@ -1681,6 +1684,7 @@ func (x *DomainBuildInfo) toC(xc *C.libxl_domain_build_info) (err error) {
 		}
 		hvm.rdm_mem_boundary_memkb = C.uint64_t(tmp.RdmMemBoundaryMemkb)
 		hvm.mca_caps = C.uint64_t(tmp.McaCaps)
+		hvm.halt_poll_ns = C.uint32_t(tmp.HaltPollNs)
 		hvmBytes := C.GoBytes(unsafe.Pointer(&hvm), C.sizeof_libxl_domain_build_info_type_union_hvm)
 		copy(xc.u[:], hvmBytes)
 	case DomainTypePv:
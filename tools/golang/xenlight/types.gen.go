@@ -436,14 +436,15 @@ type VcpuSchedParams struct {
 }
 
 type DomainSchedParams struct {
-	Sched     Scheduler
-	Weight    int
-	Cap       int
-	Period    int
-	Budget    int
-	Extratime int
-	Slice     int
-	Latency   int
+	Sched        Scheduler
+	Weight       int
+	Cap          int
+	Period       int
+	Budget       int
+	Extratime    int
+	Slice        int
+	Latency      int
+	LatencyClass int
 }
 
 type VnodeInfo struct {
@@ -593,6 +594,7 @@ type DomainBuildInfoTypeUnionHvm struct {
 	Rdm                 RdmReserve
 	RdmMemBoundaryMemkb uint64
 	McaCaps             uint64
+	HaltPollNs          uint32
 }
 
 func (x DomainBuildInfoTypeUnionHvm) isdomainBuildInfoTypeUnion() {}
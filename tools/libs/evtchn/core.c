@@ -13,6 +13,7 @@
  * License along with this library; If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
 
@@ -81,6 +82,36 @@ int xenevtchn_restrict(xenevtchn_handle *xce, domid_t domid)
     return osdep_evtchn_restrict(xce, domid);
 }
 
+int xenevtchn_notify_multi(xenevtchn_handle *xce, const evtchn_port_t *ports,
+                           unsigned int nr)
+{
+    unsigned int i;
+    int rc = 0, saved_errno = 0;
+
+    if ( !nr )
+        return 0;
+
+    rc = osdep_evtchn_notify_multi(xce, ports, nr);
+    if ( rc == 0 || errno != EOPNOTSUPP )
+        return rc;
+
+    /* No batched interface: notify the ports one at a time. */
+    rc = 0;
+    for ( i = 0; i < nr; i++ )
+    {
+        if ( xenevtchn_notify(xce, ports[i]) && !rc )
+        {
+            saved_errno = errno;
+            rc = -1;
+        }
+    }
+
+    if ( rc )
+        errno = saved_errno;
+
+    return rc;
+}
+
 /*
  * Local variables:
  * mode: C
@@ -69,6 +69,14 @@ int xenevtchn_notify(xenevtchn_handle *xce, evtchn_port_t port)
     return ioctl(fd, IOCTL_EVTCHN_NOTIFY, &notify);
 }
 
+int osdep_evtchn_notify_multi(xenevtchn_handle *xce,
+                              const evtchn_port_t *ports, unsigned int nr)
+{
+    /* The evtchn device has no batched notify. */
+    errno = EOPNOTSUPP;
+    return -1;
+}
+
 xenevtchn_port_or_error_t xenevtchn_bind_unbound_port(xenevtchn_handle *xce, uint32_t domid)
 {
     int ret, fd = xce->fd;
@@ -97,6 +97,15 @@ int xenevtchn_fd(xenevtchn_handle *xce);
  */
 int xenevtchn_notify(xenevtchn_handle *xce, evtchn_port_t port);
 
+/*
+ * Notify each of the nr given event channels, in a single hypercall where
+ * the platform allows.  Ports notifying the same guest should be adjacent.
+ * All ports are notified even if some fail.  Returns -1 on failure, in
+ * which case errno is set for the first port which could not be notified.
+ */
+int xenevtchn_notify_multi(xenevtchn_handle *xce, const evtchn_port_t *ports,
+                           unsigned int nr);
+
 /*
  * Returns a new event port awaiting interdomain connection from the given
  * domain ID, or -1 on failure, in which case errno will be set appropriately.
@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <inttypes.h>
@@ -115,6 +116,34 @@ int xenevtchn_notify(xenevtchn_handle *xce, evtchn_port_t port)
     return ret;
 }
 
+int osdep_evtchn_notify_multi(xenevtchn_handle *xce,
+                              const evtchn_port_t *ports, unsigned int nr)
+{
+    struct evtchn_send_multi *op;
+    int ret;
+
+    if (nr > EVTCHN_SEND_MULTI_MAX) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    op = malloc(sizeof(*op) + nr * sizeof(op->ports[0]));
+    if (!op)
+        return -1;
+
+    op->nr_ports = nr;
+    memcpy(op->ports, ports, nr * sizeof(op->ports[0]));
+
+    ret = HYPERVISOR_event_channel_op(EVTCHNOP_send_multi, op);
+    free(op);
+
+    if (ret < 0) {
+        errno = -ret;
+        ret = -1;
+    }
+    return ret;
+}
+
 static void evtchn_handler(evtchn_port_t port, struct pt_regs *regs, void *data)
 {
     int fd = (int)(intptr_t)data;
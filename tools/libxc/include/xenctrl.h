@@ -954,6 +954,24 @@ int xc_shadow_control(xc_interface *xch,
                       uint32_t mode,
                       xc_shadow_op_stats_t *stats);
 
+/*
+ * Read-only mapping of the flat log-dirty bitmaps of a domain, see
+ * XENMEM_resource_logdirty_bitmap.  It has to be set up before log-dirty
+ * mode gets enabled, and then serves XEN_DOMCTL_SHADOW_OP_{CLEAN,PEEK}
+ * done with the XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED mode flag.
+ */
+typedef struct xc_logdirty_map xc_logdirty_map_t;
+xc_logdirty_map_t *xc_logdirty_map(xc_interface *xch, uint32_t domid);
+void xc_logdirty_unmap(xc_interface *xch, xc_logdirty_map_t *map);
+/*
+ * The bitmap filled until the last CLEAN if @harvested, or the one pages
+ * are being logged into (as of the last PEEK) otherwise.  *nr_pfns is set to
+ * the number of pfns it covers.
+ */
+const unsigned long *xc_logdirty_bitmap(const xc_logdirty_map_t *map,
+                                        bool harvested,
+                                        unsigned long *nr_pfns);
+
 int xc_sched_credit_domain_set(xc_interface *xch,
                                uint32_t domid,
                                struct xen_domctl_sched_credit *sdom);
@@ -1261,6 +1279,15 @@ typedef struct xen_sysctl_cpuinfo xc_cpuinfo_t;
 int xc_getcpuinfo(xc_interface *xch, int max_cpus,
                   xc_cpuinfo_t *info, int *nr_cpus); 
 
+typedef struct xen_sched_vcpu_stats xc_sched_vcpu_stats_t;
+/*
+ * Fetch the scheduling statistics of up to *nr_vcpus vcpus of a domain.
+ * On return *nr_vcpus holds the number of entries written to @stats.
+ */
+int xc_sched_vcpu_stats(xc_interface *xch, uint32_t domid,
+                        unsigned int *nr_vcpus,
+                        xc_sched_vcpu_stats_t *stats);
+
 int xc_domain_setmaxmem(xc_interface *xch,
                         uint32_t domid,
                         uint64_t max_memkb);
@@ -1300,6 +1327,34 @@ int xc_domain_getvnuma(xc_interface *xch,
 int xc_domain_soft_reset(xc_interface *xch,
                          uint32_t domid);
 
+/*
+ * Move (part of) a domain's memory to a NUMA node, see XEN_DOMCTL_numa_move.
+ * On return, op->gfn and the counters in @op reflect the progress made, also
+ * when an error is returned.
+ */
+typedef struct xen_domctl_numa_move xc_numa_move_t;
+int xc_domain_numa_move(xc_interface *xch,
+                        uint32_t domid,
+                        xc_numa_move_t *op);
+
+/*
+ * Sample which of the @nr_gfns frames from @first_gfn (a multiple of 8) of
+ * an HVM domain were accessed since the previous sample, and start the next
+ * one, see XEN_DOMCTL_sample_accessed.  Bit n of @bitmap, of (@nr_gfns + 7)
+ * / 8 bytes, is set if frame @first_gfn + n was accessed.  @nr_ram and
+ * @nr_accessed, if not NULL, return the number of RAM frames and accessed
+ * frames in the range.  @bitmap may be NULL when only the counts are
+ * wanted.
+ */
+int xc_domain_sample_accessed(xc_interface *xch,
+                              uint32_t domid,
+                              uint64_t first_gfn,
+                              uint64_t nr_gfns,
+                              uint32_t flags,
+                              uint8_t *bitmap,
+                              uint64_t *nr_ram,
+                              uint64_t *nr_accessed);
+
 #if defined(__i386__) || defined(__x86_64__)
 /*
  * PC BIOS standard E820 types and structure.
@@ -1586,6 +1641,26 @@ int xc_tbuf_set_cpu_mask(xc_interface *xch, xc_cpumap_t mask);
 
 int xc_tbuf_set_evt_mask(xc_interface *xch, uint32_t mask);
 
+/**
+ * This function selects what happens when a trace buffer is full: with
+ * XEN_SYSCTL_TBUF_MODE_drop new records are lost, with
+ * XEN_SYSCTL_TBUF_MODE_overwrite the oldest records are overwritten.
+ *
+ * @parm xch a handle to an open hypervisor interface
+ * @parm mode XEN_SYSCTL_TBUF_MODE_*
+ * @return 0 on success, -1 on failure.
+ */
+int xc_tbuf_set_mode(xc_interface *xch, uint32_t mode);
+
+/**
+ * This function retrieves what happens when a trace buffer is full.
+ *
+ * @parm xch a handle to an open hypervisor interface
+ * @parm mode will contain XEN_SYSCTL_TBUF_MODE_*
+ * @return 0 on success, -1 on failure.
+ */
+int xc_tbuf_get_mode(xc_interface *xch, uint32_t *mode);
+
 int xc_domctl(xc_interface *xch, struct xen_domctl *domctl);
 int xc_sysctl(xc_interface *xch, struct xen_sysctl *sysctl);
 
@@ -1943,6 +2018,16 @@ int xc_altp2m_change_gfn(xc_interface *handle, uint32_t domid,
                          xen_pfn_t new_gfn);
 int xc_altp2m_get_vcpu_p2m_idx(xc_interface *handle, uint32_t domid,
                                uint32_t vcpuid, uint16_t *p2midx);
+/*
+ * Create a new view as a copy of an existing one, keeping the superpages
+ * of the source view whole.
+ */
+int xc_altp2m_clone_view(xc_interface *handle, uint32_t domid,
+                         uint16_t src_view_id, uint16_t *view_id);
+/* Read the EPT violation exit and superpage split counters of a view */
+int xc_altp2m_get_view_stats(xc_interface *handle, uint32_t domid,
+                             uint16_t view_id,
+                             xen_hvm_altp2m_view_stats_t *stats);
 
 /** 
  * Mem paging operations.
@@ -2083,6 +2168,23 @@ int xc_memshr_control(xc_interface *xch,
                       uint32_t domid,
                       int enable);
 
+/*
+ * Have the hypervisor look for zero filled pages of the domain in the
+ * background, at rate pages per second, and share them with a single frame.
+ * A rate of 0 stops the scan, XEN_DOMCTL_MEM_SHARING_ZERO_RATE_KEEP only
+ * retrieves the statistics.  Sharing must have been enabled with
+ * xc_memshr_control() first.
+ *
+ * stats, if not NULL, gets the current rate and the statistics of the scan.
+ *
+ * May fail with EINVAL if sharing isn't enabled or the rate is above
+ * XEN_DOMCTL_MEM_SHARING_ZERO_RATE_MAX.
+ */
+int xc_memshr_zero_scan(xc_interface *xch,
+                        uint32_t domid,
+                        uint32_t rate,
+                        struct xen_domctl_mem_sharing_zero_scan *stats);
+
 /* Create a communication ring in which the hypervisor will place ENOMEM
  * notifications.
  *
@@ -2119,6 +2221,12 @@ int xc_memshr_ring_enable(xc_interface *xch,
  */
 int xc_memshr_ring_disable(xc_interface *xch,
                            uint32_t domid);
+/* Have the hypervisor pull the responses off the ring for ENOMEM
+ * communication.
+ * Fails with ENODEV if the ring is not enabled.
+ */
+int xc_memshr_ring_resume(xc_interface *xch,
+                          uint32_t domid);
 
 /*
  * Calls below return EINVAL if sharing has not been enabled for the domain
@@ -687,6 +687,116 @@ int xc_shadow_control(xc_interface *xch,
     return (rc == 0) ? domctl.u.shadow_op.pages : rc;
 }
 
+struct xc_logdirty_map {
+    const struct xen_domctl_logdirty_bitmap_info *info;
+    /* Both bitmaps, mapped contiguously. */
+    void *bitmaps;
+    size_t size;
+    unsigned int nr_res;
+    xenforeignmemory_resource_handle *res[];
+};
+
+xc_logdirty_map_t *xc_logdirty_map(xc_interface *xch, uint32_t domid)
+{
+    struct xen_mem_acquire_resource xmar = { .domid = domid };
+    xenforeignmemory_resource_handle *res;
+    struct xen_domctl_logdirty_bitmap_info *info = NULL;
+    xc_logdirty_map_t *map;
+    unsigned long i, chunk, frames;
+
+    /* How many frames Xen hands out at once. */
+    if ( do_memory_op(xch, XENMEM_acquire_resource, &xmar, sizeof(xmar)) )
+    {
+        PERROR("Could not get the acquire_resource batch size");
+        return NULL;
+    }
+    chunk = xmar.nr_frames ?: 1;
+
+    res = xenforeignmemory_map_resource(xch->fmem, domid,
+                                        XENMEM_resource_logdirty_bitmap,
+                                        0, 0, 1, (void **)&info,
+                                        PROT_READ, 0);
+    /* Quietly, as callers are expected to fall back to copying. */
+    if ( !res )
+        return NULL;
+
+    frames = 2UL * info->nr_frames;
+    map = calloc(1, sizeof(*map) +
+                 (1 + (frames + chunk - 1) / chunk) * sizeof(map->res[0]));
+    if ( !map )
+    {
+        PERROR("Could not allocate log-dirty bitmap mapping");
+        xenforeignmemory_unmap_resource(xch->fmem, res);
+        return NULL;
+    }
+
+    map->info = info;
+    map->res[map->nr_res++] = res;
+
+    /*
+     * Mappings are limited to chunk frames each, so reserve the room for
+     * the bitmaps first and map them piecewise into it.
+     */
+    map->size = frames << XC_PAGE_SHIFT;
+    map->bitmaps = mmap(NULL, map->size, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ( map->bitmaps == MAP_FAILED )
+    {
+        PERROR("Could not reserve %zu bytes for log-dirty bitmaps",
+               map->size);
+        map->bitmaps = NULL;
+        goto err;
+    }
+
+    for ( i = 0; i < frames; i += chunk )
+    {
+        void *addr = map->bitmaps + (i << XC_PAGE_SHIFT);
+
+        res = xenforeignmemory_map_resource(xch->fmem, domid,
+                                            XENMEM_resource_logdirty_bitmap,
+                                            0, 1 + i, min(chunk, frames - i),
+                                            &addr, PROT_READ, MAP_FIXED);
+        if ( !res )
+        {
+            PERROR("Could not map log-dirty bitmaps of d%u", domid);
+            goto err;
+        }
+        map->res[map->nr_res++] = res;
+    }
+
+    return map;
+
+ err:
+    xc_logdirty_unmap(xch, map);
+    return NULL;
+}
+
+void xc_logdirty_unmap(xc_interface *xch, xc_logdirty_map_t *map)
+{
+    if ( !map )
+        return;
+
+    while ( map->nr_res-- )
+        xenforeignmemory_unmap_resource(xch->fmem, map->res[map->nr_res]);
+    if ( map->bitmaps )
+        munmap(map->bitmaps, map->size);
+    free(map);
+}
+
+const unsigned long *xc_logdirty_bitmap(const xc_logdirty_map_t *map,
+                                        bool harvested,
+                                        unsigned long *nr_pfns)
+{
+    unsigned int idx = map->info->harvested;
+
+    if ( !harvested )
+        idx = !idx;
+    *nr_pfns = map->info->nr_pfns;
+
+    return map->bitmaps +
+           ((unsigned long)idx * map->info->nr_frames << XC_PAGE_SHIFT);
+}
+
 int xc_domain_setmaxmem(xc_interface *xch,
                         uint32_t domid,
                         uint64_t max_memkb)
@@ -2321,6 +2431,63 @@ int xc_domain_soft_reset(xc_interface *xch,
     domctl.domain = domid;
     return do_domctl(xch, &domctl);
 }
+
+int xc_domain_numa_move(xc_interface *xch,
+                        uint32_t domid,
+                        xc_numa_move_t *op)
+{
+    int rc;
+    DECLARE_DOMCTL;
+
+    domctl.cmd = XEN_DOMCTL_numa_move;
+    domctl.domain = domid;
+    domctl.u.numa_move = *op;
+
+    rc = do_domctl(xch, &domctl);
+
+    *op = domctl.u.numa_move;
+
+    return rc;
+}
+
+int xc_domain_sample_accessed(xc_interface *xch,
+                              uint32_t domid,
+                              uint64_t first_gfn,
+                              uint64_t nr_gfns,
+                              uint32_t flags,
+                              uint8_t *bitmap,
+                              uint64_t *nr_ram,
+                              uint64_t *nr_accessed)
+{
+    int rc;
+    DECLARE_DOMCTL;
+    DECLARE_HYPERCALL_BOUNCE(bitmap, (nr_gfns + 7) / 8,
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( xc_hypercall_bounce_pre(xch, bitmap) )
+        return -1;
+
+    domctl.cmd = XEN_DOMCTL_sample_accessed;
+    domctl.domain = domid;
+    /* The counters accumulate. */
+    memset(&domctl.u.sample_accessed, 0, sizeof(domctl.u.sample_accessed));
+    domctl.u.sample_accessed.flags = flags;
+    domctl.u.sample_accessed.gfn = first_gfn;
+    domctl.u.sample_accessed.end_gfn = first_gfn + nr_gfns;
+    set_xen_guest_handle(domctl.u.sample_accessed.bitmap, bitmap);
+
+    rc = do_domctl(xch, &domctl);
+
+    xc_hypercall_bounce_post(xch, bitmap);
+
+    if ( nr_ram )
+        *nr_ram = domctl.u.sample_accessed.nr_ram;
+    if ( nr_accessed )
+        *nr_accessed = domctl.u.sample_accessed.nr_accessed;
+
+    return rc;
+}
+
 /*
  * Local variables:
  * mode: C
@@ -41,6 +41,29 @@ int xc_memshr_control(xc_interface *xch,
     return do_domctl(xch, &domctl);
 }
 
+int xc_memshr_zero_scan(xc_interface *xch,
+                        uint32_t domid,
+                        uint32_t rate,
+                        struct xen_domctl_mem_sharing_zero_scan *stats)
+{
+    DECLARE_DOMCTL;
+    struct xen_domctl_mem_sharing_op *op;
+    int rc;
+
+    domctl.cmd = XEN_DOMCTL_mem_sharing_op;
+    domctl.interface_version = XEN_DOMCTL_INTERFACE_VERSION;
+    domctl.domain = domid;
+    op = &(domctl.u.mem_sharing_op);
+    op->op = XEN_DOMCTL_MEM_SHARING_ZERO_SCAN;
+    op->u.zero_scan.rate = rate;
+
+    rc = do_domctl(xch, &domctl);
+    if ( !rc && stats )
+        *stats = op->u.zero_scan;
+
+    return rc;
+}
+
 int xc_memshr_ring_enable(xc_interface *xch,
                           uint32_t domid,
                           uint32_t *port)
@@ -66,6 +89,15 @@ int xc_memshr_ring_disable(xc_interface *xch,
                                NULL);
 }
 
+int xc_memshr_ring_resume(xc_interface *xch,
+                          uint32_t domid)
+{
+    return xc_vm_event_control(xch, domid,
+                               XEN_VM_EVENT_RESUME,
+                               XEN_DOMCTL_VM_EVENT_OP_SHARING,
+                               NULL);
+}
+
 static int xc_memshr_memop(xc_interface *xch, uint32_t domid,
                             xen_mem_sharing_op_t *mso)
 {
@@ -561,6 +561,33 @@ int xc_getcpuinfo(xc_interface *xch, int max_cpus,
     return rc;
 }
 
+int xc_sched_vcpu_stats(xc_interface *xch, uint32_t domid,
+                        unsigned int *nr_vcpus,
+                        xc_sched_vcpu_stats_t *stats)
+{
+    int rc;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BOUNCE(stats, *nr_vcpus * sizeof(*stats),
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+
+    if ( xc_hypercall_bounce_pre(xch, stats) )
+        return -1;
+
+    sysctl.cmd = XEN_SYSCTL_sched_vcpu_stats;
+    sysctl.u.sched_vcpu_stats.domid = domid;
+    sysctl.u.sched_vcpu_stats.nr_vcpus = *nr_vcpus;
+    set_xen_guest_handle(sysctl.u.sched_vcpu_stats.stats, stats);
+
+    rc = do_sysctl(xch, &sysctl);
+
+    xc_hypercall_bounce_post(xch, stats);
+
+    if ( !rc )
+        *nr_vcpus = sysctl.u.sched_vcpu_stats.nr_vcpus;
+
+    return rc;
+}
+
 int xc_livepatch_upload(xc_interface *xch,
                         char *name,
                         unsigned char *payload,
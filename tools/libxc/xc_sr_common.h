@@ -232,6 +232,8 @@ struct xc_sr_context
             unsigned long *deferred_pages;
             unsigned long nr_deferred_pages;
             xc_hypercall_buffer_t dirty_bitmap_hbuf;
+            /* Flat log-dirty bitmaps mapped from Xen, if available. */
+            xc_logdirty_map_t *logdirty_map;
         } save;
 
         struct /* Restore data. */
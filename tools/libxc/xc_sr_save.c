@@ -487,6 +487,58 @@ static int simple_precopy_policy(struct precopy_stats stats, void *user)
 /*
  * Send memory while guest is running.
  */
+/*
+ * Fetch the log-dirty bitmap into dirty_bitmap_hbuf.  With the flat bitmaps
+ * mapped, Xen only has to switch bitmaps with the domain paused rather than
+ * copy the whole bitmap, and the copy is made here instead.
+ */
+static int get_dirty_bitmap(struct xc_sr_context *ctx, unsigned int op,
+                            uint32_t mode, xc_shadow_op_stats_t *stats)
+{
+    xc_interface *xch = ctx->xch;
+    const unsigned long *bitmap;
+    unsigned long nr_pfns;
+
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    if ( ctx->save.logdirty_map )
+    {
+        if ( xc_shadow_control(xch, ctx->domid, op, NULL, 0, NULL,
+                               mode | XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED,
+                               stats) >= 0 )
+        {
+            bitmap = xc_logdirty_bitmap(ctx->save.logdirty_map,
+                                        op == XEN_DOMCTL_SHADOW_OP_CLEAN,
+                                        &nr_pfns);
+            assert(nr_pfns >= ctx->save.p2m_size);
+            memcpy(dirty_bitmap, bitmap, bitmap_size(ctx->save.p2m_size));
+            return 0;
+        }
+
+        if ( errno != EOVERFLOW )
+        {
+            PERROR("Failed to retrieve mapped logdirty bitmap");
+            return -1;
+        }
+
+        /* Pfns beyond the mapped bitmaps got dirty: copy from now on. */
+        DPRINTF("Guest memory map grew, not using mapped logdirty bitmaps");
+        xc_logdirty_unmap(xch, ctx->save.logdirty_map);
+        ctx->save.logdirty_map = NULL;
+    }
+
+    if ( xc_shadow_control(xch, ctx->domid, op,
+                           HYPERCALL_BUFFER(dirty_bitmap), ctx->save.p2m_size,
+                           NULL, mode, stats) != ctx->save.p2m_size )
+    {
+        PERROR("Failed to retrieve logdirty bitmap");
+        return -1;
+    }
+
+    return 0;
+}
+
 static int send_memory_live(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
@@ -546,15 +598,9 @@ static int send_memory_live(struct xc_sr_context *ctx)
         if ( policy_decision != XGS_POLICY_CONTINUE_PRECOPY )
             break;
 
-        if ( xc_shadow_control(
-                 xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
-                 &ctx->save.dirty_bitmap_hbuf, ctx->save.p2m_size,
-                 NULL, 0, &stats) != ctx->save.p2m_size )
-        {
-            PERROR("Failed to retrieve logdirty bitmap");
-            rc = -1;
+        rc = get_dirty_bitmap(ctx, XEN_DOMCTL_SHADOW_OP_CLEAN, 0, &stats);
+        if ( rc )
             goto out;
-        }
 
         policy_stats->dirty_count = stats.dirty_count;
 
@@ -636,16 +682,10 @@ static int suspend_and_send_dirty(struct xc_sr_context *ctx)
     if ( rc )
         goto out;
 
-    if ( xc_shadow_control(
-             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
-             HYPERCALL_BUFFER(dirty_bitmap), ctx->save.p2m_size,
-             NULL, XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats) !=
-         ctx->save.p2m_size )
-    {
-        PERROR("Failed to retrieve logdirty bitmap");
-        rc = -1;
+    rc = get_dirty_bitmap(ctx, XEN_DOMCTL_SHADOW_OP_CLEAN,
+                          XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats);
+    if ( rc )
         goto out;
-    }
 
     if ( ctx->save.live )
     {
@@ -699,15 +739,9 @@ static int verify_frames(struct xc_sr_context *ctx)
     if ( rc )
         goto out;
 
-    if ( xc_shadow_control(
-             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_PEEK,
-             &ctx->save.dirty_bitmap_hbuf, ctx->save.p2m_size,
-             NULL, 0, &stats) != ctx->save.p2m_size )
-    {
-        PERROR("Failed to retrieve logdirty bitmap");
-        rc = -1;
+    rc = get_dirty_bitmap(ctx, XEN_DOMCTL_SHADOW_OP_PEEK, 0, &stats);
+    if ( rc )
         goto out;
-    }
 
     DPRINTF("  Further stats: faults %u, dirty %u",
             stats.fault_count, stats.dirty_count);
@@ -803,6 +837,27 @@ static int setup(struct xc_sr_context *ctx)
         goto err;
     }
 
+    /*
+     * Xen's flat log-dirty bitmaps have to be set up before log-dirty mode
+     * is enabled.  Failing to, e.g. as it is already enabled for VRAM
+     * tracking, just means bitmaps get copied.
+     */
+    if ( ctx->save.live )
+        ctx->save.logdirty_map = xc_logdirty_map(xch, ctx->domid);
+    if ( ctx->save.logdirty_map )
+    {
+        unsigned long nr_pfns;
+
+        xc_logdirty_bitmap(ctx->save.logdirty_map, false, &nr_pfns);
+        if ( nr_pfns < ctx->save.p2m_size )
+        {
+            xc_logdirty_unmap(xch, ctx->save.logdirty_map);
+            ctx->save.logdirty_map = NULL;
+        }
+    }
+    if ( ctx->save.live && !ctx->save.logdirty_map )
+        DPRINTF("Not using mapped logdirty bitmaps");
+
     rc = 0;
 
  err:
@@ -819,6 +874,8 @@ static void cleanup(struct xc_sr_context *ctx)
     xc_shadow_control(xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_OFF,
                       NULL, 0, NULL, 0, NULL);
 
+    xc_logdirty_unmap(xch, ctx->save.logdirty_map);
+
     if ( ctx->save.ops.cleanup(ctx) )
         PERROR("Failed to clean up");
 
@@ -76,6 +76,7 @@ static int write_hvm_params(struct xc_sr_context *ctx)
         HVM_PARAM_NR_IOREQ_SERVER_PAGES,
         HVM_PARAM_X87_FIP_WIDTH,
         HVM_PARAM_MCA_CAP,
+        HVM_PARAM_HALT_POLL_NS,
     };
 
     xc_interface *xch = ctx->xch;
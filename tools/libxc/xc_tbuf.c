@@ -170,3 +170,31 @@ int xc_tbuf_set_evt_mask(xc_interface *xch, uint32_t mask)
     return do_sysctl(xch, &sysctl);
 }
 
+int xc_tbuf_set_mode(xc_interface *xch, uint32_t mode)
+{
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_tbuf_op;
+    sysctl.interface_version = XEN_SYSCTL_INTERFACE_VERSION;
+    sysctl.u.tbuf_op.cmd  = XEN_SYSCTL_TBUFOP_set_mode;
+    sysctl.u.tbuf_op.mode = mode;
+
+    return do_sysctl(xch, &sysctl);
+}
+
+int xc_tbuf_get_mode(xc_interface *xch, uint32_t *mode)
+{
+    int rc;
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_tbuf_op;
+    sysctl.interface_version = XEN_SYSCTL_INTERFACE_VERSION;
+    sysctl.u.tbuf_op.cmd  = XEN_SYSCTL_TBUFOP_get_info;
+
+    rc = do_sysctl(xch, &sysctl);
+    if ( rc == 0 )
+        *mode = sysctl.u.tbuf_op.mode;
+
+    return rc;
+}
+
@@ -317,6 +317,13 @@
  */
 #define LIBXL_HAVE_SCHED_CREDIT_MIGR_DELAY
 
+/*
+ * LIBXL_HAVE_SCHED_CREDIT2_LATENCY_CLASS indicates that there is a field
+ * in libxl_domain_sched_params called latency_class which, with Credit2,
+ * lets the vCPUs of the domain preempt others as soon as they wake up.
+ */
+#define LIBXL_HAVE_SCHED_CREDIT2_LATENCY_CLASS 1
+
 /*
  * LIBXL_HAVE_VIRIDIAN_CRASH_CTL indicates that the 'crash_ctl' value
  * is present in the viridian enlightenment enumeration.
@@ -1110,6 +1117,35 @@ void libxl_mac_copy(libxl_ctx *ctx, libxl_mac *dst, const libxl_mac *src);
 #define LIBXL_HAVE_MCA_CAPS 1
 #endif
 
+/*
+ * LIBXL_HAVE_BUILDINFO_HVM_HALT_POLL_NS
+ *
+ * If this is defined, libxl_domain_build_info's u.hvm has the halt_poll_ns
+ * field, bounding how long (in ns) a halted vCPU may busy-wait for an
+ * interrupt before blocking.  LIBXL_HALT_POLL_DEFAULT means to use the
+ * hypervisor's default.
+ */
+#define LIBXL_HAVE_BUILDINFO_HVM_HALT_POLL_NS 1
+#define LIBXL_HALT_POLL_DEFAULT (~(uint32_t)0)
+
+/*
+ * LIBXL_HAVE_DOMAIN_NUMA_MOVE
+ *
+ * If this is defined, libxl_domain_numa_pages() and libxl_domain_numa_move()
+ * are available, to find out how much of a domain's memory is on a NUMA node
+ * and to move it there.
+ */
+#define LIBXL_HAVE_DOMAIN_NUMA_MOVE 1
+
+/*
+ * LIBXL_HAVE_DOMAIN_WORKING_SET
+ *
+ * If this is defined, libxl_domain_working_set() and
+ * libxl_domain_working_set_stop() are available, to measure how much of a
+ * domain's memory it is actually using.
+ */
+#define LIBXL_HAVE_DOMAIN_WORKING_SET 1
+
 /*
  * LIBXL_HAVE_PCITOPOLOGY
  *
@@ -1797,6 +1833,35 @@ int libxl_wait_for_free_memory(libxl_ctx *ctx, uint32_t domid, uint64_t memory_k
  * time for the guest to reach its target as an argument.
  */
 int libxl_wait_for_memory_target(libxl_ctx *ctx, uint32_t domid, int wait_secs);
+/*
+ * Count the pages of (HVM or PVH) domain's RAM which are on NUMA node @node
+ * and those which are elsewhere.
+ */
+int libxl_domain_numa_pages(libxl_ctx *ctx, uint32_t domid, int node,
+                            uint64_t *on_node, uint64_t *off_node);
+/*
+ * Move up to @max_pages pages of a domain's RAM to NUMA node @node, copying
+ * them.  The domain's memory is scanned from guest frame *@cursor onwards,
+ * wrapping around at its end, and *@cursor is updated for a subsequent call
+ * to carry on from.  The number of pages moved is returned in *@moved.
+ * The domain is briefly paused while its pages are replaced.
+ * Returns ERROR_NI for PV domains and for ones using passed through
+ * devices or altp2m.
+ */
+int libxl_domain_numa_move(libxl_ctx *ctx, uint32_t domid, int node,
+                           uint64_t max_pages, uint64_t *cursor,
+                           uint64_t *moved);
+/*
+ * Sample the working set of an HVM domain: *@accessed_kb is set to the
+ * amount of its RAM accessed since the previous call, out of *@ram_kb, from
+ * the accessed bits of its p2m.  The first call starts tracking accesses,
+ * and counts all the RAM as accessed.  Returns ERROR_NI if the hardware or
+ * the domain's configuration doesn't allow it.
+ */
+int libxl_domain_working_set(libxl_ctx *ctx, uint32_t domid,
+                             uint64_t *accessed_kb, uint64_t *ram_kb);
+/* Stop tracking the accesses of a domain to its RAM. */
+int libxl_domain_working_set_stop(libxl_ctx *ctx, uint32_t domid);
 
 #if defined(LIBXL_API_VERSION) && LIBXL_API_VERSION < 0x040800
 #define libxl_get_memory_target libxl_get_memory_target_0x040700
@@ -2479,6 +2544,7 @@ int libxl_sched_credit2_params_set(libxl_ctx *ctx, uint32_t poolid,
 #define LIBXL_DOMAIN_SCHED_PARAM_LATENCY_DEFAULT   -1
 #define LIBXL_DOMAIN_SCHED_PARAM_EXTRATIME_DEFAULT -1
 #define LIBXL_DOMAIN_SCHED_PARAM_BUDGET_DEFAULT    -1
+#define LIBXL_DOMAIN_SCHED_PARAM_LATENCY_CLASS_DEFAULT -1
 
 /* Per-VCPU parameters */
 #define LIBXL_SCHED_PARAM_VCPU_INDEX_DEFAULT   -1
@@ -640,6 +640,143 @@ out:
     return rc;
 }
 
+static int libxl__domain_numa_move(libxl__gc *gc, uint32_t domid,
+                                   xc_numa_move_t *op)
+{
+    int r;
+
+    r = xc_domain_numa_move(CTX->xch, domid, op);
+    if (r) {
+        if (errno == EOPNOTSUPP)
+            return ERROR_NI;
+        LOGED(ERROR, domid, "Moving memory to node %u", op->node);
+        return ERROR_FAIL;
+    }
+
+    return 0;
+}
+
+int libxl_domain_numa_pages(libxl_ctx *ctx, uint32_t domid, int node,
+                            uint64_t *on_node, uint64_t *off_node)
+{
+    GC_INIT(ctx);
+    xc_numa_move_t op = {
+        .flags = XEN_DOMCTL_NUMA_MOVE_dry_run,
+        .node = node,
+        .end_gfn = ~0ULL,
+    };
+    int rc;
+
+    rc = libxl__domain_numa_move(gc, domid, &op);
+    if (!rc) {
+        *on_node = op.nr_local;
+        *off_node = op.nr_moved + op.nr_busy;
+    }
+
+    GC_FREE;
+    return rc;
+}
+
+int libxl_domain_numa_move(libxl_ctx *ctx, uint32_t domid, int node,
+                           uint64_t max_pages, uint64_t *cursor,
+                           uint64_t *moved)
+{
+    GC_INIT(ctx);
+    xc_numa_move_t op = {
+        .node = node,
+        .gfn = *cursor,
+        .max_moved = max_pages,
+    };
+    xen_pfn_t max_gpfn;
+    int rc;
+
+    if (xc_domain_maximum_gpfn(CTX->xch, domid, &max_gpfn) < 0) {
+        LOGED(ERROR, domid, "Getting the maximum guest frame");
+        rc = ERROR_FAIL;
+        goto out;
+    }
+
+    /* From the cursor to the end, then from the start up to the cursor. */
+    if (op.gfn > max_gpfn)
+        op.gfn = 0;
+    op.end_gfn = max_gpfn + 1;
+    rc = libxl__domain_numa_move(gc, domid, &op);
+    if (!rc && op.gfn == op.end_gfn && *cursor &&
+        (!max_pages || op.nr_moved < max_pages)) {
+        op.end_gfn = *cursor;
+        op.gfn = 0;
+        rc = libxl__domain_numa_move(gc, domid, &op);
+    }
+    if (rc)
+        goto out;
+
+    *cursor = op.gfn > max_gpfn ? 0 : op.gfn;
+    *moved = op.nr_moved;
+
+out:
+    GC_FREE;
+    return rc;
+}
+
+static int libxl__domain_sample_accessed(libxl__gc *gc, uint32_t domid,
+                                         uint64_t nr_gfns, uint32_t flags,
+                                         uint64_t *nr_ram,
+                                         uint64_t *nr_accessed)
+{
+    int r;
+
+    r = xc_domain_sample_accessed(CTX->xch, domid, 0, nr_gfns, flags, NULL,
+                                  nr_ram, nr_accessed);
+    if (r) {
+        if (errno == EOPNOTSUPP)
+            return ERROR_NI;
+        LOGED(ERROR, domid, "Sampling accessed pages");
+        return ERROR_FAIL;
+    }
+
+    return 0;
+}
+
+int libxl_domain_working_set(libxl_ctx *ctx, uint32_t domid,
+                             uint64_t *accessed_kb, uint64_t *ram_kb)
+{
+    GC_INIT(ctx);
+    uint64_t nr_ram, nr_accessed;
+    xen_pfn_t max_gpfn;
+    int rc;
+
+    if (xc_domain_maximum_gpfn(CTX->xch, domid, &max_gpfn) < 0) {
+        LOGED(ERROR, domid, "Getting the maximum guest frame");
+        rc = ERROR_FAIL;
+        goto out;
+    }
+
+    rc = libxl__domain_sample_accessed(gc, domid, max_gpfn + 1, 0,
+                                       &nr_ram, &nr_accessed);
+    if (rc)
+        goto out;
+
+    *accessed_kb = nr_accessed << (XC_PAGE_SHIFT - 10);
+    *ram_kb = nr_ram << (XC_PAGE_SHIFT - 10);
+
+out:
+    GC_FREE;
+    return rc;
+}
+
+int libxl_domain_working_set_stop(libxl_ctx *ctx, uint32_t domid)
+{
+    GC_INIT(ctx);
+    int rc;
+
+    rc = libxl__domain_sample_accessed(gc, domid, 0,
+                                       XEN_DOMCTL_SAMPLE_ACCESSED_stop,
+                                       NULL, NULL);
+
+    GC_FREE;
+    return rc;
+}
+
 /*
  * Local variables:
  * mode: C
@@ -415,6 +415,7 @@ static int sched_credit2_domain_get(libxl__gc *gc, uint32_t domid,
     scinfo->sched = LIBXL_SCHEDULER_CREDIT2;
     scinfo->weight = sdom.weight;
     scinfo->cap = sdom.cap;
+    scinfo->latency_class = !!(sdom.flags & XEN_DOMCTL_SCHEDCR2_latency);
 
     return 0;
 }
@@ -460,6 +461,14 @@ static int sched_credit2_domain_set(libxl__gc *gc, uint32_t domid,
         sdom.cap = scinfo->cap;
     }
 
+    if (scinfo->latency_class !=
+        LIBXL_DOMAIN_SCHED_PARAM_LATENCY_CLASS_DEFAULT) {
+        if (scinfo->latency_class)
+            sdom.flags |= XEN_DOMCTL_SCHEDCR2_latency;
+        else
+            sdom.flags &= ~XEN_DOMCTL_SCHEDCR2_latency;
+    }
+
     rc = xc_sched_credit2_domain_set(CTX->xch, domid, &sdom);
     if ( rc < 0 ) {
         LOGED(ERROR, domid, "Setting domain sched credit2");
@@ -420,6 +420,12 @@ static int hvm_set_conf_params(libxl__gc *gc, uint32_t domid,
             LOG(ERROR, "Couldn't set HVM_PARAM_MCA_CAP");
             goto out;
         }
+        if (info->u.hvm.halt_poll_ns != LIBXL_HALT_POLL_DEFAULT &&
+            xc_hvm_param_set(xch, domid, HVM_PARAM_HALT_POLL_NS,
+                             info->u.hvm.halt_poll_ns)) {
+            LOG(ERROR, "Couldn't set HVM_PARAM_HALT_POLL_NS");
+            goto out;
+        }
 
         /* Fallthrough */
     case LIBXL_DOMAIN_TYPE_PVH:
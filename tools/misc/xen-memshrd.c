@@ -0,0 +1,698 @@
+/*
+ * xen-memshrd: share identical pages of HVM guests.
+ *
+ * Guest memory is read through foreign mappings, and a hash of the contents
+ * of every page is kept in an index.  Pages hashing like an indexed one get
+ * nominated for sharing, which makes them read-only, compared byte for byte
+ * and then shared through xc_memshr_share_gfns().  How many guest pages get
+ * mapped per second and the share of CPU time used are both bounded.
+ *
+ * Unsharing a page needs a free page, and without a sharing ring the
+ * hypervisor crashes a domain it fails to unshare a page for.  Leave enough
+ * memory free, or have something like xen-lowmemd around.  With -a, guests
+ * are only picked up once a helper has set up their sharing ring.
+ *
+ * Statistics, among which the number of MFNs saved host-wide, are written
+ * in text form to whoever connects to the daemon's socket.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <xenctrl.h>
+#include <xen-tools/libs.h>
+#include <xenforeignmemory.h>
+
+#define PAGE_SIZE           XC_PAGE_SIZE
+#define MAX_BATCH           1024
+/* How many index slots are looked at for a given hash. */
+#define INDEX_PROBES        8
+/* How often the list of domains gets refreshed with -a, in seconds. */
+#define REFRESH_INTERVAL    10
+
+struct index_entry {
+    uint64_t hash;
+    xen_pfn_t gfn;
+    uint32_t domid;         /* DOMID_INVALID for a free slot. */
+};
+
+struct dom {
+    uint32_t domid;
+    bool seen;
+    bool unsharable;        /* Sharing can't be enabled, leave it alone. */
+    bool no_ring;           /* No sharing ring yet, see has_ring(). */
+    xen_pfn_t next_gfn, max_gfn;
+
+    /* Statistics */
+    uint64_t scanned, candidates, shared, passes;
+};
+
+/* A page of the current batch hashing like an indexed one. */
+struct candidate {
+    xen_pfn_t gfn;
+    struct index_entry *entry;
+};
+
+static xc_interface *xch;
+static xenforeignmemory_handle *fmem;
+
+static struct index_entry *index_tab;
+static unsigned long index_size = 1UL << 20, index_used;
+
+static struct dom *doms;
+static unsigned int nr_doms;
+static bool all_doms;
+static uint32_t *want_doms;
+static unsigned int nr_want_doms;
+
+static unsigned int batch = 256;
+static unsigned long rate = 25600;      /* Guest pages mapped per second. */
+static unsigned int cpu_pct = 10;
+static const char *sock_path = XEN_RUN_DIR "/xen-memshrd.sock";
+static int sock_fd = -1;
+static bool verbose;
+
+static volatile sig_atomic_t interrupted;
+
+/* Budget accounting, over windows of one second. */
+static struct timespec window_start, window_cpu;
+static unsigned long window_pages;
+
+static void close_handler(int sig)
+{
+    interrupted = sig;
+}
+
+static uint64_t ts_ns(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static uint64_t now_ns(clockid_t clk, struct timespec *ts)
+{
+    struct timespec tmp;
+
+    if ( !ts )
+        ts = &tmp;
+    clock_gettime(clk, ts);
+
+    return ts_ns(ts);
+}
+
+/* 64-bit FNV-1a, a word at a time. */
+static uint64_t page_hash(const void *page)
+{
+    const uint64_t *p = page;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    unsigned int i;
+
+    for ( i = 0; i < PAGE_SIZE / sizeof(*p); i++ )
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return h ^ (h >> 29);
+}
+
+static struct index_entry *index_lookup(uint64_t hash)
+{
+    unsigned long i;
+
+    for ( i = 0; i < INDEX_PROBES; i++ )
+    {
+        struct index_entry *e = &index_tab[(hash + i) & (index_size - 1)];
+
+        if ( e->domid != DOMID_INVALID && e->hash == hash )
+            return e;
+    }
+
+    return NULL;
+}
+
+static void index_insert(uint64_t hash, uint32_t domid, xen_pfn_t gfn)
+{
+    struct index_entry *e = NULL;
+    unsigned long i;
+
+    for ( i = 0; i < INDEX_PROBES; i++ )
+    {
+        e = &index_tab[(hash + i) & (index_size - 1)];
+        if ( e->domid == DOMID_INVALID )
+        {
+            index_used++;
+            break;
+        }
+    }
+
+    /* With no free slot, the last one probed gets evicted. */
+    e->hash = hash;
+    e->domid = domid;
+    e->gfn = gfn;
+}
+
+static void index_drop_domain(uint32_t domid)
+{
+    unsigned long i;
+
+    for ( i = 0; i < index_size; i++ )
+        if ( index_tab[i].domid == domid )
+        {
+            index_tab[i].domid = DOMID_INVALID;
+            index_used--;
+        }
+}
+
+/*
+ * Whether something listens for ENOMEM on the sharing ring of the domain.
+ * Resuming the ring only pulls off responses the helper has queued, which
+ * its next notification would have done anyway.
+ */
+static bool has_ring(uint32_t domid)
+{
+    return !xc_memshr_ring_resume(xch, domid);
+}
+
+static void enable_sharing(struct dom *d)
+{
+    if ( xc_memshr_control(xch, d->domid, 1) )
+    {
+        fprintf(stderr, "d%u: can't enable sharing: %s\n",
+                d->domid, strerror(errno));
+        d->unsharable = true;
+    }
+}
+
+static struct dom *add_domain(uint32_t domid)
+{
+    struct dom *d, *tmp;
+    unsigned int i;
+
+    for ( i = 0; i < nr_doms; i++ )
+        if ( doms[i].domid == domid )
+        {
+            d = &doms[i];
+            if ( d->no_ring && has_ring(domid) )
+            {
+                if ( verbose )
+                    printf("d%u: sharing ring set up\n", domid);
+                d->no_ring = false;
+                enable_sharing(d);
+            }
+            return d;
+        }
+
+    tmp = realloc(doms, (nr_doms + 1) * sizeof(*doms));
+    if ( !tmp )
+        return NULL;
+    doms = tmp;
+
+    d = &doms[nr_doms++];
+    memset(d, 0, sizeof(*d));
+    d->domid = domid;
+
+    /* Guests named with -d are taken as they are. */
+    if ( all_doms && !has_ring(domid) )
+    {
+        fprintf(stderr, "d%u: no sharing ring, skipped for now\n", domid);
+        d->no_ring = true;
+    }
+    else
+        enable_sharing(d);
+
+    return d;
+}
+
+static void remove_domain(struct dom *d)
+{
+    if ( verbose )
+        printf("d%u: gone\n", d->domid);
+
+    index_drop_domain(d->domid);
+    *d = doms[--nr_doms];
+}
+
+/* Pick up the HVM guests which got created, and forget dead ones. */
+static void refresh_domains(void)
+{
+    xc_dominfo_t info[64];
+    uint32_t next = 1;
+    unsigned int i;
+    int n;
+
+    for ( i = 0; i < nr_doms; i++ )
+        doms[i].seen = false;
+
+    while ( (n = xc_domain_getinfo(xch, next, ARRAY_SIZE(info), info)) > 0 )
+    {
+        for ( i = 0; i < n; i++ )
+        {
+            struct dom *d;
+
+            if ( !info[i].hvm || info[i].dying || info[i].shutdown )
+                continue;
+
+            d = add_domain(info[i].domid);
+            if ( d )
+                d->seen = true;
+        }
+
+        next = info[n - 1].domid + 1;
+    }
+
+    for ( i = 0; i < nr_doms; )
+        if ( !doms[i].seen )
+            remove_domain(&doms[i]);
+        else
+            i++;
+}
+
+/* Returns whether the two gfns were made to share a frame. */
+static bool share_candidate(struct dom *d, struct candidate *c, uint64_t hash)
+{
+    struct index_entry *e = c->entry;
+    uint64_t sh, ch;
+    void *src, *dst;
+    int err;
+    bool same;
+
+    if ( xc_memshr_nominate_gfn(xch, e->domid, e->gfn, &sh) )
+    {
+        /* The indexed page went away or can't be shared, replace it. */
+        *e = (struct index_entry){ hash, c->gfn, d->domid };
+        return false;
+    }
+
+    if ( xc_memshr_nominate_gfn(xch, d->domid, c->gfn, &ch) )
+        return false;
+
+    /* Both already point to the same frame. */
+    if ( sh == ch )
+        return false;
+
+    /* The pages are read-only now, so comparing them is conclusive. */
+    src = xenforeignmemory_map(fmem, e->domid, PROT_READ, 1, &e->gfn, &err);
+    if ( !src )
+        return false;
+    dst = xenforeignmemory_map(fmem, d->domid, PROT_READ, 1, &c->gfn, &err);
+    if ( !dst )
+    {
+        xenforeignmemory_unmap(fmem, src, 1);
+        return false;
+    }
+
+    same = !memcmp(src, dst, PAGE_SIZE);
+
+    xenforeignmemory_unmap(fmem, dst, 1);
+    xenforeignmemory_unmap(fmem, src, 1);
+
+    if ( !same )
+    {
+        /* A collision, or a stale entry: index the most recent page. */
+        *e = (struct index_entry){ hash, c->gfn, d->domid };
+        return false;
+    }
+
+    if ( xc_memshr_share_gfns(xch, e->domid, e->gfn, sh,
+                              d->domid, c->gfn, ch) )
+    {
+        if ( errno == -XENMEM_SHARING_OP_S_HANDLE_INVALID )
+            *e = (struct index_entry){ hash, c->gfn, d->domid };
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Hash the next batch of pages of the domain.  Returns the number of pages
+ * mapped, or -1 if the domain is gone.
+ */
+static int scan_batch(struct dom *d)
+{
+    xen_pfn_t pfns[MAX_BATCH];
+    int err[MAX_BATCH];
+    struct candidate cand[MAX_BATCH];
+    uint64_t hashes[MAX_BATCH];
+    unsigned int i, n, nr_cand = 0;
+    uint8_t *map;
+
+    if ( d->next_gfn == 0 &&
+         xc_domain_maximum_gpfn(xch, d->domid, &d->max_gfn) < 0 )
+        return errno == ESRCH ? -1 : 0;
+
+    n = batch;
+    if ( d->max_gfn - d->next_gfn + 1 < n )
+        n = d->max_gfn - d->next_gfn + 1;
+
+    for ( i = 0; i < n; i++ )
+        pfns[i] = d->next_gfn + i;
+
+    map = xenforeignmemory_map(fmem, d->domid, PROT_READ, n, pfns, err);
+    if ( !map )
+        return errno == ESRCH ? -1 : 0;
+
+    for ( i = 0; i < n; i++ )
+    {
+        struct index_entry *e;
+        uint64_t hash;
+
+        if ( err[i] )
+            continue;
+
+        hash = page_hash(map + i * PAGE_SIZE);
+        d->scanned++;
+
+        e = index_lookup(hash);
+        if ( !e )
+            index_insert(hash, d->domid, pfns[i]);
+        else if ( e->domid != d->domid || e->gfn != pfns[i] )
+        {
+            cand[nr_cand].gfn = pfns[i];
+            cand[nr_cand].entry = e;
+            hashes[nr_cand++] = hash;
+        }
+    }
+
+    /* Mapped pages can't be nominated, drop the mapping first. */
+    xenforeignmemory_unmap(fmem, map, n);
+
+    for ( i = 0; i < nr_cand; i++ )
+    {
+        d->candidates++;
+        if ( share_candidate(d, &cand[i], hashes[i]) )
+            d->shared++;
+    }
+
+    d->next_gfn += n;
+    if ( d->next_gfn > d->max_gfn )
+    {
+        d->next_gfn = 0;
+        d->passes++;
+        if ( verbose )
+            printf("d%u: pass %"PRIu64" done, %"PRIu64" pages shared\n",
+                   d->domid, d->passes, d->shared);
+    }
+
+    return n;
+}
+
+static void write_stats(int fd)
+{
+    char buf[256];
+    unsigned int i;
+    int len;
+
+    len = snprintf(buf, sizeof(buf),
+                   "saved_mfns %ld\nshared_frames %ld\nindex %lu/%lu\n",
+                   xc_sharing_freed_pages(xch), xc_sharing_used_frames(xch),
+                   index_used, index_size);
+    if ( write(fd, buf, len) != len )
+        return;
+
+    for ( i = 0; i < nr_doms; i++ )
+    {
+        const struct dom *d = &doms[i];
+
+        len = snprintf(buf, sizeof(buf),
+                       "d%u scanned %"PRIu64" candidates %"PRIu64
+                       " shared %"PRIu64" passes %"PRIu64"%s\n",
+                       d->domid, d->scanned, d->candidates, d->shared,
+                       d->passes, d->unsharable ? " unsharable" :
+                       d->no_ring ? " no_ring" : "");
+        if ( write(fd, buf, len) != len )
+            return;
+    }
+}
+
+/* Wait for up to timeout ms, serving stats requests meanwhile. */
+static void wait_serving(unsigned int timeout)
+{
+    struct pollfd pfd = { .fd = sock_fd, .events = POLLIN };
+    uint64_t now = now_ns(CLOCK_MONOTONIC, NULL);
+    uint64_t end = now + timeout * 1000000ULL;
+
+    do {
+        int fd;
+
+        if ( poll(&pfd, 1, (end - now) / 1000000) > 0 &&
+             (fd = accept(sock_fd, NULL, NULL)) >= 0 )
+        {
+            write_stats(fd);
+            close(fd);
+        }
+
+        now = now_ns(CLOCK_MONOTONIC, NULL);
+    } while ( !interrupted && now < end );
+}
+
+/*
+ * Account for pages having been mapped, and sleep for as long as needed to
+ * stay within both the mapping rate and the CPU budget.
+ */
+static void budget(unsigned int pages)
+{
+    struct timespec now, cpu;
+    uint64_t wall, used, need = 0;
+
+    window_pages += pages;
+    wall = now_ns(CLOCK_MONOTONIC, &now) - ts_ns(&window_start);
+    used = now_ns(CLOCK_PROCESS_CPUTIME_ID, &cpu) - ts_ns(&window_cpu);
+
+    if ( rate && window_pages * 1000000000ULL / rate > wall )
+        need = window_pages * 1000000000ULL / rate - wall;
+    if ( cpu_pct && used * 100 / cpu_pct > wall + need )
+        need = used * 100 / cpu_pct - wall;
+
+    wait_serving(need / 1000000);
+
+    if ( wall >= 1000000000ULL )
+    {
+        clock_gettime(CLOCK_MONOTONIC, &window_start);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &window_cpu);
+        window_pages = 0;
+    }
+}
+
+static int open_socket(void)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if ( strlen(sock_path) >= sizeof(addr.sun_path) )
+    {
+        fprintf(stderr, "Socket path too long: %s\n", sock_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, sock_path);
+
+    sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if ( sock_fd < 0 )
+    {
+        perror("socket");
+        return -1;
+    }
+
+    unlink(sock_path);
+    if ( bind(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+         listen(sock_fd, 4) )
+    {
+        perror(sock_path);
+        close(sock_fd);
+        sock_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <-a | -d domid...>\n"
+            "Share identical pages of HVM guests.\n\n"
+            "  -a             all HVM guests with a sharing ring, picking up\n"
+            "                 new ones\n"
+            "  -d <domid>     this guest, may be repeated\n"
+            "  -r <pages/s>   guest pages mapped per second (%lu, 0: no limit)\n"
+            "  -c <percent>   CPU time budget (%u, 0: no limit)\n"
+            "  -b <pages>     pages mapped at once (%u, max %u)\n"
+            "  -i <entries>   index slots, rounded to a power of 2 (%lu)\n"
+            "  -s <path>      statistics socket (%s)\n"
+            "  -v             verbose\n",
+            prog, rate, cpu_pct, batch, MAX_BATCH, index_size, sock_path);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sigaction act = { .sa_handler = close_handler };
+    time_t last_refresh = 0;
+    unsigned long i;
+    int opt, rc = 1;
+
+    while ( (opt = getopt(argc, argv, "ad:r:c:b:i:s:vh")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'a':
+            all_doms = true;
+            break;
+        case 'd':
+        {
+            uint32_t *tmp = realloc(want_doms,
+                                    (nr_want_doms + 1) * sizeof(*tmp));
+
+            if ( !tmp )
+                return 1;
+            want_doms = tmp;
+            want_doms[nr_want_doms++] = strtoul(optarg, NULL, 0);
+            break;
+        }
+        case 'r':
+            rate = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            cpu_pct = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            batch = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            index_size = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            sock_path = optarg;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt != 'h';
+        }
+    }
+
+    if ( all_doms == !!nr_want_doms ||
+         !batch || batch > MAX_BATCH || cpu_pct > 100 || index_size < 2 )
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    while ( index_size & (index_size - 1) )
+        index_size &= index_size - 1;
+
+    index_tab = malloc(index_size * sizeof(*index_tab));
+    if ( !index_tab )
+    {
+        perror("Allocating the index");
+        return 1;
+    }
+    for ( i = 0; i < index_size; i++ )
+        index_tab[i].domid = DOMID_INVALID;
+
+    xch = xc_interface_open(NULL, NULL, 0);
+    fmem = xenforeignmemory_open(NULL, 0);
+    if ( !xch || !fmem )
+    {
+        perror("Failed to open xc or foreignmemory interface");
+        goto out;
+    }
+
+    if ( open_socket() )
+        goto out;
+
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for ( i = 0; i < nr_want_doms; i++ )
+        if ( !add_domain(want_doms[i]) )
+            goto out;
+
+    clock_gettime(CLOCK_MONOTONIC, &window_start);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &window_cpu);
+
+    while ( !interrupted )
+    {
+        unsigned int pages = 0;
+
+        if ( all_doms && time(NULL) - last_refresh >= REFRESH_INTERVAL )
+        {
+            refresh_domains();
+            last_refresh = time(NULL);
+        }
+
+        for ( i = 0; i < nr_doms; )
+        {
+            int n = doms[i].unsharable || doms[i].no_ring
+                    ? 0 : scan_batch(&doms[i]);
+
+            if ( n < 0 )
+            {
+                remove_domain(&doms[i]);
+                continue;
+            }
+            pages += n;
+            i++;
+        }
+
+        if ( !nr_doms && !all_doms )
+            break;
+
+        if ( pages )
+            budget(pages);
+        else
+            wait_serving(1000);
+    }
+
+    rc = 0;
+
+ out:
+    if ( sock_fd >= 0 )
+    {
+        close(sock_fd);
+        unlink(sock_path);
+    }
+    if ( fmem )
+        xenforeignmemory_close(fmem);
+    if ( xch )
+        xc_interface_close(xch);
+    free(index_tab);
+    free(want_doms);
+    free(doms);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
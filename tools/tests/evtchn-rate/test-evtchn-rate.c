@@ -0,0 +1,225 @@
+/*
+ * test-evtchn-rate.c
+ *
+ * Measure the rate at which EVTCHNOP_send notifications can be issued.
+ *
+ * The test binds an interdomain event channel to its own domain and then
+ * has a number of threads notify through it concurrently, reporting the
+ * aggregate number of notifications per second.  With -s each thread
+ * gets a loopback channel of its own instead, which shows the cost of the
+ * send path without contention on a single channel.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <xenevtchn.h>
+
+#define MAX_THREADS 64
+
+struct sender {
+    pthread_t thread;
+    xenevtchn_handle *xce;
+    evtchn_port_t port;
+    unsigned int iters;
+    int rc;
+};
+
+static struct sender senders[MAX_THREADS];
+static pthread_barrier_t start_barrier;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-d domid] [-t threads] [-i iterations] [-s]\n"
+            "  -d domid       domain this test runs in (default 0)\n"
+            "  -t threads     number of sending threads (default 4)\n"
+            "  -i iterations  notifications per thread (default 1000000)\n"
+            "  -s             give each thread its own channel\n",
+            prog);
+    exit(2);
+}
+
+/*
+ * Allocate an unbound port for our own domain on @xcr and bind it from
+ * @xcl.  Returns the local (sending) port, or -1 on error.
+ */
+static int bind_loopback(xenevtchn_handle *xcl, xenevtchn_handle *xcr,
+                         unsigned int domid)
+{
+    xenevtchn_port_or_error_t rport, lport;
+
+    rport = xenevtchn_bind_unbound_port(xcr, domid);
+    if ( rport < 0 )
+    {
+        perror("xenevtchn_bind_unbound_port");
+        return -1;
+    }
+
+    lport = xenevtchn_bind_interdomain(xcl, domid, rport);
+    if ( lport < 0 )
+    {
+        perror("xenevtchn_bind_interdomain");
+        return -1;
+    }
+
+    return lport;
+}
+
+static void *send_loop(void *arg)
+{
+    struct sender *s = arg;
+    unsigned int i;
+
+    pthread_barrier_wait(&start_barrier);
+
+    for ( i = 0; i < s->iters; i++ )
+    {
+        if ( xenevtchn_notify(s->xce, s->port) )
+        {
+            perror("xenevtchn_notify");
+            s->rc = 1;
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    xenevtchn_handle *xcr, *xcl[MAX_THREADS] = { NULL };
+    unsigned int domid = 0, threads = 4, iters = 1000000;
+    unsigned int i, nr_handles;
+    bool separate = false;
+    uint64_t start, elapsed;
+    int opt, port = -1, rc = 0;
+
+    while ( (opt = getopt(argc, argv, "d:t:i:sh")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'd':
+            domid = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            threads = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            iters = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            separate = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if ( !threads || threads > MAX_THREADS || !iters )
+        usage(argv[0]);
+
+    nr_handles = separate ? threads : 1;
+
+    xcr = xenevtchn_open(NULL, 0);
+    if ( !xcr )
+    {
+        perror("xenevtchn_open");
+        return 1;
+    }
+
+    for ( i = 0; i < threads; i++ )
+    {
+        if ( i < nr_handles )
+        {
+            xcl[i] = xenevtchn_open(NULL, 0);
+            if ( !xcl[i] )
+            {
+                perror("xenevtchn_open");
+                rc = 1;
+                goto out;
+            }
+
+            port = bind_loopback(xcl[i], xcr, domid);
+            if ( port < 0 )
+            {
+                rc = 1;
+                goto out;
+            }
+        }
+
+        senders[i].xce = xcl[i < nr_handles ? i : 0];
+        senders[i].port = port;
+        senders[i].iters = iters;
+    }
+
+    if ( pthread_barrier_init(&start_barrier, NULL, threads + 1) )
+    {
+        perror("pthread_barrier_init");
+        rc = 1;
+        goto out;
+    }
+
+    for ( i = 0; i < threads; i++ )
+    {
+        if ( pthread_create(&senders[i].thread, NULL, send_loop,
+                            &senders[i]) )
+        {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    start = now_ns();
+
+    for ( i = 0; i < threads; i++ )
+    {
+        pthread_join(senders[i].thread, NULL);
+        rc |= senders[i].rc;
+    }
+
+    elapsed = now_ns() - start;
+
+    printf("%u thread(s), %s channel%s: %.1f ns/send, %.0f sends/s\n",
+           threads, separate ? "separate" : "shared", separate ? "s" : "",
+           (double)elapsed / iters,
+           (double)iters * threads * 1000000000 / elapsed);
+
+    pthread_barrier_destroy(&start_barrier);
+
+ out:
+    /* Closing the handles unbinds every port bound through them. */
+    for ( i = 0; i < nr_handles; i++ )
+        if ( xcl[i] )
+            xenevtchn_close(xcl[i]);
+    xenevtchn_close(xcr);
+
+    return rc;
+}
@@ -0,0 +1,192 @@
+/*
+ * test-logdirty.c
+ *
+ * Check the flat log-dirty bitmaps against the copied ones.
+ *
+ * The test maps the flat bitmaps of a running HVM guest, enables log-dirty
+ * mode and then, every interval, takes a copying PEEK followed by a mapped
+ * CLEAN.  Every page the PEEK reported dirty has to be set in the bitmap
+ * the CLEAN harvested: that one also holds what was drained from the PML
+ * buffers of the vCPUs once the domain got paused.  The time taken by
+ * copying and by mapped CLEANs is reported as well.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <xenctrl.h>
+
+#define BITS_PER_LONG (sizeof(unsigned long) * 8)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-r rounds] [-i interval_ms] domid\n"
+            "  -r rounds       number of PEEK/CLEAN rounds (default 20)\n"
+            "  -i interval_ms  time between rounds (default 100)\n",
+            prog);
+    exit(2);
+}
+
+static int shadow_op(xc_interface *xch, uint32_t domid, unsigned int op,
+                     xc_hypercall_buffer_t *bitmap, unsigned long pages,
+                     uint32_t mode)
+{
+    return xc_shadow_control(xch, domid, op, bitmap, pages, NULL, mode,
+                             NULL);
+}
+
+int main(int argc, char *argv[])
+{
+    xc_interface *xch;
+    xc_logdirty_map_t *map;
+    const unsigned long *flat;
+    unsigned long nr_pfns, i, longs, peeked, missing;
+    unsigned int rounds = 20, interval = 100, r;
+    uint64_t t, copy_ns = 0, mapped_ns = 0;
+    uint32_t domid;
+    int opt, rc = 1;
+    DECLARE_HYPERCALL_BUFFER(unsigned long, bitmap);
+
+    while ( (opt = getopt(argc, argv, "r:i:h")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'r':
+            rounds = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            interval = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if ( optind + 1 != argc || !rounds )
+        usage(argv[0]);
+    domid = strtoul(argv[optind], NULL, 0);
+
+    xch = xc_interface_open(NULL, NULL, 0);
+    if ( !xch )
+    {
+        perror("xc_interface_open");
+        return 1;
+    }
+
+    /* The bitmaps have to be set up before log-dirty mode is enabled. */
+    map = xc_logdirty_map(xch, domid);
+    if ( !map )
+    {
+        fprintf(stderr, "Cannot map the log-dirty bitmaps of d%u\n", domid);
+        goto out_close;
+    }
+    xc_logdirty_bitmap(map, false, &nr_pfns);
+    longs = (nr_pfns + BITS_PER_LONG - 1) / BITS_PER_LONG;
+
+    bitmap = xc_hypercall_buffer_alloc_pages(
+        xch, bitmap, (longs * sizeof(*bitmap) + XC_PAGE_SIZE - 1) /
+        XC_PAGE_SIZE);
+    if ( !bitmap )
+    {
+        perror("xc_hypercall_buffer_alloc_pages");
+        goto out_unmap;
+    }
+
+    if ( shadow_op(xch, domid, XEN_DOMCTL_SHADOW_OP_ENABLE_LOGDIRTY,
+                   NULL, 0, 0) < 0 )
+    {
+        perror("Enabling log-dirty mode");
+        goto out_free;
+    }
+
+    printf("d%u: %lu pfns\n", domid, nr_pfns);
+    printf("%-6s %-10s %-10s\n", "round", "peeked", "harvested");
+
+    for ( r = 0; r < rounds; r++ )
+    {
+        unsigned long harvested = 0;
+
+        usleep(interval * 1000);
+
+        t = now_ns();
+        if ( shadow_op(xch, domid, XEN_DOMCTL_SHADOW_OP_PEEK,
+                       HYPERCALL_BUFFER(bitmap), nr_pfns, 0) < 0 )
+        {
+            perror("PEEK");
+            goto out_off;
+        }
+        copy_ns += now_ns() - t;
+
+        t = now_ns();
+        if ( shadow_op(xch, domid, XEN_DOMCTL_SHADOW_OP_CLEAN, NULL, 0,
+                       XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED) < 0 )
+        {
+            perror("Mapped CLEAN");
+            goto out_off;
+        }
+        mapped_ns += now_ns() - t;
+
+        flat = xc_logdirty_bitmap(map, true, &nr_pfns);
+
+        peeked = missing = 0;
+        for ( i = 0; i < longs; i++ )
+        {
+            peeked += __builtin_popcountl(bitmap[i]);
+            harvested += __builtin_popcountl(flat[i]);
+            missing += __builtin_popcountl(bitmap[i] & ~flat[i]);
+        }
+
+        printf("%-6u %-10lu %-10lu\n", r, peeked, harvested);
+
+        if ( missing )
+        {
+            fprintf(stderr, "round %u: %lu dirty pages missing from the "
+                    "harvested bitmap\n", r, missing);
+            goto out_off;
+        }
+    }
+
+    printf("PEEK (copying): %.1f us, CLEAN (mapped): %.1f us\n",
+           (double)copy_ns / rounds / 1000, (double)mapped_ns / rounds / 1000);
+    rc = 0;
+
+ out_off:
+    shadow_op(xch, domid, XEN_DOMCTL_SHADOW_OP_OFF, NULL, 0, 0);
+ out_free:
+    xc_hypercall_buffer_free_pages(
+        xch, bitmap, (longs * sizeof(*bitmap) + XC_PAGE_SIZE - 1) /
+        XC_PAGE_SIZE);
+ out_unmap:
+    xc_logdirty_unmap(xch, map);
+ out_close:
+    xc_interface_close(xch);
+
+    return rc;
+}
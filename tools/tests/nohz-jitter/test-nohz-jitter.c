@@ -0,0 +1,132 @@
+/*
+ * test-nohz-jitter.c
+ *
+ * Measure the jitter a guest sees on a dedicated vCPU.
+ *
+ * Meant to be run inside a guest whose vCPUs are each assigned a pCPU of
+ * their own by the null scheduler, possibly in nohz mode (sched-null-nohz),
+ * pinned to one vCPU (e.g. with taskset) which nothing else in the guest
+ * runs on.  The test spins reading the clock, and any gap between two
+ * consecutive reads longer than the threshold is counted as the vCPU having
+ * been interrupted, by the hypervisor or by the guest kernel itself.  The
+ * distribution of those gaps is reported, along with how much of the run
+ * they took.  Comparing runs with and without nohz mode shows how much of
+ * the jitter comes from Xen's own periodic work.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Gaps are bucketed by power of two, starting at 1us. */
+#define NR_BUCKETS 21
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-d seconds] [-t threshold]\n"
+            "  -d seconds     how long to run for (default 10)\n"
+            "  -t threshold   shortest gap to count, in ns (default 1000)\n",
+            prog);
+    exit(2);
+}
+
+static unsigned int bucket(uint64_t gap)
+{
+    unsigned int b = 0;
+
+    for ( gap /= 1000; gap > 1 && b < NR_BUCKETS - 1; gap >>= 1 )
+        b++;
+
+    return b;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t hist[NR_BUCKETS] = { 0 };
+    uint64_t threshold = 1000, duration = 10;
+    uint64_t start, end, prev, now, gap;
+    uint64_t reads = 0, nr_gaps = 0, lost = 0, max = 0;
+    unsigned int i;
+    int opt;
+
+    while ( (opt = getopt(argc, argv, "d:t:h")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'd':
+            duration = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            threshold = strtoull(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if ( !duration || !threshold )
+        usage(argv[0]);
+
+    start = prev = now_ns();
+    end = start + duration * 1000000000ull;
+
+    do {
+        now = now_ns();
+        reads++;
+
+        gap = now - prev;
+        if ( gap >= threshold )
+        {
+            hist[bucket(gap)]++;
+            nr_gaps++;
+            lost += gap;
+            if ( gap > max )
+                max = gap;
+        }
+
+        prev = now;
+    } while ( now < end );
+
+    printf("%"PRIu64" clock reads in %"PRIu64"s, %.1f ns/read\n",
+           reads, duration, (double)(now - start) / reads);
+    printf("%"PRIu64" gaps >= %"PRIu64"ns (%.1f/s), max %"PRIu64"ns, "
+           "%.4f%% of the time lost\n",
+           nr_gaps, threshold, (double)nr_gaps / duration, max,
+           (double)lost * 100 / (now - start));
+
+    for ( i = 0; i < NR_BUCKETS; i++ )
+    {
+        if ( !hist[i] )
+            continue;
+        if ( i == NR_BUCKETS - 1 )
+            printf("  >= %10uus: %"PRIu64"\n", 1u << i, hist[i]);
+        else
+            printf("  < %11uus: %"PRIu64"\n", 2u << i, hist[i]);
+    }
+
+    return 0;
+}
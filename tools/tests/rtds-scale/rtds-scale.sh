@@ -0,0 +1,73 @@
+#!/bin/sh
+#
+# Measure how long RTDS scheduling decisions take, against the size of the
+# pool. For each pool size, a pool with that many of the given CPUs is
+# created, the given domains (which should be keeping their vCPUs busy) are
+# moved into it, and a trace is collected and fed to rtds-sched-lat.
+#
+# Run it once per rtds_cluster= setting to compare arrangements.
+#
+# Usage: rtds-scale.sh [-c cpus] [-s sizes] [-t seconds] domain...
+
+cpus=
+sizes="1 2 4 8 16 32"
+secs=10
+pool=rtds-scale
+trace=/tmp/rtds-scale.trace
+lat=$(dirname "$0")/rtds-sched-lat
+
+usage() {
+    echo "Usage: $0 [-c cpus] [-s sizes] [-t seconds] domain..." >&2
+    echo "  -c cpus     CPUs to use, e.g. \"2 3 4 5\" (default: all but CPU 0)" >&2
+    echo "  -s sizes    pool sizes to measure (default: \"$sizes\")" >&2
+    echo "  -t seconds  tracing time for each size (default: $secs)" >&2
+    exit 2
+}
+
+while getopts "c:s:t:" opt; do
+    case $opt in
+    c) cpus=$OPTARG ;;
+    s) sizes=$OPTARG ;;
+    t) secs=$OPTARG ;;
+    *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] || usage
+
+if [ -z "$cpus" ]; then
+    max=$(xl info | awk '/^nr_cpus/ { print $3 }')
+    cpus=$(seq 1 $((max - 1)))
+fi
+
+set -e
+
+for n in $sizes; do
+    pcpus=$(echo $cpus | tr ' ' '\n' | head -n $n)
+    [ $(echo "$pcpus" | wc -l) -eq $n ] || break
+
+    for c in $pcpus; do
+        xl cpupool-cpu-remove Pool-0 $c
+    done
+    xl cpupool-create name=\"$pool\" sched=\"rtds\" \
+        cpus=\"$(echo $pcpus | tr ' ' ',')\" >/dev/null
+    for d in "$@"; do
+        xl cpupool-migrate $d $pool
+    done
+
+    # Only trace scheduler (class) events.
+    xentrace -D -e 0x0002f000 -T $secs $trace
+
+    for d in "$@"; do
+        xl cpupool-migrate $d Pool-0
+    done
+    xl cpupool-destroy $pool
+    for c in $pcpus; do
+        xl cpupool-cpu-add Pool-0 $c
+    done
+
+    printf "pool size %3d: " $n
+    $lat $trace
+done
+
+rm -f $trace
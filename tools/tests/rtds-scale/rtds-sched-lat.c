@@ -0,0 +1,133 @@
+/*
+ * rtds-sched-lat.c
+ *
+ * Summarize how long the RTDS scheduler takes to make its decisions.
+ *
+ * Reads a trace collected with xentrace (from a file, or from stdin) and
+ * reports the distribution of the durations carried by the rtds:sched_done
+ * records, which the scheduler emits at the end of each rt_schedule().
+ * See rtds-scale.sh for collecting traces on pools of increasing size.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <xen/trace.h>
+
+#define TRC_RTDS_SCHED_DONE TRC_SCHED_CLASS_EVT(RTDS, 7)
+#define TRC_HD_EVENT_MASK   ((1U << TRACE_EXTRA_SHIFT) - 1)
+
+#define MAX_CPUS 4096
+
+struct samples {
+    uint32_t *ns;
+    size_t nr, size;
+};
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void add_sample(struct samples *s, uint32_t ns)
+{
+    if ( s->nr == s->size )
+    {
+        s->size = s->size ? s->size * 2 : 65536;
+        s->ns = realloc(s->ns, s->size * sizeof(*s->ns));
+        if ( !s->ns )
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+
+    s->ns[s->nr++] = ns;
+}
+
+int main(int argc, char *argv[])
+{
+    static unsigned char cpu_seen[MAX_CPUS], cluster_seen[MAX_CPUS];
+    struct samples s = { NULL };
+    unsigned int nr_cpus = 0, nr_clusters = 0;
+    uint64_t total = 0;
+    uint32_t hdr, data[TRACE_EXTRA_MAX];
+    FILE *f = stdin;
+
+    if ( argc > 2 )
+    {
+        fprintf(stderr, "Usage: %s [trace-file]\n", argv[0]);
+        return 2;
+    }
+
+    if ( argc == 2 && !(f = fopen(argv[1], "rb")) )
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    /*
+     * All records, including the cpu change ones xentrace inserts, have a
+     * header telling how much data follows, so we can just walk them.
+     */
+    while ( fread(&hdr, sizeof(hdr), 1, f) == 1 )
+    {
+        unsigned int extra = TRC_HD_EXTRA(hdr);
+        uint64_t tsc;
+
+        if ( (hdr & TRC_HD_CYCLE_FLAG) &&
+             fread(&tsc, sizeof(tsc), 1, f) != 1 )
+            break;
+        if ( extra && fread(data, sizeof(data[0]), extra, f) != extra )
+            break;
+
+        if ( (hdr & TRC_HD_EVENT_MASK) != TRC_RTDS_SCHED_DONE || extra < 2 )
+            continue;
+
+        /* data[0] is cpu[15:0] and cluster[31:16], data[1] the duration. */
+        if ( (data[0] & 0xffff) < MAX_CPUS && !cpu_seen[data[0] & 0xffff]++ )
+            nr_cpus++;
+        if ( (data[0] >> 16) < MAX_CPUS && !cluster_seen[data[0] >> 16]++ )
+            nr_clusters++;
+
+        add_sample(&s, data[1]);
+        total += data[1];
+    }
+
+    if ( ferror(f) )
+    {
+        perror("fread");
+        return 1;
+    }
+
+    if ( !s.nr )
+    {
+        fprintf(stderr, "No rtds:sched_done records found\n");
+        return 1;
+    }
+
+    qsort(s.ns, s.nr, sizeof(*s.ns), cmp_u32);
+
+    printf("cpus %u clusters %u samples %zu: mean %"PRIu64" ns, "
+           "p50 %"PRIu32" ns, p99 %"PRIu32" ns, max %"PRIu32" ns\n",
+           nr_cpus, nr_clusters, s.nr, total / s.nr,
+           s.ns[s.nr / 2], s.ns[(s.nr * 99) / 100], s.ns[s.nr - 1]);
+
+    free(s.ns);
+
+    return 0;
+}
@@ -0,0 +1,725 @@
+/*
+ * Stand-ins for the hypervisor environment the schedulers are built
+ * against, so that xen/common/sched/{null,credit,credit2,rt}.c can be
+ * compiled unmodified into the user space simulator.
+ *
+ * The simulation is single threaded: locks only keep count of whether they
+ * are held, "this CPU" is whichever simulated pCPU the harness is acting
+ * on behalf of (sim_cpu), and time is the simulated clock.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHED_SIM_EMUL_H_
+#define _SCHED_SIM_EMUL_H_
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xen/xen.h>
+#include <xen/domctl.h>
+#include <xen/sysctl.h>
+#include <xen/trace.h>
+#include <xen/vcpu.h>
+
+/* Compiler and generic helpers. */
+#define likely(x)                 __builtin_expect(!!(x), 1)
+#define unlikely(x)               __builtin_expect(!!(x), 0)
+#define __read_mostly
+#define __init
+#define __initdata
+#define __cacheline_aligned
+#define __used                    __attribute__((__used__))
+#define __used_section(s)         __attribute__((__used__, __section__("sim_schedulers")))
+#define __maybe_unused            __attribute__((__unused__))
+#define __must_check              __attribute__((__warn_unused_result__))
+#define noinline                  __attribute__((__noinline__))
+#define always_inline             inline __attribute__((__always_inline__))
+#define cpu_relax()               ((void)0)
+#define barrier()                 __asm__ __volatile__ ("" ::: "memory")
+#define smp_mb()                  barrier()
+#define smp_rmb()                 barrier()
+#define smp_wmb()                 barrier()
+#define prefetch(x)               __builtin_prefetch(x)
+#define ACCESS_ONCE(x)            (*(volatile typeof(x) *)&(x))
+#define read_atomic(p)            ACCESS_ONCE(*(p))
+#define write_atomic(p, x)        (ACCESS_ONCE(*(p)) = (x))
+
+#define ASSERT(x)                 assert(x)
+#define ASSERT_UNREACHABLE()      assert(0)
+#define BUG()                     assert(0)
+#define BUG_ON(x)                 assert(!(x))
+#define WARN_ON(x)                ((void)(x))
+#define WARN()                    ((void)0)
+#define BUILD_BUG_ON(x)           ((void)sizeof(char[1 - 2 * !!(x)]))
+
+#define ARRAY_SIZE(a)             (sizeof(a) / sizeof((a)[0]))
+#define IS_ERR_VALUE(x)           ((unsigned long)(x) >= (unsigned long)-4095)
+#define ERR_PTR(e)                ((void *)(long)(e))
+#define PTR_ERR(p)                ((long)(p))
+#define IS_ERR(p)                 IS_ERR_VALUE((unsigned long)(p))
+
+#define container_of(ptr, type, member) ({                      \
+        typeof(((type *)0)->member) *mptr = (ptr);              \
+                                                                \
+        (type *)((char *)mptr - offsetof(type, member));        \
+})
+
+#define min(x, y) ({                    \
+        const typeof(x) tx = (x);       \
+        const typeof(y) ty = (y);       \
+                                        \
+        (void) (&tx == &ty);            \
+        tx < ty ? tx : ty;              \
+})
+
+#define max(x, y) ({                    \
+        const typeof(x) tx = (x);       \
+        const typeof(y) ty = (y);       \
+                                        \
+        (void) (&tx == &ty);            \
+        tx > ty ? tx : ty;              \
+})
+
+#define min_t(type, x, y) ({ type tx = (x); type ty = (y); tx < ty ? tx : ty; })
+#define max_t(type, x, y) ({ type tx = (x); type ty = (y); tx > ty ? tx : ty; })
+
+#define swap(a, b) \
+    do { typeof(a) t_ = (a); (a) = (b); (b) = t_; } while ( 0 )
+
+#define DIV_ROUND_UP(n, d)        (((n) + (d) - 1) / (d))
+#define ROUNDUP(x, a)             (((x) + (a) - 1) & ~((a) - 1))
+
+#include "list.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+#define do_div(n, base) ({                              \
+        uint32_t base_ = (base);                        \
+        uint32_t rem_ = (uint64_t)(n) % base_;          \
+        (n) = (uint64_t)(n) / base_;                    \
+        rem_;                                           \
+})
+
+/* Console. */
+#define XENLOG_INFO               ""
+#define XENLOG_WARNING            ""
+#define XENLOG_ERR                ""
+#define XENLOG_DEBUG              ""
+#define XENLOG_G_INFO             ""
+#define XENLOG_G_WARNING          ""
+#define XENLOG_G_ERR              ""
+#define XENLOG_G_DEBUG            ""
+#define KERN_INFO                 ""
+#define KERN_WARNING              ""
+#define KERN_ERR                  ""
+
+/* Not checked against printf(), as it has extra %p formats. */
+void printk(const char *fmt, ...);
+#define dprintk(lvl, fmt, ...)    printk(fmt, ##__VA_ARGS__)
+#define gdprintk(lvl, fmt, ...)   printk(fmt, ##__VA_ARGS__)
+
+/* Command line parameters: kept at their defaults. */
+#define boolean_param(n, v)       static bool *__used __param_##v = &(v)
+#define integer_param(n, v)       static typeof(v) *__used __param_##v = &(v)
+#define string_param(n, v)        static char *__used __param_##v = (v)
+#define custom_param(n, f)        static int (*__used __param_##f)(const char *) = (f)
+#define __initcall(f)             static int (*__used __initcall_##f)(void) = (f)
+
+/* Memory. */
+#define xmalloc(type)             ((type *)malloc(sizeof(type)))
+#define xzalloc(type)             ((type *)calloc(1, sizeof(type)))
+#define xmalloc_array(type, n)    ((type *)calloc(n, sizeof(type)))
+#define xzalloc_array(type, n)    ((type *)calloc(n, sizeof(type)))
+#define xmalloc_bytes(n)          malloc(n)
+#define xzalloc_bytes(n)          calloc(1, n)
+#define xfree(p)                  free(p)
+
+/* Bit operations, on unsigned long arrays. */
+#define BITS_PER_LONG             (sizeof(long) * 8)
+#define BITS_TO_LONGS(bits)       DIV_ROUND_UP(bits, BITS_PER_LONG)
+#define BIT_WORD(nr)              ((nr) / BITS_PER_LONG)
+#define BIT_MASK(nr)              (1UL << ((nr) % BITS_PER_LONG))
+
+static inline void __set_bit(unsigned int nr, volatile void *addr)
+{
+    ((unsigned long *)addr)[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+static inline void __clear_bit(unsigned int nr, volatile void *addr)
+{
+    ((unsigned long *)addr)[BIT_WORD(nr)] &= ~BIT_MASK(nr);
+}
+
+static inline int test_bit(unsigned int nr, const volatile void *addr)
+{
+    return !!(((const unsigned long *)addr)[BIT_WORD(nr)] & BIT_MASK(nr));
+}
+
+static inline int __test_and_set_bit(unsigned int nr, volatile void *addr)
+{
+    int old = test_bit(nr, addr);
+
+    __set_bit(nr, addr);
+    return old;
+}
+
+static inline int __test_and_clear_bit(unsigned int nr, volatile void *addr)
+{
+    int old = test_bit(nr, addr);
+
+    __clear_bit(nr, addr);
+    return old;
+}
+
+#define set_bit                   __set_bit
+#define clear_bit                 __clear_bit
+#define test_and_set_bit          __test_and_set_bit
+#define test_and_clear_bit        __test_and_clear_bit
+
+/* Atomics. */
+typedef struct { int counter; } atomic_t;
+#define ATOMIC_INIT(i)            { (i) }
+#define atomic_read(v)            ((v)->counter)
+#define atomic_set(v, i)          ((v)->counter = (i))
+#define atomic_inc(v)             ((void)(v)->counter++)
+#define atomic_dec(v)             ((void)(v)->counter--)
+#define atomic_add(i, v)          ((void)((v)->counter += (i)))
+#define atomic_sub(i, v)          ((void)((v)->counter -= (i)))
+#define atomic_inc_return(v)      (++(v)->counter)
+#define atomic_dec_return(v)      (--(v)->counter)
+#define atomic_dec_and_test(v)    (--(v)->counter == 0)
+#define cmpxchg(p, o, n) ({                             \
+        typeof(*(p)) old_ = *(p);                       \
+        if ( old_ == (o) )                              \
+            *(p) = (n);                                 \
+        old_;                                           \
+})
+
+/* CPUs and cpumasks. */
+#define NR_CPUS                   256
+extern unsigned int nr_cpu_ids;
+extern unsigned int sim_cpu;
+#define smp_processor_id()        sim_cpu
+
+typedef struct cpumask {
+    unsigned long bits[BITS_TO_LONGS(NR_CPUS)];
+} cpumask_t;
+typedef cpumask_t *cpumask_var_t;
+
+#define cpumask_bits(m)           ((m)->bits)
+#define nr_cpumask_bits           nr_cpu_ids
+
+extern cpumask_t cpu_online_map;
+extern const cpumask_t cpumask_all;
+#define cpu_online(cpu)           cpumask_test_cpu(cpu, &cpu_online_map)
+#define num_online_cpus()         cpumask_weight(&cpu_online_map)
+
+static inline void cpumask_set_cpu(unsigned int cpu, cpumask_t *m)
+{
+    __set_bit(cpu, m->bits);
+}
+
+static inline void cpumask_clear_cpu(unsigned int cpu, cpumask_t *m)
+{
+    __clear_bit(cpu, m->bits);
+}
+
+#define __cpumask_set_cpu         cpumask_set_cpu
+#define __cpumask_clear_cpu       cpumask_clear_cpu
+
+static inline bool cpumask_test_cpu(unsigned int cpu, const cpumask_t *m)
+{
+    return test_bit(cpu, m->bits);
+}
+
+static inline bool cpumask_test_and_set_cpu(unsigned int cpu, cpumask_t *m)
+{
+    return __test_and_set_bit(cpu, m->bits);
+}
+
+static inline bool cpumask_test_and_clear_cpu(unsigned int cpu, cpumask_t *m)
+{
+    return __test_and_clear_bit(cpu, m->bits);
+}
+
+#define __cpumask_test_and_clear_cpu cpumask_test_and_clear_cpu
+
+#define CPUMASK_OP(name, expr)                                              \
+static inline void cpumask_##name(cpumask_t *d, const cpumask_t *a,         \
+                                  const cpumask_t *b)                       \
+{                                                                           \
+    unsigned int i;                                                         \
+                                                                            \
+    for ( i = 0; i < ARRAY_SIZE(d->bits); i++ )                             \
+        d->bits[i] = (expr);                                                \
+}
+CPUMASK_OP(and, a->bits[i] & b->bits[i])
+CPUMASK_OP(or, a->bits[i] | b->bits[i])
+CPUMASK_OP(xor, a->bits[i] ^ b->bits[i])
+CPUMASK_OP(andnot, a->bits[i] & ~b->bits[i])
+#undef CPUMASK_OP
+
+static inline void cpumask_complement(cpumask_t *d, const cpumask_t *s)
+{
+    unsigned int i;
+
+    for ( i = 0; i < ARRAY_SIZE(d->bits); i++ )
+        d->bits[i] = ~s->bits[i];
+}
+
+static inline void cpumask_copy(cpumask_t *d, const cpumask_t *s)
+{
+    *d = *s;
+}
+
+static inline void cpumask_clear(cpumask_t *m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+static inline void cpumask_setall(cpumask_t *m)
+{
+    unsigned int cpu;
+
+    cpumask_clear(m);
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+        cpumask_set_cpu(cpu, m);
+}
+
+static inline unsigned int cpumask_next(int n, const cpumask_t *m)
+{
+    unsigned int cpu;
+
+    for ( cpu = n + 1; cpu < nr_cpu_ids; cpu++ )
+        if ( cpumask_test_cpu(cpu, m) )
+            return cpu;
+
+    return nr_cpu_ids;
+}
+
+#define cpumask_first(m)          cpumask_next(-1, m)
+
+static inline unsigned int cpumask_last(const cpumask_t *m)
+{
+    unsigned int cpu, last = nr_cpu_ids;
+
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+        if ( cpumask_test_cpu(cpu, m) )
+            last = cpu;
+
+    return last;
+}
+
+static inline unsigned int cpumask_cycle(int n, const cpumask_t *m)
+{
+    unsigned int nxt = cpumask_next(n, m);
+
+    if ( nxt == nr_cpu_ids )
+        nxt = cpumask_first(m);
+
+    return nxt;
+}
+
+static inline unsigned int cpumask_weight(const cpumask_t *m)
+{
+    unsigned int i, w = 0;
+
+    for ( i = 0; i < ARRAY_SIZE(m->bits); i++ )
+        w += __builtin_popcountl(m->bits[i]);
+
+    return w;
+}
+
+static inline bool cpumask_empty(const cpumask_t *m)
+{
+    return !cpumask_weight(m);
+}
+
+static inline bool cpumask_equal(const cpumask_t *a, const cpumask_t *b)
+{
+    return !memcmp(a, b, sizeof(*a));
+}
+
+static inline bool cpumask_intersects(const cpumask_t *a, const cpumask_t *b)
+{
+    unsigned int i;
+
+    for ( i = 0; i < ARRAY_SIZE(a->bits); i++ )
+        if ( a->bits[i] & b->bits[i] )
+            return true;
+
+    return false;
+}
+
+static inline bool cpumask_subset(const cpumask_t *a, const cpumask_t *b)
+{
+    unsigned int i;
+
+    for ( i = 0; i < ARRAY_SIZE(a->bits); i++ )
+        if ( a->bits[i] & ~b->bits[i] )
+            return false;
+
+    return true;
+}
+
+static inline unsigned int cpumask_test_or_cycle(int n, const cpumask_t *m)
+{
+    if ( cpumask_test_cpu(n, m) )
+        return n;
+
+    return cpumask_cycle(n, m);
+}
+
+static inline unsigned int cpumask_any(const cpumask_t *m)
+{
+    return cpumask_first(m);
+}
+
+const cpumask_t *cpumask_of(unsigned int cpu);
+
+static inline bool zalloc_cpumask_var(cpumask_var_t *m)
+{
+    return (*m = calloc(1, sizeof(cpumask_t))) != NULL;
+}
+#define alloc_cpumask_var         zalloc_cpumask_var
+
+static inline void free_cpumask_var(cpumask_var_t m)
+{
+    free(m);
+}
+
+#define for_each_cpu(cpu, m)                                    \
+    for ( (cpu) = cpumask_first(m);                             \
+          (cpu) < nr_cpu_ids;                                   \
+          (cpu) = cpumask_next(cpu, m) )
+#define for_each_online_cpu(cpu)  for_each_cpu(cpu, &cpu_online_map)
+
+#define CPUMASK_PR(m)             nr_cpu_ids, cpumask_bits(m)
+
+/* Topology: sim_cpus_per_core threads per core, sim_cores_per_socket. */
+unsigned int cpu_to_core(unsigned int cpu);
+unsigned int cpu_to_socket(unsigned int cpu);
+unsigned int cpu_to_node(unsigned int cpu);
+
+/* NUMA: a single node. */
+#define MAX_NUMNODES              1
+#define NUMA_NO_NODE              0xff
+typedef struct { unsigned long bits[1]; } nodemask_t;
+extern nodemask_t node_online_map;
+extern cpumask_t node_to_cpumask_map[MAX_NUMNODES];
+#define node_to_cpumask(node)     (node_to_cpumask_map[node])
+#define NUMA_NO_DISTANCE          0xff
+#define cycle_node(n, map)        0
+#define __node_distance(a, b)     10
+#define for_each_online_node(n)   for ( (n) = 0; (n) < MAX_NUMNODES; (n)++ )
+
+/* Per-CPU variables. */
+#define DEFINE_PER_CPU(type, name)        typeof(type) per_cpu__##name[NR_CPUS]
+#define DEFINE_PER_CPU_READ_MOSTLY        DEFINE_PER_CPU
+#define DECLARE_PER_CPU(type, name)       extern typeof(type) per_cpu__##name[NR_CPUS]
+#define per_cpu(name, cpu)                (per_cpu__##name[cpu])
+#define this_cpu(name)                    per_cpu(name, sim_cpu)
+
+DECLARE_PER_CPU(cpumask_var_t, cpu_sibling_mask);
+DECLARE_PER_CPU(cpumask_var_t, cpu_core_mask);
+
+/* Locks. */
+typedef struct { int held; } spinlock_t;
+typedef struct { int held; } rwlock_t;
+
+#define SPIN_LOCK_UNLOCKED        { 0 }
+#define RW_LOCK_UNLOCKED          { 0 }
+#define DEFINE_SPINLOCK(l)        spinlock_t l = SPIN_LOCK_UNLOCKED
+#define DEFINE_RWLOCK(l)          rwlock_t l = RW_LOCK_UNLOCKED
+#define spin_lock_init(l)         ((l)->held = 0)
+#define rwlock_init(l)            ((l)->held = 0)
+
+#define spin_lock(l)              ((void)(l)->held++)
+#define spin_unlock(l)            ((void)(l)->held--)
+#define spin_trylock(l)           ((l)->held++, 1)
+#define spin_is_locked(l)         ((l)->held > 0)
+#define spin_lock_irq(l)          spin_lock(l)
+#define spin_unlock_irq(l)        spin_unlock(l)
+#define spin_lock_irqsave(l, f)   ((f) = 0, spin_lock(l))
+#define spin_unlock_irqrestore(l, f) ((void)(f), spin_unlock(l))
+#define spin_lock_recursive(l)    spin_lock(l)
+#define spin_unlock_recursive(l)  spin_unlock(l)
+
+#define read_lock(l)              ((void)(l)->held++)
+#define read_unlock(l)            ((void)(l)->held--)
+#define read_trylock(l)           ((l)->held++, 1)
+#define write_lock(l)             ((void)(l)->held++)
+#define write_unlock(l)           ((void)(l)->held--)
+#define read_lock_irqsave(l, f)   ((f) = 0, read_lock(l))
+#define read_unlock_irqrestore(l, f) ((void)(f), read_unlock(l))
+#define write_lock_irqsave(l, f)  ((f) = 0, write_lock(l))
+#define write_unlock_irqrestore(l, f) ((void)(f), write_unlock(l))
+#define write_lock_irq(l)         write_lock(l)
+#define write_unlock_irq(l)       write_unlock(l)
+#define rw_is_locked(l)           ((l)->held > 0)
+#define rw_is_write_locked(l)     ((l)->held > 0)
+
+#define local_irq_disable()       ((void)0)
+#define local_irq_enable()        ((void)0)
+#define local_irq_save(f)         ((f) = 0)
+#define local_irq_restore(f)      ((void)(f))
+#define local_irq_is_enabled()    false
+#define in_irq()                  false
+
+/* RCU. */
+typedef struct { int dummy; } rcu_read_lock_t;
+struct rcu_head {
+    struct rcu_head *next;
+    void (*func)(struct rcu_head *head);
+};
+#define DEFINE_RCU_READ_LOCK(x)   rcu_read_lock_t x
+#define rcu_read_lock(x)          ((void)(x))
+#define rcu_read_unlock(x)        ((void)(x))
+#define rcu_dereference(p)        (p)
+#define rcu_assign_pointer(p, v)  ((p) = (v))
+#define call_rcu(h, f)            (f)(h)
+
+/* Time. */
+typedef int64_t s_time_t;
+#define PRI_stime                 PRId64
+#define STIME_MAX                 ((s_time_t)((uint64_t)~0ull >> 1))
+#define STIME_DELTA_MAX           ((s_time_t)((uint64_t)~0ull >> 2))
+#define SECONDS(_s)               ((s_time_t)((_s) * 1000000000ULL))
+#define MILLISECS(_ms)            ((s_time_t)((_ms) * 1000000ULL))
+#define MICROSECS(_us)            ((s_time_t)((_us) * 1000ULL))
+
+extern s_time_t sim_now;
+#define NOW()                     sim_now
+
+/* Timers, run by the simulator's event loop. */
+struct timer {
+    s_time_t expires;
+    void (*function)(void *data);
+    void *data;
+    unsigned int cpu;
+    bool active;
+    bool killed;
+    struct timer *next;
+};
+
+void init_timer(struct timer *timer, void (*function)(void *), void *data,
+                unsigned int cpu);
+void set_timer(struct timer *timer, s_time_t expires);
+void stop_timer(struct timer *timer);
+void migrate_timer(struct timer *timer, unsigned int new_cpu);
+void kill_timer(struct timer *timer);
+
+static inline bool timer_is_active(const struct timer *timer)
+{
+    return timer->active;
+}
+
+static inline bool timer_is_expired(const struct timer *timer)
+{
+    return timer->expires <= NOW();
+}
+
+/* Softirqs: only rescheduling matters to the simulation. */
+enum {
+    TIMER_SOFTIRQ = 0,
+    RCU_SOFTIRQ,
+    SCHED_SLAVE_SOFTIRQ,
+    SCHEDULE_SOFTIRQ,
+    NEW_TLBFLUSH_CLOCK_PERIOD_SOFTIRQ,
+    TASKLET_SOFTIRQ,
+    NR_SOFTIRQS
+};
+
+void cpu_raise_softirq(unsigned int cpu, unsigned int nr);
+void cpumask_raise_softirq(const cpumask_t *mask, unsigned int nr);
+#define raise_softirq(nr)         cpu_raise_softirq(sim_cpu, nr)
+
+/* Tracing is never enabled. */
+#define tb_init_done              false
+#define __trace_var(e, c, s, d)   ((void)(d))
+#define trace_var(e, c, s, d)     ((void)(d))
+#define TRACE_0D(e)               ((void)0)
+#define TRACE_1D(e, ...)          ((void)0)
+#define TRACE_2D(e, ...)          ((void)0)
+#define TRACE_3D(e, ...)          ((void)0)
+#define TRACE_4D(e, ...)          ((void)0)
+#define TRACE_5D(e, ...)          ((void)0)
+#define TRACE_6D(e, ...)          ((void)0)
+
+/* Statistics. */
+#define SCHED_STAT_CRANK(x)       ((void)0)
+#define perfc_incr(x)             ((void)0)
+
+/* Keyhandlers are not wired up. */
+#define register_keyhandler(k, f, d, p) ((void)(f))
+
+/* Guest memory accesses are only done by *_vcpuinfo operations. */
+#define copy_to_guest_offset(h, o, s, n)      (-EFAULT)
+#define copy_from_guest_offset(d, h, o, n)    (-EFAULT)
+#define __copy_to_guest_offset(h, o, s, n)    (-EFAULT)
+#define __copy_from_guest_offset(d, h, o, n)  (-EFAULT)
+#define hypercall_preempt_check() false
+#define hypercall_create_continuation(...)    (-ERESTART)
+#define ERESTART                  85
+
+/* Domains and vCPUs. */
+struct sched_resource;
+struct cpupool;
+
+struct vcpu_runstate_info_sim {
+    int state;
+    uint64_t state_entry_time;
+    uint64_t time[4];
+};
+
+struct vcpu {
+    int vcpu_id;
+    unsigned int processor;
+    struct domain *domain;
+    struct vcpu *next_in_list;
+    struct sched_unit *sched_unit;
+    unsigned long pause_flags;
+    atomic_t pause_count;
+    struct vcpu_runstate_info_sim runstate;
+    int new_state;
+    bool is_running;
+    bool is_urgent;
+    bool force_context_switch;
+    void *sim_priv;             /* The simulator's own per-vCPU state. */
+};
+
+struct domain {
+    domid_t domain_id;
+    unsigned int max_vcpus;
+    struct vcpu **vcpu;
+    struct sched_unit *sched_unit_list;
+    void *sched_priv;
+    struct cpupool *cpupool;
+    struct domain *next_in_list;
+    atomic_t pause_count;
+    bool is_dying;
+    void *sim_priv;
+};
+
+#define is_idle_domain(d)         ((d)->domain_id == DOMID_IDLE)
+#define is_idle_vcpu(v)           (is_idle_domain((v)->domain))
+#define is_vcpu_online(v)         (!test_bit(_VPF_down, &(v)->pause_flags))
+#define is_hardware_domain(d)     false
+#define get_cpu_current(cpu)      sim_cpu_current(cpu)
+#define current                   get_cpu_current(sim_cpu)
+
+#define _VPF_blocked              0
+#define VPF_blocked               (1UL << _VPF_blocked)
+#define _VPF_down                 1
+#define VPF_down                  (1UL << _VPF_down)
+#define _VPF_migrating            3
+#define VPF_migrating             (1UL << _VPF_migrating)
+#define _VPF_parked               8
+#define VPF_parked                (1UL << _VPF_parked)
+
+static inline bool vcpu_runnable(const struct vcpu *v)
+{
+    return !(v->pause_flags |
+             atomic_read(&v->pause_count) |
+             atomic_read(&v->domain->pause_count));
+}
+
+struct sched_unit {
+    struct domain         *domain;
+    struct vcpu           *vcpu_list;
+    void                  *priv;
+    struct sched_unit     *next_in_list;
+    struct sched_resource *res;
+    unsigned int           unit_id;
+    bool                   is_running;
+    bool                   soft_aff_effective;
+    bool                   migrated;
+    uint64_t               state_entry_time;
+    unsigned int           runstate_cnt[4];
+    cpumask_var_t          cpu_hard_affinity;
+    cpumask_var_t          cpu_hard_affinity_saved;
+    cpumask_var_t          cpu_soft_affinity;
+    struct sched_unit     *next_task;
+    s_time_t               next_time;
+    atomic_t               rendezvous_in_cnt;
+    bool                   rendezvous_decided;
+    atomic_t               rendezvous_out_cnt;
+    struct xen_sched_vcpu_stats stats;
+    s_time_t               runnable_since;
+    unsigned int           runnable_cause;
+    bool                   yielded;
+};
+
+#define for_each_sched_unit(d, u)                                         \
+    for ( (u) = (d)->sched_unit_list; (u) != NULL; (u) = (u)->next_in_list )
+
+#define for_each_sched_unit_vcpu(u, v)                                    \
+    for ( (v) = (u)->vcpu_list;                                           \
+          (v) != NULL && (!(u)->next_in_list ||                           \
+                          (v)->vcpu_id < (u)->next_in_list->unit_id);     \
+          (v) = (v)->next_in_list )
+
+#define for_each_vcpu(d, v)                                               \
+    for ( (v) = (d)->vcpu ? (d)->vcpu[0] : NULL;                          \
+          (v) != NULL;                                                    \
+          (v) = (v)->next_in_list )
+
+struct domain *first_domain_in_cpupool(const struct cpupool *c);
+struct domain *next_domain_in_cpupool(struct domain *d,
+                                      const struct cpupool *c);
+#define for_each_domain_in_cpupool(d, c)                                  \
+    for ( (d) = first_domain_in_cpupool(c);                               \
+          (d) != NULL;                                                    \
+          (d) = next_domain_in_cpupool((d), (c)) )
+
+struct vcpu *sim_cpu_current(unsigned int cpu);
+void vcpu_pause_nosync(struct vcpu *v);
+void vcpu_unpause(struct vcpu *v);
+unsigned int cpupool_get_granularity(const struct cpupool *c);
+uint64_t get_cpu_idle_time(unsigned int cpu);
+
+extern bool sched_smt_power_savings;
+
+extern cpumask_t sched_nohz_cpus;
+static inline bool cpu_is_nohz(unsigned int cpu)
+{
+    return cpumask_test_cpu(cpu, &sched_nohz_cpus);
+}
+
+
+#endif /* _SCHED_SIM_EMUL_H_ */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,5 @@
+# Wakeup latency of short, frequent bursts behind CPU hogs, with the
+# latency sensitive domain in credit2's latency class and given a 1ms
+# rtds reservation period.
+name=hog vcpus=8 burst=inf
+name=rt vcpus=2 burst=50us sleep=500us dist=exp latency=1 period=1ms budget=200us
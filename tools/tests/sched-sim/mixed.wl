@@ -0,0 +1,6 @@
+# Two CPU hogs, one with twice the weight of the other, sharing the host
+# with an interactive domain and a batch one.
+name=hog-a vcpus=4 weight=512 burst=inf
+name=hog-b vcpus=4 weight=256 burst=inf
+name=web vcpus=2 burst=300us sleep=2ms dist=exp
+name=batch vcpus=2 burst=20ms sleep=5ms dist=uniform
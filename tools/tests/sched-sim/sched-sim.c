@@ -0,0 +1,1171 @@
+/*
+ * sched-sim.c
+ *
+ * Run Xen's schedulers against a workload in user space, and compare how
+ * they do.
+ *
+ * The null, credit, credit2 and rtds schedulers are built unmodified from
+ * xen/common/sched, on top of the environment in emul.h and sim-core.c,
+ * and driven by a discrete event simulation of a host with a given number
+ * of pCPUs.  Each vCPU of the workload alternates between running for a
+ * while (a burst) and blocking (a sleep), and the simulation tells, for
+ * each scheduler:
+ *  - how much CPU time each domain got, and how fairly CPU bound domains
+ *    were treated with respect to their weight (credit, credit2) or
+ *    reservation (rtds), as Jain's fairness index;
+ *  - the wakeup latency, from a vCPU being woken up to it running;
+ *  - the number of context switches and of migrations;
+ *  - how long the scheduler's do_schedule and wake hooks took, on the host
+ *    running the simulation.
+ * All of this but the last item only depends on the simulated time, and
+ * is the same from one run to the other.
+ *
+ * The workload is either described in a file, one domain per line, as
+ * key=value pairs:
+ *   name=<name>        defaults to d<domid>
+ *   vcpus=<n>          defaults to 1
+ *   weight=<w>         credit and credit2 weight, defaults to 256
+ *   cap=<pct>          credit and credit2 cap
+ *   latency=<0|1>      credit2 latency class
+ *   period=<t>         rtds period, budget=<t> rtds budget
+ *   burst=<t|inf>      how long vCPUs run before blocking, inf for never
+ *   sleep=<t>          how long vCPUs stay blocked
+ *   dist=<fixed|exp|uniform>  distribution of bursts and sleeps around
+ *                      the given means, defaults to fixed
+ *   start=<t>          when the vCPUs come up, defaults to 0
+ * with times in ns, us (the default), ms or s, e.g. 200us; or it is
+ * replayed from a xentrace capture of the sched class runstate changes:
+ * each vCPU of the trace runs and blocks for as long as it did there.
+ * Domain parameters are not part of traces, so every replayed domain gets
+ * the scheduler defaults.
+ *
+ * Each scheduler is run in a child process of its own, so that none of
+ * them sees state left behind by another.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <getopt.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "sim.h"
+
+#define MAX_DOMS         256
+#define MAX_VCPUS        128
+#define DEFAULT_WEIGHT   256
+#define TRC_HD_EVENT_MASK ((1U << TRACE_EXTRA_SHIFT) - 1)
+
+enum dist { DIST_FIXED, DIST_EXP, DIST_UNIFORM };
+
+struct phase {
+    s_time_t burst, sleep;          /* sleep < 0: blocks for good. */
+};
+
+struct samples {
+    s_time_t *ns;
+    unsigned long nr, size;
+};
+
+struct sim_vcpu {
+    struct sim_dom *dom;
+    struct vcpu *v;
+    uint64_t rng;
+
+    /* Replayed from a trace. */
+    struct phase *phases;
+    unsigned int nr_phases, next_phase;
+
+    s_time_t up;                    /* When it comes up, or -1. */
+    s_time_t remaining;             /* Of the current burst. */
+    s_time_t run_start;
+    s_time_t wake_time;             /* -1 if not waiting to run. */
+    unsigned int gen;               /* Invalidates end of burst events. */
+    bool running;
+
+    s_time_t runtime;
+    unsigned long wakeups, switches;
+    struct samples lat;
+};
+
+struct sim_dom {
+    char name[32];
+    domid_t domid;
+    unsigned int nr_vcpus;
+    unsigned int weight, cap, period, budget;
+    bool latency;
+    s_time_t burst, sleep, start;
+    enum dist dist;
+    struct domain *d;
+    struct sim_vcpu *vcpus;
+};
+
+enum ev_type { EV_UP, EV_WAKE, EV_BURST_END };
+
+struct event {
+    s_time_t time;
+    uint64_t seq;
+    enum ev_type type;
+    unsigned int gen;
+    struct sim_vcpu *sv;
+};
+
+static struct sim_dom doms[MAX_DOMS];
+static unsigned int nr_doms;
+
+static struct event *events;
+static unsigned long nr_events, events_size;
+static uint64_t event_seq;
+
+static bool no_host_times;
+
+static void *xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if ( !p )
+    {
+        perror("realloc");
+        exit(1);
+    }
+
+    return p;
+}
+
+static void add_sample(struct samples *s, s_time_t ns)
+{
+    if ( s->nr == s->size )
+    {
+        s->size = s->size ? s->size * 2 : 1024;
+        s->ns = xrealloc(s->ns, s->size * sizeof(*s->ns));
+    }
+
+    s->ns[s->nr++] = ns;
+}
+
+static int cmp_stime(const void *a, const void *b)
+{
+    s_time_t x = *(const s_time_t *)a, y = *(const s_time_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static s_time_t percentile(const struct samples *s, unsigned int pct)
+{
+    return s->nr ? s->ns[((s->nr - 1) * pct) / 100] : 0;
+}
+
+static const char *fmt_time(char *buf, s_time_t ns)
+{
+    if ( ns < 10000 )
+        sprintf(buf, "%"PRI_stime"ns", ns);
+    else if ( ns < MILLISECS(10) )
+        sprintf(buf, "%.1fus", ns / 1e3);
+    else if ( ns < SECONDS(10) )
+        sprintf(buf, "%.1fms", ns / 1e6);
+    else
+        sprintf(buf, "%.1fs", ns / 1e9);
+
+    return buf;
+}
+
+/* Workload generation. */
+static uint64_t rng_next(uint64_t *state)
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static s_time_t draw(struct sim_vcpu *sv, s_time_t mean)
+{
+    double u = (rng_next(&sv->rng) >> 11) * (1.0 / (1ULL << 53));
+    s_time_t t;
+
+    switch ( sv->dom->dist )
+    {
+    case DIST_EXP:
+        t = -log(1 - u) * mean;
+        break;
+    case DIST_UNIFORM:
+        t = 2 * u * mean;
+        break;
+    default:
+        t = mean;
+        break;
+    }
+
+    return t > 0 ? t : 1;
+}
+
+static s_time_t next_burst(struct sim_vcpu *sv)
+{
+    if ( sv->phases )
+        return sv->phases[sv->next_phase].burst;
+
+    return sv->dom->burst == STIME_MAX ? STIME_MAX : draw(sv, sv->dom->burst);
+}
+
+static s_time_t next_sleep(struct sim_vcpu *sv)
+{
+    if ( sv->phases )
+    {
+        s_time_t sleep = sv->phases[sv->next_phase].sleep;
+
+        if ( sleep >= 0 && ++sv->next_phase == sv->nr_phases )
+            sleep = -1;
+        return sleep;
+    }
+
+    return draw(sv, sv->dom->sleep);
+}
+
+/* The event queue, a binary heap ordered by time and then insertion. */
+static bool ev_before(const struct event *a, const struct event *b)
+{
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void ev_push(s_time_t time, enum ev_type type, struct sim_vcpu *sv)
+{
+    unsigned long i, parent;
+    struct event ev = {
+        .time = time, .seq = event_seq++, .type = type, .gen = sv->gen,
+        .sv = sv,
+    };
+
+    if ( nr_events == events_size )
+    {
+        events_size = events_size ? events_size * 2 : 1024;
+        events = xrealloc(events, events_size * sizeof(*events));
+    }
+
+    for ( i = nr_events++; i; i = parent )
+    {
+        parent = (i - 1) / 2;
+        if ( !ev_before(&ev, &events[parent]) )
+            break;
+        events[i] = events[parent];
+    }
+    events[i] = ev;
+}
+
+static struct event ev_pop(void)
+{
+    struct event top = events[0], last = events[--nr_events];
+    unsigned long i = 0, child;
+
+    for ( ; (child = 2 * i + 1) < nr_events; i = child )
+    {
+        if ( child + 1 < nr_events &&
+             ev_before(&events[child + 1], &events[child]) )
+            child++;
+        if ( !ev_before(&events[child], &last) )
+            break;
+        events[i] = events[child];
+    }
+    events[i] = last;
+
+    return top;
+}
+
+/* Account the time sv has been running for, up to now. */
+static void account(struct sim_vcpu *sv)
+{
+    s_time_t delta = NOW() - sv->run_start;
+
+    sv->runtime += delta;
+    if ( sv->remaining != STIME_MAX )
+        sv->remaining -= delta;
+    sv->run_start = NOW();
+}
+
+static void burst_start(struct sim_vcpu *sv)
+{
+    sv->gen++;
+    if ( sv->remaining != STIME_MAX )
+        ev_push(NOW() + sv->remaining, EV_BURST_END, sv);
+}
+
+void sim_context_switch(unsigned int cpu, struct vcpu *prev, struct vcpu *next)
+{
+    struct sim_vcpu *sv;
+
+    if ( !is_idle_vcpu(prev) )
+    {
+        sv = prev->sim_priv;
+        account(sv);
+        sv->running = false;
+        sv->gen++;
+    }
+
+    if ( !is_idle_vcpu(next) )
+    {
+        sv = next->sim_priv;
+        sv->running = true;
+        sv->run_start = NOW();
+        sv->switches++;
+        if ( sv->wake_time >= 0 )
+        {
+            add_sample(&sv->lat, NOW() - sv->wake_time);
+            sv->wake_time = -1;
+        }
+        burst_start(sv);
+    }
+}
+
+static void handle_event(const struct event *ev)
+{
+    struct sim_vcpu *sv = ev->sv;
+    s_time_t sleep;
+
+    switch ( ev->type )
+    {
+    case EV_UP:
+    case EV_WAKE:
+        sv->remaining = next_burst(sv);
+        sv->wake_time = NOW();
+        sv->wakeups++;
+        if ( ev->type == EV_UP )
+            sim_vcpu_up(sv->v);
+        else
+            sim_vcpu_unblock(sv->v);
+        /* Woken up before having had the chance to be descheduled. */
+        if ( sv->running )
+        {
+            sv->wake_time = -1;
+            sv->run_start = NOW();
+            burst_start(sv);
+        }
+        break;
+
+    case EV_BURST_END:
+        if ( ev->gen != sv->gen || !sv->running )
+            break;
+        account(sv);
+        sv->gen++;
+        sleep = next_sleep(sv);
+        sim_vcpu_block(sv->v);
+        if ( sleep >= 0 )
+            ev_push(NOW() + sleep, EV_WAKE, sv);
+        break;
+    }
+}
+
+static int simulate(s_time_t duration)
+{
+    s_time_t next;
+    unsigned int i, j;
+    int rc;
+
+    for ( i = 0; i < nr_doms; i++ )
+        for ( j = 0; j < doms[i].nr_vcpus; j++ )
+            if ( doms[i].vcpus[j].up >= 0 )
+                ev_push(doms[i].vcpus[j].up, EV_UP, &doms[i].vcpus[j]);
+
+    if ( (rc = sim_do_softirqs()) )
+        return rc;
+
+    for ( ; ; )
+    {
+        next = sim_next_timer();
+        if ( nr_events && events[0].time < next )
+            next = events[0].time;
+        if ( next >= duration )
+            break;
+
+        if ( next > sim_now )
+            sim_now = next;
+
+        sim_run_timers();
+        while ( nr_events && events[0].time <= NOW() )
+        {
+            struct event ev = ev_pop();
+
+            handle_event(&ev);
+        }
+
+        if ( (rc = sim_do_softirqs()) )
+            return rc;
+    }
+
+    sim_now = duration;
+    for ( i = 0; i < nr_doms; i++ )
+        for ( j = 0; j < doms[i].nr_vcpus; j++ )
+            if ( doms[i].vcpus[j].running )
+                account(&doms[i].vcpus[j]);
+
+    return 0;
+}
+
+static int set_params(struct sim_dom *dom)
+{
+    struct xen_domctl_scheduler_op op = {
+        .cmd = XEN_DOMCTL_SCHEDOP_putinfo,
+    };
+
+    switch ( sim_scheduler_id() )
+    {
+    case XEN_SCHEDULER_CREDIT:
+        op.u.credit.weight = dom->weight;
+        op.u.credit.cap = dom->cap;
+        break;
+    case XEN_SCHEDULER_CREDIT2:
+        op.u.credit2.weight = dom->weight;
+        op.u.credit2.cap = dom->cap;
+        op.u.credit2.flags = dom->latency ? XEN_DOMCTL_SCHEDCR2_latency : 0;
+        break;
+    case XEN_SCHEDULER_RTDS:
+        if ( !dom->period && !dom->budget )
+            return 0;
+        op.u.rtds.period = dom->period;
+        op.u.rtds.budget = dom->budget;
+        break;
+    default:
+        return 0;
+    }
+
+    return sim_domain_adjust(dom->d, &op);
+}
+
+/* What a domain is entitled to, relative to the others. */
+static double share(const struct sim_dom *dom)
+{
+    switch ( sim_scheduler_id() )
+    {
+    case XEN_SCHEDULER_CREDIT:
+    case XEN_SCHEDULER_CREDIT2:
+        return dom->weight;
+    case XEN_SCHEDULER_RTDS:
+        return dom->period ? (double)dom->budget / dom->period : 0.4;
+    default:
+        return 1;
+    }
+}
+
+static void cost_summary(const char *what, struct sim_cost *c, char *sum,
+                         size_t len)
+{
+    struct samples s = { .ns = (s_time_t *)c->ns, .nr = c->nr };
+    uint64_t total = 0;
+    unsigned long i;
+    char b[3][16];
+
+    if ( !c->nr )
+        return;
+
+    for ( i = 0; i < c->nr; i++ )
+        total += c->ns[i];
+    qsort(s.ns, s.nr, sizeof(*s.ns), cmp_stime);
+
+    printf("%-13s %lu calls, mean %s, p50 %s, p99 %s\n", what, c->nr,
+           fmt_time(b[0], total / c->nr), fmt_time(b[1], percentile(&s, 50)),
+           fmt_time(b[2], percentile(&s, 99)));
+    if ( sum )
+        snprintf(sum, len, "%9s %9s", fmt_time(b[0], percentile(&s, 50)),
+                 fmt_time(b[1], percentile(&s, 99)));
+}
+
+/*
+ * Print the results of the run, and a one line summary of them to
+ * summary, for the comparison between schedulers.
+ */
+static void report(const char *sched, s_time_t duration, FILE *summary)
+{
+    struct samples all = { NULL };
+    unsigned long switches = 0, migrations = 0;
+    double sum_x = 0, sum_x2 = 0;
+    unsigned int i, j, nr_x = 0;
+    char b[4][16], fairness[16] = "-", cost[32] = "        -         -";
+
+    printf("\n== %s, %u pCPUs, %.3fs ==\n", sim_scheduler_name(), nr_cpu_ids,
+           duration / 1e9);
+    printf("%-16s %5s %7s %8s %8s %8s %8s %8s %9s %10s\n", "domain", "vcpus",
+           "cpu%", "wakeups", "lat-p50", "lat-p90", "lat-p99", "lat-max",
+           "switches", "migrations");
+
+    for ( i = 0; i < nr_doms; i++ )
+    {
+        struct sim_dom *dom = &doms[i];
+        struct samples lat = { NULL };
+        unsigned long wakeups = 0, dswitches = 0, dmigrations = 0;
+        s_time_t runtime = 0;
+
+        for ( j = 0; j < dom->nr_vcpus; j++ )
+        {
+            struct sim_vcpu *sv = &dom->vcpus[j];
+            unsigned long k;
+
+            runtime += sv->runtime;
+            wakeups += sv->wakeups;
+            dswitches += sv->switches;
+            dmigrations += sv->v->sched_unit->stats.migrations;
+            for ( k = 0; k < sv->lat.nr; k++ )
+            {
+                add_sample(&lat, sv->lat.ns[k]);
+                add_sample(&all, sv->lat.ns[k]);
+            }
+        }
+        qsort(lat.ns, lat.nr, sizeof(*lat.ns), cmp_stime);
+
+        /* cpu% is relative to one pCPU, as in xentop. */
+        printf("%-16s %5u %7.1f %8lu %8s %8s %8s %8s %9lu %10lu\n",
+               dom->name, dom->nr_vcpus, runtime * 100.0 / duration, wakeups,
+               fmt_time(b[0], percentile(&lat, 50)),
+               fmt_time(b[1], percentile(&lat, 90)),
+               fmt_time(b[2], percentile(&lat, 99)),
+               fmt_time(b[3], percentile(&lat, 100)),
+               dswitches, dmigrations);
+
+        switches += dswitches;
+        migrations += dmigrations;
+
+        /* Fairness is only meaningful among the uncapped CPU hogs. */
+        if ( dom->burst == STIME_MAX && !dom->cap && share(dom) > 0 )
+        {
+            double x = runtime / share(dom);
+
+            sum_x += x;
+            sum_x2 += x * x;
+            nr_x++;
+        }
+
+        free(lat.ns);
+    }
+
+    qsort(all.ns, all.nr, sizeof(*all.ns), cmp_stime);
+
+    if ( nr_x > 1 && sum_x2 > 0 )
+    {
+        snprintf(fairness, sizeof(fairness), "%.4f",
+                 sum_x * sum_x / (nr_x * sum_x2));
+        printf("fairness:     Jain index %s over %u CPU bound domains\n",
+               fairness, nr_x);
+    }
+    printf("latency:      %lu wakeups, p50 %s, p90 %s, p99 %s, max %s\n",
+           all.nr, fmt_time(b[0], percentile(&all, 50)),
+           fmt_time(b[1], percentile(&all, 90)),
+           fmt_time(b[2], percentile(&all, 99)),
+           fmt_time(b[3], percentile(&all, 100)));
+    printf("switches:     %lu context switches, %lu migrations\n",
+           switches, migrations);
+    if ( !no_host_times )
+    {
+        cost_summary("do_schedule:", &sim_schedule_cost, cost, sizeof(cost));
+        cost_summary("wake:", &sim_wake_cost, NULL, 0);
+    }
+
+    fprintf(summary, "%-8s %9s %9s %9s %9s %10lu %10lu", sched, fairness,
+            fmt_time(b[0], percentile(&all, 50)),
+            fmt_time(b[1], percentile(&all, 99)),
+            fmt_time(b[2], percentile(&all, 100)),
+            switches, migrations);
+    if ( !no_host_times )
+        fprintf(summary, " %s", cost);
+    fputc('\n', summary);
+
+    free(all.ns);
+}
+
+/* Workload files. */
+static int parse_time(const char *s, s_time_t *t)
+{
+    char *end;
+    double v;
+
+    if ( !strcmp(s, "inf") )
+    {
+        *t = STIME_MAX;
+        return 0;
+    }
+
+    v = strtod(s, &end);
+    if ( end == s || v < 0 )
+        return -EINVAL;
+
+    if ( !strcmp(end, "ns") )
+        *t = v;
+    else if ( !*end || !strcmp(end, "us") )
+        *t = v * 1e3;
+    else if ( !strcmp(end, "ms") )
+        *t = v * 1e6;
+    else if ( !strcmp(end, "s") )
+        *t = v * 1e9;
+    else
+        return -EINVAL;
+
+    return 0;
+}
+
+static struct sim_dom *new_dom(void)
+{
+    struct sim_dom *dom;
+
+    if ( nr_doms == MAX_DOMS )
+    {
+        fprintf(stderr, "Too many domains, at most %u\n", MAX_DOMS);
+        exit(1);
+    }
+
+    dom = &doms[nr_doms++];
+    dom->domid = nr_doms;
+    dom->nr_vcpus = 1;
+    dom->weight = DEFAULT_WEIGHT;
+    dom->burst = STIME_MAX;
+    snprintf(dom->name, sizeof(dom->name), "d%u", dom->domid);
+
+    return dom;
+}
+
+static int parse_dom(struct sim_dom *dom, char *line)
+{
+    char *tok, *val;
+    s_time_t t;
+    int rc = 0;
+
+    for ( tok = strtok(line, " \t\n"); tok && !rc;
+          tok = strtok(NULL, " \t\n") )
+    {
+        if ( !(val = strchr(tok, '=')) )
+            return -EINVAL;
+        *val++ = '\0';
+
+        if ( !strcmp(tok, "name") )
+            snprintf(dom->name, sizeof(dom->name), "%s", val);
+        else if ( !strcmp(tok, "vcpus") )
+            dom->nr_vcpus = strtoul(val, NULL, 0);
+        else if ( !strcmp(tok, "weight") )
+            dom->weight = strtoul(val, NULL, 0);
+        else if ( !strcmp(tok, "cap") )
+            dom->cap = strtoul(val, NULL, 0);
+        else if ( !strcmp(tok, "latency") )
+            dom->latency = strtoul(val, NULL, 0);
+        else if ( !strcmp(tok, "period") || !strcmp(tok, "budget") )
+        {
+            if ( !(rc = parse_time(val, &t)) )
+                *(tok[0] == 'p' ? &dom->period : &dom->budget) = t / 1000;
+        }
+        else if ( !strcmp(tok, "burst") )
+            rc = parse_time(val, &dom->burst);
+        else if ( !strcmp(tok, "sleep") )
+            rc = parse_time(val, &dom->sleep);
+        else if ( !strcmp(tok, "start") )
+            rc = parse_time(val, &dom->start);
+        else if ( !strcmp(tok, "dist") )
+        {
+            if ( !strcmp(val, "fixed") )
+                dom->dist = DIST_FIXED;
+            else if ( !strcmp(val, "exp") )
+                dom->dist = DIST_EXP;
+            else if ( !strcmp(val, "uniform") )
+                dom->dist = DIST_UNIFORM;
+            else
+                rc = -EINVAL;
+        }
+        else
+            rc = -EINVAL;
+    }
+
+    if ( !rc && (!dom->nr_vcpus || dom->nr_vcpus > MAX_VCPUS ||
+                 dom->start == STIME_MAX ||
+                 (dom->burst != STIME_MAX && !dom->sleep)) )
+        rc = -EINVAL;
+
+    return rc;
+}
+
+static int read_workload(const char *file, uint64_t seed)
+{
+    char line[512], *p;
+    unsigned int lineno = 0, i, j;
+    FILE *f = fopen(file, "r");
+
+    if ( !f )
+    {
+        perror(file);
+        return -errno;
+    }
+
+    while ( fgets(line, sizeof(line), f) )
+    {
+        lineno++;
+        if ( (p = strchr(line, '#')) )
+            *p = '\0';
+        for ( p = line; isspace(*p); p++ )
+            continue;
+        if ( !*p )
+            continue;
+
+        if ( parse_dom(new_dom(), p) )
+        {
+            fprintf(stderr, "%s:%u: invalid domain description\n", file,
+                    lineno);
+            fclose(f);
+            return -EINVAL;
+        }
+    }
+    fclose(f);
+
+    for ( i = 0; i < nr_doms; i++ )
+    {
+        doms[i].vcpus = calloc(doms[i].nr_vcpus, sizeof(*doms[i].vcpus));
+        if ( !doms[i].vcpus )
+            return -ENOMEM;
+
+        for ( j = 0; j < doms[i].nr_vcpus; j++ )
+        {
+            struct sim_vcpu *sv = &doms[i].vcpus[j];
+            uint64_t x = seed + ((uint64_t)i << 32 | j) * 0x9e3779b97f4a7c15ULL;
+
+            /* Seed each vCPU apart, so that they see the same sequences
+             * whatever the order the scheduler runs them in. */
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            sv->rng = (x ^ (x >> 31)) ?: 1;
+            sv->up = doms[i].start;
+        }
+    }
+
+    return 0;
+}
+
+/* Trace replay. */
+struct trace_vcpu {
+    uint16_t domid, vcpuid;
+    struct phase *phases;
+    unsigned int nr_phases;
+    uint64_t first;                 /* When it first became runnable. */
+    uint64_t since, burst;          /* Entered the current state; ran. */
+    unsigned int state;
+    bool seen, blocked_once;
+};
+
+static struct trace_vcpu *trace_vcpu(struct trace_vcpu **tv, unsigned int *nr,
+                                     uint16_t domid, uint16_t vcpuid)
+{
+    unsigned int i;
+
+    for ( i = 0; i < *nr; i++ )
+        if ( (*tv)[i].domid == domid && (*tv)[i].vcpuid == vcpuid )
+            return &(*tv)[i];
+
+    *tv = xrealloc(*tv, (*nr + 1) * sizeof(**tv));
+    memset(&(*tv)[*nr], 0, sizeof(**tv));
+    (*tv)[*nr].domid = domid;
+    (*tv)[*nr].vcpuid = vcpuid;
+
+    return &(*tv)[(*nr)++];
+}
+
+static void add_phase(struct trace_vcpu *tv, s_time_t burst, s_time_t sleep)
+{
+    tv->phases = xrealloc(tv->phases, (tv->nr_phases + 1) * sizeof(*tv->phases));
+    tv->phases[tv->nr_phases].burst = burst > 0 ? burst : 1;
+    tv->phases[tv->nr_phases++].sleep = sleep;
+}
+
+/*
+ * Turn the runstate changes of each vCPU into a sequence of bursts (the
+ * time it spent running between two blocks) and sleeps (the time it spent
+ * blocked or offline).  Records from different pCPUs are interleaved in the
+ * trace in chunks, so their order in the file does not matter: only the
+ * timestamps are used, after sorting the records by them.
+ */
+struct rs_rec {
+    uint64_t tsc;
+    uint32_t event, data;
+};
+
+static int cmp_rs_rec(const void *a, const void *b)
+{
+    const struct rs_rec *x = a, *y = b;
+
+    return x->tsc < y->tsc ? -1 : x->tsc > y->tsc;
+}
+
+static int read_trace(const char *file, unsigned int mhz)
+{
+    struct rs_rec *recs = NULL;
+    unsigned long nr_recs = 0, size = 0, r;
+    struct trace_vcpu *tvs = NULL;
+    unsigned int nr_tvs = 0, i, j;
+    uint32_t hdr, data[TRACE_EXTRA_MAX];
+    uint64_t start;
+    FILE *f = strcmp(file, "-") ? fopen(file, "rb") : stdin;
+
+    if ( !f )
+    {
+        perror(file);
+        return -errno;
+    }
+
+    while ( fread(&hdr, sizeof(hdr), 1, f) == 1 )
+    {
+        unsigned int extra = TRC_HD_EXTRA(hdr);
+        uint64_t tsc = 0;
+
+        if ( (hdr & TRC_HD_CYCLE_FLAG) &&
+             fread(&tsc, sizeof(tsc), 1, f) != 1 )
+            break;
+        if ( extra && fread(data, sizeof(data[0]), extra, f) != extra )
+            break;
+
+        if ( ((hdr & TRC_HD_EVENT_MASK) & ~0xff0) != TRC_SCHED_RUNSTATE_CHANGE ||
+             !extra || !(hdr & TRC_HD_CYCLE_FLAG) )
+            continue;
+
+        if ( nr_recs == size )
+        {
+            size = size ? size * 2 : 65536;
+            recs = xrealloc(recs, size * sizeof(*recs));
+        }
+        recs[nr_recs].tsc = tsc;
+        recs[nr_recs].event = hdr & TRC_HD_EVENT_MASK;
+        recs[nr_recs++].data = data[0];
+    }
+
+    if ( ferror(f) )
+    {
+        perror("fread");
+        return -EIO;
+    }
+    if ( f != stdin )
+        fclose(f);
+
+    if ( !nr_recs )
+    {
+        fprintf(stderr, "No runstate change records in %s\n", file);
+        return -EINVAL;
+    }
+
+    qsort(recs, nr_recs, sizeof(*recs), cmp_rs_rec);
+    start = recs[0].tsc;
+
+#define TSC_NS(t) ((s_time_t)(((t) - start) * 1000 / mhz))
+
+    for ( r = 0; r < nr_recs; r++ )
+    {
+        /* data is vcpu[15:0] and domain[31:16]. */
+        uint16_t domid = recs[r].data >> 16, vcpuid = recs[r].data & 0xffff;
+        unsigned int old = (recs[r].event >> 8) & 3;
+        unsigned int new = (recs[r].event >> 4) & 3;
+        s_time_t now = TSC_NS(recs[r].tsc);
+        struct trace_vcpu *tv;
+
+        if ( domid >= DOMID_FIRST_RESERVED || vcpuid >= MAX_VCPUS )
+            continue;
+
+        tv = trace_vcpu(&tvs, &nr_tvs, domid, vcpuid);
+        if ( !tv->seen )
+        {
+            /* Up from the first runnable state we see it in. */
+            tv->seen = true;
+            tv->first = new < RUNSTATE_blocked ? now : STIME_MAX;
+            tv->state = new;
+            tv->since = now;
+            continue;
+        }
+
+        if ( tv->first == STIME_MAX && new < RUNSTATE_blocked )
+            tv->first = now;
+        else if ( old == RUNSTATE_running )
+            tv->burst += now - tv->since;
+
+        if ( old == RUNSTATE_running && new >= RUNSTATE_blocked )
+            tv->blocked_once = true;
+        else if ( old >= RUNSTATE_blocked && new < RUNSTATE_blocked &&
+                  tv->blocked_once )
+        {
+            add_phase(tv, tv->burst, now - tv->since);
+            tv->burst = 0;
+        }
+
+        tv->state = new;
+        tv->since = now;
+    }
+
+    /* Whatever it ran for last, and then it blocks for good. */
+    for ( i = 0; i < nr_tvs; i++ )
+    {
+        struct trace_vcpu *tv = &tvs[i];
+
+        if ( tv->state == RUNSTATE_running )
+            tv->burst += TSC_NS(recs[nr_recs - 1].tsc) - tv->since;
+        if ( tv->burst || tv->state < RUNSTATE_blocked )
+            add_phase(tv, tv->burst, -1);
+    }
+
+#undef TSC_NS
+
+    free(recs);
+
+    /* One domain per domid in the trace, with as many vCPUs as seen. */
+    for ( i = 0; i < nr_tvs; i++ )
+    {
+        struct sim_dom *dom = NULL;
+
+        for ( j = 0; j < nr_doms; j++ )
+            if ( doms[j].domid == tvs[i].domid )
+                dom = &doms[j];
+        if ( !dom )
+        {
+            dom = new_dom();
+            dom->domid = tvs[i].domid;
+            dom->nr_vcpus = 0;
+            dom->burst = 0;
+            snprintf(dom->name, sizeof(dom->name), "d%u", dom->domid);
+        }
+        if ( tvs[i].vcpuid >= dom->nr_vcpus )
+            dom->nr_vcpus = tvs[i].vcpuid + 1;
+    }
+
+    for ( i = 0; i < nr_doms; i++ )
+    {
+        doms[i].vcpus = calloc(doms[i].nr_vcpus, sizeof(*doms[i].vcpus));
+        if ( !doms[i].vcpus )
+            return -ENOMEM;
+        for ( j = 0; j < doms[i].nr_vcpus; j++ )
+            doms[i].vcpus[j].up = -1;
+    }
+
+    for ( i = 0; i < nr_tvs; i++ )
+    {
+        struct sim_vcpu *sv = NULL;
+
+        for ( j = 0; j < nr_doms; j++ )
+            if ( doms[j].domid == tvs[i].domid )
+                sv = &doms[j].vcpus[tvs[i].vcpuid];
+
+        if ( !tvs[i].nr_phases || tvs[i].first == STIME_MAX )
+        {
+            free(tvs[i].phases);
+            continue;
+        }
+        sv->phases = tvs[i].phases;
+        sv->nr_phases = tvs[i].nr_phases;
+        sv->up = tvs[i].first;
+    }
+
+    free(tvs);
+
+    return 0;
+}
+
+/* Run the workload under one scheduler, in a child process. */
+static int run(const char *sched, const struct sim_topology *topo,
+               s_time_t duration, FILE *summary)
+{
+    void *priv[MAX_VCPUS];
+    unsigned int i, j;
+    int rc;
+
+    if ( (rc = sim_setup(sched, topo)) )
+    {
+        fprintf(stderr, "%s: setup failed: %s\n", sched, strerror(-rc));
+        return rc;
+    }
+
+    for ( i = 0; i < nr_doms; i++ )
+    {
+        for ( j = 0; j < doms[i].nr_vcpus; j++ )
+        {
+            doms[i].vcpus[j].dom = &doms[i];
+            doms[i].vcpus[j].wake_time = -1;
+            priv[j] = &doms[i].vcpus[j];
+        }
+
+        doms[i].d = sim_domain_create(doms[i].domid, doms[i].nr_vcpus, priv);
+        if ( !doms[i].d )
+        {
+            fprintf(stderr, "%s: cannot create %s\n", sched, doms[i].name);
+            return -ENOMEM;
+        }
+        for ( j = 0; j < doms[i].nr_vcpus; j++ )
+            doms[i].vcpus[j].v = doms[i].d->vcpu[j];
+
+        if ( (rc = set_params(&doms[i])) )
+        {
+            fprintf(stderr, "%s: cannot set the parameters of %s: %s\n",
+                    sched, doms[i].name, strerror(-rc));
+            return rc;
+        }
+    }
+
+    if ( (rc = simulate(duration)) )
+        return rc;
+
+    report(sched, duration, summary);
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] {workload-file | -t trace-file}\n"
+            "  -s sched[,sched...]  schedulers to run (default: all of ",
+            prog);
+    sim_list_schedulers(stderr);
+    fprintf(stderr, ")\n"
+            "  -c cpus              pCPUs, as a count or as\n"
+            "                       sockets x cores x threads, e.g. 2x4x2 "
+            "(default 4)\n"
+            "  -d time              simulated time (default 10s)\n"
+            "  -S seed              seed for random workloads (default 1)\n"
+            "  -t trace-file        replay a xentrace capture, - for stdin\n"
+            "  -m mhz               TSC frequency of the traced host "
+            "(default 2400)\n"
+            "  -n                   leave out the host time taken by the\n"
+            "                       scheduler hooks, so output is reproducible\n"
+            "  -v                   show the schedulers' messages\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    struct sim_topology topo = { .sockets = 1, .cores = 4, .threads = 1 };
+    const char *trace = NULL;
+    char *scheds = NULL, *sched, *p, line[256];
+    s_time_t duration = SECONDS(10);
+    uint64_t seed = 1;
+    unsigned int mhz = 2400;
+    FILE *summary;
+    int opt, rc = 0, status;
+    pid_t pid;
+
+    while ( (opt = getopt(argc, argv, "s:c:d:S:t:m:nvh")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 's':
+            scheds = optarg;
+            break;
+        case 'c':
+            topo.sockets = strtoul(optarg, &p, 0);
+            topo.cores = topo.threads = 1;
+            if ( *p == 'x' )
+                topo.cores = strtoul(p + 1, &p, 0);
+            if ( *p == 'x' )
+                topo.threads = strtoul(p + 1, &p, 0);
+            if ( *p || !topo.sockets || !topo.cores || !topo.threads )
+                usage(argv[0]);
+            /* A plain count is that many cores in one socket. */
+            if ( !strchr(optarg, 'x') )
+            {
+                topo.cores = topo.sockets;
+                topo.sockets = 1;
+            }
+            break;
+        case 'd':
+            if ( parse_time(optarg, &duration) || !duration ||
+                 duration == STIME_MAX )
+                usage(argv[0]);
+            break;
+        case 'S':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            trace = optarg;
+            break;
+        case 'm':
+            mhz = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            no_host_times = true;
+            break;
+        case 'v':
+            sim_verbose++;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if ( (trace ? optind != argc : optind != argc - 1) || !mhz ||
+         topo.sockets * topo.cores * topo.threads > NR_CPUS )
+        usage(argv[0]);
+
+    rc = trace ? read_trace(trace, mhz) : read_workload(argv[optind], seed);
+    if ( rc )
+        return 1;
+    if ( !nr_doms )
+    {
+        fprintf(stderr, "Empty workload\n");
+        return 1;
+    }
+
+    if ( !scheds )
+    {
+        static char all[256];
+
+        summary = fmemopen(all, sizeof(all), "w");
+        sim_list_schedulers(summary);
+        fclose(summary);
+        for ( p = all; (p = strchr(p, ' ')); )
+            *p = ',';
+        scheds = all;
+    }
+
+    if ( !(summary = tmpfile()) )
+    {
+        perror("tmpfile");
+        return 1;
+    }
+
+    for ( sched = strtok(scheds, ","); sched; sched = strtok(NULL, ",") )
+    {
+        fflush(stdout);
+        fflush(summary);
+
+        pid = fork();
+        if ( pid < 0 )
+        {
+            perror("fork");
+            return 1;
+        }
+        if ( !pid )
+            exit(run(sched, &topo, duration, summary) ? 1 : 0);
+
+        if ( waitpid(pid, &status, 0) < 0 ||
+             !WIFEXITED(status) || WEXITSTATUS(status) )
+        {
+            fprintf(stderr, "%s: simulation failed\n", sched);
+            rc = 1;
+        }
+    }
+
+    printf("\n%-8s %9s %9s %9s %9s %10s %10s%s\n", "sched", "fairness",
+           "lat-p50", "lat-p99", "lat-max", "switches", "migrations",
+           no_host_times ? "" : " sched-p50 sched-p99");
+    rewind(summary);
+    while ( fgets(line, sizeof(line), summary) )
+        fputs(line, stdout);
+    fclose(summary);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
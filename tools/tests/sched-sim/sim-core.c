@@ -0,0 +1,796 @@
+/*
+ * sim-core.c
+ *
+ * The parts of the hypervisor the schedulers need around them: pCPUs, the
+ * idle domain, a cpupool, timers, softirqs, and a cut down version of the
+ * scheduling core (xen/common/sched/core.c) with granularity fixed to one
+ * pCPU per scheduling resource.  The core functions keep the names and
+ * structure of their counterparts there, so that the two can be compared
+ * side by side when the core changes.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <time.h>
+
+#include "sim.h"
+#include "private.h"
+
+/* Filled by REGISTER_SCHEDULER() in each scheduler. */
+extern const struct scheduler *__start_sim_schedulers[];
+extern const struct scheduler *__stop_sim_schedulers[];
+
+unsigned int sim_verbose;
+
+unsigned int nr_cpu_ids;
+unsigned int sim_cpu;
+s_time_t sim_now;
+
+cpumask_t cpu_online_map;
+const cpumask_t cpumask_all = {
+    .bits = { [0 ... BITS_TO_LONGS(NR_CPUS) - 1] = ~0UL }
+};
+static cpumask_t cpu_masks[NR_CPUS];
+
+nodemask_t node_online_map = { { 1 } };
+cpumask_t node_to_cpumask_map[MAX_NUMNODES];
+
+DEFINE_PER_CPU(cpumask_var_t, cpu_sibling_mask);
+DEFINE_PER_CPU(cpumask_var_t, cpu_core_mask);
+DEFINE_PER_CPU(cpumask_t, cpumask_scratch);
+DEFINE_PER_CPU(struct sched_resource *, sched_res);
+DEFINE_RCU_READ_LOCK(sched_res_rculock);
+
+int sched_ratelimit_us = SCHED_DEFAULT_RATELIMIT_US;
+bool sched_smt_power_savings;
+cpumask_t sched_nohz_cpus;
+
+struct sim_cost sim_schedule_cost, sim_wake_cost;
+
+static struct sim_topology topology;
+static struct scheduler ops;
+static struct cpupool pool;
+static struct domain idle_domain, *domain_list;
+static struct vcpu *idle_vcpu[NR_CPUS];
+static struct vcpu *curr_vcpu[NR_CPUS];
+static unsigned long softirq_pending[NR_CPUS];
+static struct timer *timer_list;
+
+void printk(const char *fmt, ...)
+{
+    va_list args;
+
+    if ( !sim_verbose )
+        return;
+
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void cost_add(struct sim_cost *c, uint64_t ns)
+{
+    if ( c->nr == c->size )
+    {
+        c->size = c->size ? c->size * 2 : 4096;
+        c->ns = realloc(c->ns, c->size * sizeof(*c->ns));
+        if ( !c->ns )
+        {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    c->ns[c->nr++] = ns;
+}
+
+/* Topology. */
+const cpumask_t *cpumask_of(unsigned int cpu)
+{
+    return &cpu_masks[cpu];
+}
+
+unsigned int cpu_to_core(unsigned int cpu)
+{
+    return cpu / topology.threads;
+}
+
+unsigned int cpu_to_socket(unsigned int cpu)
+{
+    return cpu / (topology.threads * topology.cores);
+}
+
+unsigned int cpu_to_node(unsigned int cpu)
+{
+    return 0;
+}
+
+/* Timers: a list of the active ones, in no particular order. */
+void init_timer(struct timer *timer, void (*function)(void *), void *data,
+                unsigned int cpu)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->function = function;
+    timer->data = data;
+    timer->cpu = cpu;
+}
+
+static void timer_remove(struct timer *timer)
+{
+    struct timer **t;
+
+    for ( t = &timer_list; *t; t = &(*t)->next )
+        if ( *t == timer )
+        {
+            *t = timer->next;
+            break;
+        }
+    timer->active = false;
+}
+
+void set_timer(struct timer *timer, s_time_t expires)
+{
+    if ( timer->killed )
+        return;
+
+    if ( !timer->active )
+    {
+        timer->next = timer_list;
+        timer_list = timer;
+        timer->active = true;
+    }
+    timer->expires = expires;
+}
+
+void stop_timer(struct timer *timer)
+{
+    if ( timer->active )
+        timer_remove(timer);
+}
+
+void migrate_timer(struct timer *timer, unsigned int new_cpu)
+{
+    timer->cpu = new_cpu;
+}
+
+void kill_timer(struct timer *timer)
+{
+    stop_timer(timer);
+    timer->killed = true;
+}
+
+s_time_t sim_next_timer(void)
+{
+    const struct timer *t;
+    s_time_t next = STIME_MAX;
+
+    for ( t = timer_list; t; t = t->next )
+        if ( t->expires < next )
+            next = t->expires;
+
+    return next;
+}
+
+void sim_run_timers(void)
+{
+    struct timer *t, *first;
+
+    for ( ; ; )
+    {
+        first = NULL;
+        for ( t = timer_list; t; t = t->next )
+            if ( t->expires <= NOW() && (!first || t->expires < first->expires) )
+                first = t;
+        if ( !first )
+            break;
+
+        timer_remove(first);
+        sim_cpu = first->cpu;
+        first->function(first->data);
+    }
+}
+
+/* Softirqs. */
+void cpu_raise_softirq(unsigned int cpu, unsigned int nr)
+{
+    __set_bit(nr, &softirq_pending[cpu]);
+}
+
+void cpumask_raise_softirq(const cpumask_t *mask, unsigned int nr)
+{
+    unsigned int cpu;
+
+    for_each_cpu ( cpu, mask )
+        cpu_raise_softirq(cpu, nr);
+}
+
+/* Domains and cpupools. */
+unsigned int cpupool_get_granularity(const struct cpupool *c)
+{
+    return 1;
+}
+
+struct domain *first_domain_in_cpupool(const struct cpupool *c)
+{
+    return domain_list;
+}
+
+struct domain *next_domain_in_cpupool(struct domain *d,
+                                      const struct cpupool *c)
+{
+    return d->next_in_list;
+}
+
+struct vcpu *sim_cpu_current(unsigned int cpu)
+{
+    return curr_vcpu[cpu];
+}
+
+uint64_t get_cpu_idle_time(unsigned int cpu)
+{
+    const struct vcpu *v = idle_vcpu[cpu];
+
+    return v->runstate.time[RUNSTATE_running] +
+           (v->runstate.state == RUNSTATE_running
+            ? NOW() - v->runstate.state_entry_time : 0);
+}
+
+static inline struct scheduler *unit_scheduler(const struct sched_unit *unit)
+{
+    return &ops;
+}
+
+/* The scheduling core, granularity 1 only. */
+static void vcpu_runstate_change(struct vcpu *v, int new_state,
+                                 s_time_t new_entry_time)
+{
+    s_time_t delta;
+    struct sched_unit *unit = v->sched_unit;
+
+    ASSERT(spin_is_locked(get_sched_res(v->processor)->schedule_lock));
+    if ( v->runstate.state == new_state )
+        return;
+
+    if ( !is_idle_vcpu(v) )
+    {
+        unit->runstate_cnt[v->runstate.state]--;
+        unit->runstate_cnt[new_state]++;
+    }
+
+    delta = new_entry_time - v->runstate.state_entry_time;
+    if ( delta > 0 )
+    {
+        v->runstate.time[v->runstate.state] += delta;
+        v->runstate.state_entry_time = new_entry_time;
+    }
+
+    v->runstate.state = new_state;
+}
+
+static void vcpu_sleep_nosync_locked(struct vcpu *v)
+{
+    struct sched_unit *unit = v->sched_unit;
+
+    if ( likely(!vcpu_runnable(v)) )
+    {
+        if ( v->runstate.state == RUNSTATE_runnable )
+            vcpu_runstate_change(v, RUNSTATE_offline, NOW());
+
+        if ( likely(!unit_runnable(unit)) )
+            sched_sleep(unit_scheduler(unit), unit);
+    }
+}
+
+static void vcpu_wake(struct vcpu *v)
+{
+    struct sched_unit *unit = v->sched_unit;
+    spinlock_t *lock;
+    uint64_t t;
+
+    lock = unit_schedule_lock_irq(unit);
+
+    if ( likely(vcpu_runnable(v)) )
+    {
+        if ( v->runstate.state >= RUNSTATE_blocked )
+            vcpu_runstate_change(v, RUNSTATE_runnable, NOW());
+
+        sim_cpu = v->processor;
+        t = host_ns();
+        sched_wake(unit_scheduler(unit), unit);
+        cost_add(&sim_wake_cost, host_ns() - t);
+    }
+    else if ( !(v->pause_flags & VPF_blocked) )
+    {
+        if ( v->runstate.state == RUNSTATE_blocked )
+            vcpu_runstate_change(v, RUNSTATE_offline, NOW());
+    }
+
+    unit_schedule_unlock_irq(lock, unit);
+}
+
+void vcpu_pause_nosync(struct vcpu *v)
+{
+    spinlock_t *lock;
+
+    atomic_inc(&v->pause_count);
+
+    lock = unit_schedule_lock_irq(v->sched_unit);
+    vcpu_sleep_nosync_locked(v);
+    unit_schedule_unlock_irq(lock, v->sched_unit);
+}
+
+void vcpu_unpause(struct vcpu *v)
+{
+    if ( atomic_dec_and_test(&v->pause_count) )
+        vcpu_wake(v);
+}
+
+void sim_vcpu_up(struct vcpu *v)
+{
+    if ( test_and_clear_bit(_VPF_down, &v->pause_flags) )
+        vcpu_wake(v);
+}
+
+void sim_vcpu_block(struct vcpu *v)
+{
+    set_bit(_VPF_blocked, &v->pause_flags);
+    cpu_raise_softirq(v->processor, SCHEDULE_SOFTIRQ);
+}
+
+void sim_vcpu_unblock(struct vcpu *v)
+{
+    if ( test_and_clear_bit(_VPF_blocked, &v->pause_flags) )
+        vcpu_wake(v);
+}
+
+static void sched_unit_migrate_finish(struct sched_unit *unit)
+{
+    struct sched_resource *new_res;
+    spinlock_t *lock;
+    struct vcpu *v;
+
+    if ( unit->is_running )
+        return;
+    for_each_sched_unit_vcpu ( unit, v )
+        if ( !test_bit(_VPF_migrating, &v->pause_flags) )
+            return;
+
+    lock = unit_schedule_lock_irq(unit);
+    new_res = sched_pick_resource(unit_scheduler(unit), unit);
+    unit_schedule_unlock_irq(lock, unit);
+
+    lock = unit_schedule_lock_irq(unit);
+    for_each_sched_unit_vcpu ( unit, v )
+        clear_bit(_VPF_migrating, &v->pause_flags);
+    sched_migrate(unit_scheduler(unit), unit, new_res->master_cpu);
+    unit_schedule_unlock_irq(lock, unit);
+
+    for_each_sched_unit_vcpu ( unit, v )
+        vcpu_wake(v);
+}
+
+static void sched_switch_units(struct sched_resource *sr,
+                               struct sched_unit *next, struct sched_unit *prev,
+                               s_time_t now)
+{
+    unsigned int cpu = sr->master_cpu;
+    struct vcpu *vprev = get_cpu_current(cpu);
+    struct vcpu *vnext = next->vcpu_list;
+
+    ASSERT(unit_running(prev));
+
+    if ( prev != next )
+    {
+        sr->curr = next;
+        sr->prev = prev;
+
+        ASSERT(!unit_running(next));
+        ASSERT(!next->is_running);
+        next->is_running = true;
+        next->state_entry_time = now;
+
+        if ( is_idle_unit(prev) )
+        {
+            prev->runstate_cnt[RUNSTATE_running] = 0;
+            prev->runstate_cnt[RUNSTATE_runnable] = 1;
+        }
+        if ( is_idle_unit(next) )
+        {
+            next->runstate_cnt[RUNSTATE_running] = 1;
+            next->runstate_cnt[RUNSTATE_runnable] = 0;
+        }
+    }
+
+    if ( vprev != vnext || vprev->runstate.state != vnext->new_state )
+    {
+        vcpu_runstate_change(vprev,
+            ((vprev->pause_flags & VPF_blocked) ? RUNSTATE_blocked :
+             (vcpu_runnable(vprev) ? RUNSTATE_runnable : RUNSTATE_offline)),
+            now);
+        vcpu_runstate_change(vnext, vnext->new_state, now);
+    }
+
+    vnext->is_running = true;
+}
+
+static void unit_context_saved(struct sched_resource *sr)
+{
+    struct sched_unit *unit = sr->prev;
+
+    if ( !unit )
+        return;
+
+    unit->is_running = false;
+    unit->state_entry_time = NOW();
+    sr->prev = NULL;
+
+    sched_context_saved(unit_scheduler(unit), unit);
+
+    if ( !is_idle_unit(unit) )
+        sched_unit_migrate_finish(unit);
+}
+
+static void schedule(unsigned int cpu)
+{
+    struct vcpu *vnext, *vprev = curr_vcpu[cpu];
+    struct sched_unit *prev = vprev->sched_unit, *next;
+    struct sched_resource *sr;
+    spinlock_t *lock;
+    s_time_t now;
+    uint64_t t;
+
+    sim_cpu = cpu;
+
+    lock = pcpu_schedule_lock_irq(cpu);
+
+    sr = get_sched_res(cpu);
+
+    stop_timer(&sr->s_timer);
+
+    now = NOW();
+
+    /* do_schedule() */
+    t = host_ns();
+    sr->scheduler->do_schedule(sr->scheduler, prev, now, false);
+    cost_add(&sim_schedule_cost, host_ns() - t);
+
+    next = prev->next_task;
+
+    if ( prev->next_time >= 0 ) /* -ve means no limit */
+        set_timer(&sr->s_timer, now + prev->next_time);
+
+    sched_switch_units(sr, next, prev, now);
+
+    pcpu_schedule_unlock_irq(lock, cpu);
+
+    vnext = next->vcpu_list;
+    if ( vprev == vnext )
+        return;
+
+    curr_vcpu[cpu] = vnext;
+    sim_context_switch(cpu, vprev, vnext);
+
+    /* sched_context_switched() */
+    vprev->is_running = false;
+    unit_context_saved(sr);
+}
+
+int sim_do_softirqs(void)
+{
+    unsigned int cpu, rounds;
+    bool pending;
+
+    /* Bound the number of reschedules at the same instant. */
+    for ( rounds = 0; rounds < 1000; rounds++ )
+    {
+        pending = false;
+        for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+            if ( __test_and_clear_bit(SCHEDULE_SOFTIRQ, &softirq_pending[cpu]) )
+            {
+                schedule(cpu);
+                pending = true;
+            }
+        if ( !pending )
+            return 0;
+    }
+
+    fprintf(stderr, "Rescheduling loop at %"PRI_stime"ns\n", NOW());
+    return -ELOOP;
+}
+
+static void s_timer_fn(void *unused)
+{
+    raise_softirq(SCHEDULE_SOFTIRQ);
+}
+
+static void sched_set_affinity(struct sched_unit *unit, const cpumask_t *hard,
+                               const cpumask_t *soft)
+{
+    sched_adjust_affinity(unit_scheduler(unit), unit, hard, soft);
+
+    if ( hard )
+        cpumask_copy(unit->cpu_hard_affinity, hard);
+    if ( soft )
+        cpumask_copy(unit->cpu_soft_affinity, soft);
+
+    unit->soft_aff_effective =
+        !cpumask_subset(unit->cpu_hard_affinity, unit->cpu_soft_affinity) &&
+        cpumask_intersects(unit->cpu_soft_affinity, unit->cpu_hard_affinity);
+}
+
+static struct sched_unit *sched_alloc_unit(struct vcpu *v)
+{
+    struct sched_unit *unit = xzalloc(struct sched_unit);
+    struct sched_unit **prev_unit;
+    struct domain *d = v->domain;
+
+    if ( !unit ||
+         !zalloc_cpumask_var(&unit->cpu_hard_affinity) ||
+         !zalloc_cpumask_var(&unit->cpu_hard_affinity_saved) ||
+         !zalloc_cpumask_var(&unit->cpu_soft_affinity) )
+        return NULL;
+
+    v->sched_unit = unit;
+    unit->vcpu_list = v;
+    unit->unit_id = v->vcpu_id;
+    unit->domain = d;
+    unit->runstate_cnt[v->runstate.state]++;
+
+    for ( prev_unit = &d->sched_unit_list; *prev_unit;
+          prev_unit = &(*prev_unit)->next_in_list )
+        continue;
+    *prev_unit = unit;
+
+    return unit;
+}
+
+static struct vcpu *vcpu_create(struct domain *d, unsigned int vcpu_id,
+                                unsigned int processor)
+{
+    struct vcpu *v = xzalloc(struct vcpu);
+    struct sched_unit *unit;
+
+    if ( !v )
+        return NULL;
+
+    v->domain = d;
+    v->vcpu_id = vcpu_id;
+    v->processor = processor;
+    if ( is_idle_domain(d) )
+        v->runstate.state = RUNSTATE_running;
+    else
+    {
+        v->runstate.state = RUNSTATE_offline;
+        v->pause_flags = VPF_down;
+    }
+    v->runstate.state_entry_time = NOW();
+
+    d->vcpu[vcpu_id] = v;
+    if ( vcpu_id )
+        d->vcpu[vcpu_id - 1]->next_in_list = v;
+
+    unit = sched_alloc_unit(v);
+    if ( !unit )
+        return NULL;
+
+    sched_set_res(unit, get_sched_res(processor));
+
+    unit->priv = sched_alloc_udata(&ops, unit, d->sched_priv);
+    if ( unit->priv == NULL )
+        return NULL;
+
+    if ( is_idle_domain(d) )
+    {
+        sched_set_affinity(unit, cpumask_of(processor), &cpumask_all);
+        get_sched_res(processor)->curr = unit;
+        get_sched_res(processor)->sched_unit_idle = unit;
+        curr_vcpu[processor] = v;
+        v->is_running = true;
+        unit->is_running = true;
+        unit->state_entry_time = NOW();
+    }
+    else
+    {
+        sched_set_affinity(unit, &cpumask_all, &cpumask_all);
+        sched_insert_unit(&ops, unit);
+    }
+
+    return v;
+}
+
+void sim_list_schedulers(FILE *f)
+{
+    const struct scheduler **s;
+
+    for ( s = __start_sim_schedulers; s < __stop_sim_schedulers; s++ )
+        fprintf(f, "%s%s", s == __start_sim_schedulers ? "" : " ",
+                (*s)->opt_name);
+}
+
+const char *sim_scheduler_name(void)
+{
+    return ops.name;
+}
+
+unsigned int sim_scheduler_id(void)
+{
+    return ops.sched_id;
+}
+
+int sim_setup(const char *name, const struct sim_topology *topo)
+{
+    const struct scheduler **s;
+    struct sched_resource *sr;
+    unsigned int cpu, i;
+    spinlock_t *lock;
+    void *ppriv;
+    int rc;
+
+    for ( s = __start_sim_schedulers; s < __stop_sim_schedulers; s++ )
+        if ( !strcmp((*s)->opt_name, name) )
+            break;
+    if ( s == __stop_sim_schedulers )
+        return -ENOENT;
+
+    ops = **s;
+    topology = *topo;
+    nr_cpu_ids = topo->sockets * topo->cores * topo->threads;
+    if ( !nr_cpu_ids || nr_cpu_ids > NR_CPUS )
+        return -EINVAL;
+
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+    {
+        cpumask_set_cpu(cpu, &cpu_masks[cpu]);
+        cpumask_set_cpu(cpu, &cpu_online_map);
+        cpumask_set_cpu(cpu, &node_to_cpumask_map[0]);
+        if ( !zalloc_cpumask_var(&per_cpu(cpu_sibling_mask, cpu)) ||
+             !zalloc_cpumask_var(&per_cpu(cpu_core_mask, cpu)) )
+            return -ENOMEM;
+        for ( i = 0; i < nr_cpu_ids; i++ )
+        {
+            if ( cpu_to_core(i) == cpu_to_core(cpu) )
+                cpumask_set_cpu(i, per_cpu(cpu_sibling_mask, cpu));
+            if ( cpu_to_socket(i) == cpu_to_socket(cpu) )
+                cpumask_set_cpu(i, per_cpu(cpu_core_mask, cpu));
+        }
+    }
+
+    if ( ops.global_init && (rc = ops.global_init()) < 0 )
+        return rc;
+    if ( (rc = sched_init(&ops)) )
+        return rc;
+
+    pool.sched = &ops;
+    pool.gran = SCHED_GRAN_cpu;
+    if ( !zalloc_cpumask_var(&pool.cpu_valid) ||
+         !zalloc_cpumask_var(&pool.res_valid) )
+        return -ENOMEM;
+
+    /* cpu_schedule_up() */
+    idle_domain.domain_id = DOMID_IDLE;
+    idle_domain.max_vcpus = nr_cpu_ids;
+    idle_domain.vcpu = xzalloc_array(struct vcpu *, nr_cpu_ids);
+    if ( !idle_domain.vcpu )
+        return -ENOMEM;
+
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+    {
+        sr = xzalloc(struct sched_resource);
+        if ( !sr || !zalloc_cpumask_var(&sr->cpus) )
+            return -ENOMEM;
+
+        sr->master_cpu = cpu;
+        cpumask_copy(sr->cpus, cpumask_of(cpu));
+        set_sched_res(cpu, sr);
+        sr->scheduler = &ops;
+        spin_lock_init(&sr->_lock);
+        sr->schedule_lock = &sr->_lock;
+        init_timer(&sr->s_timer, s_timer_fn, NULL, cpu);
+        sr->granularity = 1;
+    }
+
+    /* schedule_cpu_add(), with the idle vCPUs created on the way. */
+    for ( cpu = 0; cpu < nr_cpu_ids; cpu++ )
+    {
+        sim_cpu = cpu;
+        sr = get_sched_res(cpu);
+
+        idle_vcpu[cpu] = vcpu_create(&idle_domain, cpu, cpu);
+        if ( !idle_vcpu[cpu] )
+            return -ENOMEM;
+
+        ppriv = sched_alloc_pdata(&ops, cpu);
+        if ( IS_ERR(ppriv) )
+            return PTR_ERR(ppriv);
+
+        lock = pcpu_schedule_lock_irq(cpu);
+        sr->schedule_lock = sched_switch_sched(&ops, cpu, ppriv,
+                                               idle_vcpu[cpu]->sched_unit->priv);
+        sr->sched_priv = ppriv;
+        spin_unlock_irq(lock);
+
+        sr->cpupool = &pool;
+        cpumask_set_cpu(cpu, pool.cpu_valid);
+        cpumask_set_cpu(cpu, pool.res_valid);
+        cpu_raise_softirq(cpu, SCHEDULE_SOFTIRQ);
+    }
+
+    sim_cpu = 0;
+
+    return 0;
+}
+
+struct domain *sim_domain_create(domid_t domid, unsigned int nr_vcpus,
+                                 void **priv)
+{
+    struct domain *d = xzalloc(struct domain), **dp;
+    unsigned int i, cpu = 0;
+    void *sdom;
+
+    if ( !d )
+        return NULL;
+
+    d->domain_id = domid;
+    d->max_vcpus = nr_vcpus;
+    d->cpupool = &pool;
+    d->vcpu = xzalloc_array(struct vcpu *, nr_vcpus);
+    if ( !d->vcpu )
+        return NULL;
+
+    sdom = sched_alloc_domdata(&ops, d);
+    if ( IS_ERR(sdom) )
+        return NULL;
+    d->sched_priv = sdom;
+    pool.n_dom++;
+
+    for ( dp = &domain_list; *dp; dp = &(*dp)->next_in_list )
+        continue;
+    *dp = d;
+
+    /* sched_select_initial_cpu(): spread the vCPUs round robin. */
+    for ( i = 0; i < nr_vcpus; i++ )
+    {
+        if ( i )
+            cpu = cpumask_cycle(cpu, pool.cpu_valid);
+        if ( !vcpu_create(d, i, cpu) )
+            return NULL;
+        d->vcpu[i]->sim_priv = priv[i];
+    }
+
+    return d;
+}
+
+int sim_domain_adjust(struct domain *d, struct xen_domctl_scheduler_op *op)
+{
+    op->sched_id = ops.sched_id;
+
+    return sched_adjust_dom(&ops, d, op);
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,83 @@
+/*
+ * Interface between the simulated scheduling core (sim-core.c) and the
+ * workload driver (sched-sim.c).
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms and conditions of the GNU General Public
+ * License, version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHED_SIM_SIM_H_
+#define _SCHED_SIM_SIM_H_
+
+#include "emul.h"
+
+/* Host time spent in scheduler hooks, one sample per call. */
+struct sim_cost {
+    uint64_t *ns;
+    unsigned long nr, size;
+};
+
+extern struct sim_cost sim_schedule_cost, sim_wake_cost;
+
+/* Let printk() output through, to stderr. */
+extern unsigned int sim_verbose;
+
+/* Host pCPU topology: sockets x cores per socket x threads per core. */
+struct sim_topology {
+    unsigned int sockets, cores, threads;
+};
+
+/* List the schedulers built into the simulator, separated by spaces. */
+void sim_list_schedulers(FILE *f);
+
+/* Bring up the given scheduler on nr_cpu_ids pCPUs.  Only done once. */
+int sim_setup(const char *name, const struct sim_topology *topo);
+const char *sim_scheduler_name(void);
+unsigned int sim_scheduler_id(void);
+
+/*
+ * Create a domain of nr_vcpus vCPUs, all down.  priv is stored in each
+ * vCPU's sim_priv, indexed by vCPU id.
+ */
+struct domain *sim_domain_create(domid_t domid, unsigned int nr_vcpus,
+                                 void **priv);
+int sim_domain_adjust(struct domain *d, struct xen_domctl_scheduler_op *op);
+
+/* VCPUOP_up, and the guest blocking and being woken up. */
+void sim_vcpu_up(struct vcpu *v);
+void sim_vcpu_block(struct vcpu *v);
+void sim_vcpu_unblock(struct vcpu *v);
+
+/*
+ * Called by the core whenever a pCPU switches from one vCPU to another,
+ * including to and from the idle vCPU.
+ */
+void sim_context_switch(unsigned int cpu, struct vcpu *prev,
+                        struct vcpu *next);
+
+/* Expiry of the earliest pending timer, or STIME_MAX. */
+s_time_t sim_next_timer(void);
+/* Run all the timers which expired by NOW(). */
+void sim_run_timers(void);
+/* Run schedule() on every pCPU it has been requested for, until none is. */
+int sim_do_softirqs(void);
+
+#endif /* _SCHED_SIM_SIM_H_ */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -33,6 +33,7 @@ void policy_notify_paged_out(unsigned long gfn);
 void policy_notify_paged_in(unsigned long gfn);
 void policy_notify_paged_in_nomru(unsigned long gfn);
 void policy_notify_dropped(unsigned long gfn);
+void policy_notify_cold(unsigned long gfn);
 
 #endif // __XEN_PAGING_POLICY_H__
 
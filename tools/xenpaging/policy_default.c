@@ -24,6 +24,7 @@
 
 
 #define DEFAULT_MRU_SIZE (1024 * 16)
+#define COLD_QUEUE_SIZE (1024 * 64)
 
 
 static unsigned long *mru;
@@ -34,6 +35,8 @@ static unsigned long *unconsumed;
 static unsigned int unconsumed_cleared;
 static unsigned long current_gfn;
 static unsigned long max_pages;
+static unsigned long *cold;
+static unsigned int cold_head, cold_tail;
 
 
 int policy_init(struct xenpaging *paging)
@@ -65,6 +68,11 @@ int policy_init(struct xenpaging *paging)
     for ( i = 0; i < mru_size; i++ )
         mru[i] = INVALID_MFN;
 
+    /* Initialise queue of gfns found to be cold */
+    cold = malloc(sizeof(*cold) * COLD_QUEUE_SIZE);
+    if ( cold == NULL )
+        goto out;
+
     /* Don't page out page 0 */
     set_bit(0, bitmap);
 
@@ -81,6 +89,18 @@ unsigned long policy_choose_victim(struct xenpaging *paging)
     xc_interface *xch = paging->xc_handle;
     unsigned long i;
 
+    /* Prefer gfns which were found to be cold */
+    while ( cold_head != cold_tail )
+    {
+        i = cold[cold_head++ & (COLD_QUEUE_SIZE - 1)];
+
+        if ( i >= max_pages || test_bit(i, bitmap) || test_bit(i, unconsumed) )
+            continue;
+
+        set_bit(i, unconsumed);
+        return i;
+    }
+
     /* One iteration over all possible gfns */
     for ( i = 0; i < max_pages; i++ )
     {
@@ -174,6 +194,15 @@ void policy_notify_dropped(unsigned long gfn)
     clear_bit(gfn, bitmap);
 }
 
+void policy_notify_cold(unsigned long gfn)
+{
+    /* Drop the oldest entry when full, it is the most likely to be stale */
+    if ( cold_tail - cold_head == COLD_QUEUE_SIZE )
+        cold_head++;
+
+    cold[cold_tail++ & (COLD_QUEUE_SIZE - 1)] = gfn;
+}
+
 
 /*
  * Local variables:
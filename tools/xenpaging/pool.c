@@ -0,0 +1,312 @@
+/******************************************************************************
+ *
+ * Compressed in-memory pool for paged out pages.
+ *
+ * Pages are compressed with a small LZ4 block compressor and restored
+ * with the decompressor shared with the hypervisor and libxc, keeping the
+ * page-in path to a memory copy plus decompression.  All zero pages are
+ * not stored at all.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xc_private.h>
+
+#include "pool.h"
+
+#define CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define likely(a) a
+#define unlikely(a) a
+
+static inline uint_fast16_t le16_to_cpup(const unsigned char *buf)
+{
+    return buf[0] | (buf[1] << 8);
+}
+
+static inline uint_fast32_t le32_to_cpup(const unsigned char *buf)
+{
+    return le16_to_cpup(buf) | ((uint32_t)le16_to_cpup(buf + 2) << 16);
+}
+
+#include "../../xen/include/xen/lz4.h"
+#include "../../xen/common/decompress.h"
+#include "../../xen/common/lz4/decompress.c"
+
+/* Pages compressing to more than this are not worth keeping. */
+#define POOL_MAX_LEN    (PAGE_SIZE * 3 / 4)
+
+#define POOL_HASH_BITS  12
+
+/* Marks a slot holding an all zero page, no data is stored. */
+#define POOL_ZERO       UINT16_MAX
+
+struct pool_entry {
+    void *data;
+    uint16_t len;
+};
+
+static struct pool_entry *entries;
+static int nr_entries;
+static struct pool_stats stats;
+static uint8_t scratch[POOL_MAX_LEN];
+
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline unsigned int lz4_hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - POOL_HASH_BITS);
+}
+
+static uint8_t *put_length(uint8_t *op, size_t len)
+{
+    for ( ; len >= 255; len -= 255 )
+        *op++ = 255;
+    *op++ = len;
+
+    return op;
+}
+
+/*
+ * Greedy LZ4 block compression of one page into dst.  Follows the block
+ * format rules the decompressor relies on: the last match starts at least
+ * MFLIMIT bytes and ends at least LASTLITERALS bytes before the end.
+ * Returns the compressed length, or 0 if it would exceed dst_size.
+ */
+static size_t lz4_compress_page(const uint8_t *src, uint8_t *dst,
+                                size_t dst_size)
+{
+    uint16_t table[1 << POOL_HASH_BITS];
+    const uint8_t *ip = src, *anchor = src;
+    const uint8_t *const end = src + PAGE_SIZE;
+    const uint8_t *const mflimit = end - MFLIMIT;
+    const uint8_t *const matchlimit = end - LASTLITERALS;
+    uint8_t *op = dst, *const oend = dst + dst_size;
+    uint8_t *token;
+    size_t lit, mlen;
+
+    memset(table, 0, sizeof(table));
+
+    while ( ip < mflimit )
+    {
+        uint32_t seq = read32(ip);
+        unsigned int h = lz4_hash(seq);
+        const uint8_t *ref = src + table[h];
+        const uint8_t *m;
+
+        table[h] = ip - src;
+        if ( ref >= ip || read32(ref) != seq )
+        {
+            ip++;
+            continue;
+        }
+
+        for ( m = ip + MINMATCH, ref += MINMATCH;
+              m < matchlimit && *m == *ref; m++, ref++ )
+            ;
+
+        lit = ip - anchor;
+        mlen = m - ip - MINMATCH;
+        /* token, literals, offset, and the two length extensions */
+        if ( (size_t)(oend - op) <
+             1 + lit + lit / 255 + 1 + 2 + mlen / 255 + 1 )
+            return 0;
+
+        token = op++;
+        if ( lit >= RUN_MASK )
+        {
+            *token = RUN_MASK << ML_BITS;
+            op = put_length(op, lit - RUN_MASK);
+        }
+        else
+            *token = lit << ML_BITS;
+        memcpy(op, anchor, lit);
+        op += lit;
+
+        *op++ = (m - ref) & 0xff;
+        *op++ = (m - ref) >> 8;
+
+        if ( mlen >= ML_MASK )
+        {
+            *token |= ML_MASK;
+            op = put_length(op, mlen - ML_MASK);
+        }
+        else
+            *token |= mlen;
+
+        ip = anchor = m;
+    }
+
+    lit = end - anchor;
+    if ( (size_t)(oend - op) < 1 + lit + lit / 255 + 1 )
+        return 0;
+
+    token = op++;
+    if ( lit >= RUN_MASK )
+    {
+        *token = RUN_MASK << ML_BITS;
+        op = put_length(op, lit - RUN_MASK);
+    }
+    else
+        *token = lit << ML_BITS;
+    memcpy(op, anchor, lit);
+    op += lit;
+
+    return op - dst;
+}
+
+static int page_is_zero(const void *page)
+{
+    const unsigned long *p = page;
+    unsigned int i;
+
+    for ( i = 0; i < PAGE_SIZE / sizeof(*p); i += 8 )
+        if ( p[i] | p[i + 1] | p[i + 2] | p[i + 3] |
+             p[i + 4] | p[i + 5] | p[i + 6] | p[i + 7] )
+            return 0;
+
+    return 1;
+}
+
+int pool_init(int max_pages)
+{
+    entries = calloc(max_pages, sizeof(*entries));
+    if ( !entries )
+        return -ENOMEM;
+
+    nr_entries = max_pages;
+
+    return 0;
+}
+
+void pool_teardown(void)
+{
+    int i;
+
+    for ( i = 0; i < nr_entries; i++ )
+        free(entries[i].data);
+
+    free(entries);
+    entries = NULL;
+    nr_entries = 0;
+}
+
+int pool_compressible(const void *page)
+{
+    return page_is_zero(page) ||
+           lz4_compress_page(page, scratch, sizeof(scratch)) != 0;
+}
+
+int pool_write_page(const void *page, int slot)
+{
+    struct pool_entry *e = &entries[slot];
+    size_t len;
+
+    if ( e->len )
+        return -EEXIST;
+
+    if ( page_is_zero(page) )
+    {
+        e->len = POOL_ZERO;
+        stats.pages++;
+        stats.zero++;
+        return 0;
+    }
+
+    len = lz4_compress_page(page, scratch, sizeof(scratch));
+    if ( !len )
+    {
+        stats.rejected++;
+        return 1;
+    }
+
+    e->data = malloc(len);
+    if ( !e->data )
+        return -ENOMEM;
+
+    memcpy(e->data, scratch, len);
+    e->len = len;
+    stats.pages++;
+    stats.bytes += len;
+
+    return 0;
+}
+
+void pool_drop_page(int slot)
+{
+    struct pool_entry *e = &entries[slot];
+
+    if ( !e->len )
+        return;
+
+    if ( e->len == POOL_ZERO )
+        stats.zero--;
+    else
+        stats.bytes -= e->len;
+    stats.pages--;
+
+    free(e->data);
+    e->data = NULL;
+    e->len = 0;
+}
+
+int pool_read_page(void *page, int slot)
+{
+    struct pool_entry *e = &entries[slot];
+    size_t len = PAGE_SIZE;
+
+    if ( !e->len )
+        return 1;
+
+    if ( e->len == POOL_ZERO )
+        memset(page, 0, PAGE_SIZE);
+    else if ( lz4_decompress_unknownoutputsize(e->data, e->len,
+                                               page, &len) ||
+              len != PAGE_SIZE )
+        return -EIO;
+
+    return 0;
+}
+
+void pool_get_stats(struct pool_stats *s)
+{
+    *s = stats;
+}
+
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
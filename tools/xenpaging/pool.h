@@ -0,0 +1,73 @@
+/******************************************************************************
+ * tools/xenpaging/pool.h
+ *
+ * Compressed in-memory pool for paged out pages.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+
+struct pool_stats {
+    unsigned long pages;        /* pages held in the pool */
+    unsigned long zero;         /* ... of which are all zeroes */
+    unsigned long bytes;        /* compressed bytes held */
+    unsigned long rejected;     /* pages which did not compress well */
+};
+
+int pool_init(int max_pages);
+void pool_teardown(void);
+
+/*
+ * Returns 1 if the page is worth keeping in the pool, 0 otherwise.  Used to
+ * filter victims before nominating them when there is no pagefile to
+ * fall back to.
+ */
+int pool_compressible(const void *page);
+
+/*
+ * Store a page into the given slot.
+ * Returns < 0 on error, 0 if stored, 1 if the page did not compress well
+ * and has to go somewhere else.
+ */
+int pool_write_page(const void *page, int slot);
+
+/*
+ * Restore the page held in the given slot.  The slot is kept, so that the
+ * page is not lost if it cannot be handed back to the guest; release it
+ * with pool_drop_page() once that has succeeded.
+ * Returns < 0 on error, 0 on success, 1 if the slot is not in the pool.
+ */
+int pool_read_page(void *page, int slot);
+
+/* Release the slot without restoring it. */
+void pool_drop_page(int slot);
+
+void pool_get_stats(struct pool_stats *stats);
+
+
+#endif
+
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
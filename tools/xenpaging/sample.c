@@ -0,0 +1,240 @@
+/******************************************************************************
+ *
+ * Cold page detection by mem_access sampling.
+ *
+ * Every round a batch of resident gfns is switched to n2rwx.  The first
+ * guest access to such a page makes Xen restore rwx and post an async
+ * event on the monitor ring, which marks the page as touched.  Pages of
+ * the batch which were not touched by the end of the round are cold and
+ * handed to the policy as preferred victims.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <time.h>
+
+#include "xc_bitops.h"
+#include "policy.h"
+#include "sample.h"
+
+
+/* Length of a sampling round, in ms */
+#define SAMPLE_INTERVAL 1000
+
+
+static struct vm_event monitor;
+static unsigned long *touched;
+static uint64_t *armed;
+static uint8_t *armed_access;
+static unsigned int nr_armed;
+static unsigned long cursor;
+static struct timespec last_round;
+
+
+int sample_init(struct xenpaging *paging)
+{
+    xc_interface *xch = paging->xc_handle;
+    int rc;
+
+    armed = calloc(paging->sample_size, sizeof(*armed));
+    armed_access = calloc(paging->sample_size, sizeof(*armed_access));
+    touched = bitmap_alloc(paging->max_pages);
+    if ( !armed || !armed_access || !touched )
+    {
+        PERROR("Error allocating sampling state");
+        return -1;
+    }
+
+    monitor.domain_id = paging->vm_event.domain_id;
+    monitor.xce_handle = paging->vm_event.xce_handle;
+    monitor.port = -1;
+
+    monitor.ring_page = xc_monitor_enable(xch, monitor.domain_id,
+                                          &monitor.evtchn_port);
+    if ( !monitor.ring_page )
+    {
+        PERROR("Failed to enable the monitor ring");
+        return -1;
+    }
+
+    rc = xenevtchn_bind_interdomain(monitor.xce_handle, monitor.domain_id,
+                                    monitor.evtchn_port);
+    if ( rc < 0 )
+    {
+        PERROR("Failed to bind monitor event channel");
+        return -1;
+    }
+    monitor.port = rc;
+
+    SHARED_RING_INIT((vm_event_sring_t *)monitor.ring_page);
+    BACK_RING_INIT(&monitor.back_ring,
+                   (vm_event_sring_t *)monitor.ring_page, PAGE_SIZE);
+
+    /* Start where the policy starts its scan */
+    cursor = paging->max_pages / 2;
+    clock_gettime(CLOCK_MONOTONIC, &last_round);
+
+    DPRINTF("sampling %d gfns every %dms\n",
+            paging->sample_size, SAMPLE_INTERVAL);
+
+    return 0;
+}
+
+/* Give the gfns which are still armed back their default access */
+static void sample_disarm(struct xenpaging *paging)
+{
+    xc_interface *xch = paging->xc_handle;
+    unsigned int i, nr = 0;
+
+    for ( i = 0; i < nr_armed; i++ )
+    {
+        /* Access was restored by Xen, or the gfn was paged out meanwhile */
+        if ( test_bit(armed[i], touched) ||
+             test_bit(armed[i], paging->bitmap) )
+            continue;
+
+        armed[nr] = armed[i];
+        armed_access[nr++] = XENMEM_access_default;
+    }
+
+    if ( nr && xc_set_mem_access_multi(xch, monitor.domain_id,
+                                       armed_access, armed, nr) )
+        PERROR("Error restoring access of %u sampled gfns", nr);
+
+    nr_armed = nr;
+}
+
+void sample_teardown(struct xenpaging *paging)
+{
+    xc_interface *xch = paging->xc_handle;
+
+    if ( monitor.ring_page )
+    {
+        sample_disarm(paging);
+
+        if ( xc_monitor_disable(xch, monitor.domain_id) )
+            PERROR("Error disabling the monitor ring");
+
+        if ( monitor.port >= 0 &&
+             xenevtchn_unbind(monitor.xce_handle, monitor.port) )
+            PERROR("Error unbinding monitor event port");
+
+        munmap(monitor.ring_page, PAGE_SIZE);
+        monitor.ring_page = NULL;
+    }
+
+    free(touched);
+    free(armed_access);
+    free(armed);
+}
+
+void sample_handle_events(struct xenpaging *paging)
+{
+    vm_event_back_ring_t *back_ring = &monitor.back_ring;
+    vm_event_request_t req;
+    vm_event_response_t rsp;
+    int notify = 0;
+
+    while ( RING_HAS_UNCONSUMED_REQUESTS(back_ring) )
+    {
+        memcpy(&req, RING_GET_REQUEST(back_ring, back_ring->req_cons),
+               sizeof(req));
+        back_ring->req_cons++;
+        back_ring->sring->req_event = back_ring->req_cons + 1;
+
+        if ( req.reason == VM_EVENT_REASON_MEM_ACCESS &&
+             req.u.mem_access.gfn < paging->max_pages )
+            set_bit(req.u.mem_access.gfn, touched);
+
+        /* Events are async, the response only frees up the ring slot */
+        memset(&rsp, 0, sizeof(rsp));
+        rsp.version = VM_EVENT_INTERFACE_VERSION;
+        rsp.vcpu_id = req.vcpu_id;
+        rsp.flags = req.flags & VM_EVENT_FLAG_VCPU_PAUSED;
+        rsp.reason = req.reason;
+
+        memcpy(RING_GET_RESPONSE(back_ring, back_ring->rsp_prod_pvt), &rsp,
+               sizeof(rsp));
+        back_ring->rsp_prod_pvt++;
+        notify = 1;
+    }
+
+    if ( notify )
+    {
+        RING_PUSH_RESPONSES(back_ring);
+        xenevtchn_notify(monitor.xce_handle, monitor.port);
+    }
+}
+
+/*
+ * Close the current round once it has run for SAMPLE_INTERVAL and arm the
+ * next batch of gfns.
+ * Returns < 0 on fatal error
+ */
+int sample_round(struct xenpaging *paging)
+{
+    xc_interface *xch = paging->xc_handle;
+    struct timespec now;
+    unsigned int i, nr_cold = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ( (now.tv_sec - last_round.tv_sec) * 1000 +
+         (now.tv_nsec - last_round.tv_nsec) / 1000000 < SAMPLE_INTERVAL )
+        return 0;
+    last_round = now;
+
+    sample_disarm(paging);
+    for ( i = 0; i < nr_armed; i++ )
+        policy_notify_cold(armed[i]);
+    nr_cold = nr_armed;
+
+    bitmap_clear(touched, paging->max_pages);
+
+    /* Arm the next batch of resident gfns, skipping gfn 0 like the policy */
+    for ( nr_armed = 0, i = 0;
+          i < paging->max_pages && nr_armed < paging->sample_size; i++ )
+    {
+        if ( ++cursor >= paging->max_pages )
+            cursor = 0;
+
+        if ( !cursor || test_bit(cursor, paging->bitmap) )
+            continue;
+
+        armed[nr_armed] = cursor;
+        armed_access[nr_armed++] = XENMEM_access_n2rwx;
+    }
+
+    if ( nr_armed && xc_set_mem_access_multi(xch, monitor.domain_id,
+                                             armed_access, armed, nr_armed) )
+    {
+        PERROR("Error arming %u gfns for sampling", nr_armed);
+        return -1;
+    }
+
+    DPRINTF("sampling: %u cold gfns, next round from gfn %lx\n",
+            nr_cold, cursor);
+
+    return 0;
+}
+
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * tools/xenpaging/sample.h
+ *
+ * Cold page detection by mem_access sampling.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __SAMPLE_H__
+#define __SAMPLE_H__
+
+
+#include "xenpaging.h"
+
+
+int sample_init(struct xenpaging *paging);
+void sample_teardown(struct xenpaging *paging);
+void sample_handle_events(struct xenpaging *paging);
+int sample_round(struct xenpaging *paging);
+
+
+#endif
+
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -33,6 +33,8 @@
 #include "xc_bitops.h"
 #include "file_ops.h"
 #include "policy.h"
+#include "pool.h"
+#include "sample.h"
 #include "xenpaging.h"
 
 /* Defines number of mfns a guest should use at a time, in KiB */
@@ -201,13 +203,17 @@ static void usage(void)
 {
     printf("usage:\n\n");
 
-    printf("  xenpaging [options] -f <pagefile> -d <domain_id>\n\n");
+    printf("  xenpaging [options] -f <pagefile> -d <domain_id>\n");
+    printf("  xenpaging [options] -z [-f <pagefile>] -d <domain_id>\n\n");
 
     printf("options:\n");
     printf(" -d <domid>     --domain=<domid>         numerical domain_id of guest. This option is required.\n");
-    printf(" -f <file>      --pagefile=<file>        pagefile to use. This option is required.\n");
+    printf(" -f <file>      --pagefile=<file>        pagefile to use. This option is required without -z.\n");
     printf(" -m <max_memkb> --max_memkb=<max_memkb>  maximum amount of memory to handle.\n");
     printf(" -r <num>       --mru_size=<num>         number of paged-in pages to keep in memory.\n");
+    printf(" -z             --compress               keep paged out pages compressed in memory.\n");
+    printf("                                         Pages which do not compress well go to the pagefile, if any.\n");
+    printf(" -s <num>       --sample=<num>           detect cold pages by sampling <num> pages per second.\n");
     printf(" -v             --verbose                enable debug output.\n");
     printf(" -h             --help                   this output.\n");
 }
@@ -215,13 +221,15 @@ static void usage(void)
 static int xenpaging_getopts(struct xenpaging *paging, int argc, char *argv[])
 {
     int ch;
-    static const char sopts[] = "hvd:f:m:r:";
+    static const char sopts[] = "hvzd:f:m:r:s:";
     static const struct option lopts[] = {
         {"help", 0, NULL, 'h'},
         {"verbose", 0, NULL, 'v'},
         {"domain", 1, NULL, 'd'},
         {"pagefile", 1, NULL, 'f'},
         {"mru_size", 1, NULL, 'm'},
+        {"compress", 0, NULL, 'z'},
+        {"sample", 1, NULL, 's'},
         { }
     };
 
@@ -245,6 +253,12 @@ static int xenpaging_getopts(struct xenpaging *paging, int argc, char *argv[])
         case 'v':
             paging->debug = 1;
             break;
+        case 'z':
+            paging->compress = 1;
+            break;
+        case 's':
+            paging->sample_size = atoi(optarg);
+            break;
         case 'h':
         case '?':
             usage();
@@ -254,8 +268,8 @@ static int xenpaging_getopts(struct xenpaging *paging, int argc, char *argv[])
 
     argv += optind; argc -= optind;
     
-    /* Path to pagefile is required */
-    if ( !filename )
+    /* Path to pagefile is required, unless pages are kept in memory */
+    if ( !filename && !paging->compress )
     {
         printf("Filename for pagefile missing!\n");
         usage();
@@ -473,14 +487,26 @@ static struct xenpaging *xenpaging_init(int argc, char *argv[])
         goto err;
     }
 
-    /* Open file */
-    paging->fd = open(filename, O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
-    if ( paging->fd < 0 )
+    /* Initialise compressed pool */
+    if ( paging->compress && pool_init(paging->max_pages) )
     {
-        PERROR("failed to open file");
+        PERROR("Error initialising compressed pool");
         goto err;
     }
 
+    /* Open file */
+    paging->fd = -1;
+    if ( filename )
+    {
+        paging->fd = open(filename, O_CREAT | O_TRUNC | O_RDWR,
+                          S_IRUSR | S_IWUSR);
+        if ( paging->fd < 0 )
+        {
+            PERROR("failed to open file");
+            goto err;
+        }
+    }
+
     return paging;
 
  err:
@@ -503,6 +529,7 @@ static struct xenpaging *xenpaging_init(int argc, char *argv[])
 
         free(dom_path);
         free(watch_target_tot_pages);
+        pool_teardown();
         free(paging->free_slot_stack);
         free(paging->slot_to_gfn);
         free(paging->gfn_to_slot);
@@ -601,6 +628,23 @@ static int xenpaging_evict_page(struct xenpaging *paging, unsigned long gfn, int
 
     DECLARE_DOMCTL;
 
+    /*
+     * Without a pagefile to fall back to, skip pages which would not
+     * compress well before nominating them.
+     */
+    if ( paging->fd < 0 )
+    {
+        page = xc_map_foreign_pages(xch, paging->vm_event.domain_id,
+                                    PROT_READ, &victim, 1);
+        if ( page == NULL )
+            return 1;
+
+        ret = pool_compressible(page);
+        munmap(page, PAGE_SIZE);
+        if ( !ret )
+            return 1;
+    }
+
     /* Nominate page */
     ret = xc_mem_paging_nominate(xch, paging->vm_event.domain_id, gfn);
     if ( ret < 0 )
@@ -622,8 +666,18 @@ static int xenpaging_evict_page(struct xenpaging *paging, unsigned long gfn, int
         goto out;
     }
 
-    /* Copy page */
-    ret = write_page(paging->fd, page, slot);
+    /* Copy page, to the pool first if it compresses well enough */
+    ret = paging->compress ? pool_write_page(page, slot) : 1;
+    if ( ret > 0 )
+    {
+        /* Contents changed since the check above, leave it nominated */
+        if ( paging->fd < 0 )
+        {
+            munmap(page, PAGE_SIZE);
+            goto out;
+        }
+        ret = write_page(paging->fd, page, slot);
+    }
     if ( ret < 0 )
     {
         PERROR("Error copying page %lx", gfn);
@@ -646,6 +700,8 @@ static int xenpaging_evict_page(struct xenpaging *paging, unsigned long gfn, int
                 DPRINTF("Nominated page %lx busy", gfn);
         } else
             PERROR("Error evicting page %lx", gfn);
+        if ( paging->compress )
+            pool_drop_page(slot);
         goto out;
     }
 
@@ -699,8 +755,10 @@ static int xenpaging_populate_page(struct xenpaging *paging, unsigned long gfn,
 
     DPRINTF("populate_page < gfn %lx pageslot %d\n", gfn, i);
 
-    /* Read page */
-    ret = read_page(paging->fd, paging->paging_buffer, i);
+    /* Read page, from the pool if it was kept there */
+    ret = paging->compress ? pool_read_page(paging->paging_buffer, i) : 1;
+    if ( ret > 0 )
+        ret = read_page(paging->fd, paging->paging_buffer, i);
     if ( ret != 0 )
     {
         PERROR("Error reading page");
@@ -727,6 +785,9 @@ static int xenpaging_populate_page(struct xenpaging *paging, unsigned long gfn,
     }
     while ( ret && !interrupted );
 
+    /* Keep the pooled copy until Xen has got the page back */
+    if ( ret == 0 && paging->compress )
+        pool_drop_page(i);
 
  out:
     return ret;
@@ -869,8 +930,10 @@ int main(int argc, char *argv[])
     }
     xch = paging->xc_handle;
 
-    DPRINTF("starting %s for domain_id %u with pagefile %s\n",
-            argv[0], paging->vm_event.domain_id, filename);
+    DPRINTF("starting %s for domain_id %u with pagefile %s%s\n",
+            argv[0], paging->vm_event.domain_id,
+            filename ? filename : "(none)",
+            paging->compress ? " and compressed pool" : "");
 
     /* ensure that if we get a signal, we'll do cleanup, then exit */
     act.sa_handler = close_handler;
@@ -884,6 +947,11 @@ int main(int argc, char *argv[])
     /* listen for page-in events to stop pager */
     create_page_in_thread(paging);
 
+    /* Start looking for cold pages */
+    rc = 1;
+    if ( paging->sample_size > 0 && sample_init(paging) )
+        goto out;
+
     /* Swap pages in and out */
     while ( 1 )
     {
@@ -899,6 +967,14 @@ int main(int argc, char *argv[])
             DPRINTF("Got event from Xen\n");
         }
 
+        if ( paging->sample_size > 0 )
+        {
+            rc = 1;
+            sample_handle_events(paging);
+            if ( sample_round(paging) < 0 )
+                goto out;
+        }
+
         while ( RING_HAS_UNCONSUMED_REQUESTS(&paging->vm_event.back_ring) )
         {
             /* Indicate possible error */
@@ -933,6 +1009,8 @@ int main(int argc, char *argv[])
                             req.u.mem_paging.gfn, slot);
                     /* Notify policy of page being dropped */
                     policy_notify_dropped(req.u.mem_paging.gfn);
+                    if ( paging->compress )
+                        pool_drop_page(slot);
                 }
                 else
                 {
@@ -1063,7 +1141,20 @@ int main(int argc, char *argv[])
     DPRINTF("xenpaging got signal %d\n", interrupted);
 
  out:
-    close(paging->fd);
+    if ( paging->compress )
+    {
+        struct pool_stats stats;
+
+        pool_get_stats(&stats);
+        DPRINTF("pool: %lu pages (%lu zero) in %lu bytes, %lu rejected\n",
+                stats.pages, stats.zero, stats.bytes, stats.rejected);
+        pool_teardown();
+    }
+    if ( paging->sample_size > 0 )
+        sample_teardown(paging);
+
+    if ( paging->fd >= 0 )
+        close(paging->fd);
     unlink_pagefile();
 
     /* Tear down domain paging */
@@ -62,6 +62,10 @@ struct xenpaging {
     int policy_mru_size;
     int use_poll_timeout;
     int debug;
+    /* keep paged out pages in the compressed pool */
+    int compress;
+    /* number of gfns sampled per round for cold page detection */
+    int sample_size;
     int stack_count;
     int *free_slot_stack;
     unsigned long pagein_queue[XENPAGING_PAGEIN_QUEUE_SIZE];
@@ -449,6 +449,36 @@ xenstat_vbd *xenstat_domain_vbd(xenstat_domain * domain,
 /*
  * VCPU functions
  */
+/* Collect scheduling statistics of a domain's VCPUs.  These are optional:
+ * if the hypervisor cannot provide them they are left at zero. */
+static void xenstat_collect_sched_stats(xenstat_node * node,
+					xenstat_domain * domain)
+{
+	xc_sched_vcpu_stats_t *stats;
+	unsigned int vcpu, nr_vcpus = domain->num_vcpus;
+
+	stats = calloc(nr_vcpus, sizeof(*stats));
+	if (stats == NULL)
+		return;
+
+	if (xc_sched_vcpu_stats(node->handle->xc_handle, domain->id,
+				&nr_vcpus, stats) == 0) {
+		for (vcpu = 0; vcpu < nr_vcpus; vcpu++) {
+			xenstat_vcpu *v = &domain->vcpus[vcpu];
+			unsigned int reason;
+
+			v->preemptions = stats[vcpu].preemptions;
+			v->migrations = stats[vcpu].migrations;
+			v->wakeups = stats[vcpu].wakeups;
+			v->wake_latency_max = stats[vcpu].wake_latency_max;
+			for (reason = 0; reason < XENSTAT_DELAY_NR; reason++)
+				v->delay[reason] = stats[vcpu].delay[reason];
+		}
+	}
+
+	free(stats);
+}
+
 /* Collect information about VCPUs */
 static int xenstat_collect_vcpus(xenstat_node * node)
 {
@@ -458,8 +488,8 @@ static int xenstat_collect_vcpus(xenstat_node * node)
 	for (i = 0; i < node->num_domains; i+=inc_index) {
 		inc_index = 1; /* default is to increment to next domain */
 
-		node->domains[i].vcpus = malloc(node->domains[i].num_vcpus
-						* sizeof(xenstat_vcpu));
+		node->domains[i].vcpus = calloc(node->domains[i].num_vcpus,
+						sizeof(xenstat_vcpu));
 		if (node->domains[i].vcpus == NULL)
 			return 0;
 	
@@ -488,6 +518,9 @@ static int xenstat_collect_vcpus(xenstat_node * node)
 				node->domains[i].vcpus[vcpu].ns = info.cpu_time;
 			}
 		}
+
+		if (inc_index)
+			xenstat_collect_sched_stats(node, &node->domains[i]);
 	}
 	return 1;
 }
@@ -517,6 +550,50 @@ unsigned long long xenstat_vcpu_ns(xenstat_vcpu * vcpu)
 	return vcpu->ns;
 }
 
+/* Get VCPU time spent runnable but not running, for a given reason */
+unsigned long long xenstat_vcpu_delay_ns(xenstat_vcpu * vcpu,
+					 unsigned int reason)
+{
+	if (reason < XENSTAT_DELAY_NR)
+		return vcpu->delay[reason];
+	return 0;
+}
+
+/* Get VCPU total time spent runnable but not running */
+unsigned long long xenstat_vcpu_run_delay_ns(xenstat_vcpu * vcpu)
+{
+	unsigned long long delay = 0;
+	unsigned int reason;
+
+	for (reason = 0; reason < XENSTAT_DELAY_NR; reason++)
+		delay += vcpu->delay[reason];
+	return delay;
+}
+
+/* Get VCPU preemptions */
+unsigned long long xenstat_vcpu_preemptions(xenstat_vcpu * vcpu)
+{
+	return vcpu->preemptions;
+}
+
+/* Get VCPU migrations */
+unsigned long long xenstat_vcpu_migrations(xenstat_vcpu * vcpu)
+{
+	return vcpu->migrations;
+}
+
+/* Get VCPU wake-to-run latency samples */
+unsigned long long xenstat_vcpu_wakeups(xenstat_vcpu * vcpu)
+{
+	return vcpu->wakeups;
+}
+
+/* Get VCPU worst wake-to-run latency */
+unsigned long long xenstat_vcpu_wake_latency_max_ns(xenstat_vcpu * vcpu)
+{
+	return vcpu->wake_latency_max;
+}
+
 /*
  * Network functions
  */
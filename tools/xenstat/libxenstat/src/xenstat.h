@@ -139,6 +139,30 @@ xenstat_vbd *xenstat_domain_vbd(xenstat_domain * domain,
 unsigned int xenstat_vcpu_online(xenstat_vcpu * vcpu);
 unsigned long long xenstat_vcpu_ns(xenstat_vcpu * vcpu);
 
+/* Reasons a VCPU had to wait for a CPU, see xenstat_vcpu_delay_ns() */
+#define XENSTAT_DELAY_WAKE	0	/* woken up after blocking */
+#define XENSTAT_DELAY_PREEMPT	1	/* preempted while runnable */
+#define XENSTAT_DELAY_YIELD	2	/* yielded the CPU */
+#define XENSTAT_DELAY_OTHER	3	/* unpaused or brought online */
+#define XENSTAT_DELAY_NR	4
+
+/* Get time spent runnable but not running, for a given reason */
+unsigned long long xenstat_vcpu_delay_ns(xenstat_vcpu * vcpu,
+					 unsigned int reason);
+
+/* Get total time spent runnable but not running */
+unsigned long long xenstat_vcpu_run_delay_ns(xenstat_vcpu * vcpu);
+
+/* Get number of times the VCPU was preempted while runnable */
+unsigned long long xenstat_vcpu_preemptions(xenstat_vcpu * vcpu);
+
+/* Get number of times the VCPU moved to another physical CPU */
+unsigned long long xenstat_vcpu_migrations(xenstat_vcpu * vcpu);
+
+/* Get number of wake-to-run latency samples, and the worst of them */
+unsigned long long xenstat_vcpu_wakeups(xenstat_vcpu * vcpu);
+unsigned long long xenstat_vcpu_wake_latency_max_ns(xenstat_vcpu * vcpu);
+
 
 /*
  * Network functions - extract information from a xenstat_network
@@ -71,6 +71,12 @@ struct xenstat_domain {
 struct xenstat_vcpu {
 	unsigned int online;
 	unsigned long long ns;
+	/* Scheduling statistics */
+	unsigned long long preemptions;
+	unsigned long long migrations;
+	unsigned long long wakeups;
+	unsigned long long wake_latency_max;
+	unsigned long long delay[XENSTAT_DELAY_NR];
 };
 
 struct xenstat_network {
@@ -135,6 +135,7 @@ static void do_header(void);
 static void do_bottom_line(void);
 static void do_domain(xenstat_domain *);
 static void do_vcpu(xenstat_domain *);
+static void do_sched(xenstat_domain *);
 static void do_network(xenstat_domain *);
 static void do_vbd(xenstat_domain *);
 static void top(void);
@@ -207,6 +208,7 @@ unsigned int batch = 0;
 unsigned int loop = 1;
 unsigned int iterations = 0;
 int show_vcpus = 0;
+int show_sched = 0;
 int show_networks = 0;
 int show_vbds = 0;
 int repeat_header = 0;
@@ -237,6 +239,7 @@ static void usage(const char *program)
 	       "-x, --vbds           output vbd block device data\n"
 	       "-r, --repeat-header  repeat table header before each domain\n"
 	       "-v, --vcpus          output vcpu data\n"
+	       "-l, --latency        output vcpu scheduling latency data\n"
 	       "-b, --batch	     output in batch mode, no user input accepted\n"
 	       "-i, --iterations     number of iterations before exiting\n"
 	       "-f, --full-name      output the full domain name (not truncated)\n"
@@ -370,6 +373,9 @@ static int handle_key(int ch)
 		case 'v': case 'V':
 			show_vcpus ^= 1;
 			break;
+		case 'l': case 'L':
+			show_sched ^= 1;
+			break;
 		case KEY_DOWN:
 			first_domain_index++;
 			break;
@@ -1027,6 +1033,11 @@ void do_bottom_line(void)
 		attr_addstr(show_vcpus ? COLOR_PAIR(1) : 0, "CPUs");
 		addstr("  ");
 
+		/* scheduling latency */
+		addch(A_REVERSE | 'L');
+		attr_addstr(show_sched ? COLOR_PAIR(1) : 0, "atency");
+		addstr("  ");
+
 		/* repeat */
 		addch(A_REVERSE | 'R');
 		attr_addstr(repeat_header ? COLOR_PAIR(1) : 0, "epeat header");
@@ -1080,6 +1091,115 @@ void do_vcpu(xenstat_domain *domain)
 	print("\n");
 }
 
+/* Scheduling counters of a vcpu, all zero if there is no vcpu */
+struct sched_sample {
+	unsigned long long delay[XENSTAT_DELAY_NR];
+	unsigned long long run_delay;
+	unsigned long long preemptions;
+	unsigned long long migrations;
+	unsigned long long wakeups;
+};
+
+static void get_sched_sample(xenstat_vcpu *vcpu, struct sched_sample *s)
+{
+	unsigned int reason;
+
+	memset(s, 0, sizeof(*s));
+	if (vcpu == NULL)
+		return;
+
+	for (reason = 0; reason < XENSTAT_DELAY_NR; reason++)
+		s->delay[reason] = xenstat_vcpu_delay_ns(vcpu, reason);
+	s->run_delay = xenstat_vcpu_run_delay_ns(vcpu);
+	s->preemptions = xenstat_vcpu_preemptions(vcpu);
+	s->migrations = xenstat_vcpu_migrations(vcpu);
+	s->wakeups = xenstat_vcpu_wakeups(vcpu);
+}
+
+/* Computes the percentage of the sampling interval a counter of nanoseconds
+ * advanced by */
+static double sched_pct(unsigned long long now, unsigned long long then,
+			double us_elapsed)
+{
+	if (us_elapsed <= 0.0 || now < then)
+		return 0.0;
+	return ((now - then)/10.0)/us_elapsed;
+}
+
+/* Computes the rate per second at which an event counter advanced */
+static double sched_rate(unsigned long long now, unsigned long long then,
+			 double us_elapsed)
+{
+	if (us_elapsed <= 0.0 || now < then)
+		return 0.0;
+	return (now - then)*1000000.0/us_elapsed;
+}
+
+/* Output vcpu scheduling statistics over the last sampling interval */
+void do_sched(xenstat_domain *domain)
+{
+	xenstat_domain *old_domain = NULL;
+	unsigned int i, num_vcpus;
+	double us_elapsed;
+
+	if (prev_node != NULL)
+		old_domain = xenstat_node_domain(prev_node,
+						 xenstat_domain_id(domain));
+
+	print("VCPU sched: %6s %6s %6s %6s %6s %9s %9s %10s %10s\n",
+	      "WAIT%", "WAKE%", "PREEM%", "YIELD%", "OTHER%",
+	      "PREEMPT/s", "MIGR/s", "WAKE(us)", "MAXWK(us)");
+
+	num_vcpus = xenstat_domain_num_vcpus(domain);
+
+	/* for all online vcpus dump out values */
+	for (i = 0; i < num_vcpus; i++) {
+		xenstat_vcpu *vcpu = xenstat_domain_vcpu(domain, i);
+		xenstat_vcpu *old_vcpu = NULL;
+		struct sched_sample cur, old;
+		double wake_us = 0.0;
+
+		if (xenstat_vcpu_online(vcpu) == 0)
+			continue;
+
+		if (old_domain != NULL)
+			old_vcpu = xenstat_domain_vcpu(old_domain, i);
+
+		get_sched_sample(vcpu, &cur);
+		get_sched_sample(old_vcpu, &old);
+
+		/* Without a previous sample, report averages since the vcpu
+		 * was created */
+		if (old_vcpu != NULL)
+			us_elapsed = ((curtime.tv_sec-oldtime.tv_sec)*1000000.0
+				      +(curtime.tv_usec - oldtime.tv_usec));
+		else
+			us_elapsed = (xenstat_vcpu_ns(vcpu)
+				      + cur.run_delay)/1000.0;
+
+		if (cur.wakeups > old.wakeups)
+			wake_us = (cur.delay[XENSTAT_DELAY_WAKE]
+				   - old.delay[XENSTAT_DELAY_WAKE])/1000.0
+				  / (cur.wakeups - old.wakeups);
+
+		print("       %3u: %6.1f %6.1f %6.1f %6.1f %6.1f %9.1f %9.1f "
+		      "%10.1f %10.1f\n", i,
+		      sched_pct(cur.run_delay, old.run_delay, us_elapsed),
+		      sched_pct(cur.delay[XENSTAT_DELAY_WAKE],
+				old.delay[XENSTAT_DELAY_WAKE], us_elapsed),
+		      sched_pct(cur.delay[XENSTAT_DELAY_PREEMPT],
+				old.delay[XENSTAT_DELAY_PREEMPT], us_elapsed),
+		      sched_pct(cur.delay[XENSTAT_DELAY_YIELD],
+				old.delay[XENSTAT_DELAY_YIELD], us_elapsed),
+		      sched_pct(cur.delay[XENSTAT_DELAY_OTHER],
+				old.delay[XENSTAT_DELAY_OTHER], us_elapsed),
+		      sched_rate(cur.preemptions, old.preemptions, us_elapsed),
+		      sched_rate(cur.migrations, old.migrations, us_elapsed),
+		      wake_us,
+		      xenstat_vcpu_wake_latency_max_ns(vcpu)/1000.0);
+	}
+}
+
 /* Output all network information */
 void do_network(xenstat_domain *domain)
 {
@@ -1207,6 +1327,8 @@ static void top(void)
 		do_domain(domains[i]);
 		if (show_vcpus)
 			do_vcpu(domains[i]);
+		if (show_sched)
+			do_sched(domains[i]);
 		if (show_networks)
 			do_network(domains[i]);
 		if (show_vbds)
@@ -1238,13 +1360,14 @@ int main(int argc, char **argv)
 		{ "vbds",          no_argument,       NULL, 'x' },
 		{ "repeat-header", no_argument,       NULL, 'r' },
 		{ "vcpus",         no_argument,       NULL, 'v' },
+		{ "latency",       no_argument,       NULL, 'l' },
 		{ "delay",         required_argument, NULL, 'd' },
 		{ "batch",	   no_argument,	      NULL, 'b' },
 		{ "iterations",	   required_argument, NULL, 'i' },
 		{ "full-name",     no_argument,       NULL, 'f' },
 		{ 0, 0, 0, 0 },
 	};
-	const char *sopts = "hVnxrvd:bi:f";
+	const char *sopts = "hVnxrvld:bi:f";
 
 	if (atexit(cleanup) != 0)
 		fail("Failed to install cleanup handler.\n");
@@ -1273,6 +1396,9 @@ int main(int argc, char **argv)
 		case 'v':
 			show_vcpus = 1;
 			break;
+		case 'l':
+			show_sched = 1;
+			break;
 		case 'd':
 			delay = atoi(optarg);
 			break;
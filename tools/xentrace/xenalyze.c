@@ -174,6 +174,7 @@ struct {
         with_mmio_enumeration:1,
         with_interrupt_eip_enumeration:1,
         show_default_domain_summary:1,
+        wake_latency_histogram:1,
         mmio_enumeration_skip_vga:1,
         progress:1,
         svm_mode:1,
@@ -247,6 +248,7 @@ struct {
     .with_mmio_enumeration = 0,
     .with_interrupt_eip_enumeration = 0,
     .show_default_domain_summary = 0,
+    .wake_latency_histogram = 0,
     .mmio_enumeration_skip_vga = 1,
     .progress = 0,
     .svm_mode = 0,
@@ -1552,6 +1554,18 @@ char * runnable_state_name[RUNNABLE_STATE_MAX]={
     [RUNNABLE_STATE_OTHER]="other",
 };
 
+/*
+ * Wake latency (time from wakeup to running) histogram: bucket 0 is for
+ * less than 1us, bucket i for [2^(i-1), 2^i) us, and the last one for
+ * anything longer.
+ */
+#define WAKE_LATENCY_BUCKETS 24
+
+struct wake_latency_histogram {
+    unsigned long long count;
+    unsigned long long bucket[WAKE_LATENCY_BUCKETS];
+};
+
 /* Memory data */
 enum {
     MEM_PAGE_GRANT_MAP = 1,
@@ -1657,6 +1671,7 @@ struct vcpu_data {
     struct cycle_framework f;
     struct cycle_summary runstates[RUNSTATE_MAX];
     struct cycle_summary runnable_states[RUNNABLE_STATE_MAX];
+    struct wake_latency_histogram wake_latency;
     struct cycle_summary cpu_affinity_all,
         cpu_affinity_pcpu[MAX_CPUS];
     enum {
@@ -1717,6 +1732,7 @@ struct domain_data {
     tsc_t runstate_tsc;
     struct cycle_summary total_time;
     struct cycle_summary runstates[DOMAIN_RUNSTATE_MAX];
+    struct wake_latency_histogram wake_latency;
     struct cr3_value_struct *cr3_value_head;
     struct eip_list_struct *emulate_eip_list;
     struct eip_list_struct *interrupt_eip_list;
@@ -4930,6 +4946,51 @@ int domain_runstate(struct domain_data *d) {
     return -1; /* Never happens */
 }
 
+static void update_wake_latency(struct wake_latency_histogram *h,
+                                unsigned long long c)
+{
+    unsigned long long us = ((c << 10) / opt.cpu_qhz) / 1000;
+    int i = 0;
+
+    while ( us && i < WAKE_LATENCY_BUCKETS - 1 )
+    {
+        us >>= 1;
+        i++;
+    }
+
+    h->count++;
+    h->bucket[i]++;
+}
+
+static void print_wake_latency(const struct wake_latency_histogram *h,
+                               const char *p)
+{
+    int i;
+
+    if ( !h->count )
+        return;
+
+    printf("%s Wake latency: %llu wakeups\n", p, h->count);
+    for ( i = 0; i < WAKE_LATENCY_BUCKETS; i++ )
+    {
+        char range[32];
+
+        if ( !h->bucket[i] )
+            continue;
+
+        if ( i == 0 )
+            snprintf(range, sizeof(range), "<1us");
+        else if ( i == WAKE_LATENCY_BUCKETS - 1 )
+            snprintf(range, sizeof(range), ">=%lluus", 1ULL << (i - 1));
+        else
+            snprintf(range, sizeof(range), "%llu-%lluus",
+                     1ULL << (i - 1), (1ULL << i) - 1);
+
+        printf("%s  %16s: %10llu %5.1lf%%\n", p, range, h->bucket[i],
+               (h->bucket[i] * 100.0) / h->count);
+    }
+}
+
 static inline void runstate_update(struct vcpu_data *v, int new_runstate,
                                    tsc_t tsc)
 {
@@ -4973,6 +5034,15 @@ static inline void runstate_update(struct vcpu_data *v, int new_runstate,
         if(v->runstate.state == RUNSTATE_RUNNABLE)
             update_cycles(v->runnable_states + v->runstate.runnable_state, tsc - v->runstate.tsc);
 
+        if ( opt.wake_latency_histogram
+             && v->runstate.state == RUNSTATE_RUNNABLE
+             && v->runstate.runnable_state == RUNNABLE_STATE_WAKE
+             && new_runstate == RUNSTATE_RUNNING )
+        {
+            update_wake_latency(&v->wake_latency, tsc - v->runstate.tsc);
+            update_wake_latency(&d->wake_latency, tsc - v->runstate.tsc);
+        }
+
         /* How much did dom0 run this buffer? */
         if(v->d->did == 0) {
             int i;
@@ -7388,6 +7458,8 @@ void sched_summary_vcpu(struct vcpu_data *v)
             }
         }
     }
+    if ( opt.wake_latency_histogram )
+        print_wake_latency(&v->wake_latency, "");
     print_cpu_affinity(&v->cpu_affinity_all, " cpu affinity");
     for ( i = 0; i < MAX_CPUS ; i++)
     {
@@ -7406,6 +7478,8 @@ void sched_summary_domain(struct domain_data *d)
         snprintf(desc,30, "  %8s", domain_runstate_name[i]);
         print_cycle_summary(d->runstates+i, desc);
     }
+    if ( opt.wake_latency_histogram )
+        print_wake_latency(&d->wake_latency, "");
 }
 
 void dump_sched_vcpu_action(struct record_info *ri, const char *action)
@@ -7546,6 +7620,31 @@ void sched_process(struct pcpu_info *p)
                 printf("\n");
             }
             break;
+        case TRC_SCHED_RENDEZVOUS:
+            if(opt.dump_all)
+            {
+                struct {
+                    unsigned int domid, unitid, in_wait, out_wait;
+                } *r = (typeof(r))ri->d;
+
+                printf(" %s sched_rendezvous d%uu%u, waited %u.%03uus in, %u.%03uus out\n",
+                       ri->dump_header, r->domid, r->unitid,
+                       r->in_wait / 1000, r->in_wait % 1000,
+                       r->out_wait / 1000, r->out_wait % 1000);
+            }
+            break;
+        case TRC_SCHED_YIELD_TO:
+            if(opt.dump_all)
+            {
+                struct {
+                    unsigned int domid, vcpuid, holder, cpu;
+                } *r = (typeof(r))ri->d;
+
+                printf(" %s vcpu_yield_to d%uv%u -> d%uv%u (cpu %u)\n",
+                       ri->dump_header, r->domid, r->vcpuid,
+                       r->domid, r->holder, r->cpu);
+            }
+            break;
         case TRC_SCHED_CTL:
         case TRC_SCHED_S_TIMER_FN:
         case TRC_SCHED_T_TIMER_FN:
@@ -7972,6 +8071,17 @@ void sched_process(struct pcpu_info *p)
                        r->tickled ? ", tickled" : ", not tickled");
             }
             break;
+        case TRC_SCHED_CLASS_EVT(RTDS, 7): /* SCHED_DONE       */
+            if (opt.dump_all) {
+                struct {
+                    unsigned cpu:16, cluster:16;
+                    uint32_t duration;
+                } __attribute__((packed)) *r = (typeof(r))ri->d;
+
+                printf(" %s rtds:sched_done cpu %u, cluster %u, %u ns\n",
+                       ri->dump_header, r->cpu, r->cluster, r->duration);
+            }
+            break;
         case TRC_SCHED_CLASS_EVT(SNULL, 1): /* PICKED_CPU */
             if (opt.dump_all) {
                 struct {
@@ -10032,6 +10142,7 @@ enum {
     OPT_INTERVAL_DOMAIN_GRANT_MAPS,
     /* Summary info */
     OPT_SHOW_DEFAULT_DOMAIN_SUMMARY,
+    OPT_WAKE_LATENCY_HISTOGRAM,
     OPT_MMIO_ENUMERATION_SKIP_VGA,
     OPT_SAMPLE_SIZE,
     OPT_SAMPLE_MAX,
@@ -10209,6 +10320,9 @@ error_t cmd_parser(int key, char *arg, struct argp_state *state)
     case OPT_SHOW_DEFAULT_DOMAIN_SUMMARY:
         opt.show_default_domain_summary=1;
         break;
+    case OPT_WAKE_LATENCY_HISTOGRAM:
+        opt.wake_latency_histogram=1;
+        break;
     case OPT_SAMPLE_SIZE:
     {
         char * inval;
@@ -10752,6 +10866,11 @@ const struct argp_option cmd_opts[] =  {
       .group = OPT_GROUP_SUMMARY,
       .doc = "Show default domain information on summary", },
 
+    { .name = "wake-latency-histogram",
+      .key = OPT_WAKE_LATENCY_HISTOGRAM,
+      .group = OPT_GROUP_SUMMARY,
+      .doc = "Show histograms of the time vcpus spend runnable after waking up, before actually running.", },
+
     { .name = "mmio-enumeration-skip-vga",
       .key = OPT_MMIO_ENUMERATION_SKIP_VGA,
       .arg = "[0|1]",
@@ -62,7 +62,8 @@ typedef struct settings_st {
     unsigned long memory_buffer;
     uint8_t discard:1,
         disable_tracing:1,
-        start_disabled:1;
+        start_disabled:1,
+        overwrite:1;
 } settings_t;
 
 struct t_struct {
@@ -584,6 +585,42 @@ static void set_evt_mask(uint32_t mask)
     }
 }
 
+static uint32_t saved_mode;
+static int keep_mode;
+
+static void restore_mode(void)
+{
+    if ( keep_mode )
+        return;
+
+    if ( xc_tbuf_set_mode(xc_handle, saved_mode) != 0 )
+        PERROR("Failure to restore trace buffer mode");
+}
+
+/**
+ * set_overwrite - make Xen overwrite old records rather than lose new ones
+ *
+ * The previous mode is restored on exit, unless tracing was deliberately
+ * left running with -x.
+ */
+static void set_overwrite(void)
+{
+    if ( xc_tbuf_get_mode(xc_handle, &saved_mode) != 0 )
+    {
+        PERROR("Failure to get trace buffer mode");
+        exit(EXIT_FAILURE);
+    }
+
+    if ( xc_tbuf_set_mode(xc_handle, XEN_SYSCTL_TBUF_MODE_overwrite) != 0 )
+    {
+        PERROR("Failure to set trace buffer overwrite mode");
+        exit(EXIT_FAILURE);
+    }
+
+    if ( saved_mode != XEN_SYSCTL_TBUF_MODE_overwrite )
+        atexit(restore_mode);
+}
+
 /**
  * get_num_cpus - get the number of logical CPUs
  */
@@ -676,6 +713,7 @@ static int monitor_tbufs(void)
     struct t_buf **meta;         /* pointers to the trace buffer metadata    */
     unsigned char **data;        /* pointers to the trace buffer data areas
                                   * where they are mapped into user space.   */
+    unsigned char *copy;         /* window being read out of a trace buffer */
     unsigned long tbufs_mfn;     /* mfn of the tbufs                         */
     unsigned int  num;           /* number of trace buffers / logical CPUS   */
     unsigned long tinfo_size;    /* size of t_info metadata map */
@@ -706,10 +744,28 @@ static int monitor_tbufs(void)
     meta = tbufs->meta;
     data = tbufs->data;
 
+    /*
+     * In overwrite mode Xen moves cons as well, so it may only be updated
+     * with a compare-and-exchange (see struct t_buf).
+     */
     if ( opts.discard )
         for ( i = 0; i < num; i++ )
             if ( meta[i] )
-                meta[i]->cons = meta[i]->prod;
+            {
+                uint32_t cons;
+
+                do {
+                    cons = meta[i]->cons;
+                } while ( !__sync_bool_compare_and_swap(&meta[i]->cons, cons,
+                                                        meta[i]->prod) );
+            }
+
+    copy = malloc(data_size);
+    if ( copy == NULL )
+    {
+        PERROR("Failed to allocate trace copy buffer");
+        exit(EXIT_FAILURE);
+    }
 
     /* now, scan buffers for events */
     while ( 1 )
@@ -721,6 +777,7 @@ static int monitor_tbufs(void)
             if ( !meta[i] )
                 continue;
 
+        retry:
             /* Read window information only once. */
             cons = meta[i]->cons;
             prod = meta[i]->prod;
@@ -746,27 +803,31 @@ static int monitor_tbufs(void)
 
             if ( end_offset > start_offset )
             {
-                /* If window does not wrap, write in one big chunk */
-                write_buffer(i, data[i]+start_offset,
-                             window_size,
-                             window_size);
+                /* If window does not wrap, copy in one big chunk */
+                memcpy(copy, data[i] + start_offset, window_size);
             }
             else
             {
-                /* If wrapped, write in two chunks:
+                /* If wrapped, copy in two chunks:
                  * - first, start to the end of the buffer
                  * - second, start of buffer to end of window
                  */
-                write_buffer(i, data[i] + start_offset,
-                             data_size - start_offset,
-                             window_size);
-                write_buffer(i, data[i],
-                             end_offset,
-                             0);
+                memcpy(copy, data[i] + start_offset,
+                       data_size - start_offset);
+                memcpy(copy + data_size - start_offset, data[i],
+                       end_offset);
             }
 
-            xen_mb(); /* read buffer, then update cons. */
-            meta[i]->cons = prod;
+            /*
+             * Xen only overwrites records after moving cons past them.  If
+             * cons is still where we read it, the copy is intact and the
+             * window is ours; otherwise start over from the new cons.  This
+             * is a full barrier: read buffer, then update cons.
+             */
+            if ( !__sync_bool_compare_and_swap(&meta[i]->cons, cons, prod) )
+                goto retry;
+
+            write_buffer(i, copy, window_size, window_size);
 
         }
 
@@ -793,6 +854,7 @@ static int monitor_tbufs(void)
     /* cleanup */
     free(meta);
     free(data);
+    free(copy);
     /* don't need to munmap - cleanup is automatic */
     close(outfd);
 
@@ -837,6 +899,10 @@ static void usage(void)
 "  -X  --start-disabled    Setup trace buffers and listen, but don't enable\n" \
 "                          tracing. (Useful if tracing will be enabled by\n" \
 "                          else.)\n" \
+"  -O  --overwrite         When a trace buffer is full, overwrite the oldest\n" \
+"                          records instead of losing new ones.  Combined\n" \
+"                          with -x this leaves a flight recorder running,\n" \
+"                          whose buffers can be collected later.\n" \
 "  -T  --time-interval=s   Run xentrace for s seconds and quit.\n" \
 "  -?, --help              Show this message\n" \
 "  -V, --version           Print program version\n" \
@@ -1093,12 +1159,13 @@ static void parse_args(int argc, char **argv)
         { "discard-buffers", no_argument,      0, 'D' },
         { "dont-disable-tracing", no_argument, 0, 'x' },
         { "start-disabled", no_argument,       0, 'X' },
+        { "overwrite",      no_argument,       0, 'O' },
         { "help",           no_argument,       0, '?' },
         { "version",        no_argument,       0, 'V' },
         { 0, 0, 0, 0 }
     };
 
-    while ( (option = getopt_long(argc, argv, "t:s:c:e:S:r:T:M:DxX?V",
+    while ( (option = getopt_long(argc, argv, "t:s:c:e:S:r:T:M:DxXO?V",
                     long_options, NULL)) != -1) 
     {
         switch ( option )
@@ -1139,6 +1206,10 @@ static void parse_args(int argc, char **argv)
             opts.start_disabled = 1;
             break;
 
+        case 'O': /* Overwrite old records when full */
+            opts.overwrite = 1;
+            break;
+
         case 'T':
             opts.timeout = argtol(optarg, 0);
             break;
@@ -1190,6 +1261,9 @@ int main(int argc, char **argv)
     if ( opts.evt_mask != 0 )
         set_evt_mask(opts.evt_mask);
 
+    if ( opts.overwrite )
+        set_overwrite();
+
     if ( opts.cpu_mask_str )
     {
         if ( parse_cpu_mask() )
@@ -1230,6 +1304,10 @@ int main(int argc, char **argv)
 
     ret = monitor_tbufs();
 
+    /* Tracing keeps running, e.g. as a flight recorder: leave it as set up. */
+    if ( !opts.disable_tracing )
+        keep_mode = 1;
+
     return ret;
 }
 
@@ -252,6 +252,17 @@ struct cmd_spec cmd_table[] = {
       "Get information about page sharing",
       "[Domain]", 
     },
+    { "numa-rebalance",
+      &main_numa_rebalance, 0, 1,
+      "Move vCPU soft affinity and memory of domains to follow their load",
+      "[options] [Domain...]",
+      "-i, --interval=SECS  Seconds between rounds (default 10)\n"
+      "-r, --rate=MB        Max. memory to move per round (default 256)\n"
+      "-t, --threshold=PCT  Share of a domain's runtime a node needs to\n"
+      "                     become its home node (default 60)\n"
+      "-n, --dryrun         Only report what would be done\n"
+      "-o, --once           Do one round only",
+    },
     { "sched-credit",
       &main_sched_credit, 0, 1,
       "Get/set credit scheduler parameters",
@@ -272,6 +283,7 @@ struct cmd_spec cmd_table[] = {
       "-d DOMAIN, --domain=DOMAIN     Domain to modify\n"
       "-w WEIGHT, --weight=WEIGHT     Weight (int)\n"
       "-c CAP,    --cap=CAP           Cap (int)\n"
+      "-l LAT,    --latency-class=LAT Latency class (1=yes, 0=no)\n"
       "-s         --schedparam        Query / modify scheduler parameters\n"
       "-r RLIMIT, --ratelimit_us=RLIMIT Set the scheduling rate limit, in microseconds\n"
       "-p CPUPOOL, --cpupool=CPUPOOL  Restrict output to CPUPOOL"
@@ -0,0 +1,330 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; version 2.1 only. with the special
+ * exception on linking described in file LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <xen-tools/libs.h>
+
+#include <libxl.h>
+#include <libxl_utils.h>
+#include <libxlutil.h>
+
+#include "xl.h"
+#include "xl_utils.h"
+
+/*
+ * numa-rebalance periodically looks at which NUMA node each domain's vCPUs
+ * have been running on.  Once a node accounts for most of a domain's recent
+ * runtime, it becomes the domain's home node: the vCPUs' soft affinity is
+ * set to it, and the domain's memory is moved there, a bounded amount per
+ * round, so that placement decided at creation time follows the load.
+ */
+
+/* Free memory to leave alone on a node when moving memory to it. */
+#define REBALANCE_NODE_RESERVE_KB (64 * 1024)
+
+struct rebalance_dom {
+    uint32_t domid;
+    bool seen;              /* Still around in the current round. */
+    int home;               /* Node the domain lives on, or -1. */
+    uint64_t cursor;        /* Where to carry on moving memory from. */
+    int nr_vcpus;
+    uint64_t *vcpu_time;    /* vCPU runtimes at the previous round. */
+    double *load;           /* Decaying runtime average, per node. */
+};
+
+static struct rebalance_dom *rb_doms;
+static int rb_nr_doms;
+
+static struct rebalance_dom *rebalance_dom_get(uint32_t domid, int nr_nodes)
+{
+    struct rebalance_dom *d;
+    int i;
+
+    for (i = 0; i < rb_nr_doms; i++)
+        if (rb_doms[i].domid == domid)
+            return &rb_doms[i];
+
+    rb_doms = xrealloc(rb_doms, (rb_nr_doms + 1) * sizeof(*rb_doms));
+    d = &rb_doms[rb_nr_doms++];
+    memset(d, 0, sizeof(*d));
+    d->domid = domid;
+    d->home = -1;
+    d->load = xcalloc(nr_nodes, sizeof(*d->load));
+
+    return d;
+}
+
+/* Forget about domains which weren't seen in this round. */
+static void rebalance_dom_prune(void)
+{
+    int i = 0;
+
+    while (i < rb_nr_doms) {
+        struct rebalance_dom *d = &rb_doms[i];
+
+        if (d->seen) {
+            d->seen = false;
+            i++;
+            continue;
+        }
+
+        free(d->vcpu_time);
+        free(d->load);
+        *d = rb_doms[--rb_nr_doms];
+    }
+}
+
+/*
+ * Fold the runtime of the domain's vCPUs since the last round into the
+ * per-node load, and return the node which now accounts for at least
+ * threshold percent of it, or -1.
+ */
+static int rebalance_pick_node(struct rebalance_dom *d,
+                               const libxl_cputopology *topo, int nr_cpus,
+                               int nr_nodes, int threshold)
+{
+    libxl_vcpuinfo *vcpus;
+    int nb_vcpu, nrcpus, i, best = -1;
+    double total = 0;
+
+    vcpus = libxl_list_vcpu(ctx, d->domid, &nb_vcpu, &nrcpus);
+    if (!vcpus)
+        return -1;
+
+    if (nb_vcpu != d->nr_vcpus) {
+        d->vcpu_time = xrealloc(d->vcpu_time,
+                                nb_vcpu * sizeof(*d->vcpu_time));
+        for (i = d->nr_vcpus; i < nb_vcpu; i++)
+            d->vcpu_time[i] = vcpus[i].vcpu_time;
+        d->nr_vcpus = nb_vcpu;
+    }
+
+    for (i = 0; i < nr_nodes; i++)
+        d->load[i] /= 2;
+
+    for (i = 0; i < nb_vcpu; i++) {
+        uint64_t delta = vcpus[i].vcpu_time - d->vcpu_time[i];
+        unsigned int cpu = vcpus[i].cpu;
+
+        d->vcpu_time[i] = vcpus[i].vcpu_time;
+        if (!vcpus[i].online || cpu >= nr_cpus ||
+            topo[cpu].node >= nr_nodes)
+            continue;
+        d->load[topo[cpu].node] += delta;
+    }
+
+    libxl_vcpuinfo_list_free(vcpus, nb_vcpu);
+
+    for (i = 0; i < nr_nodes; i++) {
+        total += d->load[i];
+        if (best < 0 || d->load[i] > d->load[best])
+            best = i;
+    }
+
+    if (total == 0 || d->load[best] * 100 < total * threshold)
+        return -1;
+
+    return best;
+}
+
+static int rebalance_set_home(struct rebalance_dom *d, int node,
+                              unsigned int max_vcpus)
+{
+    libxl_bitmap cpumap;
+    int rc;
+
+    libxl_bitmap_init(&cpumap);
+    rc = libxl_cpu_bitmap_alloc(ctx, &cpumap, 0);
+    if (!rc)
+        rc = libxl_node_to_cpumap(ctx, node, &cpumap);
+    if (!rc)
+        rc = libxl_set_vcpuaffinity_all(ctx, d->domid, max_vcpus,
+                                        NULL, &cpumap);
+    libxl_bitmap_dispose(&cpumap);
+
+    return rc;
+}
+
+/*
+ * With sample_only set, only record the current vCPU runtimes, so that the
+ * next round has something to compute the load against.
+ */
+static void rebalance_round(int threshold, uint64_t budget, bool dryrun,
+                            bool sample_only, uint32_t *domids, int nr_domids)
+{
+    libxl_cputopology *topo = NULL;
+    libxl_numainfo *numa = NULL;
+    libxl_dominfo *info = NULL;
+    int nr_cpus = 0, nr_nodes = 0, nb_domain = 0, i, j;
+
+    topo = libxl_get_cpu_topology(ctx, &nr_cpus);
+    numa = libxl_get_numainfo(ctx, &nr_nodes);
+    info = libxl_list_domain(ctx, &nb_domain);
+    if (!topo || !numa || !info) {
+        fprintf(stderr, "Failed to get host or domain information.\n");
+        goto out;
+    }
+
+    for (i = 0; i < nb_domain; i++) {
+        struct rebalance_dom *d;
+        uint64_t on_node, off_node, free_kb, moved = 0;
+        int node;
+
+        if (nr_domids) {
+            for (j = 0; j < nr_domids; j++)
+                if (domids[j] == info[i].domid)
+                    break;
+            if (j == nr_domids)
+                continue;
+        } else if (info[i].domid == 0)
+            continue;
+
+        if (info[i].domain_type == LIBXL_DOMAIN_TYPE_PV ||
+            info[i].dying || info[i].shutdown)
+            continue;
+
+        d = rebalance_dom_get(info[i].domid, nr_nodes);
+        d->seen = true;
+
+        node = rebalance_pick_node(d, topo, nr_cpus, nr_nodes, threshold);
+        if (sample_only)
+            continue;
+        if (node >= 0 && node != d->home) {
+            printf("Domain %u: home node %d -> %d\n", d->domid, d->home, node);
+            if (!dryrun &&
+                rebalance_set_home(d, node, info[i].vcpu_max_id + 1)) {
+                fprintf(stderr, "Failed to set soft affinity of domain %u.\n",
+                        d->domid);
+                continue;
+            }
+            d->home = node;
+            d->cursor = 0;
+        }
+
+        if (d->home < 0)
+            continue;
+
+        if (libxl_domain_numa_pages(ctx, d->domid, d->home,
+                                    &on_node, &off_node))
+            continue;
+
+        if (off_node && !dryrun && budget) {
+            free_kb = numa[d->home].free / 1024;
+            if (numa[d->home].free == LIBXL_NUMAINFO_INVALID_ENTRY ||
+                free_kb <= REBALANCE_NODE_RESERVE_KB)
+                continue;
+            free_kb -= REBALANCE_NODE_RESERVE_KB;
+
+            if (libxl_domain_numa_move(ctx, d->domid, d->home,
+                                       min(budget, free_kb / 4),
+                                       &d->cursor, &moved))
+                fprintf(stderr, "Failed to move memory of domain %u.\n",
+                        d->domid);
+            budget -= min(moved, budget);
+            numa[d->home].free -= min(moved * 4096, numa[d->home].free);
+        }
+
+        if (off_node)
+            printf("Domain %u: %"PRIu64" of %"PRIu64" MiB on node %d, "
+                   "%"PRIu64" MiB moved\n", d->domid,
+                   (on_node + moved) >> 8, (on_node + off_node) >> 8,
+                   d->home, moved >> 8);
+    }
+
+    rebalance_dom_prune();
+
+ out:
+    if (info)
+        libxl_dominfo_list_free(info, nb_domain);
+    if (numa)
+        libxl_numainfo_list_free(numa, nr_nodes);
+    if (topo)
+        libxl_cputopology_list_free(topo, nr_cpus);
+}
+
+int main_numa_rebalance(int argc, char **argv)
+{
+    int opt, interval = 10, threshold = 60, nr_domids = 0, i;
+    uint64_t rate_mb = 256;
+    bool dryrun = false, once = false;
+    uint32_t *domids = NULL;
+    static struct option opts[] = {
+        {"interval", 1, 0, 'i'},
+        {"rate", 1, 0, 'r'},
+        {"threshold", 1, 0, 't'},
+        {"dryrun", 0, 0, 'n'},
+        {"once", 0, 0, 'o'},
+        COMMON_LONG_OPTS
+    };
+
+    SWITCH_FOREACH_OPT(opt, "i:r:t:no", opts, "numa-rebalance", 0) {
+    case 'i':
+        interval = strtol(optarg, NULL, 10);
+        break;
+    case 'r':
+        rate_mb = strtoull(optarg, NULL, 10);
+        break;
+    case 't':
+        threshold = strtol(optarg, NULL, 10);
+        break;
+    case 'n':
+        dryrun = true;
+        break;
+    case 'o':
+        once = true;
+        break;
+    }
+
+    if (interval <= 0 || threshold <= 50 || threshold > 100) {
+        fprintf(stderr, "Invalid interval or threshold.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (optind < argc) {
+        nr_domids = argc - optind;
+        domids = xmalloc(nr_domids * sizeof(*domids));
+        for (i = 0; i < nr_domids; i++)
+            domids[i] = find_domain(argv[optind + i]);
+    }
+
+    /*
+     * The load is the runtime between two rounds, so a single round needs
+     * a sample to start from.
+     */
+    if (once) {
+        rebalance_round(threshold, 0, true, true, domids, nr_domids);
+        sleep(interval);
+    }
+
+    for (;;) {
+        rebalance_round(threshold, rate_mb << 8, dryrun, false,
+                        domids, nr_domids);
+        if (once)
+            break;
+        fflush(stdout);
+        sleep(interval);
+    }
+
+    free(domids);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -1357,6 +1357,8 @@ void parse_config_data(const char *config_source,
         b_info->sched_params.latency = l;
     if (!xlu_cfg_get_long (config, "extratime", &l, 0))
         b_info->sched_params.extratime = l;
+    if (!xlu_cfg_get_long (config, "latency_class", &l, 0))
+        b_info->sched_params.latency_class = l;
 
     if (!xlu_cfg_get_long (config, "memory", &l, 0))
         b_info->target_memkb = l * 1024;
@@ -1784,6 +1786,9 @@ void parse_config_data(const char *config_source,
             exit(-ERROR_FAIL);
         }
 
+        if (!xlu_cfg_get_long (config, "halt_poll_ns", &l, 0))
+            b_info->u.hvm.halt_poll_ns = l;
+
         /*
          * The firmware config option can be used as a simplification
          * instead of setting bios or firmware_override. It has the
@@ -210,7 +210,8 @@ static int sched_credit2_domain_output(int domid)
     libxl_domain_sched_params scinfo;
 
     if (domid < 0) {
-        printf("%-33s %4s %6s %4s\n", "Name", "ID", "Weight", "Cap");
+        printf("%-33s %4s %6s %4s %7s\n", "Name", "ID", "Weight", "Cap",
+               "Latency");
         return 0;
     }
 
@@ -220,11 +221,12 @@ static int sched_credit2_domain_output(int domid)
         return 1;
     }
     domname = libxl_domid_to_name(ctx, domid);
-    printf("%-33s %4d %6d %4d\n",
+    printf("%-33s %4d %6d %4d %7d\n",
         domname,
         domid,
         scinfo.weight,
-        scinfo.cap);
+        scinfo.cap,
+        scinfo.latency_class);
     free(domname);
     libxl_domain_sched_params_dispose(&scinfo);
     return 0;
@@ -602,23 +604,25 @@ int main_sched_credit2(int argc, char **argv)
     const char *dom = NULL;
     const char *cpupool = NULL;
     int ratelimit = 0;
-    int weight = 256, cap = 0;
+    int weight = 256, cap = 0, latency_class = 0;
     bool opt_s = false;
     bool opt_r = false;
     bool opt_w = false;
     bool opt_c = false;
+    bool opt_l = false;
     int opt, rc;
     static struct option opts[] = {
         {"domain", 1, 0, 'd'},
         {"weight", 1, 0, 'w'},
         {"cap", 1, 0, 'c'},
+        {"latency-class", 1, 0, 'l'},
         {"schedparam", 0, 0, 's'},
         {"ratelimit_us", 1, 0, 'r'},
         {"cpupool", 1, 0, 'p'},
         COMMON_LONG_OPTS
     };
 
-    SWITCH_FOREACH_OPT(opt, "d:w:c:p:r:s", opts, "sched-credit2", 0) {
+    SWITCH_FOREACH_OPT(opt, "d:w:c:l:p:r:s", opts, "sched-credit2", 0) {
     case 'd':
         dom = optarg;
         break;
@@ -630,6 +634,10 @@ int main_sched_credit2(int argc, char **argv)
         cap = strtol(optarg, NULL, 10);
         opt_c = true;
         break;
+    case 'l':
+        latency_class = strtol(optarg, NULL, 10);
+        opt_l = true;
+        break;
     case 's':
         opt_s = true;
         break;
@@ -642,12 +650,12 @@ int main_sched_credit2(int argc, char **argv)
         break;
     }
 
-    if (cpupool && (dom || opt_w || opt_c)) {
+    if (cpupool && (dom || opt_w || opt_c || opt_l)) {
         fprintf(stderr, "Specifying a cpupool is not allowed with other "
                 "options.\n");
         return EXIT_FAILURE;
     }
-    if (!dom && (opt_w || opt_c)) {
+    if (!dom && (opt_w || opt_c || opt_l)) {
         fprintf(stderr, "Must specify a domain.\n");
         return EXIT_FAILURE;
     }
@@ -682,7 +690,7 @@ int main_sched_credit2(int argc, char **argv)
     } else {
         uint32_t domid = find_domain(dom);
 
-        if (!opt_w && !opt_c) { /* output credit2 scheduler info */
+        if (!opt_w && !opt_c && !opt_l) { /* output credit2 scheduler info */
             sched_credit2_domain_output(-1);
             if (sched_credit2_domain_output(domid))
                 return EXIT_FAILURE;
@@ -694,6 +702,8 @@ int main_sched_credit2(int argc, char **argv)
                 scinfo.weight = weight;
             if (opt_c)
                 scinfo.cap = cap;
+            if (opt_l)
+                scinfo.latency_class = !!latency_class;
             rc = sched_domain_set(domid, &scinfo);
             libxl_domain_sched_params_dispose(&scinfo);
             if (rc)
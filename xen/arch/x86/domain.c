@@ -36,6 +36,8 @@
 #include <xen/wait.h>
 #include <xen/guest_access.h>
 #include <xen/livepatch.h>
+#include <xen/param.h>
+#include <xen/tasklet.h>
 #include <public/sysctl.h>
 #include <public/hvm/hvm_vcpu.h>
 #include <asm/altp2m.h>
@@ -2112,6 +2114,137 @@ static int relinquish_memory(
     return ret;
 }
 
+/*
+ * Freeing the memory of a large HVM guest page by page takes long enough
+ * for it to be worth sharing the work with idle pCPUs.  HVM guests' pages
+ * carry no page table types, so all there is to do is dropping the
+ * allocation reference, which can be done in any order and from any pCPU.
+ */
+static unsigned int __read_mostly opt_relmem_workers = 4;
+integer_param("relmem-workers", opt_relmem_workers);
+
+/* Below this size the serial relinquish_memory() is quick enough. */
+#define RELMEM_PARALLEL_MIN  (GB(1) >> PAGE_SHIFT)
+#define RELMEM_BATCH         64
+
+struct relmem_worker {
+    struct tasklet tasklet;
+    struct domain *domain;
+};
+
+/*
+ * Drop the allocation reference of up to RELMEM_BATCH pages from
+ * d->page_list.  Returns whether there are pages left on the list.
+ */
+static bool relmem_batch(struct domain *d)
+{
+    struct page_info *pages[RELMEM_BATCH], *page;
+    unsigned int i, nr = 0;
+    bool more;
+
+    spin_lock(&d->page_alloc_lock);
+
+    while ( nr < ARRAY_SIZE(pages) &&
+            (page = page_list_remove_head(&d->page_list)) )
+    {
+        /* Put the page on the list and /then/ potentially free it. */
+        page_list_add_tail(page, &d->arch.relmem_list);
+        if ( likely(get_page(page, d)) )
+            pages[nr++] = page;
+    }
+    more = !page_list_empty(&d->page_list);
+
+    spin_unlock(&d->page_alloc_lock);
+
+    for ( i = 0; i < nr; i++ )
+    {
+        put_page_alloc_ref(pages[i]);
+        put_page(pages[i]);
+    }
+
+    return more;
+}
+
+static void relmem_worker_fn(void *data)
+{
+    struct relmem_worker *w = data;
+    struct domain *d = w->domain;
+    s_time_t deadline = NOW() + MILLISECS(1);
+
+    while ( relmem_batch(d) )
+    {
+        /* Give the pCPU back every now and then, if there's other work. */
+        if ( softirq_pending(smp_processor_id()) || NOW() >= deadline )
+        {
+            tasklet_schedule(&w->tasklet);
+            return;
+        }
+    }
+
+    atomic_dec(&d->arch.relmem_busy);
+}
+
+static void relmem_start_workers(struct domain *d)
+{
+    struct arch_domain *ad = &d->arch;
+    unsigned int cpu;
+
+    ad->relmem_workers = xzalloc_array(struct relmem_worker,
+                                       opt_relmem_workers);
+    if ( !ad->relmem_workers )
+        return;
+
+    for_each_online_cpu ( cpu )
+    {
+        struct relmem_worker *w;
+
+        if ( ad->nr_relmem_workers >= opt_relmem_workers )
+            break;
+        if ( cpu == smp_processor_id() || !idle_vcpu[cpu]->is_running )
+            continue;
+
+        w = &ad->relmem_workers[ad->nr_relmem_workers++];
+        w->domain = d;
+        tasklet_init(&w->tasklet, relmem_worker_fn, w);
+        atomic_inc(&ad->relmem_busy);
+        tasklet_schedule_on_cpu(&w->tasklet, cpu);
+    }
+}
+
+/*
+ * Drop the allocation references of an HVM domain's pages, with the help
+ * of idle pCPUs for large domains.  Pages which can't be freed yet end up
+ * back on d->page_list, for relinquish_memory() to deal with.
+ */
+static int relinquish_memory_parallel(struct domain *d)
+{
+    struct arch_domain *ad = &d->arch;
+    unsigned int i;
+
+    if ( !ad->relmem_workers && opt_relmem_workers &&
+         domain_tot_pages(d) >= RELMEM_PARALLEL_MIN )
+        relmem_start_workers(d);
+
+    while ( relmem_batch(d) )
+        if ( hypercall_preempt_check() )
+            return -ERESTART;
+
+    /* Wait for the workers to finish their last batch. */
+    if ( atomic_read(&ad->relmem_busy) )
+        return -ERESTART;
+
+    for ( i = 0; i < ad->nr_relmem_workers; i++ )
+        tasklet_kill(&ad->relmem_workers[i].tasklet);
+    XFREE(ad->relmem_workers);
+    ad->nr_relmem_workers = 0;
+
+    spin_lock(&d->page_alloc_lock);
+    page_list_move(&d->page_list, &ad->relmem_list);
+    spin_unlock(&d->page_alloc_lock);
+
+    return 0;
+}
+
 int domain_relinquish_resources(struct domain *d)
 {
     int ret;
@@ -2144,6 +2277,7 @@ int domain_relinquish_resources(struct domain *d)
             PROG_vcpu_pagetables,
             PROG_shared,
             PROG_xen,
+            PROG_hvm_memory,
             PROG_l4,
             PROG_l3,
             PROG_l2,
@@ -2225,6 +2359,15 @@ int domain_relinquish_resources(struct domain *d)
         if ( ret )
             return ret;
 
+    PROGRESS(hvm_memory):
+
+        if ( is_hvm_domain(d) )
+        {
+            ret = relinquish_memory_parallel(d);
+            if ( ret )
+                return ret;
+        }
+
     PROGRESS(l4):
 
         ret = relinquish_memory(d, &d->page_list, PGT_l4_page_table);
@@ -2310,6 +2453,8 @@ void vcpu_mark_events_pending(struct vcpu *v)
 
     if ( is_hvm_vcpu(v) )
         hvm_assert_evtchn_irq(v);
+    else if ( vcpu_polling_events(v) )
+        perfc_incr(vcpu_kick_polling);
     else
         vcpu_kick(v);
 }
@@ -1170,6 +1170,7 @@ long arch_do_domctl(
 #ifdef CONFIG_MEM_SHARING
     case XEN_DOMCTL_mem_sharing_op:
         ret = mem_sharing_domctl(d, &domctl->u.mem_sharing_op);
+        copyback = !ret;
         break;
 #endif
 
@@ -1188,6 +1189,32 @@ long arch_do_domctl(
         break;
 #endif /* P2M_AUDIT */
 
+    case XEN_DOMCTL_numa_move:
+        if ( d == currd ) /* no domain_pause() */
+            ret = -EPERM;
+        else
+        {
+            ret = p2m_numa_move(d, &domctl->u.numa_move);
+            if ( ret == -ERESTART )
+                ret = hypercall_create_continuation(
+                          __HYPERVISOR_domctl, "h", u_domctl);
+            copyback = true;
+        }
+        break;
+
+    case XEN_DOMCTL_sample_accessed:
+        if ( d == currd ) /* no domain_pause() */
+            ret = -EPERM;
+        else
+        {
+            ret = p2m_sample_accessed(d, &domctl->u.sample_accessed);
+            if ( ret == -ERESTART )
+                ret = hypercall_create_continuation(
+                          __HYPERVISOR_domctl, "h", u_domctl);
+            copyback = true;
+        }
+        break;
+
     case XEN_DOMCTL_set_broken_page_p2m:
     {
         p2m_type_t pt;
@@ -117,6 +117,13 @@ static const char __initconst warning_hvm_fep[] =
 static bool_t __initdata opt_altp2m_enabled = 0;
 boolean_param("altp2m", opt_altp2m_enabled);
 
+/* Default HVM_PARAM_HALT_POLL_NS for new domains. */
+static unsigned int __read_mostly opt_hvm_halt_poll_ns;
+integer_param("hvm_halt_poll_ns", opt_hvm_halt_poll_ns);
+
+#define HALT_POLL_NS_MAX         MILLISECS(1)
+#define HALT_POLL_NS_GROW_START  MICROSECS(10)
+
 static int cpu_callback(
     struct notifier_block *nfb, unsigned long action, void *hcpu)
 {
@@ -532,10 +539,46 @@ static bool hvm_get_pending_event(struct vcpu *v, struct x86_event *info)
     return alternative_call(hvm_funcs.get_pending_event, v, info);
 }
 
+/*
+ * Adapt the poll window once a halt has been ended by a wakeup @block_ns
+ * after blocking: grow it if polling a little longer would have caught the
+ * wakeup, shrink it if the vCPU stayed blocked beyond what we may poll for.
+ */
+static void hvm_halt_poll_adjust(struct vcpu *v, s_time_t block_ns)
+{
+    unsigned int max = v->domain->arch.hvm.params[HVM_PARAM_HALT_POLL_NS];
+    unsigned int window = v->arch.hvm.halt_poll_ns;
+
+    if ( block_ns > max )
+    {
+        if ( !window )
+            return;
+
+        window /= 2;
+        if ( window < HALT_POLL_NS_GROW_START )
+            window = 0;
+        perfc_incr(hvm_halt_poll_shrink);
+    }
+    else if ( window < max )
+    {
+        window = window ? min(window * 2, max)
+                        : min_t(unsigned int, HALT_POLL_NS_GROW_START, max);
+        perfc_incr(hvm_halt_poll_grow);
+    }
+
+    v->arch.hvm.halt_poll_ns = window;
+}
+
 void hvm_do_resume(struct vcpu *v)
 {
     check_wakeup_from_wait();
 
+    if ( unlikely(v->arch.hvm.halt_blocked_at) )
+    {
+        hvm_halt_poll_adjust(v, NOW() - v->arch.hvm.halt_blocked_at);
+        v->arch.hvm.halt_blocked_at = 0;
+    }
+
     pt_restore_timer(v);
 
     if ( !handle_hvm_io_completion(v) )
@@ -672,6 +715,8 @@ int hvm_domain_initialise(struct domain *d)
     hvm_init_guest_time(d);
 
     d->arch.hvm.params[HVM_PARAM_TRIPLE_FAULT_REASON] = SHUTDOWN_reboot;
+    d->arch.hvm.params[HVM_PARAM_HALT_POLL_NS] =
+        min_t(uint64_t, opt_hvm_halt_poll_ns, HALT_POLL_NS_MAX);
 
     vpic_init(d);
 
@@ -1630,6 +1675,41 @@ void hvm_vcpu_down(struct vcpu *v)
     }
 }
 
+/*
+ * Busy-wait for up to the vCPU's current poll window for an interrupt to
+ * become deliverable, rather than paying for a block/wake cycle when one
+ * arrives shortly.  Any pending softirq other than a kick ends the poll
+ * early: timers, the scheduler, etc. must run just as if we had blocked.
+ */
+static bool hvm_halt_poll(struct vcpu *v)
+{
+    unsigned int cpu = smp_processor_id();
+    unsigned int window =
+        min_t(uint64_t, v->arch.hvm.halt_poll_ns,
+              v->domain->arch.hvm.params[HVM_PARAM_HALT_POLL_NS]);
+    s_time_t deadline = NOW() + window;
+
+    if ( !window )
+        return false;
+
+    do {
+        if ( hvm_local_events_need_delivery(v) )
+        {
+            perfc_incr(hvm_halt_poll_ok);
+            return true;
+        }
+
+        if ( softirq_pending(cpu) & ~(1UL << VCPU_KICK_SOFTIRQ) )
+            break;
+
+        cpu_relax();
+    } while ( NOW() < deadline );
+
+    perfc_incr(hvm_halt_poll_fail);
+
+    return false;
+}
+
 void hvm_hlt(unsigned int eflags)
 {
     struct vcpu *curr = current;
@@ -1645,8 +1725,26 @@ void hvm_hlt(unsigned int eflags)
     if ( unlikely(!(eflags & X86_EFLAGS_IF)) )
         return hvm_vcpu_down(curr);
 
+    if ( hvm_halt_poll(curr) )
+    {
+        HVMTRACE_1D(HLT, /* pending = */ 1);
+        return;
+    }
+
     do_sched_op(SCHEDOP_block, guest_handle_from_ptr(NULL, void));
 
+    /*
+     * Unless vcpu_block() found an event pending already, note when we went
+     * to sleep, for hvm_do_resume() to see how long the halt lasted.
+     */
+    if ( curr->domain->arch.hvm.params[HVM_PARAM_HALT_POLL_NS] )
+    {
+        if ( vcpu_runnable(curr) )
+            hvm_halt_poll_adjust(curr, 0);
+        else
+            curr->arch.hvm.halt_blocked_at = NOW();
+    }
+
     HVMTRACE_1D(HLT, /* pending = */ vcpu_runnable(curr));
 }
 
@@ -1787,6 +1885,7 @@ int hvm_hap_nested_page_fault(paddr_t gpa, unsigned long gla,
     if ( altp2m_active(currd) )
     {
         p2m = p2m_get_altp2m(curr);
+        p2m->altp2m_stats.faults++;
 
         /*
          * Get the altp2m entry if present; or if not, propagate from
@@ -1861,6 +1960,9 @@ int hvm_hap_nested_page_fault(paddr_t gpa, unsigned long gla,
 
         if ( violation )
         {
+            if ( p2m_is_altp2m(p2m) )
+                p2m->altp2m_stats.violations++;
+
             /* Should #VE be emulated for this fault? */
             if ( p2m_is_altp2m(p2m) && !cpu_has_vmx_virt_exceptions )
             {
@@ -4290,6 +4392,11 @@ static int hvm_set_param(struct domain *d, uint32_t index, uint64_t value)
     case HVM_PARAM_MCA_CAP:
         rc = vmce_enable_mca_cap(d, value);
         break;
+
+    case HVM_PARAM_HALT_POLL_NS:
+        if ( value > HALT_POLL_NS_MAX )
+            rc = -EINVAL;
+        break;
     }
 
     if ( !rc )
@@ -4511,6 +4618,8 @@ static int do_altp2m_op(
     case HVMOP_altp2m_get_mem_access:
     case HVMOP_altp2m_change_gfn:
     case HVMOP_altp2m_get_p2m_idx:
+    case HVMOP_altp2m_clone_p2m:
+    case HVMOP_altp2m_get_view_stats:
         break;
 
     default:
@@ -4788,6 +4897,26 @@ static int do_altp2m_op(
         break;
     }
 
+    case HVMOP_altp2m_clone_p2m:
+        if ( a.u.clone_p2m.pad )
+            rc = -EINVAL;
+        else
+        {
+            rc = p2m_clone_altp2m(d, a.u.clone_p2m.src_view,
+                                  &a.u.clone_p2m.view,
+                                  &a.u.clone_p2m.opaque);
+            if ( (!rc || rc == -ERESTART) && __copy_to_guest(arg, &a, 1) )
+                rc = -EFAULT;
+        }
+        break;
+
+    case HVMOP_altp2m_get_view_stats:
+        if ( a.u.view_stats.pad1 || a.u.view_stats.pad2 )
+            rc = -EINVAL;
+        else if ( !(rc = p2m_get_altp2m_stats(d, &a.u.view_stats)) )
+            rc = __copy_to_guest(arg, &a, 1) ? -EFAULT : 0;
+        break;
+
     default:
         ASSERT_UNREACHABLE();
     }
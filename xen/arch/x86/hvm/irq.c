@@ -323,7 +323,13 @@ void hvm_assert_evtchn_irq(struct vcpu *v)
         vlapic_set_irq(vcpu_vlapic(v), vector, 0);
     }
     else if ( is_hvm_pv_evtchn_vcpu(v) )
-        vcpu_kick(v);
+    {
+        /* Delivery only depends on evtchn_upcall_pending, as for PV. */
+        if ( vcpu_polling_events(v) )
+            perfc_incr(vcpu_kick_polling);
+        else
+            vcpu_kick(v);
+    }
     else if ( v->vcpu_id == 0 )
         hvm_set_callback_irq_level(v);
 }
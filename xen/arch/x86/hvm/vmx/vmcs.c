@@ -1628,7 +1628,7 @@ void vmx_vcpu_disable_pml(struct vcpu *v)
 void vmx_vcpu_flush_pml_buffer(struct vcpu *v)
 {
     uint64_t *pml_buf;
-    unsigned long pml_idx;
+    unsigned long pml_idx, start;
 
     ASSERT((v == current) || (!vcpu_runnable(v) && !v->is_running));
     ASSERT(vmx_vcpu_pml_enabled(v));
@@ -1653,23 +1653,23 @@ void vmx_vcpu_flush_pml_buffer(struct vcpu *v)
     else
         pml_idx++;
 
-    for ( ; pml_idx < NR_PML_ENTRIES; pml_idx++ )
-    {
-        unsigned long gfn = pml_buf[pml_idx] >> PAGE_SHIFT;
+    /* Turn the logged GPAs into GFNs in place, to process them in bulk. */
+    for ( start = pml_idx; pml_idx < NR_PML_ENTRIES; pml_idx++ )
+        pml_buf[pml_idx] >>= PAGE_SHIFT;
 
-        /*
-         * Need to change type from log-dirty to normal memory for logged GFN.
-         * hap_track_dirty_vram depends on it to work. And we mark all logged
-         * GFNs to be dirty, as we cannot be sure whether it's safe to ignore
-         * GFNs on which p2m_change_type_one returns failure. The failure cases
-         * are very rare, and additional cost is negligible, but a missing mark
-         * is extremely difficult to debug.
-         */
-        p2m_change_type_one(v->domain, gfn, p2m_ram_logdirty, p2m_ram_rw);
+    /*
+     * Need to change type from log-dirty to normal memory for logged GFN.
+     * hap_track_dirty_vram depends on it to work. And we mark all logged
+     * GFNs to be dirty, as we cannot be sure whether it's safe to ignore
+     * GFNs on which p2m_change_type_one returns failure. The failure cases
+     * are very rare, and additional cost is negligible, but a missing mark
+     * is extremely difficult to debug.
+     */
+    p2m_change_type_list(v->domain, pml_buf + start, NR_PML_ENTRIES - start,
+                         p2m_ram_logdirty, p2m_ram_rw);
 
-        /* HVM guest: pfn == gfn */
-        paging_mark_pfn_dirty(v->domain, _pfn(gfn));
-    }
+    /* HVM guest: pfn == gfn */
+    paging_mark_pfns_dirty(v->domain, pml_buf + start, NR_PML_ENTRIES - start);
 
     unmap_domain_page(pml_buf);
 
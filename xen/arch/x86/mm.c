@@ -4654,6 +4654,10 @@ int arch_acquire_resource(struct domain *d, unsigned int type,
     }
 #endif
 
+    case XENMEM_resource_logdirty_bitmap:
+        rc = paging_log_dirty_get_frames(d, id, frame, nr_frames, mfn_list);
+        break;
+
     default:
         rc = -EOPNOTSUPP;
         break;
@@ -262,41 +262,88 @@ bool p2m_mem_access_check(paddr_t gpa, unsigned long gla,
     return (p2ma != p2m_access_n2rwx);
 }
 
-int p2m_set_altp2m_mem_access(struct domain *d, struct p2m_domain *hp2m,
-                              struct p2m_domain *ap2m, p2m_access_t a,
-                              gfn_t gfn)
+/*
+ * Set the access of gfn, and of up to nr - 1 frames following it, in an
+ * altp2m view.  Superpages of the view, or of the host p2m when the view
+ * has no entry yet, are kept whole when they already have the requested
+ * access or are entirely covered by the range, and only split otherwise.
+ * Returns the number of frames handled, or < 0 on error.
+ */
+static long p2m_set_altp2m_mem_access(struct domain *d, struct p2m_domain *hp2m,
+                                      struct p2m_domain *ap2m, p2m_access_t a,
+                                      gfn_t gfn, unsigned long nr)
 {
     mfn_t mfn;
     p2m_type_t t;
     p2m_access_t old_a;
+    unsigned int page_order;
+    unsigned long mask;
+    bool present;
     int rc;
 
-    rc = altp2m_get_effective_entry(ap2m, gfn, &mfn, &t, &old_a,
-                                    AP2MGET_prepopulate);
-    if ( rc )
-        return rc;
+    mfn = ap2m->get_entry(ap2m, gfn, &t, &old_a, 0, &page_order, NULL);
+    present = mfn_valid(mfn);
+    if ( !present )
+    {
+        mfn = __get_gfn_type_access(hp2m, gfn_x(gfn), &t, &old_a,
+                                    P2M_ALLOC | P2M_UNSHARE, &page_order, 0);
+        if ( !mfn_valid(mfn) || t != p2m_ram_rw )
+            return -ESRCH;
+    }
+
+    mask = (1UL << page_order) - 1;
+
+    /* Nothing to change up to the end of the view's entry */
+    if ( present && old_a == a )
+        return min(mask + 1 - (gfn_x(gfn) & mask), nr);
+
+    /* The range covers the whole entry: copy or update it in one go */
+    if ( !(gfn_x(gfn) & mask) && nr > mask )
+    {
+        rc = ap2m->set_entry(ap2m, gfn, mfn, page_order, t, a,
+                             present ? -1 : 1);
+        return rc ?: (long)(mask + 1);
+    }
+
+    if ( page_order != PAGE_ORDER_4K )
+    {
+        /* Copy the host superpage first, so only this frame is split off */
+        if ( !present )
+        {
+            rc = ap2m->set_entry(ap2m, _gfn(gfn_x(gfn) & ~mask),
+                                 _mfn(mfn_x(mfn) & ~mask), page_order,
+                                 t, old_a, 1);
+            if ( rc )
+                return rc;
+        }
+
+        ap2m->altp2m_stats.splits++;
+    }
 
     /*
      * Inherit the old suppress #VE bit value if it is already set, or set it
      * to 1 otherwise
      */
-    return ap2m->set_entry(ap2m, gfn, mfn, PAGE_ORDER_4K, t, a, -1);
+    rc = ap2m->set_entry(ap2m, gfn, mfn, PAGE_ORDER_4K, t, a, -1);
+
+    return rc ?: 1;
 }
 #endif
 
-static int set_mem_access(struct domain *d, struct p2m_domain *p2m,
-                          struct p2m_domain *ap2m, p2m_access_t a,
-                          gfn_t gfn)
+/* Returns the number of frames handled, or < 0 on error. */
+static long set_mem_access(struct domain *d, struct p2m_domain *p2m,
+                           struct p2m_domain *ap2m, p2m_access_t a,
+                           gfn_t gfn, unsigned long nr)
 {
-    int rc = 0;
+    long rc = 1;
 
 #ifdef CONFIG_HVM
     if ( ap2m )
     {
-        rc = p2m_set_altp2m_mem_access(d, p2m, ap2m, a, gfn);
+        rc = p2m_set_altp2m_mem_access(d, p2m, ap2m, a, gfn, nr);
         /* If the corresponding mfn is invalid we will want to just skip it */
         if ( rc == -ESRCH )
-            rc = 0;
+            rc = 1;
     }
     else
 #else
@@ -307,7 +354,10 @@ static int set_mem_access(struct domain *d, struct p2m_domain *p2m,
         p2m_type_t t;
         mfn_t mfn = __get_gfn_type_access(p2m, gfn_x(gfn), &t, &_a,
                                           P2M_ALLOC, NULL, false);
-        rc = p2m->set_entry(p2m, gfn, mfn, PAGE_ORDER_4K, t, a, -1);
+        int ret = p2m->set_entry(p2m, gfn, mfn, PAGE_ORDER_4K, t, a, -1);
+
+        if ( ret )
+            rc = ret;
     }
 
     return rc;
@@ -390,17 +440,28 @@ long p2m_set_mem_access(struct domain *d, gfn_t gfn, uint32_t nr,
     if ( ap2m )
         p2m_lock(ap2m);
 
-    for ( gfn_l = gfn_x(gfn) + start; nr > start; ++gfn_l )
+    for ( gfn_l = gfn_x(gfn) + start; nr > start; )
     {
-        rc = set_mem_access(d, p2m, ap2m, a, _gfn(gfn_l));
+        uint32_t prev = start;
+
+        rc = set_mem_access(d, p2m, ap2m, a, _gfn(gfn_l), nr - start);
 
-        if ( rc )
+        if ( rc < 0 )
             break;
 
-        /* Check for continuation if it's not the last iteration. */
-        if ( nr > ++start && !(start & mask) && hypercall_preempt_check() )
+        gfn_l += rc;
+        start += rc;
+        rc = 0;
+
+        /*
+         * Check for continuation if it's not the last iteration.  Superpages
+         * may take us past the boundary the continuation has to be on:
+         * restart from that boundary, redoing a few frames is harmless.
+         */
+        if ( nr > start && (prev | mask) < start &&
+             hypercall_preempt_check() )
         {
-            rc = start;
+            rc = start & ~mask;
             break;
         }
     }
@@ -459,10 +520,11 @@ long p2m_set_mem_access_multi(struct domain *d,
             break;
         }
 
-        rc = set_mem_access(d, p2m, ap2m, a, _gfn(gfn_l));
+        rc = set_mem_access(d, p2m, ap2m, a, _gfn(gfn_l), 1);
 
-        if ( rc )
+        if ( rc < 0 )
             break;
+        rc = 0;
 
         /* Check for continuation if it's not the last iteration. */
         if ( nr > ++start && !(start & mask) && hypercall_preempt_check() )
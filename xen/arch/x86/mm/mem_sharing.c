@@ -1327,6 +1327,14 @@ int relinquish_shared_pages(struct domain *d)
     if ( p2m == NULL )
         return 0;
 
+    if ( msd->zero.timer_initialised )
+    {
+        msd->zero.rate = 0;
+        kill_timer(&msd->zero.timer);
+        tasklet_kill(&msd->zero.tasklet);
+        msd->zero.timer_initialised = false;
+    }
+
     p2m_lock(p2m);
     for ( gfn = msd->next_shared_gfn_to_relinquish;
           gfn <= p2m->max_mapped_pfn; gfn++ )
@@ -1425,6 +1433,201 @@ static int range_share(struct domain *d, struct domain *cd,
     return rc;
 }
 
+/*
+ * Background deduplication of zero filled pages.  A timer looks at rate
+ * pages per second of the domain's p2m, and shares the zero filled ones with
+ * a single frame of the domain, copy-on-write.  Pages mapped as part of a
+ * superpage are only considered 2MiB at a time, and only if all of it is
+ * zero, so as to not shatter mappings of memory which is in use.
+ *
+ * Nominating, sharing and unsharing take the p2m and sharing locks and may
+ * allocate memory, which is not for softirq context: the timer only
+ * schedules a tasklet, which scans in idle vCPU context and re-arms it.
+ */
+#define ZERO_SCAN_PERIOD        MILLISECS(10)
+/* Bound the length of the shared frame's rmap hash chains. */
+#define ZERO_SCAN_MAX_SHARED    (RMAP_HASHTAB_SIZE * 64)
+
+static bool mfn_is_zero(mfn_t mfn)
+{
+    const unsigned long *p = map_domain_page(mfn);
+    unsigned int i;
+
+    for ( i = 0; i < PAGE_SIZE / sizeof(*p); i++ )
+        if ( p[i] )
+            break;
+
+    unmap_domain_page(p);
+
+    return i == PAGE_SIZE / sizeof(*p);
+}
+
+static void zero_share_gfn(struct domain *d, gfn_t gfn)
+{
+    struct mem_sharing_domain *msd = &d->arch.hvm.mem_sharing;
+    p2m_type_t t;
+    mfn_t mfn;
+    shr_handle_t h;
+    int rc;
+
+    if ( nominate_page(d, gfn, 0, &h) )
+        return;
+
+    /* The page is read-only now, check it wasn't written to meanwhile. */
+    mfn = get_gfn_query_unlocked(d, gfn_x(gfn), &t);
+    if ( !p2m_is_shared(t) || !mfn_is_zero(mfn) )
+    {
+        mem_sharing_unshare_page(d, gfn_x(gfn));
+        return;
+    }
+
+    if ( !gfn_eq(msd->zero.gfn, INVALID_GFN) &&
+         msd->zero.nr_shared < ZERO_SCAN_MAX_SHARED )
+    {
+        rc = share_pages(d, msd->zero.gfn, msd->zero.handle, d, gfn, h);
+        if ( !rc )
+        {
+            msd->zero.nr_shared++;
+            msd->zero.shared++;
+            return;
+        }
+
+        /* Anything but the zero frame having been written to is transient. */
+        if ( rc != XENMEM_SHARING_OP_S_HANDLE_INVALID )
+            return;
+    }
+
+    /* This page is the one the next zero pages get shared with. */
+    msd->zero.gfn = gfn;
+    msd->zero.handle = h;
+    msd->zero.nr_shared = 0;
+}
+
+static void zero_scan(struct domain *d, unsigned int budget)
+{
+    struct mem_sharing_domain *msd = &d->arch.hvm.mem_sharing;
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    unsigned long gfn = msd->zero.next_gfn;
+    bool wrapped = false;
+
+    while ( budget && !d->is_dying )
+    {
+        unsigned long i, nr;
+        unsigned int order;
+        p2m_access_t a;
+        p2m_type_t t;
+        mfn_t mfn;
+
+        if ( gfn > p2m->max_mapped_pfn )
+        {
+            if ( wrapped )
+                break;
+            wrapped = true;
+            msd->zero.passes++;
+            gfn = 0;
+        }
+
+        mfn = __get_gfn_type_access(p2m, gfn, &t, &a, 0, &order, false);
+        if ( order >= PAGE_ORDER_2M )
+            nr = PFN_DOWN(MB(2)) - (gfn & (PFN_DOWN(MB(2)) - 1));
+        else
+            nr = 1;
+
+        if ( mfn_valid(mfn) && p2m_is_sharable(t) )
+        {
+            msd->zero.scanned += nr;
+
+            for ( i = 0; i < nr; i++ )
+                if ( !mfn_is_zero(mfn_add(mfn, i)) )
+                    break;
+
+            if ( i == nr )
+            {
+                msd->zero.found += nr;
+                for ( i = 0; i < nr; i++ )
+                    zero_share_gfn(d, _gfn(gfn + i));
+            }
+        }
+
+        gfn += nr;
+        budget -= min_t(unsigned long, budget, nr);
+    }
+
+    msd->zero.next_gfn = gfn;
+}
+
+static void zero_scan_tasklet(void *data)
+{
+    struct domain *d = data;
+    struct mem_sharing_domain *msd = &d->arch.hvm.mem_sharing;
+    unsigned int rate = ACCESS_ONCE(msd->zero.rate);
+
+    if ( !rate )
+        return;
+
+    zero_scan(d, max_t(unsigned int, rate / (SECONDS(1) / ZERO_SCAN_PERIOD),
+                       1));
+
+    /* A killed timer ignores this, see relinquish_shared_pages(). */
+    if ( ACCESS_ONCE(msd->zero.rate) )
+        set_timer(&msd->zero.timer, NOW() + ZERO_SCAN_PERIOD);
+}
+
+static void zero_scan_timer_fn(void *data)
+{
+    struct domain *d = data;
+
+    if ( ACCESS_ONCE(d->arch.hvm.mem_sharing.zero.rate) )
+        tasklet_schedule(&d->arch.hvm.mem_sharing.zero.tasklet);
+}
+
+static int zero_scan_control(struct domain *d,
+                             struct xen_domctl_mem_sharing_zero_scan *zs)
+{
+    struct mem_sharing_domain *msd = &d->arch.hvm.mem_sharing;
+
+    if ( zs->rate != XEN_DOMCTL_MEM_SHARING_ZERO_RATE_KEEP )
+    {
+        if ( zs->rate > XEN_DOMCTL_MEM_SHARING_ZERO_RATE_MAX )
+            return -EINVAL;
+        if ( zs->rate && (!mem_sharing_enabled(d) || d->is_dying) )
+            return -EINVAL;
+
+        if ( !msd->zero.timer_initialised )
+        {
+            init_timer(&msd->zero.timer, zero_scan_timer_fn, d,
+                       smp_processor_id());
+            tasklet_init(&msd->zero.tasklet, zero_scan_tasklet, d);
+            msd->zero.timer_initialised = true;
+            msd->zero.gfn = INVALID_GFN;
+        }
+
+        if ( zs->rate && !msd->zero.rate )
+            set_timer(&msd->zero.timer, NOW() + ZERO_SCAN_PERIOD);
+        else if ( !zs->rate )
+            stop_timer(&msd->zero.timer);
+
+        msd->zero.rate = zs->rate;
+    }
+
+    zs->rate = msd->zero.rate;
+    zs->scanned = msd->zero.scanned;
+    zs->zero = msd->zero.found;
+    zs->shared = msd->zero.shared;
+    zs->passes = msd->zero.passes;
+
+    return 0;
+}
+
+static void zero_scan_stop(struct domain *d)
+{
+    struct mem_sharing_domain *msd = &d->arch.hvm.mem_sharing;
+
+    msd->zero.rate = 0;
+    if ( msd->zero.timer_initialised )
+        stop_timer(&msd->zero.timer);
+}
+
 static inline int mem_sharing_control(struct domain *d, bool enable)
 {
     if ( enable )
@@ -1438,6 +1641,8 @@ static inline int mem_sharing_control(struct domain *d, bool enable)
         if ( unlikely(is_iommu_enabled(d)) )
             return -EXDEV;
     }
+    else
+        zero_scan_stop(d);
 
     d->arch.hvm.mem_sharing.enabled = enable;
     return 0;
@@ -1720,6 +1925,10 @@ int mem_sharing_domctl(struct domain *d, struct xen_domctl_mem_sharing_op *mec)
         rc = mem_sharing_control(d, mec->u.enable);
         break;
 
+    case XEN_DOMCTL_MEM_SHARING_ZERO_SCAN:
+        rc = zero_scan_control(d, &mec->u.zero_scan);
+        break;
+
     default:
         rc = -ENOSYS;
         break;
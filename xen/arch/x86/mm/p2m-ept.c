@@ -638,6 +638,35 @@ bool_t ept_handle_misconfig(uint64_t gpa)
     return spurious ? (rc >= 0) : (rc > 0);
 }
 
+/*
+ * Whether replacing the present leaf entry 'old' by 'new' only grants
+ * further accesses to the same frame, in which case the old translation
+ * may stay cached: using it can at worst cause an EPT violation, which
+ * invalidates the cached translations for the faulting address (see SDM
+ * vol 3 28.3.3.1) and gets handled as spurious.  Nested p2m-s derived from
+ * this one still need flushing though, and so does clearing the D bit of
+ * log-dirty entries PML relies on.  The violation must also reach Xen:
+ * with #VE not suppressed it would be delivered to the guest instead.
+ */
+static bool ept_entry_widened(const struct p2m_domain *p2m,
+                              const ept_entry_t *old, const ept_entry_t *new,
+                              unsigned int level)
+{
+    if ( !is_epte_present(old) || (level && !is_epte_superpage(old)) ||
+         nestedhvm_enabled(p2m->domain) )
+        return false;
+
+    if ( (old->r && !new->r) || (old->w && !new->w) || (old->x && !new->x) )
+        return false;
+
+    if ( p2m->ept.ad && new->sa_p2mt == p2m_ram_logdirty )
+        return false;
+
+    return old->mfn == new->mfn && old->sp == new->sp &&
+           old->emt == new->emt && old->ipat == new->ipat &&
+           old->suppress_ve && new->suppress_ve;
+}
+
 /*
  * ept_set_entry() computes 'need_modify_vtd_table' for itself,
  * by observing whether any gfn->mfn translations are modified.
@@ -815,6 +844,13 @@ ept_set_entry(struct p2m_domain *p2m, gfn_t gfn_, mfn_t mfn,
     }
 
 out:
+    if ( needs_sync && entry_written &&
+         ept_entry_widened(p2m, &old_entry, &new_entry, target) )
+    {
+        perfc_incr(ept_sync_widening);
+        needs_sync = 0;
+    }
+
     if ( needs_sync )
         ept_sync_domain(p2m);
 
@@ -1116,6 +1152,10 @@ static void ept_sync_domain_prepare(struct p2m_domain *p2m)
 
 static void ept_sync_domain_mask(struct p2m_domain *p2m, const cpumask_t *mask)
 {
+    perfc_incr(ept_flush);
+    perfc_add(ept_flush_ipis, cpumask_weight(mask) -
+                              cpumask_test_cpu(smp_processor_id(), mask));
+
     on_selected_cpus(mask, __ept_sync_domain, p2m, 1);
 }
 
@@ -1127,10 +1167,13 @@ void ept_sync_domain(struct p2m_domain *p2m)
     if ( !paging_mode_hap(d) || !d->vcpu || !d->vcpu[0] )
         return;
 
+    perfc_incr(ept_sync);
+
     ept_sync_domain_prepare(p2m);
 
     if ( p2m->defer_flush )
     {
+        perfc_incr(ept_sync_deferred);
         p2m->need_flush = 1;
         return;
     }
@@ -1196,8 +1239,8 @@ static void ept_disable_pml(struct p2m_domain *p2m)
 
     vmx_domain_disable_pml(p2m->domain);
 
-    /* Disable EPT A/D bit */
-    ept_set_ad_sync(p2m->domain, false);
+    /* Disable EPT A/D bit, unless still needed for accessed bit sampling */
+    ept_set_ad_sync(p2m->domain, p2m->accessed_tracking);
     vmx_domain_update_eptp(p2m->domain);
 }
 
@@ -1227,6 +1270,120 @@ static void ept_flush_pml_buffers(struct p2m_domain *p2m)
     vmx_domain_flush_pml_buffers(p2m->domain);
 }
 
+static void ept_set_accessed_tracking(struct p2m_domain *p2m, bool enable)
+{
+    struct domain *d = p2m->domain;
+
+    ASSERT(p2m_is_hostp2m(p2m));
+
+    domain_pause(d);
+    p2m_lock(p2m);
+
+    p2m->accessed_tracking = enable;
+
+    /* PML keeps the A/D bits enabled for itself. */
+    if ( !vmx_domain_pml_enabled(d) )
+    {
+        ept_set_ad_sync(d, enable);
+        vmx_domain_update_eptp(d);
+    }
+
+    p2m_unlock(p2m);
+    domain_unpause(d);
+}
+
+/*
+ * Set bit n of @bitmap for each of the @nr frames from @gfn whose leaf
+ * entry has its accessed bit set, clearing it if @clear.  Superpage
+ * entries report all the frames they cover.  Returns the number of RAM
+ * frames seen.  Cleared bits only get set again once the translations
+ * are flushed from the TLBs: all CPUs are marked for an INVEPT before
+ * their next VM entry here, and the caller flushes those currently
+ * running the domain once done with the whole range.
+ */
+static unsigned int ept_sample_accessed(struct p2m_domain *p2m,
+                                        unsigned long gfn, unsigned int nr,
+                                        unsigned long *bitmap, bool clear)
+{
+    const struct ept_data *ept = &p2m->ept;
+    unsigned int done = 0, nr_ram = 0;
+    bool cleared = false;
+
+    ASSERT(p2m_locked_by_me(p2m));
+
+    while ( done < nr && gfn + done <= p2m->max_mapped_pfn )
+    {
+        ept_entry_t *table =
+            map_domain_page(pagetable_get_mfn(p2m_get_pagetable(p2m)));
+        unsigned long gfn_remainder = gfn + done;
+        unsigned int i, index, count;
+        ept_entry_t *e;
+        int ret = GUEST_TABLE_NORMAL_PAGE;
+
+        for ( i = ept->wl; i > 0; i-- )
+        {
+            ret = ept_next_level(p2m, 1, &table, &gfn_remainder, i);
+            if ( ret != GUEST_TABLE_NORMAL_PAGE )
+                break;
+        }
+
+        index = gfn_remainder >> (i * EPT_TABLE_ORDER);
+        e = table + index;
+
+        if ( !i )
+        {
+            /* Go through the rest of this L1 table. */
+            for ( ; index < EPT_PAGETABLE_ENTRIES && done < nr;
+                  index++, e++, done++ )
+            {
+                if ( !is_epte_present(e) || !p2m_is_ram(e->sa_p2mt) )
+                    continue;
+
+                nr_ram++;
+                if ( !e->a )
+                    continue;
+
+                __set_bit(done, bitmap);
+                /* The hardware may set the dirty bit meanwhile. */
+                if ( clear )
+                {
+                    clear_bit(EPTE_A_SHIFT, &e->epte);
+                    cleared = true;
+                }
+            }
+        }
+        else
+        {
+            /* The rest of the range covered by this (absent) entry. */
+            count = (1U << (i * EPT_TABLE_ORDER)) -
+                    (gfn_remainder & ((1U << (i * EPT_TABLE_ORDER)) - 1));
+            count = min(count, nr - done);
+
+            if ( ret == GUEST_TABLE_SUPER_PAGE && p2m_is_ram(e->sa_p2mt) )
+            {
+                nr_ram += count;
+                if ( e->a )
+                {
+                    bitmap_set(bitmap, done, count);
+                    if ( clear )
+                    {
+                        clear_bit(EPTE_A_SHIFT, &e->epte);
+                        cleared = true;
+                    }
+                }
+            }
+            done += count;
+        }
+
+        unmap_domain_page(table);
+    }
+
+    if ( cleared )
+        ept_sync_domain_prepare(p2m);
+
+    return nr_ram;
+}
+
 int ept_p2m_init(struct p2m_domain *p2m)
 {
     struct ept_data *ept = &p2m->ept;
@@ -1253,6 +1410,12 @@ int ept_p2m_init(struct p2m_domain *p2m)
         p2m->flush_hardware_cached_dirty = ept_flush_pml_buffers;
     }
 
+    if ( cpu_has_vmx_ept_ad )
+    {
+        p2m->set_accessed_tracking = ept_set_accessed_tracking;
+        p2m->sample_accessed = ept_sample_accessed;
+    }
+
     if ( !zalloc_cpumask_var(&ept->invalidate) )
         return -ENOMEM;
 
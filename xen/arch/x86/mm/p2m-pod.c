@@ -22,6 +22,7 @@
 #include <xen/event.h>
 #include <xen/mm.h>
 #include <xen/sched.h>
+#include <xen/softirq.h>
 #include <xen/trace.h>
 #include <asm/page.h>
 #include <asm/paging.h>
@@ -378,6 +379,7 @@ int p2m_pod_empty_cache(struct domain *d)
 
     /* After this barrier no new PoD activities can happen. */
     BUG_ON(!d->is_dying);
+    tasklet_kill(&p2m->pod.reclaim_tasklet);
     spin_barrier(&p2m->pod.lock.lock);
 
     lock_page_alloc(p2m);
@@ -671,8 +673,25 @@ void p2m_pod_dump_data(struct domain *d)
 {
     struct p2m_domain *p2m = p2m_get_hostp2m(d);
 
-    printk("    PoD entries=%ld cachesize=%ld\n",
-           p2m->pod.entry_count, p2m->pod.count);
+    printk("    PoD entries=%ld cachesize=%ld reclaimed in background=%lu\n",
+           p2m->pod.entry_count, p2m->pod.count, p2m->pod.reclaimed_bg);
+}
+
+/*
+ * Check nr words, a multiple of 8, for being zero.  Xen doesn't use vector
+ * registers, so OR a cache line worth of words together at a time instead,
+ * branching once per line rather than once per word.
+ */
+static bool words_are_zero(const unsigned long *p, unsigned int nr)
+{
+    unsigned int i;
+
+    for ( i = 0; i < nr; i += 8 )
+        if ( p[i] | p[i + 1] | p[i + 2] | p[i + 3] |
+             p[i + 4] | p[i + 5] | p[i + 6] | p[i + 7] )
+            return false;
+
+    return true;
 }
 
 
@@ -689,7 +708,7 @@ p2m_pod_zero_check_superpage(struct p2m_domain *p2m, gfn_t gfn)
     unsigned long * map = NULL;
     int ret=0, reset = 0;
     unsigned long i, n;
-    unsigned int j;
+    bool zero;
     int max_ref = 1;
     struct domain *d = p2m->domain;
 
@@ -761,14 +780,10 @@ p2m_pod_zero_check_superpage(struct p2m_domain *p2m, gfn_t gfn)
     {
         /* Quick zero-check */
         map = map_domain_page(mfn_add(mfn0, i));
-
-        for ( j = 0; j < 16; j++ )
-            if ( *(map + j) != 0 )
-                break;
-
+        zero = words_are_zero(map, 16);
         unmap_domain_page(map);
 
-        if ( j < 16 )
+        if ( !zero )
             goto out;
 
     }
@@ -799,14 +814,7 @@ p2m_pod_zero_check_superpage(struct p2m_domain *p2m, gfn_t gfn)
     for ( i = 0; i < SUPERPAGE_PAGES; i++ )
     {
         map = map_domain_page(mfn_add(mfn0, i));
-
-        for ( j = 0; j < (PAGE_SIZE / sizeof(*map)); j++ )
-            if ( *(map+j) != 0 )
-            {
-                reset = 1;
-                break;
-            }
-
+        reset = !words_are_zero(map, PAGE_SIZE / sizeof(*map));
         unmap_domain_page(map);
 
         if ( reset )
@@ -865,7 +873,8 @@ p2m_pod_zero_check(struct p2m_domain *p2m, const gfn_t *gfns, unsigned int count
     p2m_type_t types[POD_SWEEP_STRIDE];
     unsigned long *map[POD_SWEEP_STRIDE];
     struct domain *d = p2m->domain;
-    unsigned int i, j, max_ref = 1;
+    unsigned int i, max_ref = 1;
+    bool zero;
 
     BUG_ON(count > POD_SWEEP_STRIDE);
 
@@ -906,9 +915,8 @@ p2m_pod_zero_check(struct p2m_domain *p2m, const gfn_t *gfns, unsigned int count
             continue;
 
         /* Quick zero-check */
-        for ( j = 0; j < 16; j++ )
-            if ( *(map[i] + j) != 0 )
-                goto skip;
+        if ( !words_are_zero(map[i], 16) )
+            goto skip;
 
         /* Try to remove the page, restoring old mapping if it fails. */
         if ( p2m_set_entry(p2m, gfns[i], INVALID_MFN, PAGE_ORDER_4K,
@@ -949,9 +957,7 @@ p2m_pod_zero_check(struct p2m_domain *p2m, const gfn_t *gfns, unsigned int count
         if ( !map[i] )
             continue;
 
-        for ( j = 0; j < (PAGE_SIZE / sizeof(*map[i])); j++ )
-            if ( *(map[i] + j) != 0 )
-                break;
+        zero = words_are_zero(map[i], PAGE_SIZE / sizeof(*map[i]));
 
         unmap_domain_page(map[i]);
 
@@ -961,7 +967,7 @@ p2m_pod_zero_check(struct p2m_domain *p2m, const gfn_t *gfns, unsigned int count
          * See comment in p2m_pod_zero_check_superpage() re gnttab
          * check timing.
          */
-        if ( j < (PAGE_SIZE / sizeof(*map[i])) )
+        if ( !zero )
         {
             /*
              * If the previous p2m_set_entry call succeeded, this one shouldn't
@@ -1065,6 +1071,122 @@ p2m_pod_emergency_sweep(struct p2m_domain *p2m)
 
 }
 
+/*
+ * Background reclaim: when the cache runs low while the guest still has PoD
+ * entries, a tasklet on another (preferably idle) pCPU sweeps for zero pages
+ * to refill it, rather than the faulting vCPU having to find them.
+ */
+#define POD_RECLAIM_LOW     SUPERPAGE_PAGES
+#define POD_RECLAIM_TARGET  (SUPERPAGE_PAGES * 4)
+
+static bool pod_want_reclaim(const struct p2m_domain *p2m)
+{
+    return p2m->pod.count < POD_RECLAIM_TARGET &&
+           p2m->pod.entry_count > p2m->pod.count &&
+           p2m->pod.reclaim_idle <= gfn_x(p2m->pod.max_guest);
+}
+
+/*
+ * Look at up to POD_SWEEP_LIMIT gfns, going down from where the last sweep
+ * stopped.  Superpages are only reclaimed whole, so as not to shatter them.
+ */
+static void pod_background_sweep(struct p2m_domain *p2m)
+{
+    gfn_t gfns[POD_SWEEP_STRIDE];
+    unsigned long gfn = gfn_x(p2m->pod.reclaim_bg), scanned = 0;
+    long count = p2m->pod.count;
+    unsigned int j = 0;
+
+    ASSERT(p2m_locked_by_me(p2m) && pod_locked_by_me(p2m));
+
+    if ( gfn == 0 || gfn > gfn_x(p2m->pod.max_guest) )
+        gfn = gfn_x(p2m->pod.max_guest);
+
+    while ( gfn > 0 && j < POD_SWEEP_STRIDE && scanned < POD_SWEEP_LIMIT )
+    {
+        unsigned int order;
+        p2m_access_t a;
+        p2m_type_t t;
+
+        p2m->get_entry(p2m, _gfn(gfn), &t, &a, 0, &order, NULL);
+
+        if ( p2m_is_ram(t) && order >= PAGE_ORDER_2M )
+        {
+            unsigned long start = gfn & ~(SUPERPAGE_PAGES - 1);
+
+            p2m_pod_zero_check_superpage(p2m, _gfn(start));
+            scanned += gfn - start + 1;
+            gfn = start ? start - 1 : 0;
+            continue;
+        }
+
+        if ( p2m_is_ram(t) )
+            gfns[j++] = _gfn(gfn);
+
+        gfn--;
+        scanned++;
+    }
+
+    if ( j )
+        p2m_pod_zero_check(p2m, gfns, j);
+
+    p2m->pod.reclaim_bg = _gfn(gfn);
+
+    if ( p2m->pod.count > count )
+    {
+        p2m->pod.reclaimed_bg += p2m->pod.count - count;
+        p2m->pod.reclaim_idle = 0;
+    }
+    else
+        p2m->pod.reclaim_idle += scanned;
+}
+
+static void pod_reclaim_tasklet(void *data)
+{
+    struct p2m_domain *p2m = data;
+    struct domain *d = p2m->domain;
+    s_time_t deadline = NOW() + MILLISECS(1);
+    bool more;
+
+    do {
+        /* Drop the locks between sweeps, for vCPUs to make progress. */
+        p2m_lock(p2m);
+        pod_lock(p2m);
+
+        more = !d->is_dying && pod_want_reclaim(p2m);
+        if ( more )
+            pod_background_sweep(p2m);
+
+        pod_unlock(p2m);
+        p2m_unlock(p2m);
+    } while ( more && NOW() < deadline &&
+              !softirq_pending(smp_processor_id()) );
+
+    if ( more )
+        tasklet_schedule(&p2m->pod.reclaim_tasklet);
+}
+
+static void pod_schedule_reclaim(struct p2m_domain *p2m)
+{
+    unsigned int cpu;
+
+    ASSERT(pod_locked_by_me(p2m));
+
+    if ( tasklet_is_scheduled(&p2m->pod.reclaim_tasklet) )
+        return;
+
+    /* A fresh demand means new memory may have become zero since. */
+    p2m->pod.reclaim_idle = 0;
+
+    for_each_online_cpu ( cpu )
+        if ( cpu != smp_processor_id() && idle_vcpu[cpu]->is_running )
+            break;
+    if ( cpu >= nr_cpu_ids )
+        cpu = smp_processor_id();
+
+    tasklet_schedule_on_cpu(&p2m->pod.reclaim_tasklet, cpu);
+}
+
 static void pod_eager_reclaim(struct p2m_domain *p2m)
 {
     struct pod_mrp_list *mrp = &p2m->pod.mrp;
@@ -1089,10 +1211,16 @@ static void pod_eager_reclaim(struct p2m_domain *p2m)
 
                 if ( p2m_pod_zero_check_superpage(p2m, gfn) == 0 )
                 {
-                    unsigned int x;
-
-                    for ( x = 0; x < SUPERPAGE_PAGES; ++x, gfn = gfn_add(gfn, 1) )
-                        p2m_pod_zero_check(p2m, &gfn, 1);
+                    gfn_t gfns[POD_SWEEP_STRIDE];
+                    unsigned int x, y;
+
+                    /* One TLB flush per stride rather than per page. */
+                    for ( x = 0; x < SUPERPAGE_PAGES; x += POD_SWEEP_STRIDE )
+                    {
+                        for ( y = 0; y < POD_SWEEP_STRIDE; ++y )
+                            gfns[y] = gfn_add(gfn, x + y);
+                        p2m_pod_zero_check(p2m, gfns, POD_SWEEP_STRIDE);
+                    }
                 }
             }
             else
@@ -1205,6 +1333,10 @@ p2m_pod_demand_populate(struct p2m_domain *p2m, gfn_t gfn,
 
     pod_eager_record(p2m, gfn_aligned, order);
 
+    if ( p2m->pod.count < POD_RECLAIM_LOW &&
+         p2m->pod.entry_count > p2m->pod.count )
+        pod_schedule_reclaim(p2m);
+
     if ( tb_init_done )
     {
         struct {
@@ -1328,6 +1460,7 @@ void p2m_pod_init(struct p2m_domain *p2m)
     mm_lock_init(&p2m->pod.lock);
     INIT_PAGE_LIST_HEAD(&p2m->pod.super);
     INIT_PAGE_LIST_HEAD(&p2m->pod.single);
+    tasklet_init(&p2m->pod.reclaim_tasklet, pod_reclaim_tasklet, p2m);
 
     for ( i = 0; i < ARRAY_SIZE(p2m->pod.mrp.list); ++i )
         p2m->pod.mrp.list[i] = gfn_x(INVALID_GFN);
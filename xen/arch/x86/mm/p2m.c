@@ -1034,6 +1034,24 @@ int p2m_change_type_one(struct domain *d, unsigned long gfn_l,
     return rc;
 }
 
+/*
+ * As p2m_change_type_one() for each of the gfns, failures being ignored,
+ * but with the p2m lock taken once for the whole batch.
+ */
+void p2m_change_type_list(struct domain *d, const uint64_t *gfns,
+                          unsigned int nr, p2m_type_t ot, p2m_type_t nt)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    unsigned int i;
+
+    p2m_lock(p2m);
+
+    for ( i = 0; i < nr; i++ )
+        p2m_change_type_one(d, gfns[i], ot, nt);
+
+    p2m_unlock(p2m);
+}
+
 /* Modify the p2m type of [start, end_exclusive) from ot to nt. */
 static void change_type_range(struct p2m_domain *p2m,
                               unsigned long start, unsigned long end_exclusive,
@@ -1886,6 +1904,275 @@ void p2m_mem_paging_resume(struct domain *d, vm_event_response_t *rsp)
     }
 }
 
+/*
+ * Replace the 2^order frames mapped at gfn, starting at mfn, by a copy on
+ * the given node.  Only frames referenced solely by the p2m qualify, as
+ * any other reference would keep pointing at the old frame.
+ */
+static int p2m_numa_move_one(struct p2m_domain *p2m, gfn_t gfn, mfn_t mfn,
+                             unsigned int order, p2m_type_t t,
+                             p2m_access_t a, nodeid_t node)
+{
+    struct domain *d = p2m->domain;
+    struct page_info *old = mfn_to_page(mfn), *new;
+    unsigned long i, nr = 1UL << order;
+    int rc = -EBUSY;
+
+    ASSERT(gfn_locked_by_me(p2m, gfn));
+
+    for ( i = 0; i < nr; i++ )
+    {
+        if ( unlikely(!get_page(&old[i], d)) )
+            break;
+
+        if ( (old[i].count_info & (PGC_count_mask | PGC_allocated)) !=
+             (2 | PGC_allocated) ||
+             (old[i].u.inuse.type_info & PGT_count_mask) ||
+             is_special_page(&old[i]) )
+        {
+            put_page(&old[i]);
+            break;
+        }
+    }
+    if ( i < nr )
+    {
+        nr = i;
+        goto out;
+    }
+
+    /* No need to scrub: the contents get overwritten right away. */
+    new = alloc_domheap_pages(d, order, MEMF_node(node) | MEMF_exact_node |
+                                        MEMF_no_owner | MEMF_no_scrub);
+    if ( !new )
+    {
+        rc = -ENOMEM;
+        goto out;
+    }
+
+    for ( i = 0; i < nr; i++ )
+        copy_domain_page(mfn_add(page_to_mfn(new), i), mfn_add(mfn, i));
+
+    /*
+     * The new frames are accounted to the domain only here, and the old
+     * ones cease to be once freed below: the domain may be at its
+     * allocation limit.
+     */
+    rc = assign_pages(d, new, order, MEMF_no_refcount);
+    if ( rc )
+    {
+        free_domheap_pages(new, order);
+        goto out;
+    }
+    spin_lock(&d->page_alloc_lock);
+    if ( unlikely(domain_adjust_tot_pages(d, nr) == nr) )
+        get_knownalive_domain(d);
+    spin_unlock(&d->page_alloc_lock);
+
+    rc = p2m_set_entry(p2m, gfn, page_to_mfn(new), order, t, a);
+    if ( rc )
+    {
+        for ( i = 0; i < nr; i++ )
+            if ( test_and_clear_bit(_PGC_allocated, &new[i].count_info) )
+                put_page(&new[i]);
+        goto out;
+    }
+
+    for ( i = 0; i < nr; i++ )
+    {
+        set_gpfn_from_mfn(mfn_x(mfn) + i, INVALID_M2P_ENTRY);
+        set_gpfn_from_mfn(mfn_x(page_to_mfn(new)) + i, gfn_x(gfn) + i);
+        put_page_alloc_ref(&old[i]);
+    }
+
+ out:
+    /* Drops the last reference to the old frames if they were replaced. */
+    for ( i = 0; i < nr; i++ )
+        put_page(&old[i]);
+
+    return rc;
+}
+
+int p2m_numa_move(struct domain *d, struct xen_domctl_numa_move *op)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    bool dry_run = op->flags & XEN_DOMCTL_NUMA_MOVE_dry_run;
+    uint64_t end_gfn;
+    int rc = 0;
+
+    if ( op->flags & ~XEN_DOMCTL_NUMA_MOVE_dry_run )
+        return -EINVAL;
+
+    if ( op->node >= MAX_NUMNODES || !node_online(op->node) )
+        return -EINVAL;
+
+    if ( !paging_mode_translate(d) )
+        return -EOPNOTSUPP;
+
+    if ( !dry_run && (altp2m_active(d) || has_arch_pdevs(d)) )
+        return -EOPNOTSUPP;
+
+    end_gfn = min_t(uint64_t, op->end_gfn, p2m->max_mapped_pfn + 1);
+
+    if ( !dry_run )
+        domain_pause(d);
+
+    while ( op->gfn < end_gfn )
+    {
+        gfn_t gfn = _gfn(op->gfn);
+        unsigned long mask;
+        unsigned int order;
+        p2m_type_t t;
+        p2m_access_t a;
+        mfn_t mfn;
+
+        if ( op->max_moved && op->nr_moved >= op->max_moved )
+            break;
+
+        gfn_lock(p2m, gfn, 0);
+
+        mfn = p2m->get_entry(p2m, gfn, &t, &a, 0, &order, NULL);
+
+        /* Deal with whole (up to 2M) mappings, unless we start mid-way. */
+        order = min_t(unsigned int, order, PAGE_ORDER_2M);
+        mask = (1UL << order) - 1;
+        if ( (op->gfn & mask) || op->gfn + mask >= end_gfn )
+            order = 0, mask = 0;
+
+        if ( !mfn_valid(mfn) || t != p2m_ram_rw )
+            /* Nothing to do. */;
+        else if ( phys_to_nid(mfn_to_maddr(mfn)) == op->node )
+            op->nr_local += mask + 1;
+        else if ( dry_run )
+            op->nr_moved += mask + 1;
+        else
+        {
+            rc = p2m_numa_move_one(p2m, gfn, mfn, order, t, a, op->node);
+
+            /* Fall back to splitting the superpage if the node is short. */
+            if ( rc == -ENOMEM && order )
+            {
+                order = 0, mask = 0;
+                rc = p2m_numa_move_one(p2m, gfn, mfn, order, t, a, op->node);
+            }
+
+            if ( !rc )
+                op->nr_moved += mask + 1;
+            else if ( rc == -EBUSY )
+            {
+                op->nr_busy += mask + 1;
+                rc = 0;
+            }
+        }
+
+        gfn_unlock(p2m, gfn, 0);
+
+        if ( rc )
+            break;
+
+        op->gfn += mask + 1;
+
+        if ( op->gfn < end_gfn && hypercall_preempt_check() )
+        {
+            rc = -ERESTART;
+            break;
+        }
+    }
+
+    if ( !dry_run )
+        domain_unpause(d);
+
+    return rc;
+}
+
+/* Frames sampled with the p2m lock held, a multiple of 8 */
+#define SAMPLE_ACCESSED_BATCH 512
+
+int p2m_sample_accessed(struct domain *d,
+                        struct xen_domctl_sample_accessed *op)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    bool clear = !(op->flags & XEN_DOMCTL_SAMPLE_ACCESSED_peek);
+    unsigned long bitmap[SAMPLE_ACCESSED_BATCH / BITS_PER_LONG];
+    bool flush = false;
+    int rc = 0;
+
+    if ( op->flags & ~(XEN_DOMCTL_SAMPLE_ACCESSED_peek |
+                       XEN_DOMCTL_SAMPLE_ACCESSED_stop) )
+        return -EINVAL;
+
+    if ( !hap_enabled(d) || !p2m->sample_accessed ||
+         altp2m_active(d) || nestedhvm_enabled(d) )
+        return -EOPNOTSUPP;
+
+    if ( op->flags & XEN_DOMCTL_SAMPLE_ACCESSED_stop )
+    {
+        if ( p2m->accessed_tracking )
+            p2m->set_accessed_tracking(p2m, false);
+        return 0;
+    }
+
+    /*
+     * Without PML the EPT A/D bits are enabled for tracking only, and with
+     * them the hardware treats guest page table walks as writes: pages
+     * holding guest page tables which mem_access made read-only would
+     * fault on every walk.
+     */
+    if ( vm_event_check_ring(d->vm_event_monitor) ||
+         p2m->default_access != p2m_access_rwx )
+    {
+        if ( p2m->accessed_tracking )
+            p2m->set_accessed_tracking(p2m, false);
+        return -EBUSY;
+    }
+
+    if ( op->gfn & 7 )
+        return -EINVAL;
+
+    if ( !p2m->accessed_tracking )
+        p2m->set_accessed_tracking(p2m, true);
+
+    while ( op->gfn < op->end_gfn )
+    {
+        unsigned int nr = min_t(uint64_t, op->end_gfn - op->gfn,
+                                SAMPLE_ACCESSED_BATCH);
+        unsigned int accessed;
+
+        memset(bitmap, 0, sizeof(bitmap));
+
+        p2m_lock(p2m);
+        op->nr_ram += p2m->sample_accessed(p2m, op->gfn, nr, bitmap, clear);
+        p2m_unlock(p2m);
+
+        accessed = bitmap_weight(bitmap, nr);
+        op->nr_accessed += accessed;
+        flush |= clear && accessed;
+
+        if ( !guest_handle_is_null(op->bitmap) )
+        {
+            if ( copy_to_guest(op->bitmap, (uint8_t *)bitmap,
+                               DIV_ROUND_UP(nr, 8)) )
+            {
+                rc = -EFAULT;
+                break;
+            }
+            guest_handle_add_offset(op->bitmap, nr / 8);
+        }
+        op->gfn += nr;
+
+        if ( op->gfn < op->end_gfn && hypercall_preempt_check() )
+        {
+            rc = -ERESTART;
+            break;
+        }
+    }
+
+    /* Make the hardware walk the p2m, and set the accessed bits, again. */
+    if ( flush )
+        p2m->tlb_flush(p2m);
+
+    return rc;
+}
+
 #ifdef CONFIG_HVM
 static struct p2m_domain *
 p2m_getlru_nestedp2m(struct domain *d, struct p2m_domain *p2m)
@@ -2464,6 +2751,10 @@ bool p2m_altp2m_get_or_propagate(struct p2m_domain *ap2m, unsigned long gfn_l,
     rc = p2m_set_entry(ap2m, gfn, amfn, page_order, *p2mt, *p2ma);
     p2m_unlock(ap2m);
 
+    ap2m->altp2m_stats.propagated++;
+    if ( page_order != PAGE_ORDER_4K )
+        ap2m->altp2m_stats.propagated_super++;
+
     if ( rc )
     {
         gprintk(XENLOG_ERR,
@@ -2552,6 +2843,7 @@ static int p2m_activate_altp2m(struct domain *d, unsigned int idx,
     p2m->global_logdirty = hostp2m->global_logdirty;
     p2m->min_remapped_gfn = gfn_x(INVALID_GFN);
     p2m->max_mapped_pfn = p2m->max_remapped_gfn = 0;
+    memset(&p2m->altp2m_stats, 0, sizeof(p2m->altp2m_stats));
 
     p2m_init_altp2m_ept(d, idx);
 
@@ -2579,17 +2871,11 @@ int p2m_init_altp2m_by_id(struct domain *d, unsigned int idx)
     return rc;
 }
 
-int p2m_init_next_altp2m(struct domain *d, uint16_t *idx,
-                         xenmem_access_t hvmmem_default_access)
+static int p2m_activate_next_altp2m(struct domain *d, uint16_t *idx,
+                                    p2m_access_t a)
 {
     int rc = -EINVAL;
     unsigned int i;
-    p2m_access_t a;
-    struct p2m_domain *hostp2m = p2m_get_hostp2m(d);
-
-    if ( hvmmem_default_access > XENMEM_access_default ||
-         !xenmem_access_to_p2m_access(hostp2m, hvmmem_default_access, &a) )
-        return rc;
 
     altp2m_list_lock(d);
 
@@ -2610,6 +2896,134 @@ int p2m_init_next_altp2m(struct domain *d, uint16_t *idx,
     return rc;
 }
 
+int p2m_init_next_altp2m(struct domain *d, uint16_t *idx,
+                         xenmem_access_t hvmmem_default_access)
+{
+    p2m_access_t a;
+    struct p2m_domain *hostp2m = p2m_get_hostp2m(d);
+
+    if ( hvmmem_default_access > XENMEM_access_default ||
+         !xenmem_access_to_p2m_access(hostp2m, hvmmem_default_access, &a) )
+        return -EINVAL;
+
+    return p2m_activate_next_altp2m(d, idx, a);
+}
+
+/*
+ * Create a new view as a copy of view src_idx, or continue copying into
+ * view *idx from *next_gfn on when that is non-zero.  Entries are copied
+ * with the page order they have in the source view, so superpages stay
+ * whole.  Returns -ERESTART, with *next_gfn updated, when preempted.  On
+ * any other error the new view is destroyed again.
+ */
+int p2m_clone_altp2m(struct domain *d, unsigned int src_idx, uint16_t *idx,
+                     uint64_t *next_gfn)
+{
+    struct p2m_domain *hp2m = p2m_get_hostp2m(d), *src, *dst;
+    unsigned int nr_views = min(ARRAY_SIZE(d->arch.altp2m_p2m), MAX_EPTP);
+    unsigned long gfn = *next_gfn;
+    unsigned int count = 0;
+    int rc;
+
+    if ( src_idx >= nr_views ||
+         d->arch.altp2m_eptp[array_index_nospec(src_idx, MAX_EPTP)] ==
+         mfn_x(INVALID_MFN) )
+        return -EINVAL;
+
+    src = array_access_nospec(d->arch.altp2m_p2m, src_idx);
+
+    if ( !gfn )
+    {
+        rc = p2m_activate_next_altp2m(d, idx, src->default_access);
+        if ( rc )
+            return rc;
+    }
+    else if ( !*idx || *idx == src_idx || *idx >= nr_views ||
+              d->arch.altp2m_eptp[array_index_nospec(*idx, MAX_EPTP)] ==
+              mfn_x(INVALID_MFN) )
+        return -EINVAL;
+
+    dst = array_access_nospec(d->arch.altp2m_p2m, *idx);
+
+    /* Lock the two views in index order */
+    p2m_lock(hp2m);
+    p2m_lock(src_idx < *idx ? src : dst);
+    p2m_lock(src_idx < *idx ? dst : src);
+
+    if ( !gfn )
+    {
+        dst->min_remapped_gfn = src->min_remapped_gfn;
+        dst->max_remapped_gfn = src->max_remapped_gfn;
+    }
+
+    rc = 0;
+    while ( gfn <= src->max_mapped_pfn )
+    {
+        p2m_type_t t;
+        p2m_access_t a;
+        unsigned int order;
+        unsigned long mask;
+        bool_t sve;
+        mfn_t mfn = src->get_entry(src, _gfn(gfn), &t, &a, 0, &order, &sve);
+
+        /* For holes, order is that of the missing table: skip it whole. */
+        mask = (1UL << order) - 1;
+
+        if ( !mfn_eq(mfn, INVALID_MFN) &&
+             (rc = dst->set_entry(dst, _gfn(gfn & ~mask),
+                                  _mfn(mfn_x(mfn) & ~mask), order,
+                                  t, a, sve)) )
+            break;
+
+        gfn = (gfn | mask) + 1;
+
+        /* Check for continuation if it's not the last iteration. */
+        if ( gfn <= src->max_mapped_pfn && !(++count & 0xff) &&
+             hypercall_preempt_check() )
+        {
+            rc = -ERESTART;
+            break;
+        }
+    }
+
+    *next_gfn = gfn;
+
+    p2m_unlock(src_idx < *idx ? dst : src);
+    p2m_unlock(src_idx < *idx ? src : dst);
+    p2m_unlock(hp2m);
+
+    /*
+     * Don't leave a partial copy behind, whose index the caller doesn't
+     * get to see.  This only fails if a vCPU has been switched to the view
+     * already, in which case it is the guest's to destroy.
+     */
+    if ( rc && rc != -ERESTART )
+        p2m_destroy_altp2m_by_id(d, *idx);
+
+    return rc;
+}
+
+int p2m_get_altp2m_stats(struct domain *d,
+                         struct xen_hvm_altp2m_view_stats *stats)
+{
+    const struct p2m_domain *p2m;
+
+    if ( stats->view >= min(ARRAY_SIZE(d->arch.altp2m_p2m), MAX_EPTP) ||
+         d->arch.altp2m_eptp[array_index_nospec(stats->view, MAX_EPTP)] ==
+         mfn_x(INVALID_MFN) )
+        return -EINVAL;
+
+    p2m = array_access_nospec(d->arch.altp2m_p2m, stats->view);
+
+    stats->faults = p2m->altp2m_stats.faults;
+    stats->propagated = p2m->altp2m_stats.propagated;
+    stats->propagated_super = p2m->altp2m_stats.propagated_super;
+    stats->violations = p2m->altp2m_stats.violations;
+    stats->splits = p2m->altp2m_stats.splits;
+
+    return 0;
+}
+
 int p2m_destroy_altp2m_by_id(struct domain *d, unsigned int idx)
 {
     struct p2m_domain *p2m;
@@ -28,6 +28,7 @@
 #include <asm/event.h>
 #include <asm/hvm/nestedhvm.h>
 #include <xen/numa.h>
+#include <xen/vmap.h>
 #include <xsm/xsm.h>
 #include <public/sched.h> /* SHUTDOWN_suspend */
 
@@ -209,8 +210,167 @@ static int paging_free_log_dirty_bitmap(struct domain *d, int rc)
     return rc;
 }
 
+/* One of the two flat bitmaps following the header page. */
+static unsigned long *paging_flat_bitmap(const struct domain *d,
+                                         unsigned int idx)
+{
+    const struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
+
+    return (void *)ld->flat + PAGE_SIZE * (1 + idx * ld->flat_frames);
+}
+
+/* The flat bitmap pfns are currently logged into. */
+static unsigned long *paging_flat_active(const struct domain *d)
+{
+    return paging_flat_bitmap(d, !d->arch.paging.log_dirty.flat->harvested);
+}
+
+static void paging_free_flat_pages(void *va, unsigned int nr)
+{
+    unsigned int i;
+
+    for ( i = 0; i < nr; i++ )
+        free_xenheap_page(mfn_to_virt(mfn_x(vmap_to_mfn(va +
+                                                        i * PAGE_SIZE))));
+    vunmap(va);
+}
+
+/*
+ * The flat bitmaps may cover up to this many pfns per page of guest memory,
+ * and at least the low 4GiB.  Sparse memory maps are otherwise left to the
+ * log-dirty trie, so that a high gfn cannot make Xen allocate bitmaps out
+ * of proportion to the guest.
+ */
+#define LOGDIRTY_FLAT_PFNS_PER_PAGE 4
+#define LOGDIRTY_FLAT_MIN_PFNS      (1UL << (32 - PAGE_SHIFT))
+
+/*
+ * Allocate the flat bitmaps, sized after the guest's current memory map.
+ * The pages are individually allocated and vmap()-ed, as the bitmaps of
+ * large guests are too big for higher order allocations to be reliable.
+ */
+static int paging_alloc_log_dirty_flat(struct domain *d)
+{
+    struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
+    unsigned long pfns = ROUNDUP(domain_get_maximum_gpfn(d) + 1,
+                                 PAGE_SIZE * 8);
+    unsigned int i, frames, nr;
+    struct xen_domctl_logdirty_bitmap_info *info = NULL;
+    mfn_t *mfns;
+    int rc = -ENOMEM;
+
+    if ( ld->flat )
+        return 0;
+
+    if ( pfns > max(LOGDIRTY_FLAT_MIN_PFNS,
+                    LOGDIRTY_FLAT_PFNS_PER_PAGE *
+                    (unsigned long)domain_tot_pages(d)) )
+        return -E2BIG;
+
+    frames = pfns / (PAGE_SIZE * 8);
+    nr = 1 + 2 * frames;
+
+    mfns = xmalloc_array(mfn_t, nr);
+    if ( !mfns )
+        return -ENOMEM;
+
+    for ( i = 0; i < nr; i++ )
+    {
+        void *p = alloc_xenheap_page();
+
+        if ( !p )
+            break;
+        clear_page(p);
+        mfns[i] = _mfn(virt_to_mfn(p));
+    }
+
+    if ( i == nr )
+        info = vmap(mfns, nr);
+    if ( !info )
+    {
+        while ( i-- )
+            free_xenheap_page(mfn_to_virt(mfn_x(mfns[i])));
+        xfree(mfns);
+        return -ENOMEM;
+    }
+
+    xfree(mfns);
+
+    info->nr_pfns = pfns;
+    info->nr_frames = frames;
+
+    paging_lock(d);
+
+    if ( ld->flat )
+        rc = 0;
+    else if ( d->is_dying )
+        rc = -EINVAL;
+    /* Pfns dirtied so far would be in the tree only. */
+    else if ( paging_mode_log_dirty(d) )
+        rc = -EBUSY;
+    else
+    {
+        for ( i = 0; i < nr; i++ )
+            share_xen_page_with_guest(vmap_to_page((void *)info +
+                                                   i * PAGE_SIZE),
+                                      d, SHARE_ro);
+
+        ld->flat_pfns = pfns;
+        ld->flat_frames = frames;
+        ld->flat = info;
+        info = NULL;
+        rc = 0;
+    }
+
+    paging_unlock(d);
+
+    if ( info )
+        paging_free_flat_pages(info, nr);
+
+    return rc;
+}
+
+static void paging_free_log_dirty_flat(struct domain *d)
+{
+    struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
+
+    if ( !ld->flat )
+        return;
+
+    paging_free_flat_pages(ld->flat, 1 + 2 * ld->flat_frames);
+    ld->flat = NULL;
+    ld->flat_pfns = 0;
+}
+
+int paging_log_dirty_get_frames(struct domain *d, unsigned int id,
+                                unsigned long frame, unsigned int nr_frames,
+                                xen_pfn_t mfn_list[])
+{
+    struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
+    unsigned int i, nr;
+    int rc;
+
+    if ( id )
+        return -EINVAL;
+
+    rc = paging_alloc_log_dirty_flat(d);
+    if ( rc )
+        return rc;
+
+    nr = 1 + 2 * ld->flat_frames;
+    if ( frame >= nr || nr_frames > nr - frame )
+        return -EINVAL;
+
+    for ( i = 0; i < nr_frames; i++ )
+        mfn_list[i] = mfn_x(vmap_to_mfn((void *)ld->flat +
+                                        (frame + i) * PAGE_SIZE));
+
+    return 0;
+}
+
 int paging_log_dirty_enable(struct domain *d, bool log_global)
 {
+    struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
     int ret;
 
     if ( has_arch_pdevs(d) && log_global )
@@ -225,6 +385,26 @@ int paging_log_dirty_enable(struct domain *d, bool log_global)
     if ( paging_mode_log_dirty(d) )
         return -EINVAL;
 
+    /* Serialise against paging_alloc_log_dirty_flat(). */
+    paging_lock(d);
+
+    if ( ld->flat )
+    {
+        /* Nothing logs into the flat bitmaps while log-dirty mode is off. */
+        if ( ld->flat_used )
+        {
+            void *bitmaps = paging_flat_bitmap(d, 0);
+            unsigned int i;
+
+            for ( i = 0; i < 2 * ld->flat_frames; i++ )
+                clear_page(bitmaps + i * PAGE_SIZE);
+        }
+        ld->flat_overflow = 0;
+        ld->flat_used = true;
+    }
+
+    paging_unlock(d);
+
     domain_pause(d);
     ret = d->arch.paging.log_dirty.ops->enable(d, log_global);
     domain_unpause(d);
@@ -256,82 +436,136 @@ static int paging_log_dirty_disable(struct domain *d, bool_t resuming)
     return ret;
 }
 
-/* Mark a page as dirty, with taking guest pfn as parameter */
-void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn)
+/* Find the log-dirty leaf covering pfn, allocating the path to it. */
+static mfn_t paging_log_dirty_leaf(struct domain *d, pfn_t pfn)
 {
-    bool changed;
     mfn_t mfn, *l4, *l3, *l2;
-    unsigned long *l1;
-    unsigned int i1, i2, i3, i4;
-
-    if ( !paging_mode_log_dirty(d) )
-        return;
-
-    /* Shared MFNs should NEVER be marked dirty */
-    BUG_ON(paging_mode_translate(d) && SHARED_M2P(pfn_x(pfn)));
 
-    /*
-     * Values with the MSB set denote MFNs that aren't really part of the
-     * domain's pseudo-physical memory map (e.g., the shared info frame).
-     * Nothing to do here...
-     */
-    if ( unlikely(!VALID_M2P(pfn_x(pfn))) )
-        return;
-
-    i1 = L1_LOGDIRTY_IDX(pfn);
-    i2 = L2_LOGDIRTY_IDX(pfn);
-    i3 = L3_LOGDIRTY_IDX(pfn);
-    i4 = L4_LOGDIRTY_IDX(pfn);
-
-    /* Recursive: this is called from inside the shadow code */
-    paging_lock_recursive(d);
-
-    if ( unlikely(!mfn_valid(d->arch.paging.log_dirty.top)) ) 
+    if ( unlikely(!mfn_valid(d->arch.paging.log_dirty.top)) )
     {
-         d->arch.paging.log_dirty.top = paging_new_log_dirty_node(d);
-         if ( unlikely(!mfn_valid(d->arch.paging.log_dirty.top)) )
-             goto out;
+        d->arch.paging.log_dirty.top = paging_new_log_dirty_node(d);
+        if ( unlikely(!mfn_valid(d->arch.paging.log_dirty.top)) )
+            return INVALID_MFN;
     }
 
     l4 = paging_map_log_dirty_bitmap(d);
-    mfn = l4[i4];
+    mfn = l4[L4_LOGDIRTY_IDX(pfn)];
     if ( !mfn_valid(mfn) )
-        l4[i4] = mfn = paging_new_log_dirty_node(d);
+        l4[L4_LOGDIRTY_IDX(pfn)] = mfn = paging_new_log_dirty_node(d);
     unmap_domain_page(l4);
     if ( !mfn_valid(mfn) )
-        goto out;
+        return INVALID_MFN;
 
     l3 = map_domain_page(mfn);
-    mfn = l3[i3];
+    mfn = l3[L3_LOGDIRTY_IDX(pfn)];
     if ( !mfn_valid(mfn) )
-        l3[i3] = mfn = paging_new_log_dirty_node(d);
+        l3[L3_LOGDIRTY_IDX(pfn)] = mfn = paging_new_log_dirty_node(d);
     unmap_domain_page(l3);
     if ( !mfn_valid(mfn) )
-        goto out;
+        return INVALID_MFN;
 
     l2 = map_domain_page(mfn);
-    mfn = l2[i2];
+    mfn = l2[L2_LOGDIRTY_IDX(pfn)];
     if ( !mfn_valid(mfn) )
-        l2[i2] = mfn = paging_new_log_dirty_leaf(d);
+        l2[L2_LOGDIRTY_IDX(pfn)] = mfn = paging_new_log_dirty_leaf(d);
     unmap_domain_page(l2);
-    if ( !mfn_valid(mfn) )
-        goto out;
 
-    l1 = map_domain_page(mfn);
-    changed = !__test_and_set_bit(i1, l1);
-    unmap_domain_page(l1);
-    if ( changed )
+    return mfn;
+}
+
+/*
+ * Mark a pfn dirty, with the paging lock held.  *l1 caches the mapping of
+ * the leaf last used, the one covering pfns [*leaf << (PAGE_SHIFT + 3), ...),
+ * so that batches of neighbouring pfns don't walk the tree for each of them.
+ * The caller unmaps *l1 once done.
+ */
+static void paging_mark_pfn_dirty_locked(struct domain *d, pfn_t pfn,
+                                         unsigned long **l1,
+                                         unsigned long *leaf)
+{
+    struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
+    unsigned long *bitmap, idx;
+
+    /* Shared MFNs should NEVER be marked dirty */
+    BUG_ON(paging_mode_translate(d) && SHARED_M2P(pfn_x(pfn)));
+
+    /*
+     * Values with the MSB set denote MFNs that aren't really part of the
+     * domain's pseudo-physical memory map (e.g., the shared info frame).
+     * Nothing to do here...
+     */
+    if ( unlikely(!VALID_M2P(pfn_x(pfn))) )
+        return;
+
+    if ( pfn_x(pfn) < ld->flat_pfns )
+    {
+        bitmap = paging_flat_active(d);
+        idx = pfn_x(pfn);
+    }
+    else
     {
-        PAGING_DEBUG(LOGDIRTY,
-                     "d%d: marked mfn %" PRI_mfn " (pfn %" PRI_pfn ")\n",
-                     d->domain_id, mfn_x(mfn), pfn_x(pfn));
-        d->arch.paging.log_dirty.dirty_count++;
+        if ( !*l1 || *leaf != pfn_x(pfn) >> (PAGE_SHIFT + 3) )
+        {
+            mfn_t mfn = paging_log_dirty_leaf(d, pfn);
+
+            if ( *l1 )
+                unmap_domain_page(*l1);
+            /* We've already recorded any failed allocations */
+            *l1 = mfn_valid(mfn) ? map_domain_page(mfn) : NULL;
+            if ( !*l1 )
+                return;
+            *leaf = pfn_x(pfn) >> (PAGE_SHIFT + 3);
+        }
+        bitmap = *l1;
+        idx = L1_LOGDIRTY_IDX(pfn);
     }
 
-out:
-    /* We've already recorded any failed allocations */
+    if ( !__test_and_set_bit(idx, bitmap) )
+    {
+        PAGING_DEBUG(LOGDIRTY, "d%d: marked pfn %" PRI_pfn "\n",
+                     d->domain_id, pfn_x(pfn));
+        ld->dirty_count++;
+        if ( bitmap == *l1 && ld->flat )
+            ld->flat_overflow++;
+    }
+}
+
+/* Mark a page as dirty, with taking guest pfn as parameter */
+void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn)
+{
+    unsigned long *l1 = NULL, leaf = 0;
+
+    if ( !paging_mode_log_dirty(d) )
+        return;
+
+    /* Recursive: this is called from inside the shadow code */
+    paging_lock_recursive(d);
+    paging_mark_pfn_dirty_locked(d, pfn, &l1, &leaf);
+    if ( l1 )
+        unmap_domain_page(l1);
+    paging_unlock(d);
+}
+
+/*
+ * Mark a batch of pages as dirty, e.g. the contents of a PML buffer: the
+ * paging lock is taken once, and pfns covered by the flat bitmap or sharing
+ * a leaf with their predecessor don't need any tree walk.
+ */
+void paging_mark_pfns_dirty(struct domain *d, const uint64_t *pfns,
+                            unsigned int nr)
+{
+    unsigned long *l1 = NULL, leaf = 0;
+    unsigned int i;
+
+    if ( !paging_mode_log_dirty(d) || !nr )
+        return;
+
+    paging_lock_recursive(d);
+    for ( i = 0; i < nr; i++ )
+        paging_mark_pfn_dirty_locked(d, _pfn(pfns[i]), &l1, &leaf);
+    if ( l1 )
+        unmap_domain_page(l1);
     paging_unlock(d);
-    return;
 }
 
 /* Mark a page as dirty */
@@ -367,6 +601,9 @@ int paging_mfn_is_dirty(struct domain *d, mfn_t gmfn)
     if ( unlikely(!VALID_M2P(pfn_x(pfn))) )
         return 0;
 
+    if ( pfn_x(pfn) < d->arch.paging.log_dirty.flat_pfns )
+        return test_bit(pfn_x(pfn), paging_flat_active(d));
+
     mfn = d->arch.paging.log_dirty.top;
     if ( !mfn_valid(mfn) )
         return 0;
@@ -406,6 +643,7 @@ static int paging_log_dirty_op(struct domain *d,
     unsigned long pages = 0;
     mfn_t *l4 = NULL, *l3 = NULL, *l2 = NULL;
     unsigned long *l1 = NULL;
+    bool l1_flat = false;
     int i4, i3, i2;
 
     if ( !resuming )
@@ -482,8 +720,14 @@ static int paging_log_dirty_op(struct domain *d,
                   i2++ )
             {
                 unsigned int bytes = PAGE_SIZE;
-                l1 = ((l2 && mfn_valid(l2[i2])) ?
-                      map_domain_page(l2[i2]) : NULL);
+
+                /* The flat bitmap covers whole leaves. */
+                l1_flat = pages < d->arch.paging.log_dirty.flat_pfns;
+                if ( l1_flat )
+                    l1 = paging_flat_active(d) + pages / BITS_PER_LONG;
+                else
+                    l1 = ((l2 && mfn_valid(l2[i2])) ?
+                          map_domain_page(l2[i2]) : NULL);
                 if ( unlikely(((sc->pages - pages + 7) >> 3) < bytes) )
                     bytes = (unsigned int)((sc->pages - pages + 7) >> 3);
                 if ( likely(peek) )
@@ -503,7 +747,9 @@ static int paging_log_dirty_op(struct domain *d,
                 {
                     if ( clean )
                         clear_page(l1);
-                    unmap_domain_page(l1);
+                    if ( !l1_flat )
+                        unmap_domain_page(l1);
+                    l1 = NULL;
                 }
             }
             if ( l2 )
@@ -540,6 +786,7 @@ static int paging_log_dirty_op(struct domain *d,
         {
             d->arch.paging.log_dirty.fault_count = 0;
             d->arch.paging.log_dirty.dirty_count = 0;
+            d->arch.paging.log_dirty.flat_overflow = 0;
         }
     }
     else
@@ -574,7 +821,7 @@ static int paging_log_dirty_op(struct domain *d,
     paging_unlock(d);
     domain_unpause(d);
 
-    if ( l1 )
+    if ( l1 && !l1_flat )
         unmap_domain_page(l1);
     if ( l2 )
         unmap_domain_page(l2);
@@ -586,6 +833,90 @@ static int paging_log_dirty_op(struct domain *d,
     return rv;
 }
 
+/*
+ * CLEAN/PEEK with XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED: nothing gets copied,
+ * the toolstack reads the flat bitmaps through its own read-only mapping.
+ * The only O(bitmap size) work left, clearing the bitmap to be logged into
+ * next, is done before pausing the domain.
+ */
+static int paging_log_dirty_flat_op(struct domain *d,
+                                    struct xen_domctl_shadow_op *sc,
+                                    bool resuming)
+{
+    struct log_dirty_domain *ld = &d->arch.paging.log_dirty;
+    bool clean = sc->op == XEN_DOMCTL_SHADOW_OP_CLEAN;
+    unsigned int i;
+    int rc = 0;
+
+    if ( !ld->flat )
+        return -ENODATA;
+
+    paging_lock(d);
+    if ( !resuming )
+        memset(&d->arch.paging.preempt.log_dirty, 0,
+               sizeof(d->arch.paging.preempt.log_dirty));
+    i = d->arch.paging.preempt.log_dirty.done;
+    paging_unlock(d);
+
+    /*
+     * Nothing logs into the harvested bitmap, so it can be cleared with the
+     * domain running.  The toolstack has to be done with its contents.
+     */
+    for ( ; clean && i < ld->flat_frames; i++ )
+    {
+        clear_page((void *)paging_flat_bitmap(d, ld->flat->harvested) +
+                   i * PAGE_SIZE);
+
+        if ( i + 1 < ld->flat_frames && hypercall_preempt_check() )
+        {
+            paging_lock(d);
+            d->arch.paging.preempt.dom = current->domain;
+            d->arch.paging.preempt.op = sc->op;
+            d->arch.paging.preempt.log_dirty.done = i + 1;
+            paging_unlock(d);
+            return -ERESTART;
+        }
+    }
+
+    if ( is_hvm_domain(d) && (sc->mode & XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL) )
+        hvm_mapped_guest_frames_mark_dirty(d);
+
+    domain_pause(d);
+
+    /* Drain e.g. PML buffers into the active bitmap. */
+    p2m_flush_hardware_cached_dirty(d);
+
+    paging_lock(d);
+
+    d->arch.paging.preempt.dom = NULL;
+
+    sc->stats.fault_count = ld->fault_count;
+    sc->stats.dirty_count = ld->dirty_count;
+    sc->pages = ld->flat_pfns;
+
+    if ( unlikely(ld->failed_allocs) )
+        rc = -ENOMEM;
+    else if ( ld->flat_overflow )
+        rc = -EOVERFLOW;
+    else if ( clean )
+    {
+        ld->flat->harvested ^= 1;
+        ld->flat->generation++;
+        ld->fault_count = 0;
+        ld->dirty_count = 0;
+    }
+
+    paging_unlock(d);
+
+    /* Safe because the domain is paused. */
+    if ( clean && !rc )
+        ld->ops->clean(d);
+
+    domain_unpause(d);
+
+    return rc;
+}
+
 void paging_log_dirty_range(struct domain *d,
                            unsigned long begin_pfn,
                            unsigned long nr,
@@ -736,8 +1067,11 @@ int paging_domctl(struct domain *d, struct xen_domctl_shadow_op *sc,
 
     case XEN_DOMCTL_SHADOW_OP_CLEAN:
     case XEN_DOMCTL_SHADOW_OP_PEEK:
-        if ( sc->mode & ~XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL )
+        if ( sc->mode & ~(XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL |
+                          XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED) )
             return -EINVAL;
+        if ( sc->mode & XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED )
+            return paging_log_dirty_flat_op(d, sc, resuming);
         return paging_log_dirty_op(d, sc, resuming);
     }
 
@@ -823,6 +1157,8 @@ void paging_final_teardown(struct domain *d)
         shadow_final_teardown(d);
 
     p2m_final_teardown(d);
+
+    paging_free_log_dirty_flat(d);
 }
 
 /* Enable an arbitrary paging-assistance mode.  Call once at domain
@@ -79,6 +79,7 @@ void shadow_vcpu_init(struct vcpu *v)
 #if (SHADOW_OPTIMIZATIONS & SHOPT_OUT_OF_SYNC)
     int i, j;
 
+    v->arch.paging.shadow.oos_nr = SHADOW_OOS_PAGES_MIN;
     for ( i = 0; i < SHADOW_OOS_PAGES; i++ )
     {
         v->arch.paging.shadow.oos[i] = INVALID_MFN;
@@ -156,8 +157,54 @@ __initcall(shadow_audit_key_init);
  * We keep a hash per vcpu, because we want as much as possible to do
  * the re-sync on the save vcpu we did the unsync on, so the VA hint
  * will be valid.
+ *
+ * Only the first oos_nr slots of the hash are used.  Vcpus which keep
+ * evicting pages to unsync others (e.g. fork/exec heavy guests rewriting
+ * many l1s) get more slots; oos_hash_resize() adjusts this while the
+ * vcpu has no page out of sync, so no entry needs moving.
  */
 
+#define SHADOW_OOS_WINDOW 64
+
+static inline unsigned int oos_hash(const struct vcpu *v, mfn_t gmfn)
+{
+    return mfn_x(gmfn) % v->arch.paging.shadow.oos_nr;
+}
+
+static inline unsigned int oos_next(const struct vcpu *v, unsigned int idx)
+{
+    return (idx + 1) % v->arch.paging.shadow.oos_nr;
+}
+
+static void oos_hash_resize(struct vcpu *v)
+{
+    struct shadow_vcpu *sv = &v->arch.paging.shadow;
+    unsigned int idx;
+
+    if ( sv->oos_adds < SHADOW_OOS_WINDOW )
+        return;
+
+    for ( idx = 0; idx < SHADOW_OOS_PAGES; idx++ )
+        if ( mfn_valid(sv->oos[idx]) )
+            return;
+
+    /* Grow above one eviction in four unsyncs, shrink below one in 32 */
+    if ( sv->oos_evicts * 4 > sv->oos_adds &&
+         sv->oos_nr < SHADOW_OOS_PAGES )
+    {
+        sv->oos_nr += 2;
+        perfc_incr(shadow_oos_grow);
+    }
+    else if ( sv->oos_evicts * 32 < sv->oos_adds &&
+              sv->oos_nr > SHADOW_OOS_PAGES_MIN )
+    {
+        sv->oos_nr -= 2;
+        perfc_incr(shadow_oos_shrink);
+    }
+
+    sv->oos_adds = sv->oos_evicts = 0;
+}
+
 static void sh_oos_audit(struct domain *d)
 {
     unsigned int idx, expected_idx, expected_idx_alt;
@@ -172,8 +219,8 @@ static void sh_oos_audit(struct domain *d)
             if ( !mfn_valid(oos[idx]) )
                 continue;
 
-            expected_idx = mfn_x(oos[idx]) % SHADOW_OOS_PAGES;
-            expected_idx_alt = ((expected_idx + 1) % SHADOW_OOS_PAGES);
+            expected_idx = oos_hash(v, oos[idx]);
+            expected_idx_alt = oos_next(v, expected_idx);
             if ( idx != expected_idx && idx != expected_idx_alt )
             {
                 printk("%s: idx %x contains gmfn %lx, expected at %x or %x.\n",
@@ -216,9 +263,9 @@ void oos_audit_hash_is_present(struct domain *d, mfn_t gmfn)
     for_each_vcpu(d, v)
     {
         oos = v->arch.paging.shadow.oos;
-        idx = mfn_x(gmfn) % SHADOW_OOS_PAGES;
+        idx = oos_hash(v, gmfn);
         if ( !mfn_eq(oos[idx], gmfn) )
-            idx = (idx + 1) % SHADOW_OOS_PAGES;
+            idx = oos_next(v, idx);
 
         if ( mfn_eq(oos[idx], gmfn) )
             return;
@@ -288,9 +335,9 @@ void oos_fixup_add(struct domain *d, mfn_t gmfn,
     {
         oos = v->arch.paging.shadow.oos;
         oos_fixup = v->arch.paging.shadow.oos_fixup;
-        idx = mfn_x(gmfn) % SHADOW_OOS_PAGES;
+        idx = oos_hash(v, gmfn);
         if ( !mfn_eq(oos[idx], gmfn) )
-            idx = (idx + 1) % SHADOW_OOS_PAGES;
+            idx = oos_next(v, idx);
         if ( mfn_eq(oos[idx], gmfn) )
         {
             int i;
@@ -428,24 +475,26 @@ static void oos_hash_add(struct vcpu *v, mfn_t gmfn)
     for (i = 0; i < SHADOW_OOS_FIXUPS; i++ )
         fixup.smfn[i] = INVALID_MFN;
 
-    idx = mfn_x(gmfn) % SHADOW_OOS_PAGES;
+    idx = oos_hash(v, gmfn);
     oidx = idx;
 
     if ( mfn_valid(oos[idx])
-         && (mfn_x(oos[idx]) % SHADOW_OOS_PAGES) == idx )
+         && oos_hash(v, oos[idx]) == idx )
     {
         /* Punt the current occupant into the next slot */
         SWAP(oos[idx], gmfn);
         SWAP(oos_fixup[idx], fixup);
         swap = 1;
-        idx = (idx + 1) % SHADOW_OOS_PAGES;
+        idx = oos_next(v, idx);
     }
     if ( mfn_valid(oos[idx]) )
    {
         /* Crush the current occupant. */
         _sh_resync(v, oos[idx], &oos_fixup[idx], oos_snapshot[idx]);
         perfc_incr(shadow_unsync_evict);
+        v->arch.paging.shadow.oos_evicts++;
     }
+    v->arch.paging.shadow.oos_adds++;
     oos[idx] = gmfn;
     oos_fixup[idx] = fixup;
 
@@ -471,9 +520,9 @@ static void oos_hash_remove(struct domain *d, mfn_t gmfn)
     for_each_vcpu(d, v)
     {
         oos = v->arch.paging.shadow.oos;
-        idx = mfn_x(gmfn) % SHADOW_OOS_PAGES;
+        idx = oos_hash(v, gmfn);
         if ( !mfn_eq(oos[idx], gmfn) )
-            idx = (idx + 1) % SHADOW_OOS_PAGES;
+            idx = oos_next(v, idx);
         if ( mfn_eq(oos[idx], gmfn) )
         {
             oos[idx] = INVALID_MFN;
@@ -497,9 +546,9 @@ mfn_t oos_snapshot_lookup(struct domain *d, mfn_t gmfn)
     {
         oos = v->arch.paging.shadow.oos;
         oos_snapshot = v->arch.paging.shadow.oos_snapshot;
-        idx = mfn_x(gmfn) % SHADOW_OOS_PAGES;
+        idx = oos_hash(v, gmfn);
         if ( !mfn_eq(oos[idx], gmfn) )
-            idx = (idx + 1) % SHADOW_OOS_PAGES;
+            idx = oos_next(v, idx);
         if ( mfn_eq(oos[idx], gmfn) )
         {
             return oos_snapshot[idx];
@@ -525,9 +574,9 @@ void sh_resync(struct domain *d, mfn_t gmfn)
         oos = v->arch.paging.shadow.oos;
         oos_fixup = v->arch.paging.shadow.oos_fixup;
         oos_snapshot = v->arch.paging.shadow.oos_snapshot;
-        idx = mfn_x(gmfn) % SHADOW_OOS_PAGES;
+        idx = oos_hash(v, gmfn);
         if ( !mfn_eq(oos[idx], gmfn) )
-            idx = (idx + 1) % SHADOW_OOS_PAGES;
+            idx = oos_next(v, idx);
 
         if ( mfn_eq(oos[idx], gmfn) )
         {
@@ -588,6 +637,8 @@ void sh_resync_all(struct vcpu *v, int skip, int this, int others)
             oos[idx] = INVALID_MFN;
         }
 
+    oos_hash_resize(v);
+
  resync_others:
     if ( !others )
         return;
@@ -1344,18 +1395,24 @@ static unsigned int shadow_get_allocation(struct domain *d)
  * The table itself is an array of pointers to shadows; the shadows are then
  * threaded on a singly-linked list of shadows with the same hash value */
 
-#define SHADOW_HASH_BUCKETS 251
-/* Other possibly useful primes are 509, 1021, 2039, 4093, 8191, 16381 */
+/*
+ * The table starts with the smallest of these sizes and moves on to the
+ * next one whenever the chains get longer than two shadows on average.
+ */
+static const unsigned int sh_hash_sizes[] = {
+    251, 509, 1021, 2039, 4093, 8191, 16381,
+};
 
 /* Hash function that takes a gfn or mfn, plus another byte of type info */
 typedef u32 key_t;
-static inline key_t sh_hash(unsigned long n, unsigned int t)
+static inline key_t sh_hash(const struct domain *d, unsigned long n,
+                            unsigned int t)
 {
     unsigned char *p = (unsigned char *)&n;
     key_t k = t;
     int i;
     for ( i = 0; i < sizeof(n) ; i++ ) k = (u32)p[i] + (k<<6) + (k<<16) - k;
-    return k % SHADOW_HASH_BUCKETS;
+    return k % d->arch.paging.shadow.hash_buckets;
 }
 
 /* Before we get to the mechanism, define a pair of audit functions
@@ -1380,7 +1437,7 @@ static void sh_hash_audit_bucket(struct domain *d, int bucket)
         /* Wrong page of a multi-page shadow? */
         BUG_ON( !sp->u.sh.head );
         /* Wrong bucket? */
-        BUG_ON( sh_hash(__backpointer(sp), sp->u.sh.type) != bucket );
+        BUG_ON( sh_hash(d, __backpointer(sp), sp->u.sh.type) != bucket );
         /* Duplicate entry? */
         for ( x = next_shadow(sp); x; x = next_shadow(x) )
             BUG_ON( x->v.sh.back == sp->v.sh.back &&
@@ -1438,7 +1495,7 @@ static void sh_hash_audit(struct domain *d)
     if ( !(SHADOW_AUDIT & SHADOW_AUDIT_HASH_FULL) || !SHADOW_AUDIT_ENABLE )
         return;
 
-    for ( i = 0; i < SHADOW_HASH_BUCKETS; i++ )
+    for ( i = 0; i < d->arch.paging.shadow.hash_buckets; i++ )
     {
         sh_hash_audit_bucket(d, i);
     }
@@ -1453,12 +1510,65 @@ static int shadow_hash_alloc(struct domain *d)
     ASSERT(paging_locked_by_me(d));
     ASSERT(!d->arch.paging.shadow.hash_table);
 
-    table = xzalloc_array(struct page_info *, SHADOW_HASH_BUCKETS);
+    table = xzalloc_array(struct page_info *, sh_hash_sizes[0]);
     if ( !table ) return 1;
     d->arch.paging.shadow.hash_table = table;
+    d->arch.paging.shadow.hash_buckets = sh_hash_sizes[0];
+    d->arch.paging.shadow.hash_entries = 0;
+    d->arch.paging.shadow.hash_grow_at = 2 * sh_hash_sizes[0] + 1;
     return 0;
 }
 
+/* Move all shadows to a table of the next size up, once the average chain
+ * length exceeds 2.  Failing to allocate it is harmless: we carry on with
+ * longer chains, and try again once they got longer by one on average. */
+static void shadow_hash_grow(struct domain *d)
+{
+    struct page_info **old = d->arch.paging.shadow.hash_table, **table;
+    struct page_info *sp, *next;
+    unsigned int i, size, old_size = d->arch.paging.shadow.hash_buckets;
+    key_t key;
+
+    ASSERT(paging_locked_by_me(d));
+    ASSERT(!d->arch.paging.shadow.hash_walking);
+
+    for ( i = 0; i < ARRAY_SIZE(sh_hash_sizes); i++ )
+        if ( sh_hash_sizes[i] > old_size )
+            break;
+    if ( i == ARRAY_SIZE(sh_hash_sizes) )
+    {
+        d->arch.paging.shadow.hash_grow_at = UINT_MAX;
+        return;
+    }
+    size = sh_hash_sizes[i];
+
+    table = xzalloc_array(struct page_info *, size);
+    if ( !table )
+    {
+        d->arch.paging.shadow.hash_grow_at =
+            d->arch.paging.shadow.hash_entries + old_size;
+        return;
+    }
+
+    d->arch.paging.shadow.hash_table = table;
+    d->arch.paging.shadow.hash_buckets = size;
+    d->arch.paging.shadow.hash_grow_at = 2 * size + 1;
+
+    for ( i = 0; i < old_size; i++ )
+        for ( sp = old[i]; sp; sp = next )
+        {
+            next = next_shadow(sp);
+            key = sh_hash(d, __backpointer(sp), sp->u.sh.type);
+            set_next_shadow(sp, table[key]);
+            table[key] = sp;
+        }
+
+    xfree(old);
+    perfc_incr(shadow_hash_resizes);
+
+    sh_hash_audit(d);
+}
+
 /* Tear down the hash table and return all memory to Xen.
  * This function does not care whether the table is populated. */
 static void shadow_hash_teardown(struct domain *d)
@@ -1468,6 +1578,9 @@ static void shadow_hash_teardown(struct domain *d)
 
     xfree(d->arch.paging.shadow.hash_table);
     d->arch.paging.shadow.hash_table = NULL;
+    d->arch.paging.shadow.hash_buckets = 0;
+    d->arch.paging.shadow.hash_entries = 0;
+    d->arch.paging.shadow.hash_grow_at = 0;
 }
 
 
@@ -1485,7 +1598,7 @@ mfn_t shadow_hash_lookup(struct domain *d, unsigned long n, unsigned int t)
     sh_hash_audit(d);
 
     perfc_incr(shadow_hash_lookups);
-    key = sh_hash(n, t);
+    key = sh_hash(d, n, t);
     sh_hash_audit_bucket(d, key);
 
     sp = d->arch.paging.shadow.hash_table[key];
@@ -1538,7 +1651,7 @@ void shadow_hash_insert(struct domain *d, unsigned long n, unsigned int t,
     sh_hash_audit(d);
 
     perfc_incr(shadow_hash_inserts);
-    key = sh_hash(n, t);
+    key = sh_hash(d, n, t);
     sh_hash_audit_bucket(d, key);
 
     /* Insert this shadow at the top of the bucket */
@@ -1547,6 +1660,12 @@ void shadow_hash_insert(struct domain *d, unsigned long n, unsigned int t,
     d->arch.paging.shadow.hash_table[key] = sp;
 
     sh_hash_audit_bucket(d, key);
+
+    /* While walking, growing is put off to the next insert. */
+    if ( ++d->arch.paging.shadow.hash_entries >=
+         d->arch.paging.shadow.hash_grow_at &&
+         !d->arch.paging.shadow.hash_walking )
+        shadow_hash_grow(d);
 }
 
 void shadow_hash_delete(struct domain *d, unsigned long n, unsigned int t,
@@ -1563,7 +1682,7 @@ void shadow_hash_delete(struct domain *d, unsigned long n, unsigned int t,
     sh_hash_audit(d);
 
     perfc_incr(shadow_hash_deletes);
-    key = sh_hash(n, t);
+    key = sh_hash(d, n, t);
     sh_hash_audit_bucket(d, key);
 
     sp = mfn_to_page(smfn);
@@ -1587,6 +1706,7 @@ void shadow_hash_delete(struct domain *d, unsigned long n, unsigned int t,
         }
     }
     set_next_shadow(sp, NULL);
+    d->arch.paging.shadow.hash_entries--;
 
     sh_hash_audit_bucket(d, key);
 }
@@ -1620,7 +1740,7 @@ static void hash_vcpu_foreach(struct vcpu *v, unsigned int callback_mask,
     ASSERT(d->arch.paging.shadow.hash_walking == 0);
     d->arch.paging.shadow.hash_walking = 1;
 
-    for ( i = 0; i < SHADOW_HASH_BUCKETS; i++ )
+    for ( i = 0; i < d->arch.paging.shadow.hash_buckets; i++ )
     {
         /* WARNING: This is not safe against changes to the hash table.
          * The callback *must* return non-zero if it has inserted or
@@ -1667,7 +1787,7 @@ static void hash_domain_foreach(struct domain *d,
     ASSERT(d->arch.paging.shadow.hash_walking == 0);
     d->arch.paging.shadow.hash_walking = 1;
 
-    for ( i = 0; i < SHADOW_HASH_BUCKETS; i++ )
+    for ( i = 0; i < d->arch.paging.shadow.hash_buckets; i++ )
     {
         /* WARNING: This is not safe against changes to the hash table.
          * The callback *must* return non-zero if it has inserted or
@@ -3500,6 +3500,23 @@ propagate:
     return 0;
 }
 
+#ifdef CONFIG_PERF_COUNTERS
+/* Account the cost of each shadow fault, whichever way it was handled. */
+static int sh_page_fault_timed(struct vcpu *v,
+                               unsigned long va,
+                               struct cpu_user_regs *regs)
+{
+    cycles_t start = get_cycles();
+    int rc = sh_page_fault(v, va, regs);
+
+    perfc_incra(shadow_fault_cycles,
+                min_t(unsigned int, fls64((get_cycles() - start) >> 9),
+                      SHADOW_FAULT_CYCLES_SIZE - 1));
+
+    return rc;
+}
+#endif
+
 
 /*
  * Called when the guest requests an invlpg.  Returns true if the invlpg
@@ -4868,7 +4885,11 @@ int sh_audit_l4_table(struct vcpu *v, mfn_t sl4mfn, mfn_t x)
 /* Entry points into this mode of the shadow code.
  * This will all be mangled by the preprocessor to uniquify everything. */
 const struct paging_mode sh_paging_mode = {
+#ifdef CONFIG_PERF_COUNTERS
+    .page_fault                    = sh_page_fault_timed,
+#else
     .page_fault                    = sh_page_fault,
+#endif
     .invlpg                        = sh_invlpg,
     .gva_to_gfn                    = sh_gva_to_gfn,
     .update_cr3                    = sh_update_cr3,
@@ -1717,7 +1717,16 @@ static void time_calibration(void *unused)
         local_irq_enable();
     }
 
-    cpumask_copy(&r.cpu_calibration_map, &cpu_online_map);
+    /*
+     * With the nop rendezvous, calibration only re-bases the local time of
+     * a CPU onto the very same TSC-derived line, so nohz CPUs can safely be
+     * left alone.  The other rendezvous need every CPU to take part.
+     */
+    if ( time_calibration_rendezvous_fn == time_calibration_nop_rendezvous )
+        cpumask_andnot(&r.cpu_calibration_map, &cpu_online_map,
+                       &sched_nohz_cpus);
+    else
+        cpumask_copy(&r.cpu_calibration_map, &cpu_online_map);
 
     /* @wait=1 because we must wait for all cpus before freeing @r. */
     on_selected_cpus(&r.cpu_calibration_map,
@@ -33,6 +33,10 @@ DEFINE_XEN_GUEST_HANDLE(gnttab_setup_table_compat_t);
 DEFINE_XEN_GUEST_HANDLE(gnttab_transfer_compat_t);
 DEFINE_XEN_GUEST_HANDLE(gnttab_copy_compat_t);
 
+#define xen_gnttab_copy_sg gnttab_copy_sg
+CHECK_gnttab_copy_sg;
+#undef xen_gnttab_copy_sg
+
 #define xen_gnttab_dump_table gnttab_dump_table
 CHECK_gnttab_dump_table;
 #undef xen_gnttab_dump_table
@@ -54,6 +54,10 @@ CHECK_evtchn_op;
 #undef xen_evtchn_status
 #undef xen_evtchn_unmask
 
+#define xen_evtchn_send_multi evtchn_send_multi
+CHECK_evtchn_send_multi;
+#undef xen_evtchn_send_multi
+
 #define xen_mmu_update mmu_update
 CHECK_mmu_update;
 #undef xen_mmu_update
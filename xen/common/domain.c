@@ -727,7 +727,10 @@ int domain_kill(struct domain *d)
         if ( cpupool_move_domain(d, cpupool0) )
             return -ERESTART;
         for_each_vcpu ( d, v )
+        {
             unmap_vcpu_info(v);
+            unmap_sched_hints(v);
+        }
         d->is_dying = DOMDYING_dead;
         /* Mem event cleanup has to go here because the rings 
          * have to be put before we call put_domain. */
@@ -1169,6 +1172,7 @@ int domain_soft_reset(struct domain *d)
     {
         set_xen_guest_handle(runstate_guest(v), NULL);
         unmap_vcpu_info(v);
+        unmap_sched_hints(v);
     }
 
     rc = arch_domain_soft_reset(d);
@@ -1309,6 +1313,67 @@ void unmap_vcpu_info(struct vcpu *v)
     put_page_and_type(mfn_to_page(mfn));
 }
 
+/*
+ * Map the guest's scheduling hints for @v.  They are read by the scheduler
+ * from any pcpu, so need a global mapping like vcpu_info.
+ */
+int map_sched_hints(struct vcpu *v, unsigned long gfn, unsigned int offset)
+{
+    struct domain *d = v->domain;
+    void *mapping;
+    struct vcpu_sched_hints *hints;
+    struct page_info *page;
+
+    if ( offset > (PAGE_SIZE - sizeof(*hints)) ||
+         (offset & (sizeof(uint32_t) - 1)) )
+        return -EINVAL;
+
+    if ( v->sched_hints )
+        return -EINVAL;
+
+    /* Run this command on yourself or on other offline VCPUS. */
+    if ( (v != current) && !(v->pause_flags & VPF_down) )
+        return -EINVAL;
+
+    page = get_page_from_gfn(d, gfn, NULL, P2M_ALLOC);
+    if ( !page )
+        return -EINVAL;
+
+    if ( !get_page_type(page, PGT_writable_page) )
+    {
+        put_page(page);
+        return -EINVAL;
+    }
+
+    mapping = __map_domain_page_global(page);
+    if ( mapping == NULL )
+    {
+        put_page_and_type(page);
+        return -ENOMEM;
+    }
+
+    hints = mapping + offset;
+    write_atomic(&v->sched_hints, hints);
+
+    return 0;
+}
+
+/* Unmap the scheduling hints.  Used from domain_kill() and soft reset. */
+void unmap_sched_hints(struct vcpu *v)
+{
+    struct vcpu_sched_hints *hints = v->sched_hints;
+    mfn_t mfn;
+
+    if ( !hints )
+        return;
+
+    write_atomic(&v->sched_hints, NULL);
+
+    mfn = domain_page_map_to_mfn(hints);
+    unmap_domain_page_global((void *)((unsigned long)hints & PAGE_MASK));
+    put_page_and_type(mfn_to_page(mfn));
+}
+
 int default_initialise_vcpu(struct vcpu *v, XEN_GUEST_HANDLE_PARAM(void) arg)
 {
     struct vcpu_guest_context *ctxt;
@@ -1481,6 +1546,25 @@ long do_vcpu_op(int cmd, unsigned int vcpuid, XEN_GUEST_HANDLE_PARAM(void) arg)
         break;
     }
 
+    case VCPUOP_register_sched_hints:
+    {
+        struct vcpu_register_sched_hints info;
+
+        rc = -EFAULT;
+        if ( copy_from_guest(&info, arg, 1) )
+            break;
+
+        rc = -EINVAL;
+        if ( info.rsvd )
+            break;
+
+        domain_lock(d);
+        rc = map_sched_hints(v, info.mfn, info.offset);
+        domain_unlock(d);
+
+        break;
+    }
+
     case VCPUOP_register_runstate_memory_area:
     {
         struct vcpu_register_runstate_memory_area area;
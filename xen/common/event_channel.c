@@ -50,6 +50,47 @@
 
 #define consumer_is_xen(e) (!!(e)->xen_consumer)
 
+/*
+ * evtchn_send() does not take the per-channel lock.  Instead it holds the
+ * sending domain's evtchn_send_lock for reading, which costs no more than a
+ * per-CPU store and touches no shared cache line.  Binding an interdomain
+ * or IPI channel publishes the binding before the state (smp_wmb()), and
+ * tearing such a binding down takes evtchn_send_lock for writing on every
+ * domain which could be sending through it, so that no send is in flight
+ * once the channel is freed.
+ */
+static DEFINE_PERCPU_RWLOCK_GLOBAL(evtchn_send_rwlock);
+
+static void evtchn_send_write_lock(struct domain *d)
+{
+    percpu_write_lock(evtchn_send_rwlock, &d->evtchn_send_lock);
+}
+
+static void evtchn_send_write_unlock(struct domain *d)
+{
+    percpu_write_unlock(evtchn_send_rwlock, &d->evtchn_send_lock);
+}
+
+/* As for double_evtchn_lock(), avoid deadlock by locking in address order. */
+static void double_evtchn_send_write_lock(struct domain *d1,
+                                          struct domain *d2)
+{
+    if ( d1 > d2 )
+        SWAP(d1, d2);
+
+    evtchn_send_write_lock(d1);
+    if ( d1 != d2 )
+        evtchn_send_write_lock(d2);
+}
+
+static void double_evtchn_send_write_unlock(struct domain *d1,
+                                            struct domain *d2)
+{
+    evtchn_send_write_unlock(d1);
+    if ( d1 != d2 )
+        evtchn_send_write_unlock(d2);
+}
+
 /*
  * The function alloc_unbound_xen_event_channel() allows an arbitrary
  * notifier function to be specified. However, very few unique functions
@@ -326,11 +367,14 @@ static long evtchn_bind_interdomain(evtchn_bind_interdomain_t *bind)
 
     lchn->u.interdomain.remote_dom  = rd;
     lchn->u.interdomain.remote_port = rport;
-    lchn->state                     = ECS_INTERDOMAIN;
     evtchn_port_init(ld, lchn);
-    
+    /* Pairs with smp_rmb() in evtchn_send(). */
+    smp_wmb();
+    lchn->state                     = ECS_INTERDOMAIN;
+
     rchn->u.interdomain.remote_dom  = ld;
     rchn->u.interdomain.remote_port = lport;
+    smp_wmb();
     rchn->state                     = ECS_INTERDOMAIN;
 
     /*
@@ -435,9 +479,11 @@ static long evtchn_bind_ipi(evtchn_bind_ipi_t *bind)
 
     spin_lock(&chn->lock);
 
-    chn->state          = ECS_IPI;
     chn->notify_vcpu_id = vcpu;
     evtchn_port_init(d, chn);
+    /* Pairs with smp_rmb() in evtchn_send(). */
+    smp_wmb();
+    chn->state          = ECS_IPI;
 
     spin_unlock(&chn->lock);
 
@@ -599,7 +645,12 @@ int evtchn_close(struct domain *d1, int port1, bool guest)
         break;
 
     case ECS_IPI:
-        break;
+        evtchn_send_write_lock(d1);
+        spin_lock(&chn1->lock);
+        evtchn_free(d1, chn1);
+        spin_unlock(&chn1->lock);
+        evtchn_send_write_unlock(d1);
+        goto out;
 
     case ECS_INTERDOMAIN:
         if ( d2 == NULL )
@@ -641,6 +692,7 @@ int evtchn_close(struct domain *d1, int port1, bool guest)
         BUG_ON(chn2->state != ECS_INTERDOMAIN);
         BUG_ON(chn2->u.interdomain.remote_dom != d1);
 
+        double_evtchn_send_write_lock(d1, d2);
         double_evtchn_lock(chn1, chn2);
 
         evtchn_free(d1, chn1);
@@ -649,6 +701,7 @@ int evtchn_close(struct domain *d1, int port1, bool guest)
         chn2->u.unbound.remote_domid = d1->domain_id;
 
         double_evtchn_unlock(chn1, chn2);
+        double_evtchn_send_write_unlock(d1, d2);
 
         goto out;
 
@@ -673,43 +726,86 @@ int evtchn_close(struct domain *d1, int port1, bool guest)
     return rc;
 }
 
-int evtchn_send(struct domain *ld, unsigned int lport)
+/* Number of ports EVTCHNOP_send_multi handles per acquisition of the lock. */
+#define EVTCHN_SEND_BATCH 32
+
+/* Run of events gathered by EVTCHNOP_send_multi for a single vcpu. */
+struct evtchn_send_batch {
+    struct domain *d;
+    unsigned int   vcpu_id;
+    unsigned int   nr;
+    struct evtchn *chns[EVTCHN_SEND_BATCH];
+};
+
+static void evtchn_send_batch_flush(struct evtchn_send_batch *batch)
+{
+    if ( batch->nr )
+        evtchn_port_set_pending_multi(batch->d, batch->vcpu_id,
+                                      batch->chns, batch->nr);
+    batch->nr = 0;
+}
+
+static void evtchn_send_set_pending(struct domain *d, unsigned int vcpu_id,
+                                    struct evtchn *chn,
+                                    struct evtchn_send_batch *batch)
+{
+    if ( !batch )
+    {
+        evtchn_port_set_pending(d, vcpu_id, chn);
+        return;
+    }
+
+    if ( batch->nr &&
+         (batch->d != d || batch->vcpu_id != vcpu_id ||
+          batch->nr == ARRAY_SIZE(batch->chns)) )
+        evtchn_send_batch_flush(batch);
+
+    batch->d = d;
+    batch->vcpu_id = vcpu_id;
+    batch->chns[batch->nr++] = chn;
+}
+
+/*
+ * Called with ld's evtchn_send_lock held for reading.  If batch is non-NULL
+ * guest-bound events are gathered there, and the caller must flush it before
+ * dropping the lock.
+ */
+static int evtchn_send_locked(struct domain *ld, unsigned int lport,
+                              struct evtchn_send_batch *batch)
 {
     struct evtchn *lchn, *rchn;
     struct domain *rd;
-    int            rport, ret = 0;
+    int            rport, ret;
 
     if ( !port_is_valid(ld, lport) )
         return -EINVAL;
 
     lchn = evtchn_from_port(ld, lport);
 
-    spin_lock(&lchn->lock);
-
     /* Guest cannot send via a Xen-attached event channel. */
     if ( unlikely(consumer_is_xen(lchn)) )
-    {
-        ret = -EINVAL;
-        goto out;
-    }
+        return -EINVAL;
 
     ret = xsm_evtchn_send(XSM_HOOK, ld, lchn);
     if ( ret )
-        goto out;
+        return ret;
 
-    switch ( lchn->state )
+    switch ( read_atomic(&lchn->state) )
     {
     case ECS_INTERDOMAIN:
+        /* Pairs with smp_wmb() in evtchn_bind_interdomain(). */
+        smp_rmb();
         rd    = lchn->u.interdomain.remote_dom;
         rport = lchn->u.interdomain.remote_port;
         rchn  = evtchn_from_port(rd, rport);
         if ( consumer_is_xen(rchn) )
             xen_notification_fn(rchn)(rd->vcpu[rchn->notify_vcpu_id], rport);
         else
-            evtchn_port_set_pending(rd, rchn->notify_vcpu_id, rchn);
+            evtchn_send_set_pending(rd, rchn->notify_vcpu_id, rchn, batch);
         break;
     case ECS_IPI:
-        evtchn_port_set_pending(ld, lchn->notify_vcpu_id, lchn);
+        smp_rmb();
+        evtchn_send_set_pending(ld, lchn->notify_vcpu_id, lchn, batch);
         break;
     case ECS_UNBOUND:
         /* silently drop the notification */
@@ -718,12 +814,60 @@ int evtchn_send(struct domain *ld, unsigned int lport)
         ret = -EINVAL;
     }
 
-out:
-    spin_unlock(&lchn->lock);
+    return ret;
+}
+
+int evtchn_send(struct domain *ld, unsigned int lport)
+{
+    int ret;
+
+    percpu_read_lock(evtchn_send_rwlock, &ld->evtchn_send_lock);
+    ret = evtchn_send_locked(ld, lport, NULL);
+    percpu_read_unlock(evtchn_send_rwlock, &ld->evtchn_send_lock);
 
     return ret;
 }
 
+static long evtchn_send_multi(XEN_GUEST_HANDLE_PARAM(void) arg)
+{
+    struct domain *ld = current->domain;
+    struct evtchn_send_multi multi;
+    struct evtchn_send_batch batch = { .nr = 0 };
+    evtchn_port_t ports[EVTCHN_SEND_BATCH];
+    unsigned int i, j, n;
+    unsigned int off = offsetof(struct evtchn_send_multi, ports) /
+                       sizeof(ports[0]);
+    long rc = 0;
+
+    if ( copy_from_guest(&multi, arg, 1) )
+        return -EFAULT;
+
+    if ( multi.nr_ports > EVTCHN_SEND_MULTI_MAX )
+        return -E2BIG;
+
+    for ( i = 0; i < multi.nr_ports; i += n )
+    {
+        n = min_t(unsigned int, multi.nr_ports - i, ARRAY_SIZE(ports));
+        if ( copy_from_guest_offset(ports, arg, off + i, n) )
+            return -EFAULT;
+
+        percpu_read_lock(evtchn_send_rwlock, &ld->evtchn_send_lock);
+
+        for ( j = 0; j < n; j++ )
+        {
+            int ret = evtchn_send_locked(ld, ports[j], &batch);
+
+            if ( ret && !rc )
+                rc = ret;
+        }
+        evtchn_send_batch_flush(&batch);
+
+        percpu_read_unlock(evtchn_send_rwlock, &ld->evtchn_send_lock);
+    }
+
+    return rc;
+}
+
 int guest_enabled_event(struct vcpu *v, uint32_t virq)
 {
     return ((v != NULL) && (v->virq_to_evtchn[virq] != 0));
@@ -1123,6 +1267,10 @@ long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         break;
     }
 
+    case EVTCHNOP_send_multi:
+        rc = evtchn_send_multi(arg);
+        break;
+
     case EVTCHNOP_status: {
         struct evtchn_status status;
         if ( copy_from_guest(&status, arg, 1) != 0 )
@@ -1301,6 +1449,7 @@ int evtchn_init(struct domain *d, unsigned int max_port)
     d->valid_evtchns = EVTCHNS_PER_BUCKET;
 
     spin_lock_init_prof(d, event_lock);
+    percpu_rwlock_resource_init(&d->evtchn_send_lock, evtchn_send_rwlock);
     if ( get_free_port(d) != 0 )
     {
         free_evtchn_bucket(d, d->evtchn);
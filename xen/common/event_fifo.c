@@ -152,6 +152,39 @@ static bool_t evtchn_fifo_set_link(struct domain *d, event_word_t *word,
     return 1;
 }
 
+/*
+ * Append port to the tail of q, which must be locked.  Returns true if the
+ * queue was empty, in which case the caller must set the queue's READY bit.
+ */
+static bool evtchn_fifo_link_tail(struct domain *d,
+                                  struct evtchn_fifo_queue *q,
+                                  evtchn_port_t port)
+{
+    event_word_t *tail_word;
+    bool_t linked = 0;
+
+    /*
+     * Atomically link the tail to port iff the tail is linked.
+     * If the tail is unlinked the queue is empty.
+     *
+     * If port is the same as tail, the queue is empty but q->tail
+     * will appear linked as we just set LINKED above.
+     *
+     * If the queue is empty (i.e., we haven't linked to the new
+     * event), head must be updated.
+     */
+    if ( q->tail )
+    {
+        tail_word = evtchn_fifo_word_from_port(d, q->tail);
+        linked = evtchn_fifo_set_link(d, tail_word, port);
+    }
+    if ( !linked )
+        write_atomic(q->head, port);
+    q->tail = port;
+
+    return !linked;
+}
+
 static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
 {
     struct domain *d = v->domain;
@@ -182,8 +215,7 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
          !guest_test_bit(d, EVTCHN_FIFO_LINKED, word) )
     {
         struct evtchn_fifo_queue *q, *old_q;
-        event_word_t *tail_word;
-        bool_t linked = 0;
+        bool empty;
 
         /*
          * Control block not mapped.  The guest must not unmask an
@@ -232,28 +264,11 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
             spin_lock_irqsave(&q->lock, flags);
         }
 
-        /*
-         * Atomically link the tail to port iff the tail is linked.
-         * If the tail is unlinked the queue is empty.
-         *
-         * If port is the same as tail, the queue is empty but q->tail
-         * will appear linked as we just set LINKED above.
-         *
-         * If the queue is empty (i.e., we haven't linked to the new
-         * event), head must be updated.
-         */
-        if ( q->tail )
-        {
-            tail_word = evtchn_fifo_word_from_port(d, q->tail);
-            linked = evtchn_fifo_set_link(d, tail_word, port);
-        }
-        if ( !linked )
-            write_atomic(q->head, port);
-        q->tail = port;
+        empty = evtchn_fifo_link_tail(d, q, port);
 
         spin_unlock_irqrestore(&q->lock, flags);
 
-        if ( !linked
+        if ( empty
              && !guest_test_and_set_bit(d, q->priority,
                                         &v->evtchn_fifo->control_block->ready) )
             vcpu_mark_events_pending(v);
@@ -263,6 +278,92 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
         evtchn_check_pollers(d, port);
 }
 
+/*
+ * Set a batch of events pending on v.  Consecutive events which are still
+ * on the queue they are being linked onto (i.e. which have not changed vcpu
+ * or priority since they were last linked) are linked under a single
+ * acquisition of the queue lock, and the vcpu is marked as having events
+ * pending at most once.  Anything else takes the evtchn_fifo_set_pending()
+ * path.
+ */
+static void evtchn_fifo_set_pending_multi(struct vcpu *v,
+                                          struct evtchn **evtchns,
+                                          unsigned int nr)
+{
+    struct domain *d = v->domain;
+    struct evtchn_fifo_queue *q = NULL;
+    unsigned long flags = 0, ready = 0, poll = 0;
+    bool mark = false;
+    unsigned int i;
+
+    ASSERT(nr <= BITS_PER_LONG);
+
+    for ( i = 0; i < nr; i++ )
+    {
+        struct evtchn *evtchn = evtchns[i];
+        struct evtchn_fifo_queue *new_q, *old_q;
+        evtchn_port_t port = evtchn->port;
+        event_word_t *word = evtchn_fifo_word_from_port(d, port);
+
+        if ( unlikely(!word) || unlikely(!v->evtchn_fifo->control_block) )
+            goto slow;
+
+        new_q = &v->evtchn_fifo->queue[evtchn->priority];
+        if ( new_q != q )
+        {
+            if ( q )
+                spin_unlock_irqrestore(&q->lock, flags);
+            q = new_q;
+            spin_lock_irqsave(&q->lock, flags);
+        }
+
+        /*
+         * last_vcpu_id and last_priority only change under the lock of the
+         * queue they name, so this is stable while we hold q->lock.
+         */
+        old_q = &d->vcpu[evtchn->last_vcpu_id]->evtchn_fifo->queue[
+            evtchn->last_priority];
+        if ( old_q != q )
+            goto slow;
+
+        if ( !guest_test_and_set_bit(d, EVTCHN_FIFO_PENDING, word) )
+            __set_bit(i, &poll);
+
+        if ( guest_test_bit(d, EVTCHN_FIFO_MASKED, word) ||
+             guest_test_and_set_bit(d, EVTCHN_FIFO_LINKED, word) )
+            continue;
+
+        /* See evtchn_fifo_set_pending(). */
+        if ( q->tail == port )
+            q->tail = 0;
+
+        if ( evtchn_fifo_link_tail(d, q, port) )
+            __set_bit(q->priority, &ready);
+        continue;
+
+    slow:
+        if ( q )
+        {
+            spin_unlock_irqrestore(&q->lock, flags);
+            q = NULL;
+        }
+        evtchn_fifo_set_pending(v, evtchn);
+    }
+
+    if ( q )
+        spin_unlock_irqrestore(&q->lock, flags);
+
+    for_each_set_bit ( i, &ready, EVTCHN_FIFO_MAX_QUEUES )
+        if ( !guest_test_and_set_bit(d, i,
+                                     &v->evtchn_fifo->control_block->ready) )
+            mark = true;
+    if ( mark )
+        vcpu_mark_events_pending(v);
+
+    for_each_set_bit ( i, &poll, nr )
+        evtchn_check_pollers(d, evtchns[i]->port);
+}
+
 static void evtchn_fifo_clear_pending(struct domain *d, struct evtchn *evtchn)
 {
     event_word_t *word;
@@ -352,6 +453,7 @@ static const struct evtchn_port_ops evtchn_port_ops_fifo =
 {
     .init          = evtchn_fifo_init,
     .set_pending   = evtchn_fifo_set_pending,
+    .set_pending_multi = evtchn_fifo_set_pending_multi,
     .clear_pending = evtchn_fifo_clear_pending,
     .unmask        = evtchn_fifo_unmask,
     .is_pending    = evtchn_fifo_is_pending,
@@ -43,6 +43,8 @@
 #include <asm/flushtlb.h>
 #include <asm/guest_atomics.h>
 
+#define GNTTAB_PERSISTENT_BUCKETS 64
+
 /* Per-domain grant information. */
 struct grant_table {
     /*
@@ -78,6 +80,12 @@ struct grant_table {
     struct active_grant_entry **active;
     /* Mapping tracking table per vcpu. */
     struct grant_mapping **maptrack;
+    /* Lock protecting the persistent mapping hash. */
+    spinlock_t            persistent_lock;
+    /* Persistent mappings of foreign grants, hashed by grant reference. */
+    struct list_head      persistent[GNTTAB_PERSISTENT_BUCKETS];
+    /* Number of entries in the persistent mapping hash. */
+    unsigned int          nr_persistent;
 
     /* Domain to which this struct grant_table belongs. */
     const struct domain *domain;
@@ -218,7 +226,7 @@ struct gnttab_unmap_common {
  */
 struct grant_mapping {
     grant_ref_t ref;        /* grant ref */
-    uint16_t flags;         /* 0-4: GNTMAP_* ; 5-15: unused */
+    uint16_t flags;         /* 0-4,6: GNTMAP_* ; 5,7-15: unused */
     domid_t  domid;         /* granting domain */
     uint32_t vcpu;          /* vcpu which created the grant mapping */
     uint32_t pad;           /* round size to a power of 2 */
@@ -673,6 +681,175 @@ get_maptrack_handle(
     return handle;
 }
 
+/*
+ * Tracks a mapping established with GNTMAP_persistent.  Identical map
+ * requests (same granting domain, grant reference, flags and address) take
+ * a reference on the existing mapping instead of creating a new one, and
+ * unmaps only drop that reference until the last one goes away.  Backends
+ * can thus keep a frontend's grants mapped for the lifetime of a ring
+ * without any maptrack or TLB flush activity on the per-request path.
+ */
+struct grant_persistent {
+    struct list_head list;
+    uint64_t host_addr;
+    mfn_t mfn;
+    grant_handle_t handle;
+    grant_ref_t ref;
+    domid_t domid;
+    uint32_t flags;
+    unsigned int count;
+};
+
+#define persistent_bucket(t, r) \
+    (&(t)->persistent[(r) % GNTTAB_PERSISTENT_BUCKETS])
+
+/* Caller must hold t->persistent_lock. */
+static struct grant_persistent *
+persistent_find(struct grant_table *t, domid_t domid, grant_ref_t ref,
+                unsigned int flags, uint64_t host_addr)
+{
+    struct grant_persistent *p;
+
+    list_for_each_entry ( p, persistent_bucket(t, ref), list )
+        if ( p->ref == ref && p->domid == domid && p->flags == flags &&
+             p->host_addr == host_addr )
+            return p;
+
+    return NULL;
+}
+
+/*
+ * Try to satisfy a GNTMAP_persistent map request from an existing mapping.
+ * Returns true if op has been completed.  Mappings of a dying domain's
+ * grants are no longer handed out, so that the backend is forced to drop
+ * them and the granting domain can be torn down.
+ */
+static bool persistent_map_get(struct grant_table *lgt,
+                               const struct domain *rd,
+                               struct gnttab_map_grant_ref *op)
+{
+    struct grant_persistent *p;
+    bool done = false;
+
+    spin_lock(&lgt->persistent_lock);
+
+    p = persistent_find(lgt, rd->domain_id, op->ref, op->flags, op->host_addr);
+    if ( !p )
+        goto out;
+
+    if ( unlikely(rd->is_dying) )
+        op->status = GNTST_bad_domain;
+    else if ( unlikely(p->count == UINT_MAX) )
+        op->status = GNTST_general_error;
+    else
+    {
+        p->count++;
+        op->handle = p->handle;
+        op->dev_bus_addr = mfn_to_maddr(p->mfn);
+        op->status = GNTST_okay;
+    }
+    done = true;
+
+ out:
+    spin_unlock(&lgt->persistent_lock);
+
+    return done;
+}
+
+/*
+ * Record a freshly created mapping as persistent.  Returns false if it
+ * cannot be tracked (out of memory, or a racing identical request won), in
+ * which case the caller turns it into an ordinary mapping.
+ */
+static bool persistent_map_add(struct grant_table *lgt,
+                               const struct gnttab_map_grant_ref *op,
+                               grant_handle_t handle, mfn_t mfn)
+{
+    struct grant_persistent *p = xmalloc(struct grant_persistent);
+    bool added = false;
+
+    if ( !p )
+        return false;
+
+    p->host_addr = op->host_addr;
+    p->mfn = mfn;
+    p->handle = handle;
+    p->ref = op->ref;
+    p->domid = op->dom;
+    p->flags = op->flags;
+    p->count = 1;
+
+    spin_lock(&lgt->persistent_lock);
+    if ( !persistent_find(lgt, op->dom, op->ref, op->flags, op->host_addr) )
+    {
+        list_add(&p->list, persistent_bucket(lgt, op->ref));
+        lgt->nr_persistent++;
+        added = true;
+    }
+    spin_unlock(&lgt->persistent_lock);
+
+    if ( !added )
+        xfree(p);
+
+    return added;
+}
+
+/*
+ * Drop a reference on the persistent mapping tracked by handle.  Returns a
+ * positive value if other references remain, i.e. the mapping must be left
+ * in place, zero if the caller is to tear the mapping down, or a GNTST_*
+ * error code.
+ */
+static int persistent_map_put(struct grant_table *lgt, grant_ref_t ref,
+                              grant_handle_t handle, uint64_t host_addr)
+{
+    struct grant_persistent *p;
+    int rc = 0;
+
+    spin_lock(&lgt->persistent_lock);
+
+    list_for_each_entry ( p, persistent_bucket(lgt, ref), list )
+    {
+        if ( p->handle != handle )
+            continue;
+
+        if ( host_addr && host_addr != p->host_addr )
+            rc = GNTST_general_error;
+        else if ( p->count > 1 )
+        {
+            p->count--;
+            rc = 1;
+        }
+        else
+        {
+            list_del(&p->list);
+            lgt->nr_persistent--;
+            xfree(p);
+        }
+        break;
+    }
+
+    spin_unlock(&lgt->persistent_lock);
+
+    return rc;
+}
+
+static void persistent_map_flush(struct grant_table *gt)
+{
+    struct grant_persistent *p, *tmp;
+    unsigned int i;
+
+    spin_lock(&gt->persistent_lock);
+    for ( i = 0; i < GNTTAB_PERSISTENT_BUCKETS; i++ )
+        list_for_each_entry_safe ( p, tmp, &gt->persistent[i], list )
+        {
+            list_del(&p->list);
+            xfree(p);
+        }
+    gt->nr_persistent = 0;
+    spin_unlock(&gt->persistent_lock);
+}
+
 /* Number of grant table entries. Caller must hold d's grant table lock. */
 static unsigned int nr_grant_entries(struct grant_table *gt)
 {
@@ -990,6 +1167,13 @@ map_grant_ref(
     }
 
     lgt = ld->grant_table;
+
+    if ( (op->flags & GNTMAP_persistent) && persistent_map_get(lgt, rd, op) )
+    {
+        rcu_unlock_domain(rd);
+        return;
+    }
+
     handle = get_maptrack_handle(lgt);
     if ( unlikely(handle == INVALID_MAPTRACK_HANDLE) )
     {
@@ -1209,6 +1393,11 @@ map_grant_ref(
     smp_wmb();
     write_atomic(&mt->flags, op->flags);
 
+    /* Fall back to an ordinary mapping if it can't be tracked. */
+    if ( (op->flags & GNTMAP_persistent) &&
+         !persistent_map_add(lgt, op, handle, mfn) )
+        write_atomic(&mt->flags, op->flags & ~GNTMAP_persistent);
+
     if ( need_iommu )
         double_gt_unlock(lgt, rgt);
 
@@ -1300,7 +1489,7 @@ unmap_common(
     s16              rc = 0;
     struct grant_mapping *map;
     unsigned int flags;
-    bool put_handle = false;
+    bool put_handle = false, retained = false;
 
     ld = current->domain;
     lgt = ld->grant_table;
@@ -1399,6 +1588,29 @@ unmap_common(
                  "Bus address doesn't match gntref (%"PRIx64" != %"PRIpaddr")\n",
                  op->dev_bus_addr, mfn_to_maddr(act->mfn));
 
+    /*
+     * Unmapping a persistent mapping may just drop a reference.  Replacing
+     * one is refused: other users may still hold references to it, and the
+     * tracking entry would be left behind pointing at a stale handle.
+     */
+    if ( flags & GNTMAP_persistent )
+    {
+        int prc;
+
+        if ( op->new_addr )
+            PIN_FAIL(act_release_out, GNTST_general_error,
+                     "Cannot replace persistent mapping %#x\n", op->handle);
+
+        prc = persistent_map_put(lgt, ref, op->handle, op->host_addr);
+
+        if ( prc )
+        {
+            rc = prc < 0 ? prc : GNTST_okay;
+            retained = true;
+            goto act_release_out;
+        }
+    }
+
     if ( op->host_addr && (flags & GNTMAP_host_map) )
     {
         if ( (rc = replace_grant_host_mapping(op->host_addr,
@@ -1430,7 +1642,7 @@ unmap_common(
     if ( put_handle )
         put_maptrack_handle(lgt, op->handle);
 
-    if ( rc == GNTST_okay && gnttab_need_iommu_mapping(ld) )
+    if ( rc == GNTST_okay && !retained && gnttab_need_iommu_mapping(ld) )
     {
         unsigned int kind;
         int err = 0;
@@ -1569,11 +1781,13 @@ gnttab_unmap_grant_ref(
     int i, c, partial_done, done = 0;
     struct gnttab_unmap_grant_ref op;
     struct gnttab_unmap_common common[GNTTAB_UNMAP_BATCH_SIZE];
+    bool need_flush;
 
     while ( count != 0 )
     {
         c = min(count, (unsigned int)GNTTAB_UNMAP_BATCH_SIZE);
         partial_done = 0;
+        need_flush = false;
 
         for ( i = 0; i < c; i++ )
         {
@@ -1581,12 +1795,18 @@ gnttab_unmap_grant_ref(
                 goto fault;
             unmap_grant_ref(&op, &common[i]);
             ++partial_done;
+            need_flush |= common[i].done;
             if ( unlikely(__copy_field_to_guest(uop, &op, status)) )
                 goto fault;
             guest_handle_add_offset(uop, 1);
         }
 
-        gnttab_flush_tlb(current->domain);
+        /*
+         * A batch which only dropped references to persistent mappings
+         * hasn't changed any translations, so doesn't need a flush.
+         */
+        if ( need_flush )
+            gnttab_flush_tlb(current->domain);
 
         for ( i = 0; i < partial_done; i++ )
             unmap_common_complete(&common[i]);
@@ -1856,6 +2076,7 @@ int grant_table_init(struct domain *d, int max_grant_frames,
                      int max_maptrack_frames)
 {
     struct grant_table *gt;
+    unsigned int i;
     int ret = -ENOMEM;
 
     /* Default to maximum value if no value was specified */
@@ -1875,6 +2096,9 @@ int grant_table_init(struct domain *d, int max_grant_frames,
     /* Simple stuff. */
     percpu_rwlock_resource_init(&gt->lock, grant_rwlock);
     spin_lock_init(&gt->maptrack_lock);
+    spin_lock_init(&gt->persistent_lock);
+    for ( i = 0; i < GNTTAB_PERSISTENT_BUCKETS; i++ )
+        INIT_LIST_HEAD(&gt->persistent[i]);
 
     gt->gt_version = 1;
     gt->max_grant_frames = max_grant_frames;
@@ -2733,100 +2957,129 @@ struct gnttab_copy_buf {
     bool_t have_type;
 };
 
-static int gnttab_copy_lock_domain(domid_t domid, bool is_gref,
-                                   struct gnttab_copy_buf *buf)
-{
-    /* Only DOMID_SELF may reference via frame. */
-    if ( domid != DOMID_SELF && !is_gref )
-        return GNTST_permission_denied;
+/*
+ * Number of source and of destination frames kept mapped across the ops of
+ * a single copy hypercall.  Backends typically issue many small copies
+ * hitting the same few frames (e.g. several packet fragments into one
+ * page), which would otherwise be claimed, mapped and released each time.
+ */
+#define GNTTAB_COPY_CACHE_SLOTS 4
 
-    buf->domain = rcu_lock_domain_by_any_id(domid);
+struct gnttab_copy_cache {
+    /* Domains all cached buffers belong to, locked for as long as cached. */
+    struct domain *src_domain, *dest_domain;
+    domid_t src_domid, dest_domid;
 
-    if ( !buf->domain )
-        return GNTST_bad_domain;
+    struct gnttab_copy_buf src[GNTTAB_COPY_CACHE_SLOTS];
+    struct gnttab_copy_buf dest[GNTTAB_COPY_CACHE_SLOTS];
 
-    buf->ptr.domid = domid;
+    /* Slot to be recycled on the next miss. */
+    unsigned int src_next, dest_next;
+};
 
-    return GNTST_okay;
+static void gnttab_copy_release_buf(struct gnttab_copy_buf *buf)
+{
+    if ( buf->virt )
+    {
+        unmap_domain_page(buf->virt);
+        buf->virt = NULL;
+    }
+    if ( buf->have_grant )
+    {
+        release_grant_for_copy(buf->domain, buf->ptr.u.ref, buf->read_only);
+        buf->have_grant = 0;
+    }
+    if ( buf->have_type )
+    {
+        put_page_type(buf->page);
+        buf->have_type = 0;
+    }
+    if ( buf->page )
+    {
+        put_page(buf->page);
+        buf->page = NULL;
+    }
+}
+
+static void gnttab_copy_release_cache(struct gnttab_copy_cache *cache)
+{
+    unsigned int i;
+
+    for ( i = 0; i < GNTTAB_COPY_CACHE_SLOTS; i++ )
+    {
+        gnttab_copy_release_buf(&cache->src[i]);
+        gnttab_copy_release_buf(&cache->dest[i]);
+    }
 }
 
-static void gnttab_copy_unlock_domains(struct gnttab_copy_buf *src,
-                                       struct gnttab_copy_buf *dest)
+static void gnttab_copy_unlock_domains(struct gnttab_copy_cache *cache)
 {
-    if ( src->domain )
+    gnttab_copy_release_cache(cache);
+
+    if ( cache->src_domain )
     {
-        rcu_unlock_domain(src->domain);
-        src->domain = NULL;
+        rcu_unlock_domain(cache->src_domain);
+        cache->src_domain = NULL;
     }
-    if ( dest->domain )
+    if ( cache->dest_domain )
     {
-        rcu_unlock_domain(dest->domain);
-        dest->domain = NULL;
+        rcu_unlock_domain(cache->dest_domain);
+        cache->dest_domain = NULL;
     }
 }
 
-static int gnttab_copy_lock_domains(const struct gnttab_copy *op,
-                                    struct gnttab_copy_buf *src,
-                                    struct gnttab_copy_buf *dest)
+static int gnttab_copy_lock_domains(domid_t src_domid, domid_t dest_domid,
+                                    struct gnttab_copy_cache *cache)
 {
     int rc;
 
-    rc = gnttab_copy_lock_domain(op->source.domid,
-                                 op->flags & GNTCOPY_source_gref, src);
-    if ( rc < 0 )
+    if ( cache->src_domain && src_domid == cache->src_domid &&
+         cache->dest_domain && dest_domid == cache->dest_domid )
+        return GNTST_okay;
+
+    gnttab_copy_unlock_domains(cache);
+
+    cache->src_domain = rcu_lock_domain_by_any_id(src_domid);
+    if ( !cache->src_domain )
+    {
+        rc = GNTST_bad_domain;
         goto error;
-    rc = gnttab_copy_lock_domain(op->dest.domid,
-                                 op->flags & GNTCOPY_dest_gref, dest);
-    if ( rc < 0 )
+    }
+    cache->src_domid = src_domid;
+
+    cache->dest_domain = rcu_lock_domain_by_any_id(dest_domid);
+    if ( !cache->dest_domain )
+    {
+        rc = GNTST_bad_domain;
         goto error;
+    }
+    cache->dest_domid = dest_domid;
 
-    rc = xsm_grant_copy(XSM_HOOK, src->domain, dest->domain);
+    rc = xsm_grant_copy(XSM_HOOK, cache->src_domain, cache->dest_domain);
     if ( rc < 0 )
     {
         rc = GNTST_permission_denied;
         goto error;
     }
-    return 0;
+    return GNTST_okay;
 
  error:
-    gnttab_copy_unlock_domains(src, dest);
+    gnttab_copy_unlock_domains(cache);
     return rc;
 }
 
-static void gnttab_copy_release_buf(struct gnttab_copy_buf *buf)
-{
-    if ( buf->virt )
-    {
-        unmap_domain_page(buf->virt);
-        buf->virt = NULL;
-    }
-    if ( buf->have_grant )
-    {
-        release_grant_for_copy(buf->domain, buf->ptr.u.ref, buf->read_only);
-        buf->have_grant = 0;
-    }
-    if ( buf->have_type )
-    {
-        put_page_type(buf->page);
-        buf->have_type = 0;
-    }
-    if ( buf->page )
-    {
-        put_page(buf->page);
-        buf->page = NULL;
-    }
-}
-
-static int gnttab_copy_claim_buf(const struct gnttab_copy *op,
-                                 const struct gnttab_copy_ptr *ptr,
-                                 struct gnttab_copy_buf *buf,
-                                 unsigned int gref_flag)
+static int gnttab_copy_claim_buf(const struct gnttab_copy_ptr *ptr,
+                                 bool is_gref, bool read_only,
+                                 struct domain *d,
+                                 struct gnttab_copy_buf *buf)
 {
     int rc;
 
-    buf->read_only = gref_flag == GNTCOPY_source_gref;
+    buf->domain = d;
+    buf->ptr.domid = ptr->domid;
+    buf->read_only = read_only;
 
-    if ( op->flags & gref_flag )
+    if ( is_gref )
     {
         rc = acquire_grant_for_copy(buf->domain, ptr->u.ref,
                                     current->domain->domain_id,
@@ -2881,38 +3134,106 @@ static bool_t gnttab_copy_buf_valid(const struct gnttab_copy_ptr *p,
         return 0;
     if ( has_gref )
         return b->have_grant && p->u.ref == b->ptr.u.ref;
-    return p->u.gmfn == b->ptr.u.gmfn;
+    return !b->have_grant && p->u.gmfn == b->ptr.u.gmfn;
+}
+
+/*
+ * Look up the frame referenced by ptr in the cache, claiming and mapping it
+ * into the least recently claimed slot if it isn't there yet.  Returns NULL
+ * with *rc set on failure.
+ */
+static struct gnttab_copy_buf *gnttab_copy_get_buf(
+    struct gnttab_copy_cache *cache, const struct gnttab_copy_ptr *ptr,
+    bool is_gref, bool is_dest, int *rc)
+{
+    struct gnttab_copy_buf *bufs = is_dest ? cache->dest : cache->src;
+    unsigned int *next = is_dest ? &cache->dest_next : &cache->src_next;
+    struct gnttab_copy_buf *buf;
+    unsigned int i;
+
+    /* Only DOMID_SELF may reference via frame. */
+    if ( !is_gref && ptr->domid != DOMID_SELF )
+    {
+        *rc = GNTST_permission_denied;
+        return NULL;
+    }
+
+    for ( i = 0; i < GNTTAB_COPY_CACHE_SLOTS; i++ )
+        if ( gnttab_copy_buf_valid(ptr, &bufs[i], is_gref) )
+            return &bufs[i];
+
+    buf = &bufs[*next];
+    *next = (*next + 1) % GNTTAB_COPY_CACHE_SLOTS;
+
+    gnttab_copy_release_buf(buf);
+    *rc = gnttab_copy_claim_buf(ptr, is_gref, !is_dest,
+                                is_dest ? cache->dest_domain
+                                        : cache->src_domain, buf);
+    if ( *rc != GNTST_okay )
+    {
+        gnttab_copy_release_buf(buf);
+        return NULL;
+    }
+
+    return buf;
+}
+
+/*
+ * Copies issued by backends are mostly well below a page (packet headers,
+ * small fragments), for which the setup cost of the string instructions
+ * dominates.  Cover those with at most two (possibly overlapping) fixed
+ * size moves, which the compiler emits as plain loads and stores.
+ */
+static void gnttab_memcpy(void *dst, const void *src, unsigned int len)
+{
+#define COPY_PAIR(sz) ({                                  \
+    memcpy(dst, src, sz);                                 \
+    memcpy(dst + len - (sz), src + len - (sz), sz);       \
+})
+    if ( len > 64 )
+        memcpy(dst, src, len);
+    else if ( len >= 32 )
+        COPY_PAIR(32);
+    else if ( len >= 16 )
+        COPY_PAIR(16);
+    else if ( len >= 8 )
+        COPY_PAIR(8);
+    else if ( len >= 4 )
+        COPY_PAIR(4);
+    else if ( len )
+    {
+        *(uint8_t *)dst = *(const uint8_t *)src;
+        if ( len > 1 )
+            COPY_PAIR(2);
+    }
+#undef COPY_PAIR
 }
 
-static int gnttab_copy_buf(const struct gnttab_copy *op,
-                           struct gnttab_copy_buf *dest,
-                           const struct gnttab_copy_buf *src)
+static int gnttab_copy_buf(struct gnttab_copy_buf *dest, unsigned int dest_off,
+                           const struct gnttab_copy_buf *src,
+                           unsigned int src_off, unsigned int len)
 {
     int rc;
 
-    if ( ((op->source.offset + op->len) > PAGE_SIZE) ||
-         ((op->dest.offset + op->len) > PAGE_SIZE) )
+    if ( ((src_off + len) > PAGE_SIZE) || ((dest_off + len) > PAGE_SIZE) )
         PIN_FAIL(out, GNTST_bad_copy_arg, "copy beyond page area\n");
 
-    if ( op->source.offset < src->ptr.offset ||
-         op->source.offset + op->len > src->ptr.offset + src->len )
+    if ( src_off < src->ptr.offset ||
+         src_off + len > src->ptr.offset + src->len )
         PIN_FAIL(out, GNTST_general_error,
                  "copy source out of bounds: %d < %d || %d > %d\n",
-                 op->source.offset, src->ptr.offset,
-                 op->len, src->len);
+                 src_off, src->ptr.offset, len, src->len);
 
-    if ( op->dest.offset < dest->ptr.offset ||
-         op->dest.offset + op->len > dest->ptr.offset + dest->len )
+    if ( dest_off < dest->ptr.offset ||
+         dest_off + len > dest->ptr.offset + dest->len )
         PIN_FAIL(out, GNTST_general_error,
                  "copy dest out of bounds: %d < %d || %d > %d\n",
-                 op->dest.offset, dest->ptr.offset,
-                 op->len, dest->len);
+                 dest_off, dest->ptr.offset, len, dest->len);
 
     /* Make sure the above checks are not bypassed speculatively */
     block_speculation();
 
-    memcpy(dest->virt + op->dest.offset, src->virt + op->source.offset,
-           op->len);
+    gnttab_memcpy(dest->virt + dest_off, src->virt + src_off, len);
     gnttab_mark_dirty(dest->domain, dest->mfn);
     rc = GNTST_okay;
  out:
@@ -2920,46 +3241,27 @@ static int gnttab_copy_buf(const struct gnttab_copy *op,
 }
 
 static int gnttab_copy_one(const struct gnttab_copy *op,
-                           struct gnttab_copy_buf *dest,
-                           struct gnttab_copy_buf *src)
+                           struct gnttab_copy_cache *cache)
 {
+    struct gnttab_copy_buf *src, *dest;
     int rc;
 
-    if ( !src->domain || op->source.domid != src->ptr.domid ||
-         !dest->domain || op->dest.domid != dest->ptr.domid )
-    {
-        gnttab_copy_release_buf(src);
-        gnttab_copy_release_buf(dest);
-        gnttab_copy_unlock_domains(src, dest);
-
-        rc = gnttab_copy_lock_domains(op, src, dest);
-        if ( rc < 0 )
-            goto out;
-    }
+    rc = gnttab_copy_lock_domains(op->source.domid, op->dest.domid, cache);
+    if ( rc < 0 )
+        return rc;
 
-    /* Different source? */
-    if ( !gnttab_copy_buf_valid(&op->source, src,
-                                op->flags & GNTCOPY_source_gref) )
-    {
-        gnttab_copy_release_buf(src);
-        rc = gnttab_copy_claim_buf(op, &op->source, src, GNTCOPY_source_gref);
-        if ( rc )
-            goto out;
-    }
+    src = gnttab_copy_get_buf(cache, &op->source,
+                              op->flags & GNTCOPY_source_gref, false, &rc);
+    if ( !src )
+        return rc;
 
-    /* Different dest? */
-    if ( !gnttab_copy_buf_valid(&op->dest, dest,
-                                op->flags & GNTCOPY_dest_gref) )
-    {
-        gnttab_copy_release_buf(dest);
-        rc = gnttab_copy_claim_buf(op, &op->dest, dest, GNTCOPY_dest_gref);
-        if ( rc )
-            goto out;
-    }
+    dest = gnttab_copy_get_buf(cache, &op->dest,
+                               op->flags & GNTCOPY_dest_gref, true, &rc);
+    if ( !dest )
+        return rc;
 
-    rc = gnttab_copy_buf(op, dest, src);
- out:
-    return rc;
+    return gnttab_copy_buf(dest, op->dest.offset, src, op->source.offset,
+                           op->len);
 }
 
 /*
@@ -2975,8 +3277,7 @@ static long gnttab_copy(
 {
     unsigned int i;
     struct gnttab_copy op;
-    struct gnttab_copy_buf src = {};
-    struct gnttab_copy_buf dest = {};
+    struct gnttab_copy_cache cache = {};
     long rc = 0;
 
     for ( i = 0; i < count; i++ )
@@ -2993,17 +3294,14 @@ static long gnttab_copy(
             break;
         }
 
-        rc = gnttab_copy_one(&op, &dest, &src);
+        rc = gnttab_copy_one(&op, &cache);
         if ( rc > 0 )
         {
             rc = count - i;
             break;
         }
         if ( rc != GNTST_okay )
-        {
-            gnttab_copy_release_buf(&src);
-            gnttab_copy_release_buf(&dest);
-        }
+            gnttab_copy_release_cache(&cache);
 
         op.status = rc;
         rc = 0;
@@ -3015,9 +3313,208 @@ static long gnttab_copy(
         guest_handle_add_offset(uop, 1);
     }
 
-    gnttab_copy_release_buf(&src);
-    gnttab_copy_release_buf(&dest);
-    gnttab_copy_unlock_domains(&src, &dest);
+    gnttab_copy_unlock_domains(&cache);
+
+    return rc;
+}
+
+static void gnttab_copy_sg_ptr(const struct gnttab_copy_sg *seg,
+                               struct gnttab_copy_ptr *ptr)
+{
+    if ( seg->flags & GNTCOPY_sg_gref )
+        ptr->u.ref = seg->u.ref;
+    else
+        ptr->u.gmfn = seg->u.gmfn;
+    ptr->domid = seg->domid;
+}
+
+/* Perform the copy described by one scatter-gather chain. */
+static int gnttab_copy_sg_chain(const struct gnttab_copy_sg *segs,
+                                unsigned int nr, struct gnttab_copy_cache *cache)
+{
+    unsigned int i, s = nr, d = nr, s_done = 0, d_done = 0;
+    unsigned int src_len = 0, dest_len = 0;
+    domid_t src_domid = DOMID_INVALID, dest_domid = DOMID_INVALID;
+    int rc;
+
+    for ( i = 0; i < nr; i++ )
+    {
+        domid_t *domid = segs[i].flags & GNTCOPY_sg_dest ? &dest_domid
+                                                          : &src_domid;
+
+        if ( segs[i].flags & ~(GNTCOPY_sg_gref | GNTCOPY_sg_dest |
+                               GNTCOPY_sg_last) )
+            return GNTST_general_error;
+        if ( segs[i].offset + segs[i].len > PAGE_SIZE )
+            return GNTST_bad_copy_arg;
+        if ( *domid != DOMID_INVALID && *domid != segs[i].domid )
+            return GNTST_bad_copy_arg;
+        *domid = segs[i].domid;
+
+        if ( segs[i].flags & GNTCOPY_sg_dest )
+        {
+            dest_len += segs[i].len;
+            d = min(d, i);
+        }
+        else
+        {
+            src_len += segs[i].len;
+            s = min(s, i);
+        }
+    }
+
+    if ( src_len != dest_len )
+        return GNTST_bad_copy_arg;
+    if ( !src_len )
+        return GNTST_okay;
+
+    rc = gnttab_copy_lock_domains(src_domid, dest_domid, cache);
+    if ( rc < 0 )
+        return rc;
+
+    /* Walk both segment lists in parallel, copying the overlapping parts. */
+    while ( src_len )
+    {
+        struct gnttab_copy_ptr ptr;
+        struct gnttab_copy_buf *src, *dest;
+        unsigned int len;
+
+        while ( s_done == segs[s].len || (segs[s].flags & GNTCOPY_sg_dest) )
+        {
+            s++;
+            s_done = 0;
+        }
+        while ( d_done == segs[d].len || !(segs[d].flags & GNTCOPY_sg_dest) )
+        {
+            d++;
+            d_done = 0;
+        }
+
+        gnttab_copy_sg_ptr(&segs[s], &ptr);
+        src = gnttab_copy_get_buf(cache, &ptr, segs[s].flags & GNTCOPY_sg_gref,
+                                  false, &rc);
+        if ( !src )
+            return rc;
+
+        gnttab_copy_sg_ptr(&segs[d], &ptr);
+        dest = gnttab_copy_get_buf(cache, &ptr, segs[d].flags & GNTCOPY_sg_gref,
+                                   true, &rc);
+        if ( !dest )
+            return rc;
+
+        len = min(segs[s].len - s_done, segs[d].len - d_done);
+        rc = gnttab_copy_buf(dest, segs[d].offset + d_done,
+                             src, segs[s].offset + s_done, len);
+        if ( rc != GNTST_okay )
+            return rc;
+
+        s_done += len;
+        d_done += len;
+        src_len -= len;
+    }
+
+    return GNTST_okay;
+}
+
+/*
+ * Continuation argument of GNTTABOP_copy_sg: the op was preempted while
+ * failing the segments of a chain longer than GNTTAB_COPY_SG_MAX_SEGS.
+ */
+#define GNTTAB_COPY_SG_OVERSIZED (1U << GNTTABOP_CONTINUATION_ARG_SHIFT)
+
+/*
+ * Like gnttab_copy(), returns "count - i" when preempted.  *opaque carries
+ * GNTTAB_COPY_SG_OVERSIZED across continuations.
+ */
+static long gnttab_copy_sg(
+    XEN_GUEST_HANDLE_PARAM(gnttab_copy_sg_t) uop, unsigned int *opaque,
+    unsigned int count)
+{
+    struct gnttab_copy_sg segs[GNTTAB_COPY_SG_MAX_SEGS];
+    struct gnttab_copy_cache cache = {};
+    unsigned int i = 0, j, nr;
+    long rc = 0;
+
+    if ( *opaque & ~GNTTAB_COPY_SG_OVERSIZED )
+        return -EINVAL;
+
+    while ( i < count )
+    {
+        if ( i && hypercall_preempt_check() )
+        {
+            rc = count - i;
+            break;
+        }
+
+        /* Fail the rest of an oversized chain, up to its last segment. */
+        if ( *opaque )
+        {
+            if ( unlikely(__copy_from_guest_offset(&segs[0], uop, i, 1)) )
+            {
+                rc = -EFAULT;
+                goto out;
+            }
+            segs[0].status = GNTST_bad_copy_arg;
+            if ( unlikely(__copy_to_guest_offset(uop, i, &segs[0], 1)) )
+            {
+                rc = -EFAULT;
+                goto out;
+            }
+            if ( segs[0].flags & GNTCOPY_sg_last )
+                *opaque = 0;
+            i++;
+            continue;
+        }
+
+        for ( nr = 0; i + nr < count && nr < ARRAY_SIZE(segs); )
+        {
+            if ( unlikely(__copy_from_guest_offset(&segs[nr], uop, i + nr,
+                                                   1)) )
+            {
+                rc = -EFAULT;
+                goto out;
+            }
+            if ( segs[nr++].flags & GNTCOPY_sg_last )
+                break;
+        }
+
+        if ( !(segs[nr - 1].flags & GNTCOPY_sg_last) )
+        {
+            rc = GNTST_bad_copy_arg;
+            if ( nr == ARRAY_SIZE(segs) )
+                *opaque = GNTTAB_COPY_SG_OVERSIZED;
+        }
+        else
+            rc = gnttab_copy_sg_chain(segs, nr, &cache);
+
+        /* Restart the whole chain. */
+        if ( rc > 0 )
+        {
+            rc = count - i;
+            break;
+        }
+        if ( rc != GNTST_okay )
+            gnttab_copy_release_cache(&cache);
+
+        for ( j = 0; j < nr; j++ )
+        {
+            segs[j].status = rc;
+            if ( unlikely(__copy_to_guest_offset(uop, i + j, &segs[j], 1)) )
+            {
+                rc = -EFAULT;
+                goto out;
+            }
+        }
+        i += nr;
+        rc = 0;
+    }
+
+ out:
+    gnttab_copy_unlock_domains(&cache);
+
+    /* Nothing to carry on with, be it because of an error or the end. */
+    if ( rc <= 0 )
+        *opaque = 0;
 
     return rc;
 }
@@ -3490,7 +3987,8 @@ do_grant_table_op(
     if ( (int)count < 0 )
         return -EINVAL;
 
-    if ( (cmd &= GNTTABOP_CMD_MASK) != GNTTABOP_cache_flush && opaque_in )
+    if ( (cmd &= GNTTABOP_CMD_MASK) != GNTTABOP_cache_flush &&
+         cmd != GNTTABOP_copy_sg && opaque_in )
         return -EINVAL;
 
     rc = -EFAULT;
@@ -3583,6 +4081,24 @@ do_grant_table_op(
         break;
     }
 
+    case GNTTABOP_copy_sg:
+    {
+        XEN_GUEST_HANDLE_PARAM(gnttab_copy_sg_t) copy =
+            guest_handle_cast(uop, gnttab_copy_sg_t);
+
+        if ( unlikely(!guest_handle_okay(copy, count)) )
+            goto out;
+        rc = gnttab_copy_sg(copy, &opaque_in, count);
+        if ( rc > 0 )
+        {
+            rc = count - rc;
+            guest_handle_add_offset(copy, rc);
+            uop = guest_handle_cast(copy, void);
+        }
+        opaque_out = opaque_in;
+        break;
+    }
+
     case GNTTABOP_query_size:
         rc = gnttab_query_size(
             guest_handle_cast(uop, gnttab_query_size_t), count);
@@ -3767,6 +4283,8 @@ gnttab_release_mappings(
 
         map->flags = 0;
     }
+
+    persistent_map_flush(gt);
 }
 
 void grant_table_warn_active_grants(struct domain *d)
@@ -3826,6 +4344,8 @@ grant_table_destroy(
 
     gnttab_destroy_arch(t);
 
+    persistent_map_flush(t);
+
     for ( i = 0; i < nr_grant_frames(t); i++ )
         free_xenheap_page(t->shared_raw[i]);
     xfree(t->shared_raw);
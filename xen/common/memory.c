@@ -246,7 +246,8 @@ static void populate_physmap(struct memop_args *a)
             }
             else
             {
-                page = alloc_domheap_pages(d, a->extent_order, a->memflags);
+                page = alloc_domheap_pages(d, a->extent_order,
+                                           a->memflags | MEMF_scrub_parallel);
 
                 if ( unlikely(!page) )
                 {
@@ -1095,6 +1096,11 @@ static int acquire_resource(
                                  mfn_list);
         break;
 
+    case XENMEM_resource_sched_stats:
+        rc = sched_stats_get_frames(d, xmar.id, xmar.frame, xmar.nr_frames,
+                                    mfn_list);
+        break;
+
     default:
         rc = arch_acquire_resource(d, xmar.type, xmar.id, xmar.frame,
                                    xmar.nr_frames, mfn_list);
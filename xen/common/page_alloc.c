@@ -136,6 +136,7 @@
 #include <xen/numa.h>
 #include <xen/nodemask.h>
 #include <xen/event.h>
+#include <xen/tasklet.h>
 #include <public/sysctl.h>
 #include <public/sched.h>
 #include <asm/page.h>
@@ -217,6 +218,13 @@ size_param("bootscrub_chunk", opt_bootscrub_chunk);
 static bool __read_mostly opt_scrub_domheap;
 boolean_param("scrub-domheap", opt_scrub_domheap);
 
+/*
+ * alloc-scrub-workers -> Number of idle CPUs helping to scrub large dirty
+ * allocations made on behalf of guests
+ */
+static unsigned int __read_mostly opt_alloc_scrub_workers = 4;
+integer_param("alloc-scrub-workers", opt_alloc_scrub_workers);
+
 #ifdef CONFIG_SCRUB_DEBUG
 static bool __read_mostly scrub_debug;
 #else
@@ -911,6 +919,103 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
     }
 }
 
+/*
+ * Scrubbing a large dirty allocation, e.g. a 1GiB extent for a guest being
+ * built right after another one got destroyed, is worth sharing with idle
+ * CPUs of the node.  Chunks are handed out from a shared counter, and the
+ * allocating CPU takes whatever nobody else got to, so it only ever waits
+ * for chunks already being scrubbed.
+ */
+#define SCRUB_CHUNK_ORDER 9
+
+struct scrub_job {
+    struct page_info *pg;
+    unsigned int nr_chunks;
+    atomic_t next;           /* Next chunk to be claimed. */
+    atomic_t dirty;          /* Number of pages which needed scrubbing. */
+};
+
+static bool scrub_job_chunk(struct scrub_job *job)
+{
+    unsigned int chunk = atomic_inc_return(&job->next) - 1;
+    struct page_info *pg;
+    unsigned int i, dirty = 0;
+
+    if ( chunk >= job->nr_chunks )
+        return false;
+
+    pg = job->pg + (chunk << SCRUB_CHUNK_ORDER);
+
+    for ( i = 0; i < (1U << SCRUB_CHUNK_ORDER); i++ )
+    {
+        if ( test_bit(_PGC_need_scrub, &pg[i].count_info) )
+        {
+            scrub_one_page(&pg[i]);
+            dirty++;
+        }
+        else
+            check_one_page(&pg[i]);
+    }
+
+    if ( dirty )
+    {
+        spin_lock(&heap_lock);
+        for ( i = 0; i < (1U << SCRUB_CHUNK_ORDER); i++ )
+            pg[i].count_info &= ~PGC_need_scrub;
+        spin_unlock(&heap_lock);
+
+        atomic_add(dirty, &job->dirty);
+    }
+
+    return true;
+}
+
+static void scrub_job_worker(void *data)
+{
+    struct scrub_job *job = data;
+
+    while ( !softirq_pending(smp_processor_id()) && scrub_job_chunk(job) )
+        continue;
+}
+
+/* Scrub 2^@order pages. Returns the number of pages which were dirty. */
+static unsigned int scrub_pages_parallel(struct page_info *pg,
+                                         unsigned int order, nodeid_t node)
+{
+    struct scrub_job job = {
+        .pg = pg,
+        .nr_chunks = 1U << (order - SCRUB_CHUNK_ORDER),
+    };
+    struct tasklet workers[8];
+    unsigned int cpu, i, nr = 0;
+    unsigned int max = min(opt_alloc_scrub_workers, job.nr_chunks - 1);
+
+    atomic_set(&job.next, 0);
+    atomic_set(&job.dirty, 0);
+
+    for_each_cpu ( cpu, &node_to_cpumask(node) )
+    {
+        if ( nr >= max || nr >= ARRAY_SIZE(workers) )
+            break;
+        if ( cpu == smp_processor_id() || !cpu_online(cpu) ||
+             !idle_vcpu[cpu]->is_running )
+            continue;
+
+        tasklet_init(&workers[nr], scrub_job_worker, &job);
+        tasklet_schedule_on_cpu(&workers[nr], cpu);
+        nr++;
+    }
+
+    while ( scrub_job_chunk(&job) )
+        continue;
+
+    /* Cancel the workers which didn't get to run. */
+    for ( i = 0; i < nr; i++ )
+        tasklet_kill(&workers[i]);
+
+    return atomic_read(&job.dirty);
+}
+
 /* Allocate 2^@order contiguous pages. */
 static struct page_info *alloc_heap_pages(
     unsigned int zone_lo, unsigned int zone_hi,
@@ -1031,8 +1136,21 @@ static struct page_info *alloc_heap_pages(
 
     spin_unlock(&heap_lock);
 
-    if ( first_dirty != INVALID_DIRTY_IDX ||
-         (scrub_debug && !(memflags & MEMF_no_scrub)) )
+    if ( (memflags & MEMF_scrub_parallel) && !(memflags & MEMF_no_scrub) &&
+         order > SCRUB_CHUNK_ORDER &&
+         (first_dirty != INVALID_DIRTY_IDX || scrub_debug) )
+    {
+        dirty_cnt = scrub_pages_parallel(pg, order, node);
+
+        if ( dirty_cnt )
+        {
+            spin_lock(&heap_lock);
+            node_need_scrub[node] -= dirty_cnt;
+            spin_unlock(&heap_lock);
+        }
+    }
+    else if ( first_dirty != INVALID_DIRTY_IDX ||
+              (scrub_debug && !(memflags & MEMF_no_scrub)) )
     {
         for ( i = 0; i < (1U << order); i++ )
         {
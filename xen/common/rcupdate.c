@@ -140,6 +140,31 @@ static s_time_t __read_mostly idle_timer_period;
 
 static DEFINE_PER_CPU(struct rcu_data, rcu_data);
 
+/*
+ * nohz CPUs (see sched_nohz_cpus) should not be disturbed by RCU:
+ * - callbacks queued on them are handed over to RCU_NOHZ_CPU, which waits
+ *   for the grace period to end and invokes them.  So are the ones a CPU
+ *   still has queued when it goes nohz (see rcu_nohz_enter());
+ * - they still need to go through a quiescent state for a grace period to
+ *   complete, which only gets recorded when they process softirqs.  If
+ *   that does not happen within RCU_NOHZ_KICK_DELAY, RCU_NOHZ_CPU sends
+ *   them RCU_SOFTIRQ, to move things forward.
+ */
+#define RCU_NOHZ_CPU         0
+#define RCU_NOHZ_KICK_DELAY  MILLISECS(10)
+
+static struct {
+    spinlock_t lock;
+    struct rcu_head *list;
+    struct rcu_head **tail;
+    long qlen;
+} rcu_nohz = {
+    .lock = SPIN_LOCK_UNLOCKED,
+    .tail = &rcu_nohz.list,
+};
+
+static struct timer rcu_nohz_timer;
+
 static int blimit = 10;
 static int qhimark = 10000;
 static int qlowmark = 100;
@@ -280,6 +305,24 @@ void call_rcu(struct rcu_head *head,
 
     head->func = func;
     head->next = NULL;
+
+    if ( cpu_is_nohz(smp_processor_id()) )
+    {
+        bool kick;
+
+        spin_lock_irqsave(&rcu_nohz.lock, flags);
+        kick = !rcu_nohz.list;
+        *rcu_nohz.tail = head;
+        rcu_nohz.tail = &head->next;
+        rcu_nohz.qlen++;
+        spin_unlock_irqrestore(&rcu_nohz.lock, flags);
+
+        perfc_incr(rcu_nohz_offload);
+        if ( kick )
+            cpu_raise_softirq(RCU_NOHZ_CPU, RCU_SOFTIRQ);
+        return;
+    }
+
     local_irq_save(flags);
     rdp = &this_cpu(rcu_data);
     *rdp->nxttail = head;
@@ -365,6 +408,9 @@ static void rcu_start_batch(struct rcu_ctrlblk *rcp)
         */
         smp_mb();
         cpumask_andnot(&rcp->cpumask, &cpu_online_map, &rcp->idle_cpumask);
+
+        if ( cpumask_intersects(&rcp->cpumask, &sched_nohz_cpus) )
+            set_timer(&rcu_nohz_timer, NOW() + RCU_NOHZ_KICK_DELAY);
     }
 }
 
@@ -419,12 +465,122 @@ static void rcu_check_quiescent_state(struct rcu_ctrlblk *rcp,
 }
 
 
+/*
+ * Move the callbacks queued on nohz CPUs to RCU_NOHZ_CPU's own list, from
+ * where they are dealt with as any other callback.
+ */
+static void rcu_nohz_adopt(struct rcu_data *rdp)
+{
+    spin_lock_irq(&rcu_nohz.lock);
+    if (rcu_nohz.list) {
+        *rdp->nxttail = rcu_nohz.list;
+        rdp->nxttail = rcu_nohz.tail;
+        rdp->qlen += rcu_nohz.qlen;
+        rcu_nohz.list = NULL;
+        rcu_nohz.tail = &rcu_nohz.list;
+        rcu_nohz.qlen = 0;
+    }
+    spin_unlock_irq(&rcu_nohz.lock);
+}
+
+/*
+ * Hand the callbacks still queued on a CPU which went nohz over to
+ * RCU_NOHZ_CPU, whatever stage they are at: they just wait for a later
+ * grace period there.  Runs on that CPU, from the RCU softirq.
+ */
+static void rcu_nohz_handover(struct rcu_data *rdp)
+{
+    struct rcu_head *list = NULL, **tail = &list;
+    unsigned long flags;
+    long qlen;
+    bool kick;
+
+    local_irq_save(flags);
+    if (rdp->donelist) {
+        *tail = rdp->donelist;
+        tail = rdp->donetail;
+    }
+    if (rdp->curlist) {
+        *tail = rdp->curlist;
+        tail = rdp->curtail;
+    }
+    if (rdp->nxtlist) {
+        *tail = rdp->nxtlist;
+        tail = rdp->nxttail;
+    }
+    rdp->donelist = rdp->curlist = rdp->nxtlist = NULL;
+    rdp->donetail = &rdp->donelist;
+    rdp->curtail = &rdp->curlist;
+    rdp->nxttail = &rdp->nxtlist;
+    qlen = rdp->qlen;
+    rdp->qlen = 0;
+    rdp->blimit = blimit;
+
+    if (!list) {
+        local_irq_restore(flags);
+        return;
+    }
+
+    spin_lock(&rcu_nohz.lock);
+    kick = !rcu_nohz.list;
+    *rcu_nohz.tail = list;
+    rcu_nohz.tail = tail;
+    rcu_nohz.qlen += qlen;
+    spin_unlock(&rcu_nohz.lock);
+    local_irq_restore(flags);
+
+    perfc_add(rcu_nohz_offload, qlen);
+    if (kick)
+        cpu_raise_softirq(RCU_NOHZ_CPU, RCU_SOFTIRQ);
+}
+
+/*
+ * cpu has just been made nohz: have it hand over the callbacks it has
+ * queued already, rather than leaving them until it next processes
+ * softirqs, which may be a long time away.  rcu_pending() tells it to.
+ */
+void rcu_nohz_enter(unsigned int cpu)
+{
+    cpu_raise_softirq(cpu, RCU_SOFTIRQ);
+}
+
+/*
+ * Poke the nohz CPUs that are still holding up the current grace period.
+ */
+static void rcu_nohz_timer_fn(void *unused)
+{
+    static cpumask_t mask;
+    struct rcu_ctrlblk *rcp = &rcu_ctrlblk;
+
+    spin_lock(&rcp->lock);
+    cpumask_and(&mask, &rcp->cpumask, &sched_nohz_cpus);
+    if (rcp->cur != rcp->completed && !cpumask_empty(&mask))
+        set_timer(&rcu_nohz_timer, NOW() + RCU_NOHZ_KICK_DELAY);
+    else
+        cpumask_clear(&mask);
+    spin_unlock(&rcp->lock);
+
+    if (!cpumask_empty(&mask)) {
+        perfc_incr(rcu_nohz_kick);
+        cpumask_raise_softirq(&mask, RCU_SOFTIRQ);
+    }
+}
+
 /*
  * This does the RCU processing work from softirq context. 
  */
 static void __rcu_process_callbacks(struct rcu_ctrlblk *rcp,
                                     struct rcu_data *rdp)
 {
+    if (rdp->cpu == RCU_NOHZ_CPU && read_atomic(&rcu_nohz.list))
+        rcu_nohz_adopt(rdp);
+
+    if (cpu_is_nohz(rdp->cpu)) {
+        rcu_nohz_handover(rdp);
+        rcu_check_quiescent_state(rcp, rdp);
+        return;
+    }
+
     if (rdp->curlist && !rcu_batch_before(rcp->completed, rdp->batch)) {
         *rdp->donetail = rdp->curlist;
         rdp->donetail = rdp->curtail;
@@ -486,6 +642,15 @@ static void rcu_process_callbacks(void)
 
 static int __rcu_pending(struct rcu_ctrlblk *rcp, struct rcu_data *rdp)
 {
+    /* There are callbacks from nohz CPUs for this cpu to take over */
+    if (rdp->cpu == RCU_NOHZ_CPU && read_atomic(&rcu_nohz.list))
+        return 1;
+
+    /* This cpu went nohz with callbacks still queued */
+    if (cpu_is_nohz(rdp->cpu) &&
+        (rdp->donelist || rdp->curlist || rdp->nxtlist))
+        return 1;
+
     /* This cpu has pending rcu entries and the grace period
      * for them has completed.
      */
@@ -686,6 +851,7 @@ void __init rcu_init(void)
     idle_timer_period = MILLISECS(idle_timer_period_ms);
 
     cpumask_clear(&rcu_ctrlblk.idle_cpumask);
+    init_timer(&rcu_nohz_timer, rcu_nohz_timer_fn, NULL, RCU_NOHZ_CPU);
     cpu_callback(&cpu_nfb, CPU_UP_PREPARE, cpu);
     register_cpu_notifier(&cpu_nfb);
     open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
@@ -67,6 +67,9 @@ integer_param("sched_ratelimit_us", sched_ratelimit_us);
 bool __read_mostly sched_disable_smt_switching;
 cpumask_t sched_res_mask;
 
+/* pCPUs in nohz mode. */
+cpumask_t sched_nohz_cpus;
+
 /* Common lock for free cpus. */
 static DEFINE_SPINLOCK(sched_free_cpu_lock);
 
@@ -87,6 +90,9 @@ DEFINE_PER_CPU(cpumask_t, cpumask_scratch);
 /* How many urgent vcpus. */
 DEFINE_PER_CPU(atomic_t, sched_urgent_count);
 
+/* Time spent in the last rendezvous before a context switch (if tracing). */
+static DEFINE_PER_CPU(s_time_t, sched_rdv_wait);
+
 extern const struct scheduler *__start_schedulers_array[], *__end_schedulers_array[];
 #define NUM_SCHEDULERS (__end_schedulers_array - __start_schedulers_array)
 #define schedulers __start_schedulers_array
@@ -803,6 +809,172 @@ void sched_destroy_domain(struct domain *d)
 
         cpupool_rm_domain(d);
     }
+
+    if ( d->sched_stats )
+    {
+        free_xenheap_pages(d->sched_stats, d->sched_stats_order);
+        d->sched_stats = NULL;
+    }
+}
+
+/*
+ * Scheduling statistics.  They are only updated with the unit's schedule lock
+ * held, so each unit has a single writer at any time.
+ */
+static void sched_stats_publish(struct sched_unit *unit)
+{
+    struct xen_sched_vcpu_stats *stats = unit->domain->sched_stats;
+    const struct vcpu *v;
+
+    unit->stats.unit = unit->unit_id;
+
+    if ( likely(!stats) )
+        return;
+
+    for_each_sched_unit_vcpu ( unit, v )
+    {
+        struct xen_sched_vcpu_stats *s = &stats[v->vcpu_id];
+        uint32_t version = s->version + 1;
+
+        /* An odd version tells readers the record is being updated. */
+        write_atomic(&s->version, version);
+        smp_wmb();
+        unit->stats.version = version;
+        *s = unit->stats;
+        smp_wmb();
+        write_atomic(&s->version, version + 1);
+    }
+}
+
+static void sched_stats_wait_end(struct sched_unit *unit, s_time_t now)
+{
+    if ( !unit->runnable_since )
+        return;
+
+    unit->stats.delay[unit->runnable_cause] += now - unit->runnable_since;
+    unit->runnable_since = 0;
+}
+
+static void sched_stats_wake(struct sched_unit *unit, unsigned int cause,
+                             s_time_t now)
+{
+    if ( unit->is_running || unit->runnable_since )
+        return;
+
+    unit->runnable_since = now;
+    unit->runnable_cause = cause;
+}
+
+static void sched_stats_switch(struct sched_unit *prev,
+                               struct sched_unit *next, s_time_t now)
+{
+    if ( !is_idle_unit(prev) )
+    {
+        if ( unit_runnable(prev) )
+        {
+            if ( prev->yielded )
+                prev->runnable_cause = XEN_SCHED_DELAY_yield;
+            else
+            {
+                prev->runnable_cause = XEN_SCHED_DELAY_preempt;
+                prev->stats.preemptions++;
+            }
+            prev->runnable_since = now;
+        }
+        prev->yielded = false;
+        sched_stats_publish(prev);
+    }
+
+    if ( !is_idle_unit(next) )
+    {
+        if ( next->runnable_since &&
+             next->runnable_cause == XEN_SCHED_DELAY_wake )
+        {
+            uint64_t latency = now - next->runnable_since;
+
+            next->stats.wakeups++;
+            if ( latency > next->stats.wake_latency_max )
+                next->stats.wake_latency_max = latency;
+        }
+        sched_stats_wait_end(next, now);
+        sched_stats_publish(next);
+    }
+}
+
+static int sched_stats_alloc(struct domain *d)
+{
+    struct xen_sched_vcpu_stats *stats;
+    struct sched_unit *unit;
+    unsigned int i, order;
+    int rc = 0;
+
+    if ( d->sched_stats )
+        return 0;
+
+    order = get_order_from_bytes(d->max_vcpus * sizeof(*stats));
+
+    domain_lock(d);
+
+    if ( d->is_dying )
+        rc = -EINVAL;
+    else if ( !d->sched_stats )
+    {
+        stats = alloc_xenheap_pages(order, 0);
+        if ( !stats )
+        {
+            rc = -ENOMEM;
+            goto out;
+        }
+
+        memset(stats, 0, PAGE_SIZE << order);
+        for ( i = 0; i < (1u << order); i++ )
+            share_xen_page_with_guest(virt_to_page((void *)stats +
+                                                   i * PAGE_SIZE),
+                                      d, SHARE_ro);
+
+        d->sched_stats_order = order;
+        smp_wmb();
+        d->sched_stats = stats;
+
+        rcu_read_lock(&sched_res_rculock);
+
+        for_each_sched_unit ( d, unit )
+        {
+            spinlock_t *lock = unit_schedule_lock_irq(unit);
+
+            sched_stats_publish(unit);
+            unit_schedule_unlock_irq(lock, unit);
+        }
+
+        rcu_read_unlock(&sched_res_rculock);
+    }
+
+ out:
+    domain_unlock(d);
+
+    return rc;
+}
+
+int sched_stats_get_frames(struct domain *d, unsigned int id,
+                           unsigned long frame, unsigned int nr_frames,
+                           xen_pfn_t mfn_list[])
+{
+    unsigned int nr = PFN_UP(d->max_vcpus * sizeof(*d->sched_stats));
+    unsigned int i;
+    int rc;
+
+    if ( id || frame >= nr || nr_frames > nr - frame )
+        return -EINVAL;
+
+    rc = sched_stats_alloc(d);
+    if ( rc )
+        return rc;
+
+    for ( i = 0; i < nr_frames; i++ )
+        mfn_list[i] = virt_to_mfn((void *)d->sched_stats +
+                                  (frame + i) * PAGE_SIZE);
+
+    return 0;
 }
 
 static void vcpu_sleep_nosync_locked(struct vcpu *v)
@@ -818,7 +990,10 @@ static void vcpu_sleep_nosync_locked(struct vcpu *v)
 
         /* Only put unit to sleep in case all vcpus are not runnable. */
         if ( likely(!unit_runnable(unit)) )
+        {
+            sched_stats_wait_end(unit, NOW());
             sched_sleep(unit_scheduler(unit), unit);
+        }
         else if ( unit_running(unit) > 1 && v->is_running &&
                   !v->force_context_switch )
         {
@@ -871,7 +1046,14 @@ void vcpu_wake(struct vcpu *v)
     if ( likely(vcpu_runnable(v)) )
     {
         if ( v->runstate.state >= RUNSTATE_blocked )
-            vcpu_runstate_change(v, RUNSTATE_runnable, NOW());
+        {
+            s_time_t now = NOW();
+
+            sched_stats_wake(unit, (v->runstate.state == RUNSTATE_blocked)
+                                   ? XEN_SCHED_DELAY_wake
+                                   : XEN_SCHED_DELAY_other, now);
+            vcpu_runstate_change(v, RUNSTATE_runnable, now);
+        }
         /*
          * Call sched_wake() unconditionally, even if unit is running already.
          * We might have not been de-scheduled after vcpu_sleep_nosync_locked()
@@ -1385,6 +1567,44 @@ static void vcpu_block_enable_events(void)
     vcpu_block();
 }
 
+/*
+ * @v is about to yield or block while spinning on a lock.  If the guest told
+ * us which vcpu holds the lock, and that one has been preempted, ask the
+ * scheduler to run it first.
+ */
+static void sched_yield_to_lock_holder(struct vcpu *v)
+{
+    const struct vcpu_sched_hints *hints = v->sched_hints;
+    struct sched_unit *unit;
+    struct vcpu *holder;
+    spinlock_t *lock;
+
+    if ( !hints || !(ACCESS_ONCE(hints->flags) & VCPU_HINT_spinning) )
+        return;
+
+    holder = domain_vcpu(v->domain, ACCESS_ONCE(hints->lock_holder));
+    if ( !holder || holder->sched_unit == v->sched_unit ||
+         holder->is_running || !vcpu_runnable(holder) )
+        return;
+
+    rcu_read_lock(&sched_res_rculock);
+
+    unit = holder->sched_unit;
+    lock = unit_schedule_lock_irq(unit);
+
+    if ( !unit->is_running && unit_runnable(unit) )
+    {
+        SCHED_STAT_CRANK(vcpu_yield_to);
+        TRACE_4D(TRC_SCHED_YIELD_TO, v->domain->domain_id, v->vcpu_id,
+                 holder->vcpu_id, sched_unit_master(unit));
+        sched_yield_to(unit_scheduler(unit), v->sched_unit, unit);
+    }
+
+    unit_schedule_unlock_irq(lock, unit);
+
+    rcu_read_unlock(&sched_res_rculock);
+}
+
 static long do_poll(struct sched_poll *sched_poll)
 {
     struct vcpu   *v = current;
@@ -1447,6 +1667,8 @@ static long do_poll(struct sched_poll *sched_poll)
     if ( sched_poll->timeout != 0 )
         set_timer(&v->poll_timer, sched_poll->timeout);
 
+    sched_yield_to_lock_holder(v);
+
     TRACE_2D(TRC_SCHED_BLOCK, d->domain_id, v->vcpu_id);
     raise_softirq(SCHEDULE_SOFTIRQ);
 
@@ -1465,9 +1687,12 @@ long vcpu_yield(void)
     struct vcpu * v=current;
     spinlock_t *lock;
 
+    sched_yield_to_lock_holder(v);
+
     rcu_read_lock(&sched_res_rculock);
 
     lock = unit_schedule_lock_irq(v->sched_unit);
+    v->sched_unit->yielded = true;
     sched_yield(vcpu_scheduler(v), v->sched_unit);
     unit_schedule_unlock_irq(lock, v->sched_unit);
 
@@ -2050,6 +2275,69 @@ long sched_adjust_global(struct xen_sysctl_scheduler_op *op)
     return rc;
 }
 
+/* Return the scheduling statistics of a domain's vcpus. */
+int sched_vcpu_stats(struct xen_sysctl_sched_vcpu_stats *op)
+{
+    struct domain *d;
+    struct sched_unit *unit;
+    const struct vcpu *v;
+    int rc;
+
+    if ( op->pad )
+        return -EINVAL;
+
+    d = rcu_lock_domain_by_id(op->domid);
+    if ( d == NULL )
+        return -ESRCH;
+
+    rc = xsm_getdomaininfo(XSM_HOOK, d);
+    if ( rc )
+        goto out;
+
+    if ( guest_handle_is_null(op->stats) )
+    {
+        op->nr_vcpus = d->max_vcpus;
+        goto out;
+    }
+
+    op->nr_vcpus = min(op->nr_vcpus, d->max_vcpus);
+
+    rcu_read_lock(&sched_res_rculock);
+
+    for_each_sched_unit ( d, unit )
+    {
+        struct xen_sched_vcpu_stats stats;
+        spinlock_t *lock = unit_schedule_lock_irq(unit);
+
+        stats = unit->stats;
+        unit_schedule_unlock_irq(lock, unit);
+
+        stats.version = 0;
+        stats.unit = unit->unit_id;
+
+        for_each_sched_unit_vcpu ( unit, v )
+        {
+            if ( v->vcpu_id >= op->nr_vcpus )
+                break;
+            if ( copy_to_guest_offset(op->stats, v->vcpu_id, &stats, 1) )
+            {
+                rc = -EFAULT;
+                break;
+            }
+        }
+
+        if ( rc )
+            break;
+    }
+
+    rcu_read_unlock(&sched_res_rculock);
+
+ out:
+    rcu_unlock_domain(d);
+
+    return rc;
+}
+
 static void vcpu_periodic_timer_work_locked(struct vcpu *v)
 {
     s_time_t now;
@@ -2120,6 +2408,8 @@ static void sched_switch_units(struct sched_resource *sr,
 
         ASSERT(!unit_running(next));
 
+        sched_stats_switch(prev, next, now);
+
         /*
          * NB. Don't add any trace records from here until the actual context
          * switch, else lost_records resume will not work properly.
@@ -2260,11 +2550,15 @@ static void unit_context_saved(struct sched_resource *sr)
  * 1 and perform the final needed action in that case (call of
  * unit_context_saved()), and then set the counter to zero. The other members
  * will wait until the counter becomes zero until they proceed.
+ * If tracing, the time spent waiting in both the rendezvous before
+ * (see sched_wait_rendezvous_in()) and after the context switch is logged
+ * here, as no trace records can be added in between.
  */
 void sched_context_switched(struct vcpu *vprev, struct vcpu *vnext)
 {
     struct sched_unit *next = vnext->sched_unit;
     struct sched_resource *sr;
+    s_time_t out_start = 0;
 
     rcu_read_lock(&sched_res_rculock);
 
@@ -2274,6 +2568,9 @@ void sched_context_switched(struct vcpu *vprev, struct vcpu *vnext)
     {
         int cnt = atomic_dec_return(&next->rendezvous_out_cnt);
 
+        if ( unlikely(tb_init_done) )
+            out_start = NOW();
+
         vcpu_context_saved(vprev, vnext);
 
         /* Call unit_context_saved() before releasing other waiters. */
@@ -2285,6 +2582,16 @@ void sched_context_switched(struct vcpu *vprev, struct vcpu *vnext)
         else
             while ( atomic_read(&next->rendezvous_out_cnt) )
                 cpu_relax();
+
+        if ( unlikely(tb_init_done) )
+        {
+            s_time_t in_wait = this_cpu(sched_rdv_wait);
+
+            TRACE_4D(TRC_SCHED_RENDEZVOUS, next->domain->domain_id,
+                     next->unit_id, min_t(s_time_t, in_wait, UINT32_MAX),
+                     min_t(s_time_t, NOW() - out_start, UINT32_MAX));
+        }
+        this_cpu(sched_rdv_wait) = 0;
     }
     else
     {
@@ -2405,13 +2712,16 @@ static struct vcpu *sched_force_context_switch(struct vcpu *vprev,
 
 /*
  * Rendezvous before taking a scheduling decision.
- * Called with schedule lock held, so all accesses to the rendezvous counter
- * can be normal ones (no atomic accesses needed).
+ * Called with schedule lock held. The counter is only modified with the lock
+ * held, but it is atomic so that waiters can poll it without holding it.
  * The counter is initialized to the number of cpus to rendezvous initially.
  * Each cpu entering will decrement the counter. In case the counter becomes
  * zero do_schedule() is called and the rendezvous counter for leaving
  * context_switch() is set. All other members will wait until the counter is
- * becoming zero, dropping the schedule lock in between.
+ * becoming zero, dropping the schedule lock in between, and only taking it
+ * again when it is (or something else needs to be dealt with).
+ * If the decision has been taken already (see schedule()), the members
+ * entering just pick it up, without waiting.
  * Either returns the new unit to run, or NULL if no context switch is
  * required or (on Arm) has already been performed. If NULL is returned
  * sched_res_rculock has been dropped.
@@ -2425,15 +2735,24 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
     struct sched_resource *sr = get_sched_res(cpu);
     unsigned int gran = sr->granularity;
 
-    if ( !--prev->rendezvous_in_cnt )
+    if ( prev->rendezvous_decided )
+    {
+        if ( atomic_dec_and_test(&prev->rendezvous_in_cnt) )
+            prev->rendezvous_decided = false;
+        return prev->next_task;
+    }
+
+    if ( atomic_dec_and_test(&prev->rendezvous_in_cnt) )
     {
+        if ( unlikely(tb_init_done) )
+            this_cpu(sched_rdv_wait) = NOW() - now;
         next = do_schedule(prev, now, cpu);
         atomic_set(&next->rendezvous_out_cnt, gran + 1);
         return next;
     }
 
     v = unit2vcpu_cpu(prev, cpu);
-    while ( prev->rendezvous_in_cnt )
+    while ( atomic_read(&prev->rendezvous_in_cnt) )
     {
         if ( v && v->force_context_switch )
         {
@@ -2444,7 +2763,7 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
             if ( v )
             {
                 /* We'll come back another time, so adjust rendezvous_in_cnt. */
-                prev->rendezvous_in_cnt++;
+                atomic_inc(&prev->rendezvous_in_cnt);
                 atomic_set(&prev->rendezvous_out_cnt, 0);
 
                 pcpu_schedule_unlock_irq(*lock, cpu);
@@ -2467,7 +2786,7 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
         {
             struct vcpu *vprev = current;
 
-            prev->rendezvous_in_cnt++;
+            atomic_inc(&prev->rendezvous_in_cnt);
             atomic_set(&prev->rendezvous_out_cnt, 0);
 
             pcpu_schedule_unlock_irq(*lock, cpu);
@@ -2480,7 +2799,21 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
 
         pcpu_schedule_unlock_irq(*lock, cpu);
 
-        cpu_relax();
+        /*
+         * Wait for the other members without the lock, so we don't slow
+         * them down (and the last one, who has to call do_schedule(), in
+         * particular) in getting it. Only take it back for checking again
+         * when the rendezvous is complete, or when there is any of the
+         * above to deal with.
+         */
+        do {
+            cpu_relax();
+        } while ( atomic_read(&prev->rendezvous_in_cnt) &&
+                  !(v && v->force_context_switch) &&
+                  !(is_idle_unit(prev) &&
+                    (per_cpu(tasklet_work_to_do, cpu) & TASKLET_enqueued)) &&
+                  likely(scheduler_active) &&
+                  likely(sr == get_sched_res(cpu)) );
 
         *lock = pcpu_schedule_lock_irq(cpu);
 
@@ -2488,7 +2821,7 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
         {
             ASSERT(is_idle_unit(prev));
             atomic_set(&prev->next_task->rendezvous_out_cnt, 0);
-            prev->rendezvous_in_cnt = 0;
+            atomic_set(&prev->rendezvous_in_cnt, 0);
         }
 
         /*
@@ -2500,20 +2833,41 @@ static struct sched_unit *sched_wait_rendezvous_in(struct sched_unit *prev,
         {
             ASSERT(is_idle_unit(prev));
             atomic_set(&prev->next_task->rendezvous_out_cnt, 0);
-            prev->rendezvous_in_cnt = 0;
+            atomic_set(&prev->rendezvous_in_cnt, 0);
             pcpu_schedule_unlock_irq(*lock, cpu);
             rcu_read_unlock(&sched_res_rculock);
             return NULL;
         }
     }
 
+    if ( unlikely(tb_init_done) )
+        this_cpu(sched_rdv_wait) = NOW() - now;
+
     return prev->next_task;
 }
 
+/*
+ * The unit vprev, running on cpu, is part of, for the purpose of scheduling.
+ * This is vprev's unit, unless the (idle) siblings have been told to switch
+ * to a unit decided already (see schedule()), as in that case vprev, if it
+ * is idle, may be assigned to the new unit already.
+ * Must be called with the schedule lock held.
+ */
+static struct sched_unit *sched_prev_unit(const struct vcpu *vprev,
+                                          unsigned int cpu)
+{
+    struct sched_unit *idle = get_sched_res(cpu)->sched_unit_idle;
+
+    if ( is_idle_vcpu(vprev) && idle && unlikely(idle->rendezvous_decided) )
+        return idle;
+
+    return vprev->sched_unit;
+}
+
 static void sched_slave(void)
 {
     struct vcpu          *v, *vprev = current;
-    struct sched_unit    *prev = vprev->sched_unit, *next;
+    struct sched_unit    *prev, *next;
     s_time_t              now;
     spinlock_t           *lock;
     bool                  do_softirq = false;
@@ -2525,6 +2879,7 @@ static void sched_slave(void)
 
     lock = pcpu_schedule_lock_irq(cpu);
 
+    prev = sched_prev_unit(vprev, cpu);
     now = NOW();
 
     v = unit2vcpu_cpu(prev, cpu);
@@ -2544,7 +2899,7 @@ static void sched_slave(void)
         do_softirq = true;
     }
 
-    if ( !prev->rendezvous_in_cnt )
+    if ( !atomic_read(&prev->rendezvous_in_cnt) )
     {
         pcpu_schedule_unlock_irq(lock, cpu);
 
@@ -2557,7 +2912,9 @@ static void sched_slave(void)
         return;
     }
 
-    stop_timer(&get_sched_res(cpu)->s_timer);
+    /* If the decision has been taken, the timer has been set for it. */
+    if ( !prev->rendezvous_decided )
+        stop_timer(&get_sched_res(cpu)->s_timer);
 
     next = sched_wait_rendezvous_in(prev, &lock, cpu, now);
     if ( !next )
@@ -2577,7 +2934,7 @@ static void sched_slave(void)
 static void schedule(void)
 {
     struct vcpu          *vnext, *vprev = current;
-    struct sched_unit    *prev = vprev->sched_unit, *next = NULL;
+    struct sched_unit    *prev, *next = NULL;
     s_time_t              now;
     struct sched_resource *sr;
     spinlock_t           *lock;
@@ -2594,8 +2951,9 @@ static void schedule(void)
 
     sr = get_sched_res(cpu);
     gran = sr->granularity;
+    prev = sched_prev_unit(vprev, cpu);
 
-    if ( prev->rendezvous_in_cnt )
+    if ( atomic_read(&prev->rendezvous_in_cnt) )
     {
         /*
          * We have a race: sched_slave() should be called, so raise a softirq
@@ -2613,11 +2971,39 @@ static void schedule(void)
 
     now = NOW();
 
-    if ( gran > 1 )
+    if ( gran > 1 && is_idle_unit(prev) )
+    {
+        /*
+         * All the siblings are idle, and hence have nothing to deschedule:
+         * there's no need for them to join before taking the decision.
+         * If we are staying idle, they don't have to do anything at all,
+         * otherwise they just switch to next (and we'll wait for them to
+         * have done so in sched_context_switched()).
+         */
+        ASSERT(prev == sr->sched_unit_idle);
+        next = do_schedule(prev, now, cpu);
+        if ( next == prev )
+        {
+            SCHED_STAT_CRANK(sched_rdv_skip);
+            atomic_set(&next->rendezvous_out_cnt, 0);
+        }
+        else
+        {
+            cpumask_t *mask = cpumask_scratch_cpu(cpu);
+
+            SCHED_STAT_CRANK(sched_rdv_decided);
+            atomic_set(&next->rendezvous_out_cnt, gran + 1);
+            prev->rendezvous_decided = true;
+            atomic_set(&prev->rendezvous_in_cnt, gran - 1);
+            cpumask_andnot(mask, sr->cpus, cpumask_of(cpu));
+            cpumask_raise_softirq(mask, SCHED_SLAVE_SOFTIRQ);
+        }
+    }
+    else if ( gran > 1 )
     {
         cpumask_t *mask = cpumask_scratch_cpu(cpu);
 
-        prev->rendezvous_in_cnt = gran;
+        atomic_set(&prev->rendezvous_in_cnt, gran);
         cpumask_andnot(mask, sr->cpus, cpumask_of(cpu));
         cpumask_raise_softirq(mask, SCHED_SLAVE_SOFTIRQ);
         next = sched_wait_rendezvous_in(prev, &lock, cpu, now);
@@ -2626,7 +3012,7 @@ static void schedule(void)
     }
     else
     {
-        prev->rendezvous_in_cnt = 0;
+        atomic_set(&prev->rendezvous_in_cnt, 0);
         next = do_schedule(prev, now, cpu);
         atomic_set(&next->rendezvous_out_cnt, 0);
     }
@@ -2718,7 +3104,8 @@ static int cpu_schedule_up(unsigned int cpu)
     if ( idle_vcpu[cpu] == NULL )
         return -ENOMEM;
 
-    idle_vcpu[cpu]->sched_unit->rendezvous_in_cnt = 0;
+    atomic_set(&idle_vcpu[cpu]->sched_unit->rendezvous_in_cnt, 0);
+    idle_vcpu[cpu]->sched_unit->rendezvous_decided = false;
 
     /*
      * No need to allocate any scheduler data, as cpus coming online are
@@ -3177,7 +3564,8 @@ int schedule_cpu_rm(unsigned int cpu)
             unit = idle_vcpu[cpu_iter]->sched_unit;
             unit->priv = NULL;
             atomic_set(&unit->next_task->rendezvous_out_cnt, 0);
-            unit->rendezvous_in_cnt = 0;
+            atomic_set(&unit->rendezvous_in_cnt, 0);
+            unit->rendezvous_decided = false;
         }
         else
         {
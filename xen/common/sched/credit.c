@@ -1165,6 +1165,30 @@ csched_unit_yield(const struct scheduler *ops, struct sched_unit *unit)
     set_bit(CSCHED_FLAG_UNIT_YIELD, &svc->flags);
 }
 
+static void
+csched_unit_yield_to(const struct scheduler *ops, struct sched_unit *unit,
+                     struct sched_unit *target)
+{
+    struct csched_unit * const svc = CSCHED_UNIT(target);
+
+    /*
+     * Boost a preempted lock holder the way we boost units on wakeup, so it
+     * runs ahead of everything but other boosted units.  As on wakeup, only
+     * do that for units which are not over their share.
+     */
+    if ( !__unit_on_runq(svc) || svc->pri != CSCHED_PRI_TS_UNDER ||
+         test_bit(CSCHED_FLAG_UNIT_PARKED, &svc->flags) )
+        return;
+
+    TRACE_2D(TRC_CSCHED_BOOST_START, target->domain->domain_id,
+             target->unit_id);
+    SCHED_STAT_CRANK(unit_boost);
+    runq_remove(svc);
+    svc->pri = CSCHED_PRI_TS_BOOST;
+    runq_insert(svc);
+    __runq_tickle(svc);
+}
+
 static int
 csched_dom_cntl(
     const struct scheduler *ops,
@@ -2247,6 +2271,7 @@ static const struct scheduler sched_credit_def = {
     .sleep          = csched_unit_sleep,
     .wake           = csched_unit_wake,
     .yield          = csched_unit_yield,
+    .yield_to       = csched_unit_yield_to,
 
     .adjust         = csched_dom_cntl,
     .adjust_affinity= csched_aff_cntl,
@@ -301,10 +301,69 @@
  */
 #define __CSFLAG_pinned 5
 #define CSFLAG_pinned (1U<<__CSFLAG_pinned)
+/*
+ * CSFLAG_latency: this unit belongs to a domain in the latency class (see
+ * below). Kept in sync with the domain's setting by csched2_dom_cntl().
+ */
+#define __CSFLAG_latency 6
+#define CSFLAG_latency (1U<<__CSFLAG_latency)
 
 static unsigned int __read_mostly opt_migrate_resist = 500;
 integer_param("sched_credit2_migrate_resist", opt_migrate_resist);
 
+/*
+ * Migration cost
+ *
+ * Moving an unit to another runqueue means it has to refill the caches it
+ * was using, and how much that costs depends on how far apart, in the
+ * topology, the cpus of the two runqueues are: hyperthreads of a core share
+ * all their caches, cores of a socket share (typically) the last level one,
+ * while different sockets share none, and may even be further apart in
+ * terms of memory access latency, as reported by the ACPI SLIT distance
+ * of their NUMA nodes.
+ *
+ * opt_migration_cost is the estimated cost, in microseconds, of moving an
+ * unit across sockets at local NUMA distance. Moves to remote nodes cost
+ * more, in proportion to their distance, moves within a socket cost a
+ * quarter of it, and moves among hyperthreads are free.
+ *
+ * Caches are left behind warm when an unit stops running, and cool down as
+ * other units run. An unit is therefore considered cache hot for
+ * CSCHED2_CACHE_HOT_WINDOW after it last ran, during which the cost of
+ * moving it decreases linearly, down to zero.
+ *
+ * Load balancing only moves units when the gain, i.e., the cpu time that
+ * the reduction in load imbalance gives back until the next balancing
+ * (roughly, a credit period), is higher than the cost of the moves.
+ */
+static unsigned int __read_mostly opt_migration_cost = 500;
+integer_param("sched_credit2_migration_cost", opt_migration_cost);
+#define CSCHED2_MIGRATION_COST       ((opt_migration_cost)*MICROSECS(1))
+#define CSCHED2_CACHE_HOT_WINDOW     CSCHED2_CREDIT_INIT
+#define CSCHED2_BALANCE_PERIOD       CSCHED2_CREDIT_INIT
+
+/*
+ * Latency class
+ *
+ * Units of domains in the latency class (XEN_DOMCTL_SCHEDCR2_latency) are
+ * meant to run as soon as possible after waking up, even when they share
+ * their pcpus with batch workloads. To achieve that, when competing with a
+ * unit not in the latency class, they are allowed to borrow up to
+ * opt_latency_borrow microseconds of credit from their future allocation:
+ * they can preempt a bulk unit (ignoring ratelimiting) as long as their
+ * credit, plus the borrowing allowance, is higher than the bulk unit's one,
+ * and they sort on the runqueue accordingly.
+ *
+ * Borrowed credit is paid back naturally, as the unit keeps burning credit
+ * while it runs and credit resets preserve debts. A latency unit that
+ * consumes more than its fair share will therefore see its credit drop
+ * below the allowance, and go back to competing as any other unit would.
+ * Over time, this bounds the unfairness to the allowance itself.
+ */
+static unsigned int __read_mostly opt_latency_borrow = 2000;
+integer_param("sched_credit2_latency_borrow", opt_latency_borrow);
+#define CSCHED2_LATENCY_BORROW       ((opt_latency_borrow)*MICROSECS(1))
+
 /*
  * Load tracking and load balancing
  *
@@ -532,6 +591,7 @@ struct csched2_unit {
     s_time_t budget_quota;             /* Budget to which unit is entitled    */
 
     s_time_t start_time;               /* Time we were scheduled (for credit) */
+    s_time_t last_ran;                 /* Time we were last descheduled       */
 
     /* Individual contribution to load                                        */
     s_time_t load_last_update;         /* Last time average was updated       */
@@ -562,6 +622,7 @@ struct csched2_dom {
     uint16_t weight;            /* User specified weight                      */
     uint16_t cap;               /* User specified cap                         */
     uint16_t nr_units;          /* Number of units of this domain             */
+    bool latency;               /* Domain is in the latency class             */
 };
 
 /*
@@ -605,6 +666,39 @@ static inline bool has_cap(const struct csched2_unit *svc)
     return svc->budget != STIME_MAX;
 }
 
+/*
+ * Credit with which svc competes against other units, i.e., including the
+ * borrowing allowance, if it is in the latency class. Units in the latency
+ * class then compare among themselves exactly as if it were not there.
+ */
+static inline s_time_t unit_credit(const struct csched2_unit *svc)
+{
+    s_time_t credit = svc->credit;
+
+    if ( unlikely(svc->flags & CSFLAG_latency) )
+        credit += CSCHED2_LATENCY_BORROW;
+
+    return credit;
+}
+
+/*
+ * Is there a unit in the latency class waiting in rqd, which would win
+ * against the (not in the latency class) scurr?
+ */
+static inline bool latency_waiting(const struct csched2_runqueue_data *rqd,
+                                   const struct csched2_unit *scurr)
+{
+    const struct csched2_unit *svc;
+
+    if ( (scurr->flags & CSFLAG_latency) || list_empty(&rqd->runq) )
+        return false;
+
+    svc = list_entry(rqd->runq.next, struct csched2_unit, runq_elem);
+
+    return (svc->flags & CSFLAG_latency) &&
+           unit_credit(svc) > unit_credit(scurr);
+}
+
 /*
  * Hyperthreading (SMT) support.
  *
@@ -1288,7 +1382,7 @@ static void runq_insert(struct csched2_unit *svc)
     {
         struct csched2_unit * iter_svc = runq_elem(iter);
 
-        if ( svc->credit > iter_svc->credit )
+        if ( unit_credit(svc) > unit_credit(iter_svc) )
             break;
 
         pos++;
@@ -1369,14 +1463,19 @@ static s_time_t tickle_score(const struct scheduler *ops, s_time_t now,
      * We are dealing with cpus that are marked non-idle (i.e., that are not
      * in rqd->idle). However, some of them may be running their idle unit,
      * if taking care of tasklets. In that case, we want to leave it alone.
+     *
+     * Units in the latency class are not subject to ratelimiting, when it
+     * comes to preempting units which are not.
      */
-    if ( unlikely(is_idle_unit(cur->unit) ||
-         !is_preemptable(cur, now, MICROSECS(prv->ratelimit_us))) )
+    if ( unlikely(is_idle_unit(cur->unit)) )
+        return -1;
+    if ( !((new->flags & CSFLAG_latency) && !(cur->flags & CSFLAG_latency)) &&
+         !is_preemptable(cur, now, MICROSECS(prv->ratelimit_us)) )
         return -1;
 
     burn_credits(rqd, cur, now);
 
-    score = new->credit - cur->credit;
+    score = unit_credit(new) - unit_credit(cur);
     if ( sched_unit_master(new->unit) != cpu )
         score -= CSCHED2_MIGRATE_RESIST;
 
@@ -2046,6 +2145,8 @@ csched2_alloc_udata(const struct scheduler *ops, struct sched_unit *unit,
         ASSERT(svc->sdom != NULL);
         svc->credit = CSCHED2_CREDIT_INIT;
         svc->weight = svc->sdom->weight;
+        if ( svc->sdom->latency )
+            svc->flags |= CSFLAG_latency;
         /* Starting load of 50% */
         svc->avgload = 1ULL << (csched2_priv(ops)->load_precision_shift - 1);
         svc->load_last_update = NOW() >> LOADAVG_GRANULARITY_SHIFT;
@@ -2152,6 +2253,38 @@ csched2_unit_yield(const struct scheduler *ops, struct sched_unit *unit)
     __set_bit(__CSFLAG_unit_yield, &svc->flags);
 }
 
+static void
+csched2_unit_yield_to(const struct scheduler *ops, struct sched_unit *unit,
+                      struct sched_unit *target)
+{
+    struct csched2_unit * const svc = csched2_unit(unit);
+    struct csched2_unit * const tsvc = csched2_unit(target);
+    int gap;
+
+    /*
+     * We hold the runqueue lock of the lock holder, so we can only move
+     * credits around if the yielding unit is in that same runqueue.
+     */
+    if ( !unit_on_runq(tsvc) || svc->rqd != tsvc->rqd )
+        return;
+
+    /*
+     * Hand over enough of our credits to put the lock holder just ahead of
+     * us.  The total amount of credits in the runqueue does not change, so
+     * this can't be used to get more than the domain's share of the CPU.
+     */
+    gap = svc->credit - tsvc->credit;
+    if ( gap < 0 )
+        return;
+
+    gap = gap / 2 + 1;
+    svc->credit -= gap;
+    tsvc->credit += gap;
+
+    runq_remove(tsvc);
+    runq_insert(tsvc);
+}
+
 static void
 csched2_context_saved(const struct scheduler *ops, struct sched_unit *unit)
 {
@@ -2193,6 +2326,55 @@ csched2_context_saved(const struct scheduler *ops, struct sched_unit *unit)
     unpark_parked_units(ops, &were_parked);
 }
 
+/*
+ * Topology based cost of moving an unit between two runqueues (see
+ * opt_migration_cost). Any cpu of a runqueue will do for checking where it
+ * is, as runqueues never span more than one socket or node, unless all the
+ * cpus are in only one of them.
+ */
+static s_time_t rqd_migration_cost(const struct csched2_runqueue_data *a,
+                                   const struct csched2_runqueue_data *b)
+{
+    unsigned int ca = a->pick_bias, cb = b->pick_bias;
+    unsigned int dist;
+
+    if ( a == b || same_core(ca, cb) )
+        return 0;
+
+    if ( same_socket(ca, cb) )
+        return CSCHED2_MIGRATION_COST / 4;
+
+    dist = same_node(ca, cb) ? 10 : __node_distance(cpu_to_node(ca),
+                                                   cpu_to_node(cb));
+    if ( dist < 10 || dist == NUMA_NO_DISTANCE )
+        dist = 20;
+
+    return CSCHED2_MIGRATION_COST * dist / 10;
+}
+
+/*
+ * Cost of moving svc, given the topology based cost of the move, and how
+ * cache hot svc is.
+ */
+static s_time_t unit_migration_cost(const struct csched2_unit *svc,
+                                    s_time_t cost, s_time_t now)
+{
+    s_time_t cold;
+
+    if ( !cost )
+        return 0;
+
+    /* If running, we are as hot as it gets. */
+    if ( svc->flags & CSFLAG_scheduled )
+        return cost;
+
+    cold = now - svc->last_ran;
+    if ( cold >= CSCHED2_CACHE_HOT_WINDOW )
+        return 0;
+
+    return cost - (cost * cold) / CSCHED2_CACHE_HOT_WINDOW;
+}
+
 #define MAX_LOAD (STIME_MAX)
 static struct sched_resource *
 csched2_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
@@ -2201,6 +2383,7 @@ csched2_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
     unsigned int new_cpu, cpu = sched_unit_master(unit);
     struct csched2_unit *svc = csched2_unit(unit);
     s_time_t min_avgload = MAX_LOAD, min_s_avgload = MAX_LOAD;
+    s_time_t now = NOW();
     bool has_soft;
     struct csched2_runqueue_data *rqd, *min_rqd = NULL, *min_s_rqd = NULL;
 
@@ -2313,6 +2496,18 @@ csched2_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
         {
             rqd_avgload = rqd->b_avgload;
             spin_unlock(&rqd->lock);
+
+            /*
+             * Moving there means paying the migration cost. Account for it
+             * as the load that would keep a cpu busy for as long, over a
+             * balancing period, so we only move if the load there is low
+             * enough to make up for it.
+             */
+            if ( svc->rqd )
+                rqd_avgload +=
+                    (unit_migration_cost(svc, rqd_migration_cost(svc->rqd, rqd),
+                                         now) << prv->load_precision_shift) /
+                    CSCHED2_BALANCE_PERIOD;
         }
 
         /*
@@ -2417,9 +2612,14 @@ csched2_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
 /* Working state of the load-balancing algorithm */
 typedef struct {
     /* NB: Modified by consider() */
-    s_time_t load_delta;
+    s_time_t best_gain;
+    bool cost_resisted;
     struct csched2_unit * best_push_svc, *best_pull_svc;
     /* NB: Read by consider() */
+    s_time_t load_delta;
+    s_time_t cost;
+    s_time_t now;
+    unsigned int load_precision_shift;
     struct csched2_runqueue_data *lrqd;
     struct csched2_runqueue_data *orqd;
 } balance_state_t;
@@ -2428,7 +2628,7 @@ static void consider(balance_state_t *st,
                      struct csched2_unit *push_svc,
                      struct csched2_unit *pull_svc)
 {
-    s_time_t l_load, o_load, delta;
+    s_time_t l_load, o_load, delta, gain;
 
     l_load = st->lrqd->b_avgload;
     o_load = st->orqd->b_avgload;
@@ -2449,9 +2649,25 @@ static void consider(balance_state_t *st,
     if ( delta < 0 )
         delta = -delta;
 
-    if ( delta < st->load_delta )
+    if ( delta >= st->load_delta )
+        return;
+
+    /*
+     * Turn the reduction of the imbalance into the cpu time it gives back
+     * until the next balancing, and see whether that pays for the moves.
+     */
+    gain = ((st->load_delta - delta) * CSCHED2_BALANCE_PERIOD) >>
+           st->load_precision_shift;
+    if ( push_svc )
+        gain -= unit_migration_cost(push_svc, st->cost, st->now);
+    if ( pull_svc )
+        gain -= unit_migration_cost(pull_svc, st->cost, st->now);
+
+    if ( gain <= 0 )
+        st->cost_resisted = true;
+    else if ( gain > st->best_gain )
     {
-        st->load_delta = delta;
+        st->best_gain = gain;
         st->best_push_svc=push_svc;
         st->best_pull_svc=pull_svc;
     }
@@ -2674,7 +2890,13 @@ retry:
     /* Look for "swap" which gives the best load average
      * FIXME: O(n^2)! */
 
-    /* Reuse load delta (as we're trying to minimize it) */
+    /* Load delta is what we're trying to reduce, net of migration costs */
+    st.best_gain = 0;
+    st.cost_resisted = false;
+    st.cost = rqd_migration_cost(st.lrqd, st.orqd);
+    st.now = now;
+    st.load_precision_shift = prv->load_precision_shift;
+
     list_for_each( push_iter, &st.lrqd->svc )
     {
         struct csched2_unit * push_svc = list_entry(push_iter, struct csched2_unit, rqd_elem);
@@ -2719,6 +2941,8 @@ retry:
         migrate(ops, st.best_push_svc, st.orqd, now);
     if ( st.best_pull_svc )
         migrate(ops, st.best_pull_svc, st.lrqd, now);
+    if ( !st.best_push_svc && !st.best_pull_svc && st.cost_resisted )
+        SCHED_STAT_CRANK(migrate_cost_resisted);
 
  out_up:
     spin_unlock(&st.orqd->lock);
@@ -2782,9 +3006,15 @@ csched2_dom_cntl(
         read_lock_irqsave(&prv->lock, flags);
         op->u.credit2.weight = sdom->weight;
         op->u.credit2.cap = sdom->cap;
+        op->u.credit2.flags = sdom->latency ? XEN_DOMCTL_SCHEDCR2_latency : 0;
         read_unlock_irqrestore(&prv->lock, flags);
         break;
     case XEN_DOMCTL_SCHEDOP_putinfo:
+        if ( op->u.credit2.flags & ~XEN_DOMCTL_SCHEDCR2_latency )
+        {
+            rc = -EINVAL;
+            break;
+        }
         write_lock_irqsave(&prv->lock, flags);
         /* Weight */
         if ( op->u.credit2.weight != 0 )
@@ -2948,6 +3178,32 @@ csched2_dom_cntl(
 
             unpark_parked_units(ops, &parked);
         }
+        /* Latency class */
+        if ( !!(op->u.credit2.flags & XEN_DOMCTL_SCHEDCR2_latency) !=
+             sdom->latency )
+        {
+            sdom->latency = !sdom->latency;
+
+            for_each_sched_unit ( d, unit )
+            {
+                struct csched2_unit *svc = csched2_unit(unit);
+                spinlock_t *lock = unit_schedule_lock(unit);
+
+                if ( sdom->latency )
+                    __set_bit(__CSFLAG_latency, &svc->flags);
+                else
+                    __clear_bit(__CSFLAG_latency, &svc->flags);
+
+                /* The runqueue position depends on the class too. */
+                if ( unit_on_runq(svc) )
+                {
+                    runq_remove(svc);
+                    runq_insert(svc);
+                }
+
+                unit_schedule_unlock(lock, unit);
+            }
+        }
         write_unlock_irqrestore(&prv->lock, flags);
         break;
     default:
@@ -3172,7 +3428,7 @@ csched2_runtime(const struct scheduler *ops, int cpu,
         if ( ! is_idle_unit(swait->unit)
              && swait->credit > 0 )
         {
-            rt_credit = snext->credit - swait->credit;
+            rt_credit = unit_credit(snext) - unit_credit(swait);
         }
     }
 
@@ -3250,7 +3506,8 @@ runq_candidate(struct csched2_runqueue_data *rqd,
      * no point forcing it to do so until rate limiting expires.
      */
     if ( !yield && prv->ratelimit_us && unit_runnable_state(scurr->unit) &&
-         (now - scurr->unit->state_entry_time) < MICROSECS(prv->ratelimit_us) )
+         (now - scurr->unit->state_entry_time) < MICROSECS(prv->ratelimit_us) &&
+         !latency_waiting(rqd, scurr) )
     {
         if ( unlikely(tb_init_done) )
         {
@@ -3349,7 +3606,8 @@ runq_candidate(struct csched2_runqueue_data *rqd,
          * its credit is at least CSCHED2_MIGRATE_RESIST higher.
          */
         if ( sched_unit_master(svc->unit) != cpu
-             && snext->credit + CSCHED2_MIGRATE_RESIST > svc->credit )
+             && unit_credit(snext) + CSCHED2_MIGRATE_RESIST >
+                unit_credit(svc) )
         {
             (*skipped)++;
             SCHED_STAT_CRANK(migrate_resisted);
@@ -3362,7 +3620,7 @@ runq_candidate(struct csched2_runqueue_data *rqd,
          * if the one in runqueue either is not capped, or is capped but has
          * some budget, then choose it.
          */
-        if ( (yield || svc->credit > snext->credit) &&
+        if ( (yield || unit_credit(svc) > unit_credit(snext)) &&
              (!has_cap(svc) || unit_grab_budget(svc)) &&
              unit_runnable_state(svc->unit) )
             snext = svc;
@@ -3501,6 +3759,10 @@ static void csched2_schedule(
          && unit_runnable(currunit) )
         __set_bit(__CSFLAG_delayed_runq_add, &scurr->flags);
 
+    /* Remember when current stops running, to know how cache hot it is. */
+    if ( snext != scurr && !is_idle_unit(currunit) )
+        scurr->last_ran = now;
+
     /* Accounting for non-idle tasks */
     if ( !is_idle_unit(snext->unit) )
     {
@@ -3982,13 +4244,17 @@ csched2_init(struct scheduler *ops)
            XENLOG_INFO " underload_balance_tolerance: %d\n"
            XENLOG_INFO " overload_balance_tolerance: %d\n"
            XENLOG_INFO " runqueues arrangement: %s\n"
-           XENLOG_INFO " cap enforcement granularity: %dms\n",
+           XENLOG_INFO " cap enforcement granularity: %dms\n"
+           XENLOG_INFO " migration cost: %uus\n"
+           XENLOG_INFO " latency class credit borrowing: %uus\n",
            opt_load_precision_shift,
            opt_load_window_shift,
            opt_underload_balance_tolerance,
            opt_overload_balance_tolerance,
            opt_runqueue_str[opt_runqueue],
-           opt_cap_period);
+           opt_cap_period,
+           opt_migration_cost,
+           opt_latency_borrow);
 
     printk(XENLOG_INFO "load tracking window length %llu ns\n",
            1ULL << opt_load_window_shift);
@@ -4042,6 +4308,7 @@ static const struct scheduler sched_credit2_def = {
     .sleep          = csched2_unit_sleep,
     .wake           = csched2_unit_wake,
     .yield          = csched2_unit_yield,
+    .yield_to       = csched2_unit_yield_to,
 
     .adjust         = csched2_dom_cntl,
     .adjust_affinity= csched2_aff_cntl,
@@ -28,6 +28,7 @@
  * if the scheduler is used inside a cpupool.
  */
 
+#include <xen/param.h>
 #include <xen/sched.h>
 #include <xen/softirq.h>
 #include <xen/trace.h>
@@ -72,6 +73,15 @@
  *    the runqueue lock or the private lock.
  */
 
+/*
+ * nohz mode: a pCPU with a unit assigned is dedicated to it, so Xen keeps
+ * its own periodic work (time calibration, RCU callbacks, cpufreq load
+ * sampling) off the pCPU for as long as that is the case.  CPU0 does the
+ * housekeeping on behalf of all the others, and never goes nohz.
+ */
+static bool __read_mostly opt_null_nohz;
+boolean_param("sched-null-nohz", opt_null_nohz);
+
 /*
  * System-wide private data
  */
@@ -158,6 +168,27 @@ static void null_deinit(struct scheduler *ops)
     ops->sched_data = NULL;
 }
 
+static void set_nohz(unsigned int cpu, bool nohz)
+{
+    unsigned int i;
+
+    if ( !opt_null_nohz )
+        return;
+
+    for_each_cpu ( i, get_sched_res(cpu)->cpus )
+    {
+        if ( i == 0 )
+            continue;
+        if ( nohz )
+        {
+            if ( !cpumask_test_and_set_cpu(i, &sched_nohz_cpus) )
+                rcu_nohz_enter(i);
+        }
+        else
+            cpumask_clear_cpu(i, &sched_nohz_cpus);
+    }
+}
+
 static void init_pdata(struct null_private *prv, struct null_pcpu *npc,
                        unsigned int cpu)
 {
@@ -174,6 +205,7 @@ static void null_deinit_pdata(const struct scheduler *ops, void *pcpu, int cpu)
     ASSERT(npc);
 
     cpumask_clear_cpu(cpu, &prv->cpus_free);
+    cpumask_clear_cpu(cpu, &sched_nohz_cpus);
     npc->unit = NULL;
 }
 
@@ -349,6 +381,7 @@ static void unit_assign(struct null_private *prv, struct sched_unit *unit,
     npc->unit = unit;
     sched_set_res(unit, get_sched_res(cpu));
     cpumask_clear_cpu(cpu, &prv->cpus_free);
+    set_nohz(cpu, true);
 
     dprintk(XENLOG_G_INFO, "%d <-- %pdv%d\n", cpu, unit->domain, unit->unit_id);
 
@@ -379,6 +412,7 @@ static bool unit_deassign(struct null_private *prv, const struct sched_unit *uni
 
     npc->unit = NULL;
     cpumask_set_cpu(cpu, &prv->cpus_free);
+    set_nohz(cpu, false);
 
     dprintk(XENLOG_G_INFO, "%d <-- NULL (%pdv%d)\n", cpu, unit->domain,
             unit->unit_id);
@@ -954,6 +988,8 @@ static void null_dump_pcpu(const struct scheduler *ops, int cpu)
            CPUMASK_PR(per_cpu(cpu_core_mask, cpu)));
     if ( npc->unit != NULL )
         printk(", unit=%pdv%d", npc->unit->domain, npc->unit->unit_id);
+    if ( cpu_is_nohz(cpu) )
+        printk(", nohz");
     printk("\n");
 
     /* current unit (nothing to say if that's the idle unit) */
@@ -156,6 +156,8 @@ static inline void sched_set_res(struct sched_unit *unit,
         cpu = cpumask_next(cpu, res->cpus);
     }
 
+    if ( unit->res && unit->res != res )
+        unit->stats.migrations++;
     unit->res = res;
 }
 
@@ -328,6 +330,9 @@ struct scheduler {
                                     struct sched_unit *);
     void         (*yield)          (const struct scheduler *,
                                     struct sched_unit *);
+    void         (*yield_to)       (const struct scheduler *,
+                                    struct sched_unit *,
+                                    struct sched_unit *);
     void         (*context_saved)  (const struct scheduler *,
                                     struct sched_unit *);
 
@@ -460,6 +465,15 @@ static inline void sched_yield(const struct scheduler *s,
         s->yield(s, unit);
 }
 
+/* Let @target run ahead of @unit.  Called with @target's lock held. */
+static inline void sched_yield_to(const struct scheduler *s,
+                                  struct sched_unit *unit,
+                                  struct sched_unit *target)
+{
+    if ( s->yield_to )
+        s->yield_to(s, unit, target);
+}
+
 static inline void sched_context_saved(const struct scheduler *s,
                                        struct sched_unit *unit)
 {
@@ -13,6 +13,7 @@
 
 #include <xen/init.h>
 #include <xen/lib.h>
+#include <xen/param.h>
 #include <xen/sched.h>
 #include <xen/domain.h>
 #include <xen/delay.h>
@@ -65,27 +66,86 @@
  * When an UNIT has no task but with budget left, its budget is preserved.
  *
  * Queue scheme:
- * A global runqueue and a global depletedqueue for each CPU pool.
- * The runqueue holds all runnable UNITs with budget,
+ * The PCPUs of a CPU pool are grouped in clusters (see below), and there
+ * is a runqueue, a depletedqueue and a replenishment queue for each
+ * cluster. The runqueue holds all runnable UNITs with budget,
  * sorted by priority_level and deadline;
  * The depletedqueue holds all UNITs without budget, unsorted;
+ * EDF is global within a cluster: an UNIT can run on any PCPU of the
+ * cluster it is assigned to, but never on PCPUs of other clusters.
  *
  * Note: cpumask and cpupool is supported.
  */
 
 /*
  * Locking:
- * A global system lock is used to protect the RunQ and DepletedQ.
- * The global lock is referenced by sched_res->schedule_lock
- * from all physical cpus.
+ * Each cluster has a lock protecting its RunQ, DepletedQ and ReplQ, and
+ * the parameters of the UNITs assigned to it. The cluster lock is
+ * referenced by sched_res->schedule_lock from all the physical cpus of
+ * the cluster.
  *
  * The lock is already grabbed when calling wake/sleep/schedule/ functions
  * in schedule.c
  *
  * The functions involes RunQ and needs to grab locks are:
  *    unit_insert, unit_remove, context_saved, runq_insert
+ *
+ * The private lock of the scheduler protects the list of clusters and
+ * the list of domains. When both are needed, it must be taken before any
+ * cluster lock.
  */
 
+/*
+ * Cluster organization.
+ *
+ * With a single runqueue, every wakeup, block and replenishment in the
+ * pool contends on the same lock, and queue operations are linear in the
+ * number of UNITs of the whole pool. Grouping PCPUs in clusters, each
+ * with its own queues, lock and replenishment timer, bounds both to what
+ * is assigned to the cluster. Clusters can be formed of:
+ *
+ * - cpu: one cluster per PCPU, i.e., partitioned EDF;
+ * - core, socket or node: one cluster per physical core, socket or NUMA
+ *   node, i.e., clustered EDF;
+ * - all: one cluster for the whole pool, i.e., global EDF, as it has
+ *   always been (and is still the default).
+ *
+ * The arrangement is chosen with the rtds_cluster parameter. UNITs are
+ * assigned to the least utilized cluster they have affinity with when
+ * they are inserted in the scheduler, and only move to another cluster
+ * when they have to (e.g., when their affinity changes).
+ */
+#define OPT_CLUSTER_CPU     0
+#define OPT_CLUSTER_CORE    1
+#define OPT_CLUSTER_SOCKET  2
+#define OPT_CLUSTER_NODE    3
+#define OPT_CLUSTER_ALL     4
+static const char *const opt_cluster_str[] = {
+    [OPT_CLUSTER_CPU] = "cpu",
+    [OPT_CLUSTER_CORE] = "core",
+    [OPT_CLUSTER_SOCKET] = "socket",
+    [OPT_CLUSTER_NODE] = "node",
+    [OPT_CLUSTER_ALL] = "all"
+};
+static int __read_mostly opt_cluster = OPT_CLUSTER_ALL;
+
+static int __init parse_rtds_cluster(const char *s)
+{
+    unsigned int i;
+
+    for ( i = 0; i < ARRAY_SIZE(opt_cluster_str); i++ )
+    {
+        if ( !strcmp(s, opt_cluster_str[i]) )
+        {
+            opt_cluster = i;
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+custom_param("rtds_cluster", parse_rtds_cluster);
+
 
 /*
  * Default parameters:
@@ -118,6 +178,12 @@
  */
 #define UPDATE_LIMIT_SHIFT      10
 
+/*
+ * Utilization (budget / period) of UNITs and clusters is kept in fixed
+ * point, with an UNIT that never gives up its PCPU worth 1 << UTIL_SHIFT.
+ */
+#define UTIL_SHIFT              16
+
 /*
  * Flags
  */
@@ -172,17 +238,18 @@
 #define TRC_RTDS_BUDGET_REPLENISH TRC_SCHED_CLASS_EVT(RTDS, 4)
 #define TRC_RTDS_SCHED_TASKLET    TRC_SCHED_CLASS_EVT(RTDS, 5)
 #define TRC_RTDS_SCHEDULE         TRC_SCHED_CLASS_EVT(RTDS, 6)
+#define TRC_RTDS_SCHED_DONE       TRC_SCHED_CLASS_EVT(RTDS, 7)
 
 static void repl_timer_handler(void *data);
 
 /*
- * System-wide private data, include global RunQueue/DepletedQ
- * Global lock is referenced by sched_res->schedule_lock from all
- * physical cpus. It can be grabbed via unit_schedule_lock_irq()
+ * Cluster data, include the cluster's RunQueue/DepletedQ/ReplQ.
+ * The cluster lock is referenced by sched_res->schedule_lock from all
+ * the physical cpus of the cluster. It can be grabbed via
+ * unit_schedule_lock_irq()
  */
-struct rt_private {
-    spinlock_t lock;            /* the global coarse-grained lock */
-    struct list_head sdom;      /* list of availalbe domains, used for dump */
+struct rt_cluster {
+    spinlock_t lock;            /* protects the queues of the cluster */
 
     struct list_head runq;      /* ordered list of runnable units */
     struct list_head depletedq; /* unordered list of depleted units */
@@ -190,7 +257,34 @@ struct rt_private {
     struct timer repl_timer;    /* replenishment timer */
     struct list_head replq;     /* ordered list of units that need replenishment */
 
+    cpumask_t active;           /* cpus of the cluster */
     cpumask_t tickled;          /* cpus been tickled */
+
+    unsigned long util;         /* total utilization of the units */
+    unsigned int nr_units;      /* units assigned to the cluster */
+
+    struct list_head cl_elem;   /* on rt_private's list of clusters */
+    unsigned int id;            /* cluster ID, used for dump */
+    unsigned int nr_cpus;       /* cpus in active */
+    unsigned int refcnt;        /* cpus with pdata pointing to us */
+    unsigned int pick_bias;     /* cpu used for topology comparisons */
+};
+
+/*
+ * System-wide private data
+ */
+struct rt_private {
+    rwlock_t lock;              /* protects the lists below */
+    struct list_head sdom;      /* list of availalbe domains, used for dump */
+    struct list_head clusters;  /* list of clusters, ordered by ID */
+    cpumask_t initialized;      /* cpus that are part of a cluster */
+};
+
+/*
+ * Physical CPU
+ */
+struct rt_pcpu {
+    struct rt_cluster *cl;      /* cluster this cpu belongs to */
 };
 
 /*
@@ -216,6 +310,8 @@ struct rt_unit {
     unsigned priority_level;
 
     unsigned flags;              /* mark __RTDS_scheduled, etc.. */
+
+    unsigned long util;          /* budget / period, see UTIL_SHIFT */
 };
 
 /*
@@ -239,19 +335,21 @@ static inline struct rt_unit *rt_unit(const struct sched_unit *unit)
     return unit->priv;
 }
 
-static inline struct list_head *rt_runq(const struct scheduler *ops)
+static inline struct rt_pcpu *rt_pcpu(unsigned int cpu)
 {
-    return &rt_priv(ops)->runq;
+    return get_sched_res(cpu)->sched_priv;
 }
 
-static inline struct list_head *rt_depletedq(const struct scheduler *ops)
+/* The cluster a cpu (which must be one of ours) belongs to. */
+static inline struct rt_cluster *rt_cpu_cluster(unsigned int cpu)
 {
-    return &rt_priv(ops)->depletedq;
+    return rt_pcpu(cpu)->cl;
 }
 
-static inline struct list_head *rt_replq(const struct scheduler *ops)
+/* The cluster an unit is assigned to. */
+static inline struct rt_cluster *rt_unit_cluster(const struct rt_unit *svc)
 {
-    return &rt_priv(ops)->replq;
+    return rt_cpu_cluster(sched_unit_master(svc->unit));
 }
 
 static inline bool has_extratime(const struct rt_unit *svc)
@@ -259,6 +357,28 @@ static inline bool has_extratime(const struct rt_unit *svc)
     return svc->flags & RTDS_extratime;
 }
 
+static unsigned long unit_util(const struct rt_unit *svc)
+{
+    /* Shifting budgets this large would overflow, but periods are too. */
+    if ( svc->budget >> (63 - UTIL_SHIFT) )
+        return svc->budget / (svc->period >> UTIL_SHIFT);
+
+    return (svc->budget << UTIL_SHIFT) / svc->period;
+}
+
+/*
+ * Update the utilization of an unit after its parameters changed, and the
+ * one of the cluster it is assigned to. The cluster lock must be held.
+ */
+static void update_util(struct rt_unit *svc)
+{
+    struct rt_cluster *cl = rt_unit_cluster(svc);
+
+    cl->util -= svc->util;
+    svc->util = unit_util(svc);
+    cl->util += svc->util;
+}
+
 /*
  * Helper functions for manipulating the runqueue, the depleted queue,
  * and the replenishment events queue.
@@ -351,58 +471,70 @@ rt_dump_unit(const struct scheduler *ops, const struct rt_unit *svc)
 static void
 rt_dump_pcpu(const struct scheduler *ops, int cpu)
 {
-    struct rt_private *prv = rt_priv(ops);
     const struct rt_unit *svc;
+    spinlock_t *lock;
     unsigned long flags;
 
-    spin_lock_irqsave(&prv->lock, flags);
-    printk("CPU[%02d]\n", cpu);
+    lock = pcpu_schedule_lock_irqsave(cpu, &flags);
+    printk("CPU[%02d] cluster=%u\n", cpu, rt_cpu_cluster(cpu)->id);
     /* current UNIT (nothing to say if that's the idle unit). */
     svc = rt_unit(curr_on_cpu(cpu));
     if ( svc && !is_idle_unit(svc->unit) )
     {
         rt_dump_unit(ops, svc);
     }
-    spin_unlock_irqrestore(&prv->lock, flags);
+    pcpu_schedule_unlock_irqrestore(lock, flags, cpu);
 }
 
 static void
 rt_dump(const struct scheduler *ops)
 {
-    struct list_head *runq, *depletedq, *replq, *iter;
+    struct list_head *iter;
     struct rt_private *prv = rt_priv(ops);
+    struct rt_cluster *cl;
     const struct rt_unit *svc;
     const struct rt_dom *sdom;
     unsigned long flags;
 
-    spin_lock_irqsave(&prv->lock, flags);
+    read_lock_irqsave(&prv->lock, flags);
+
+    printk("Cluster arrangement: %s\n", opt_cluster_str[opt_cluster]);
 
     if ( list_empty(&prv->sdom) )
         goto out;
 
-    runq = rt_runq(ops);
-    depletedq = rt_depletedq(ops);
-    replq = rt_replq(ops);
-
-    printk("Global RunQueue info:\n");
-    list_for_each ( iter, runq )
+    list_for_each_entry ( cl, &prv->clusters, cl_elem )
     {
-        svc = q_elem(iter);
-        rt_dump_unit(ops, svc);
-    }
+        /* We need the lock to scan the queues. */
+        spin_lock(&cl->lock);
 
-    printk("Global DepletedQueue info:\n");
-    list_for_each ( iter, depletedq )
-    {
-        svc = q_elem(iter);
-        rt_dump_unit(ops, svc);
-    }
+        printk("Cluster %u: cpus=%*pbl units=%u utilization=%lu.%02lu\n",
+               cl->id, CPUMASK_PR(&cl->active), cl->nr_units,
+               cl->util >> UTIL_SHIFT,
+               ((cl->util & ((1UL << UTIL_SHIFT) - 1)) * 100) >> UTIL_SHIFT);
 
-    printk("Global Replenishment Events info:\n");
-    list_for_each ( iter, replq )
-    {
-        svc = replq_elem(iter);
-        rt_dump_unit(ops, svc);
+        printk("RunQueue info:\n");
+        list_for_each ( iter, &cl->runq )
+        {
+            svc = q_elem(iter);
+            rt_dump_unit(ops, svc);
+        }
+
+        printk("DepletedQueue info:\n");
+        list_for_each ( iter, &cl->depletedq )
+        {
+            svc = q_elem(iter);
+            rt_dump_unit(ops, svc);
+        }
+
+        printk("Replenishment Events info:\n");
+        list_for_each ( iter, &cl->replq )
+        {
+            svc = replq_elem(iter);
+            rt_dump_unit(ops, svc);
+        }
+
+        spin_unlock(&cl->lock);
     }
 
     printk("Domain info:\n");
@@ -415,13 +547,17 @@ rt_dump(const struct scheduler *ops)
 
         for_each_sched_unit ( sdom->dom, unit )
         {
+            spinlock_t *lock = unit_schedule_lock(unit);
+
             svc = rt_unit(unit);
             rt_dump_unit(ops, svc);
+
+            unit_schedule_unlock(lock, unit);
         }
     }
 
  out:
-    spin_unlock_irqrestore(&prv->lock, flags);
+    read_unlock_irqrestore(&prv->lock, flags);
 }
 
 /*
@@ -530,10 +666,9 @@ q_remove(struct rt_unit *svc)
 }
 
 static inline void
-replq_remove(const struct scheduler *ops, struct rt_unit *svc)
+replq_remove(struct rt_cluster *cl, struct rt_unit *svc)
 {
-    struct rt_private *prv = rt_priv(ops);
-    struct list_head *replq = rt_replq(ops);
+    struct list_head *replq = &cl->replq;
 
     ASSERT( unit_on_replq(svc) );
 
@@ -548,10 +683,10 @@ replq_remove(const struct scheduler *ops, struct rt_unit *svc)
         if ( !list_empty(replq) )
         {
             const struct rt_unit *svc_next = replq_elem(replq->next);
-            set_timer(&prv->repl_timer, svc_next->cur_deadline);
+            set_timer(&cl->repl_timer, svc_next->cur_deadline);
         }
         else
-            stop_timer(&prv->repl_timer);
+            stop_timer(&cl->repl_timer);
     }
 }
 
@@ -561,12 +696,11 @@ replq_remove(const struct scheduler *ops, struct rt_unit *svc)
  * Insert svc without budget in DepletedQ unsorted;
  */
 static void
-runq_insert(const struct scheduler *ops, struct rt_unit *svc)
+runq_insert(struct rt_cluster *cl, struct rt_unit *svc)
 {
-    struct rt_private *prv = rt_priv(ops);
-    struct list_head *runq = rt_runq(ops);
+    struct list_head *runq = &cl->runq;
 
-    ASSERT( spin_is_locked(&prv->lock) );
+    ASSERT( spin_is_locked(&cl->lock) );
     ASSERT( !unit_on_q(svc) );
     ASSERT( unit_on_replq(svc) );
 
@@ -575,14 +709,13 @@ runq_insert(const struct scheduler *ops, struct rt_unit *svc)
          has_extratime(svc) )
         deadline_runq_insert(svc, &svc->q_elem, runq);
     else
-        list_add(&svc->q_elem, &prv->depletedq);
+        list_add(&svc->q_elem, &cl->depletedq);
 }
 
 static void
-replq_insert(const struct scheduler *ops, struct rt_unit *svc)
+replq_insert(struct rt_cluster *cl, struct rt_unit *svc)
 {
-    struct list_head *replq = rt_replq(ops);
-    struct rt_private *prv = rt_priv(ops);
+    struct list_head *replq = &cl->replq;
 
     ASSERT( !unit_on_replq(svc) );
 
@@ -591,7 +724,7 @@ replq_insert(const struct scheduler *ops, struct rt_unit *svc)
      * at the front of the event list.
      */
     if ( deadline_replq_insert(svc, &svc->replq_elem, replq) )
-        set_timer(&prv->repl_timer, svc->cur_deadline);
+        set_timer(&cl->repl_timer, svc->cur_deadline);
 }
 
 /*
@@ -601,9 +734,9 @@ replq_insert(const struct scheduler *ops, struct rt_unit *svc)
  * changed.
  */
 static void
-replq_reinsert(const struct scheduler *ops, struct rt_unit *svc)
+replq_reinsert(struct rt_cluster *cl, struct rt_unit *svc)
 {
-    struct list_head *replq = rt_replq(ops);
+    struct list_head *replq = &cl->replq;
     const struct rt_unit *rearm_svc = svc;
     bool rearm = false;
 
@@ -628,28 +761,74 @@ replq_reinsert(const struct scheduler *ops, struct rt_unit *svc)
         rearm = deadline_replq_insert(svc, &svc->replq_elem, replq);
 
     if ( rearm )
-        set_timer(&rt_priv(ops)->repl_timer, rearm_svc->cur_deadline);
+        set_timer(&cl->repl_timer, rearm_svc->cur_deadline);
 }
 
 /*
  * Pick a valid resource for the unit vc
  * Valid resource of an unit is intesection of unit's affinity
  * and available resources
+ *
+ * Unless we are placing the unit for the first time, we stay on the cpu
+ * we are on or, if that's not possible, in the cluster we are in. If not
+ * even that is possible, or if we are placing the unit, the cluster with
+ * the lowest utilization is chosen among the ones we can run in.
  */
 static struct sched_resource *
-rt_res_pick_locked(const struct sched_unit *unit, unsigned int locked_cpu)
+rt_res_pick_locked(const struct scheduler *ops, const struct sched_unit *unit,
+                   unsigned int locked_cpu, bool place)
 {
+    struct rt_private *prv = rt_priv(ops);
     cpumask_t *cpus = cpumask_scratch_cpu(locked_cpu);
+    const struct rt_cluster *cl, *best = NULL;
     const cpumask_t *online;
-    int cpu;
+    unsigned int cpu = sched_unit_master(unit);
 
     online = cpupool_domain_master_cpumask(unit->domain);
     cpumask_and(cpus, online, unit->cpu_hard_affinity);
+    ASSERT( !cpumask_empty(cpus) );
+
+    if ( !place && cpumask_test_cpu(cpu, cpus) )
+        return get_sched_res(cpu);
+
+    /*
+     * We are holding a cluster lock already, so we can only try to take
+     * the private lock. If we fail, just go for any cpu we can run on,
+     * even if it is in another cluster.
+     */
+    if ( !read_trylock(&prv->lock) )
+        goto out;
+
+    if ( !place && cpumask_test_cpu(cpu, &prv->initialized) &&
+         cpumask_intersects(cpus, &rt_cpu_cluster(cpu)->active) )
+        best = rt_cpu_cluster(cpu);
+
+    if ( best == NULL )
+    {
+        /*
+         * Utilizations of other clusters are read without their locks
+         * held, which means we may be looking at slightly stale values.
+         * That is fine, as we are only trying to balance things a bit.
+         */
+        list_for_each_entry ( cl, &prv->clusters, cl_elem )
+        {
+            if ( !cpumask_intersects(cpus, &cl->active) )
+                continue;
+
+            if ( best == NULL ||
+                 read_atomic(&cl->util) < read_atomic(&best->util) )
+                best = cl;
+        }
+    }
 
-    cpu = cpumask_test_cpu(sched_unit_master(unit), cpus)
-            ? sched_unit_master(unit)
-            : cpumask_cycle(sched_unit_master(unit), cpus);
-    ASSERT( !cpumask_empty(cpus) && cpumask_test_cpu(cpu, cpus) );
+    if ( best != NULL )
+        cpumask_and(cpus, cpus, &best->active);
+
+    read_unlock(&prv->lock);
+
+ out:
+    cpu = cpumask_test_or_cycle(cpu, cpus);
+    ASSERT( cpu < nr_cpu_ids );
 
     return get_sched_res(cpu);
 }
@@ -664,7 +843,7 @@ rt_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
 {
     struct sched_resource *res;
 
-    res = rt_res_pick_locked(unit, unit->res->master_cpu);
+    res = rt_res_pick_locked(ops, unit, unit->res->master_cpu, false);
 
     return res;
 }
@@ -685,11 +864,9 @@ rt_init(struct scheduler *ops)
     if ( prv == NULL )
         goto err;
 
-    spin_lock_init(&prv->lock);
+    rwlock_init(&prv->lock);
     INIT_LIST_HEAD(&prv->sdom);
-    INIT_LIST_HEAD(&prv->runq);
-    INIT_LIST_HEAD(&prv->depletedq);
-    INIT_LIST_HEAD(&prv->replq);
+    INIT_LIST_HEAD(&prv->clusters);
 
     ops->sched_data = prv;
     rc = 0;
@@ -706,48 +883,173 @@ rt_deinit(struct scheduler *ops)
 {
     struct rt_private *prv = rt_priv(ops);
 
-    ASSERT(prv->repl_timer.status == TIMER_STATUS_invalid ||
-           prv->repl_timer.status == TIMER_STATUS_killed);
+    ASSERT(list_empty(&prv->clusters));
 
     ops->sched_data = NULL;
     xfree(prv);
 }
 
+static inline bool same_node(unsigned int cpua, unsigned int cpub)
+{
+    return cpu_to_node(cpua) == cpu_to_node(cpub);
+}
+
+static inline bool same_socket(unsigned int cpua, unsigned int cpub)
+{
+    return cpu_to_socket(cpua) == cpu_to_socket(cpub);
+}
+
+static inline bool same_core(unsigned int cpua, unsigned int cpub)
+{
+    return same_socket(cpua, cpub) &&
+           cpu_to_core(cpua) == cpu_to_core(cpub);
+}
+
+/* Find (or create) the cluster cpu belongs to, and take a reference. */
+static struct rt_cluster *
+cpu_add_to_cluster(struct rt_private *prv, unsigned int cpu)
+{
+    struct rt_cluster *cl, *cl_new;
+    struct list_head *cl_ins;
+    unsigned long flags;
+    unsigned int id = 0;
+    bool id_unused = false, cl_valid = false;
+
+    /* Prealloc in case we need it - not allowed with interrupts off. */
+    cl_new = xzalloc(struct rt_cluster);
+
+    write_lock_irqsave(&prv->lock, flags);
+
+    cl_ins = &prv->clusters;
+    list_for_each_entry ( cl, &prv->clusters, cl_elem )
+    {
+        unsigned int peer_cpu;
+
+        /* Remember first unused cluster ID. */
+        if ( !id_unused && cl->id > id )
+            id_unused = true;
+
+        peer_cpu = cl->pick_bias;
+        BUG_ON(cpu_to_socket(cpu) == XEN_INVALID_SOCKET_ID ||
+               cpu_to_socket(peer_cpu) == XEN_INVALID_SOCKET_ID);
+
+        /* OPT_CLUSTER_CPU will never find an existing cluster. */
+        if ( opt_cluster == OPT_CLUSTER_ALL ||
+             (opt_cluster == OPT_CLUSTER_CORE && same_core(peer_cpu, cpu)) ||
+             (opt_cluster == OPT_CLUSTER_SOCKET && same_socket(peer_cpu, cpu)) ||
+             (opt_cluster == OPT_CLUSTER_NODE && same_node(peer_cpu, cpu)) )
+        {
+            cl_valid = true;
+            break;
+        }
+
+        if ( !id_unused )
+        {
+            id++;
+            cl_ins = &cl->cl_elem;
+        }
+    }
+
+    if ( !cl_valid )
+    {
+        if ( !cl_new )
+        {
+            cl = ERR_PTR(-ENOMEM);
+            goto out;
+        }
+        cl = cl_new;
+        cl_new = NULL;
+
+        spin_lock_init(&cl->lock);
+        INIT_LIST_HEAD(&cl->runq);
+        INIT_LIST_HEAD(&cl->depletedq);
+        INIT_LIST_HEAD(&cl->replq);
+
+        list_add(&cl->cl_elem, cl_ins);
+        cl->pick_bias = cpu;
+        cl->id = id;
+    }
+
+    cl->refcnt++;
+
+ out:
+    write_unlock_irqrestore(&prv->lock, flags);
+
+    xfree(cl_new);
+
+    return cl;
+}
+
+static void *
+rt_alloc_pdata(const struct scheduler *ops, int cpu)
+{
+    struct rt_pcpu *spc;
+    struct rt_cluster *cl;
+
+    spc = xzalloc(struct rt_pcpu);
+    if ( spc == NULL )
+        return ERR_PTR(-ENOMEM);
+
+    cl = cpu_add_to_cluster(rt_priv(ops), cpu);
+    if ( IS_ERR(cl) )
+    {
+        xfree(spc);
+        return cl;
+    }
+
+    spc->cl = cl;
+
+    return spc;
+}
+
 /* Change the scheduler of cpu to us (RTDS). */
 static spinlock_t *
 rt_switch_sched(struct scheduler *new_ops, unsigned int cpu,
                 void *pdata, void *vdata)
 {
     struct rt_private *prv = rt_priv(new_ops);
+    struct rt_pcpu *spc = pdata;
     struct rt_unit *svc = vdata;
+    struct rt_cluster *cl;
 
-    ASSERT(!pdata && svc && is_idle_unit(svc->unit));
+    ASSERT(spc && svc && is_idle_unit(svc->unit));
 
     /*
      * We are holding the runqueue lock already (it's been taken in
      * schedule_cpu_switch()). It's actually the runqueue lock of
      * another scheduler, but that is how things need to be, for
-     * preventing races.
+     * preventing races. As it is not the lock of any of our clusters,
+     * it has no ordering relationship with our private lock.
      */
-    ASSERT(get_sched_res(cpu)->schedule_lock != &prv->lock);
+    ASSERT(!local_irq_is_enabled());
+    write_lock(&prv->lock);
+
+    cl = spc->cl;
+    ASSERT(get_sched_res(cpu)->schedule_lock != &cl->lock);
+    ASSERT(!cpumask_test_cpu(cpu, &cl->active));
 
     /*
-     * If we are the absolute first cpu being switched toward this
-     * scheduler (in which case we'll see TIMER_STATUS_invalid), or the
-     * first one that is added back to the cpupool that had all its cpus
-     * removed (in which case we'll see TIMER_STATUS_killed), it's our
+     * If we are the absolute first cpu of this cluster, or the first one
+     * that is added back to it after all its cpus were removed, it's our
      * job to (re)initialize the timer.
      */
-    if ( prv->repl_timer.status == TIMER_STATUS_invalid ||
-         prv->repl_timer.status == TIMER_STATUS_killed )
+    if ( !cl->nr_cpus )
     {
-        init_timer(&prv->repl_timer, repl_timer_handler, (void *)new_ops, cpu);
-        dprintk(XENLOG_DEBUG, "RTDS: timer initialized on cpu %u\n", cpu);
+        init_timer(&cl->repl_timer, repl_timer_handler, cl, cpu);
+        dprintk(XENLOG_DEBUG, "RTDS: cluster %u timer initialized on cpu %u\n",
+                cl->id, cpu);
+        cl->pick_bias = cpu;
     }
 
+    __cpumask_set_cpu(cpu, &cl->active);
+    __cpumask_set_cpu(cpu, &prv->initialized);
+    cl->nr_cpus++;
+
     sched_idle_unit(cpu)->priv = vdata;
 
-    return &prv->lock;
+    write_unlock(&prv->lock);
+
+    return &cl->lock;
 }
 
 static void
@@ -755,31 +1057,87 @@ rt_deinit_pdata(const struct scheduler *ops, void *pcpu, int cpu)
 {
     unsigned long flags;
     struct rt_private *prv = rt_priv(ops);
+    struct rt_pcpu *spc = pcpu;
+    struct rt_cluster *cl;
+    bool kill = false;
 
-    spin_lock_irqsave(&prv->lock, flags);
+    write_lock_irqsave(&prv->lock, flags);
 
-    if ( prv->repl_timer.cpu == cpu )
+    ASSERT(spc && spc->cl);
+    ASSERT(cpumask_test_cpu(cpu, &prv->initialized));
+
+    cl = spc->cl;
+
+    /* No need to save IRQs here, they're already disabled */
+    spin_lock(&cl->lock);
+
+    __cpumask_clear_cpu(cpu, &cl->active);
+    __cpumask_clear_cpu(cpu, &cl->tickled);
+    cl->nr_cpus--;
+
+    /*
+     * Make sure the timer run on one of the cpus that are still part of
+     * the cluster. If there aren't any left, it means it's the time to
+     * just kill it.
+     */
+    if ( !cl->nr_cpus )
+        kill = true;
+    else
     {
-        cpumask_t *online = get_sched_res(cpu)->cpupool->res_valid;
-        unsigned int new_cpu = cpumask_cycle(cpu, online);
+        if ( cl->repl_timer.cpu == cpu )
+            migrate_timer(&cl->repl_timer, cpumask_first(&cl->active));
+        if ( cl->pick_bias == cpu )
+            cl->pick_bias = cpumask_first(&cl->active);
+    }
 
-        /*
-         * Make sure the timer run on one of the cpus that are still available
-         * to this scheduler. If there aren't any left, it means it's the time
-         * to just kill it.
-         */
-        if ( new_cpu >= nr_cpu_ids )
-        {
-            kill_timer(&prv->repl_timer);
-            dprintk(XENLOG_DEBUG, "RTDS: timer killed on cpu %d\n", cpu);
-        }
-        else
-        {
-            migrate_timer(&prv->repl_timer, new_cpu);
-        }
+    spin_unlock(&cl->lock);
+
+    /*
+     * The timer handler takes the cluster lock, which hence must not be
+     * held while kill_timer() waits for a running handler to finish.
+     */
+    if ( kill )
+    {
+        kill_timer(&cl->repl_timer);
+        dprintk(XENLOG_DEBUG, "RTDS: cluster %u timer killed on cpu %d\n",
+                cl->id, cpu);
     }
 
-    spin_unlock_irqrestore(&prv->lock, flags);
+    __cpumask_clear_cpu(cpu, &prv->initialized);
+
+    write_unlock_irqrestore(&prv->lock, flags);
+}
+
+static void
+rt_free_pdata(const struct scheduler *ops, void *pcpu, int cpu)
+{
+    struct rt_private *prv = rt_priv(ops);
+    struct rt_pcpu *spc = pcpu;
+    struct rt_cluster *cl;
+    unsigned long flags;
+
+    if ( !spc )
+        return;
+
+    write_lock_irqsave(&prv->lock, flags);
+
+    cl = spc->cl;
+    ASSERT(cl && cl->refcnt);
+    ASSERT(!cpumask_test_cpu(cpu, &prv->initialized));
+
+    cl->refcnt--;
+    if ( !cl->refcnt )
+    {
+        ASSERT(!cl->nr_cpus);
+        list_del(&cl->cl_elem);
+    }
+    else
+        cl = NULL;
+
+    write_unlock_irqrestore(&prv->lock, flags);
+
+    xfree(cl);
+    xfree(spc);
 }
 
 static void *
@@ -797,9 +1155,9 @@ rt_alloc_domdata(const struct scheduler *ops, struct domain *dom)
     sdom->dom = dom;
 
     /* spinlock here to insert the dom */
-    spin_lock_irqsave(&prv->lock, flags);
+    write_lock_irqsave(&prv->lock, flags);
     list_add_tail(&sdom->sdom_elem, &(prv->sdom));
-    spin_unlock_irqrestore(&prv->lock, flags);
+    write_unlock_irqrestore(&prv->lock, flags);
 
     return sdom;
 }
@@ -814,9 +1172,9 @@ rt_free_domdata(const struct scheduler *ops, void *data)
     {
         unsigned long flags;
 
-        spin_lock_irqsave(&prv->lock, flags);
+        write_lock_irqsave(&prv->lock, flags);
         list_del_init(&sdom->sdom_elem);
-        spin_unlock_irqrestore(&prv->lock, flags);
+        write_unlock_irqrestore(&prv->lock, flags);
 
         xfree(sdom);
     }
@@ -843,7 +1201,10 @@ rt_alloc_udata(const struct scheduler *ops, struct sched_unit *unit, void *dd)
     svc->priority_level = 0;
     svc->period = RTDS_DEFAULT_PERIOD;
     if ( !is_idle_unit(unit) )
+    {
         svc->budget = RTDS_DEFAULT_BUDGET;
+        svc->util = unit_util(svc);
+    }
 
     SCHED_STAT_CRANK(unit_alloc);
 
@@ -869,6 +1230,7 @@ static void
 rt_unit_insert(const struct scheduler *ops, struct sched_unit *unit)
 {
     struct rt_unit *svc = rt_unit(unit);
+    struct rt_cluster *cl;
     s_time_t now;
     spinlock_t *lock;
     unsigned int cpu = smp_processor_id();
@@ -877,21 +1239,25 @@ rt_unit_insert(const struct scheduler *ops, struct sched_unit *unit)
 
     /* This is safe because unit isn't yet being scheduled */
     lock = pcpu_schedule_lock_irq(cpu);
-    sched_set_res(unit, rt_res_pick_locked(unit, cpu));
+    sched_set_res(unit, rt_res_pick_locked(ops, unit, cpu, true));
     pcpu_schedule_unlock_irq(lock, cpu);
 
     lock = unit_schedule_lock_irq(unit);
 
+    cl = rt_unit_cluster(svc);
+    cl->util += svc->util;
+    cl->nr_units++;
+
     now = NOW();
     if ( now >= svc->cur_deadline )
         rt_update_deadline(now, svc);
 
     if ( !unit_on_q(svc) && unit_runnable(unit) )
     {
-        replq_insert(ops, svc);
+        replq_insert(cl, svc);
 
         if ( !unit->is_running )
-            runq_insert(ops, svc);
+            runq_insert(cl, svc);
     }
     unit_schedule_unlock_irq(lock, unit);
 
@@ -906,6 +1272,7 @@ rt_unit_remove(const struct scheduler *ops, struct sched_unit *unit)
 {
     struct rt_unit * const svc = rt_unit(unit);
     struct rt_dom * const sdom = svc->sdom;
+    struct rt_cluster *cl;
     spinlock_t *lock;
 
     SCHED_STAT_CRANK(unit_remove);
@@ -913,15 +1280,63 @@ rt_unit_remove(const struct scheduler *ops, struct sched_unit *unit)
     BUG_ON( sdom == NULL );
 
     lock = unit_schedule_lock_irq(unit);
+    cl = rt_unit_cluster(svc);
+
     if ( unit_on_q(svc) )
         q_remove(svc);
 
     if ( unit_on_replq(svc) )
-        replq_remove(ops,svc);
+        replq_remove(cl, svc);
+
+    cl->util -= svc->util;
+    cl->nr_units--;
 
     unit_schedule_unlock_irq(lock, unit);
 }
 
+/*
+ * Move an unit to new_cpu. If that means changing cluster, the unit also
+ * moves from the queues of the old cluster to the ones of the new one.
+ * The locks of both are held by our caller.
+ */
+static void
+rt_unit_migrate(const struct scheduler *ops, struct sched_unit *unit,
+                unsigned int new_cpu)
+{
+    struct rt_unit * const svc = rt_unit(unit);
+    struct rt_cluster *ocl = rt_unit_cluster(svc);
+    struct rt_cluster *ncl = rt_cpu_cluster(new_cpu);
+    bool on_q, on_replq;
+
+    ASSERT(cpumask_test_cpu(new_cpu, unit->cpu_hard_affinity));
+
+    if ( ocl == ncl )
+    {
+        sched_set_res(unit, get_sched_res(new_cpu));
+        return;
+    }
+
+    on_q = unit_on_q(svc);
+    if ( on_q )
+        q_remove(svc);
+    on_replq = unit_on_replq(svc);
+    if ( on_replq )
+        replq_remove(ocl, svc);
+
+    ocl->util -= svc->util;
+    ocl->nr_units--;
+
+    sched_set_res(unit, get_sched_res(new_cpu));
+
+    ncl->util += svc->util;
+    ncl->nr_units++;
+
+    if ( on_replq )
+        replq_insert(ncl, svc);
+    if ( on_q )
+        runq_insert(ncl, svc);
+}
+
 /*
  * Burn budget in nanosecond granularity
  */
@@ -991,9 +1406,9 @@ burn_budget(const struct scheduler *ops, struct rt_unit *svc, s_time_t now)
  * lock is grabbed before calling this function
  */
 static struct rt_unit *
-runq_pick(const struct scheduler *ops, const cpumask_t *mask, unsigned int cpu)
+runq_pick(struct rt_cluster *cl, const cpumask_t *mask, unsigned int cpu)
 {
-    struct list_head *runq = rt_runq(ops);
+    struct list_head *runq = &cl->runq;
     struct list_head *iter;
     struct rt_unit *svc = NULL;
     struct rt_unit *iter_svc = NULL;
@@ -1048,7 +1463,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
 {
     const unsigned int cur_cpu = smp_processor_id();
     const unsigned int sched_cpu = sched_get_resource_cpu(cur_cpu);
-    struct rt_private *prv = rt_priv(ops);
+    struct rt_cluster *cl = rt_cpu_cluster(sched_cpu);
     struct rt_unit *const scurr = rt_unit(currunit);
     struct rt_unit *snext = NULL;
     bool migrated = false;
@@ -1060,7 +1475,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
         } d;
         d.cpu = cur_cpu;
         d.tasklet = tasklet_work_scheduled;
-        d.tickled = cpumask_test_cpu(sched_cpu, &prv->tickled);
+        d.tickled = cpumask_test_cpu(sched_cpu, &cl->tickled);
         d.idle = is_idle_unit(currunit);
         trace_var(TRC_RTDS_SCHEDULE, 1,
                   sizeof(d),
@@ -1068,7 +1483,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
     }
 
     /* clear ticked bit now that we've been scheduled */
-    cpumask_clear_cpu(sched_cpu, &prv->tickled);
+    cpumask_clear_cpu(sched_cpu, &cl->tickled);
 
     /* burn_budget would return for IDLE UNIT */
     burn_budget(ops, scurr, now);
@@ -1080,7 +1495,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
     }
     else
     {
-        snext = runq_pick(ops, cpumask_of(sched_cpu), cur_cpu);
+        snext = runq_pick(cl, cpumask_of(sched_cpu), cur_cpu);
 
         if ( snext == NULL )
             snext = rt_unit(sched_idle_unit(sched_cpu));
@@ -1123,6 +1538,21 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
     }
     currunit->next_task = snext->unit;
     snext->unit->migrated = migrated;
+
+    /* TRACE */
+    if ( unlikely(tb_init_done) )
+    {
+        struct __packed {
+            unsigned cpu:16, cluster:16;
+            uint32_t duration;
+        } d;
+        d.cpu = cur_cpu;
+        d.cluster = cl->id;
+        d.duration = min_t(s_time_t, NOW() - now, UINT32_MAX);
+        trace_var(TRC_RTDS_SCHED_DONE, 1,
+                  sizeof(d),
+                  (unsigned char *)&d);
+    }
 }
 
 /*
@@ -1142,7 +1572,7 @@ rt_unit_sleep(const struct scheduler *ops, struct sched_unit *unit)
     else if ( unit_on_q(svc) )
     {
         q_remove(svc);
-        replq_remove(ops, svc);
+        replq_remove(rt_unit_cluster(svc), svc);
     }
     else if ( svc->flags & RTDS_delayed_runq_add )
         __clear_bit(__RTDS_delayed_runq_add, &svc->flags);
@@ -1164,25 +1594,33 @@ rt_unit_sleep(const struct scheduler *ops, struct sched_unit *unit)
  * 1) what if these two units belongs to the same domain?
  *    replace an unit belonging to the same domain introduces more overhead
  *
+ * Only the cpus of the cluster the unit is assigned to are considered.
+ *
  * lock is grabbed before calling this function
  */
 static void
-runq_tickle(const struct scheduler *ops, const struct rt_unit *new)
+runq_tickle(struct rt_cluster *cl, const struct rt_unit *new)
 {
-    struct rt_private *prv = rt_priv(ops);
     const struct rt_unit *latest_deadline_unit = NULL; /* lowest priority */
     const struct rt_unit *iter_svc;
     const struct sched_unit *iter_unit;
     int cpu = 0, cpu_to_tickle = 0;
-    cpumask_t *not_tickled = cpumask_scratch_cpu(smp_processor_id());
+    cpumask_t *not_tickled;
     const cpumask_t *online;
 
     if ( new == NULL || is_idle_unit(new->unit) )
         return;
 
+    /*
+     * We may be running on a cpu of another cluster, whose scratch mask is
+     * not protected by the lock we hold. The one of new's cpu is.
+     */
+    not_tickled = cpumask_scratch_cpu(sched_unit_master(new->unit));
+
     online = cpupool_domain_master_cpumask(new->unit->domain);
     cpumask_and(not_tickled, online, new->unit->cpu_hard_affinity);
-    cpumask_andnot(not_tickled, not_tickled, &prv->tickled);
+    cpumask_and(not_tickled, not_tickled, &cl->active);
+    cpumask_andnot(not_tickled, not_tickled, &cl->tickled);
 
     /*
      * 1) If there are any idle CPUs, kick one.
@@ -1233,7 +1671,7 @@ runq_tickle(const struct scheduler *ops, const struct rt_unit *new)
                   (unsigned char *)&d);
     }
 
-    cpumask_set_cpu(cpu_to_tickle, &prv->tickled);
+    cpumask_set_cpu(cpu_to_tickle, &cl->tickled);
     cpu_raise_softirq(cpu_to_tickle, SCHEDULE_SOFTIRQ);
     return;
 }
@@ -1248,6 +1686,7 @@ static void
 rt_unit_wake(const struct scheduler *ops, struct sched_unit *unit)
 {
     struct rt_unit * const svc = rt_unit(unit);
+    struct rt_cluster *cl = rt_unit_cluster(svc);
     s_time_t now;
     bool missed;
 
@@ -1298,16 +1737,16 @@ rt_unit_wake(const struct scheduler *ops, struct sched_unit *unit)
          * and queue a new one (to occur at our new deadline).
          */
         if ( missed )
-           replq_reinsert(ops, svc);
+           replq_reinsert(cl, svc);
         return;
     }
 
     /* Replenishment event got cancelled when we blocked. Add it back. */
-    replq_insert(ops, svc);
+    replq_insert(cl, svc);
     /* insert svc to runq/depletedq because svc is not in queue now */
-    runq_insert(ops, svc);
+    runq_insert(cl, svc);
 
-    runq_tickle(ops, svc);
+    runq_tickle(cl, svc);
 }
 
 /*
@@ -1328,11 +1767,11 @@ rt_context_saved(const struct scheduler *ops, struct sched_unit *unit)
     if ( __test_and_clear_bit(__RTDS_delayed_runq_add, &svc->flags) &&
          likely(unit_runnable(unit)) )
     {
-        runq_insert(ops, svc);
-        runq_tickle(ops, svc);
+        runq_insert(rt_unit_cluster(svc), svc);
+        runq_tickle(rt_unit_cluster(svc), svc);
     }
     else
-        replq_remove(ops, svc);
+        replq_remove(rt_unit_cluster(svc), svc);
 
 out:
     unit_schedule_unlock_irq(lock, unit);
@@ -1347,9 +1786,9 @@ rt_dom_cntl(
     struct domain *d,
     struct xen_domctl_scheduler_op *op)
 {
-    struct rt_private *prv = rt_priv(ops);
     struct rt_unit *svc;
     const struct sched_unit *unit;
+    spinlock_t *lock;
     unsigned long flags;
     int rc = 0;
     struct xen_domctl_schedparam_vcpu local_sched;
@@ -1369,14 +1808,15 @@ rt_dom_cntl(
             rc = -EINVAL;
             break;
         }
-        spin_lock_irqsave(&prv->lock, flags);
         for_each_sched_unit ( d, unit )
         {
+            lock = unit_schedule_lock_irqsave(unit, &flags);
             svc = rt_unit(unit);
             svc->period = MICROSECS(op->u.rtds.period); /* transfer to nanosec */
             svc->budget = MICROSECS(op->u.rtds.budget);
+            update_util(svc);
+            unit_schedule_unlock_irqrestore(lock, flags, unit);
         }
-        spin_unlock_irqrestore(&prv->lock, flags);
         break;
     case XEN_DOMCTL_SCHEDOP_getvcpuinfo:
     case XEN_DOMCTL_SCHEDOP_putvcpuinfo:
@@ -1397,15 +1837,16 @@ rt_dom_cntl(
 
             if ( op->cmd == XEN_DOMCTL_SCHEDOP_getvcpuinfo )
             {
-                spin_lock_irqsave(&prv->lock, flags);
-                svc = rt_unit(d->vcpu[local_sched.vcpuid]->sched_unit);
+                unit = d->vcpu[local_sched.vcpuid]->sched_unit;
+                lock = unit_schedule_lock_irqsave(unit, &flags);
+                svc = rt_unit(unit);
                 local_sched.u.rtds.budget = svc->budget / MICROSECS(1);
                 local_sched.u.rtds.period = svc->period / MICROSECS(1);
                 if ( has_extratime(svc) )
                     local_sched.u.rtds.flags |= XEN_DOMCTL_SCHEDRT_extra;
                 else
                     local_sched.u.rtds.flags &= ~XEN_DOMCTL_SCHEDRT_extra;
-                spin_unlock_irqrestore(&prv->lock, flags);
+                unit_schedule_unlock_irqrestore(lock, flags, unit);
 
                 if ( copy_to_guest_offset(op->u.v.vcpus, index,
                                           &local_sched, 1) )
@@ -1425,15 +1866,17 @@ rt_dom_cntl(
                     break;
                 }
 
-                spin_lock_irqsave(&prv->lock, flags);
-                svc = rt_unit(d->vcpu[local_sched.vcpuid]->sched_unit);
+                unit = d->vcpu[local_sched.vcpuid]->sched_unit;
+                lock = unit_schedule_lock_irqsave(unit, &flags);
+                svc = rt_unit(unit);
                 svc->period = period;
                 svc->budget = budget;
+                update_util(svc);
                 if ( local_sched.u.rtds.flags & XEN_DOMCTL_SCHEDRT_extra )
                     __set_bit(__RTDS_extratime, &svc->flags);
                 else
                     __clear_bit(__RTDS_extratime, &svc->flags);
-                spin_unlock_irqrestore(&prv->lock, flags);
+                unit_schedule_unlock_irqrestore(lock, flags, unit);
             }
             /* Process a most 64 vCPUs without checking for preemptions. */
             if ( (++index > 63) && hypercall_preempt_check() )
@@ -1451,18 +1894,19 @@ rt_dom_cntl(
 /*
  * The replenishment timer handler picks units
  * from the replq and does the actual replenishment.
+ * There is one timer per cluster, dealing only with the units of the
+ * cluster, and running on one of its cpus.
  */
 static void repl_timer_handler(void *data){
     s_time_t now;
-    const struct scheduler *ops = data;
-    struct rt_private *prv = rt_priv(ops);
-    struct list_head *replq = rt_replq(ops);
-    struct list_head *runq = rt_runq(ops);
+    struct rt_cluster *cl = data;
+    struct list_head *replq = &cl->replq;
+    struct list_head *runq = &cl->runq;
     struct list_head *iter, *tmp;
     struct rt_unit *svc;
     LIST_HEAD(tmp_replq);
 
-    spin_lock_irq(&prv->lock);
+    spin_lock_irq(&cl->lock);
 
     now = NOW();
 
@@ -1486,7 +1930,7 @@ static void repl_timer_handler(void *data){
         if ( unit_on_q(svc) )
         {
             q_remove(svc);
-            runq_insert(ops, svc);
+            runq_insert(cl, svc);
         }
     }
 
@@ -1507,11 +1951,11 @@ static void repl_timer_handler(void *data){
             struct rt_unit *next_on_runq = q_elem(runq->next);
 
             if ( compare_unit_priority(svc, next_on_runq) < 0 )
-                runq_tickle(ops, next_on_runq);
+                runq_tickle(cl, next_on_runq);
         }
         else if ( __test_and_clear_bit(__RTDS_depleted, &svc->flags) &&
                   unit_on_q(svc) )
-            runq_tickle(ops, svc);
+            runq_tickle(cl, svc);
 
         list_del(&svc->replq_elem);
         deadline_replq_insert(svc, &svc->replq_elem, replq);
@@ -1523,9 +1967,9 @@ static void repl_timer_handler(void *data){
      * the one in the front.
      */
     if ( !list_empty(replq) )
-        set_timer(&prv->repl_timer, replq_elem(replq->next)->cur_deadline);
+        set_timer(&cl->repl_timer, replq_elem(replq->next)->cur_deadline);
 
-    spin_unlock_irq(&prv->lock);
+    spin_unlock_irq(&cl->lock);
 }
 
 static const struct scheduler sched_rtds_def = {
@@ -1539,7 +1983,9 @@ static const struct scheduler sched_rtds_def = {
     .init           = rt_init,
     .deinit         = rt_deinit,
     .switch_sched   = rt_switch_sched,
+    .alloc_pdata    = rt_alloc_pdata,
     .deinit_pdata   = rt_deinit_pdata,
+    .free_pdata     = rt_free_pdata,
     .alloc_domdata  = rt_alloc_domdata,
     .free_domdata   = rt_free_domdata,
     .alloc_udata    = rt_alloc_udata,
@@ -1550,6 +1996,7 @@ static const struct scheduler sched_rtds_def = {
     .adjust         = rt_dom_cntl,
 
     .pick_resource  = rt_res_pick,
+    .migrate        = rt_unit_migrate,
     .do_schedule    = rt_schedule,
     .sleep          = rt_unit_sleep,
     .wake           = rt_unit_wake,
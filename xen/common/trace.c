@@ -25,12 +25,13 @@
 #include <xen/trace.h>
 #include <xen/errno.h>
 #include <xen/event.h>
-#include <xen/tasklet.h>
 #include <xen/init.h>
 #include <xen/mm.h>
 #include <xen/percpu.h>
 #include <xen/pfn.h>
 #include <xen/cpu.h>
+#include <xen/softirq.h>
+#include <xen/vmap.h>
 #include <asm/atomic.h>
 #include <public/sysctl.h>
 
@@ -49,20 +50,46 @@ static unsigned int opt_tevt_mask;
 integer_param("tbuf_size", opt_tbuf_size);
 integer_param("tevt_mask", opt_tevt_mask);
 
+/* Overwrite the oldest records rather than dropping new ones when full. */
+static bool __read_mostly tb_overwrite;
+boolean_param("tbuf_overwrite", tb_overwrite);
+
 /* Pointers to the meta-data objects for all system trace buffers */
 static struct t_info *t_info;
 static unsigned int t_info_pages;
 
+/*
+ * Each CPU's trace pages are vmap()ed contiguously: struct t_buf at the
+ * start, followed by data_size bytes of records.
+ */
 static DEFINE_PER_CPU_READ_MOSTLY(struct t_buf *, t_bufs);
-static DEFINE_PER_CPU_READ_MOSTLY(spinlock_t, t_lock);
+static DEFINE_PER_CPU_READ_MOSTLY(unsigned char *, t_data);
 static u32 data_size __read_mostly;
 
+/*
+ * Records are written without locks, so that tracing works from any
+ * context, NMI included.  Only the local CPU writes its buffer, but a
+ * writer may be interrupted by another.  Space is reserved by advancing
+ * t_head with cmpxchg(), so nested writers never overlap.  buf->prod,
+ * which is what the consumer sees, is only moved up to t_head by the
+ * outermost writer.  Nested writers have always finished by then.
+ * t_reserved lets the outermost writer spot a writer which reserved
+ * space after it had published, and publish again.
+ */
+static DEFINE_PER_CPU(uint32_t, t_head);
+static DEFINE_PER_CPU(atomic_t, t_writers);
+static DEFINE_PER_CPU(atomic_t, t_reserved);
+
+/* Set when corrupt prod/cons are found, to be reported by the softirq. */
+static DEFINE_PER_CPU(bool, t_bogus);
+static DEFINE_PER_CPU(bool, t_notify);
+
 /* High water mark for trace buffers; */
 /* Send virtual interrupt when buffer level reaches this point */
 static u32 t_buf_highwater;
 
 /* Number of records lost due to per-CPU trace buffer being full. */
-static DEFINE_PER_CPU(unsigned long, lost_records);
+static DEFINE_PER_CPU(atomic_t, lost_records);
 static DEFINE_PER_CPU(unsigned long, lost_records_first_tsc);
 
 /* a flag recording whether initialization has been done */
@@ -79,21 +106,6 @@ static u32 tb_event_mask = TRC_ALL;
  * i.e., sizeof(_type) * ans >= _x. */
 #define fit_to_type(_type, _x) (((_x)+sizeof(_type)-1) / sizeof(_type))
 
-static int cpu_callback(
-    struct notifier_block *nfb, unsigned long action, void *hcpu)
-{
-    unsigned int cpu = (unsigned long)hcpu;
-
-    if ( action == CPU_UP_PREPARE )
-        spin_lock_init(&per_cpu(t_lock, cpu));
-
-    return NOTIFY_DONE;
-}
-
-static struct notifier_block cpu_nfb = {
-    .notifier_call = cpu_callback
-};
-
 static uint32_t calc_tinfo_first_offset(void)
 {
     int offset_in_bytes = offsetof(struct t_info, mfn_offset[NR_CPUS]);
@@ -177,6 +189,7 @@ static int alloc_trace_bufs(unsigned int pages)
     uint32_t *t_info_mfn_list;
     uint16_t t_info_first_offset;
     uint16_t offset;
+    mfn_t *mfns = NULL;
 
     if ( t_info )
         return -EBUSY;
@@ -189,6 +202,10 @@ static int alloc_trace_bufs(unsigned int pages)
 
     pages = calculate_tbuf_size(pages, t_info_first_offset);
 
+    mfns = xmalloc_array(mfn_t, pages);
+    if ( mfns == NULL )
+        goto out_fail;
+
     t_info = alloc_xenheap_pages(get_order_from_pages(t_info_pages), 0);
     if ( t_info == NULL )
         goto out_fail;
@@ -223,24 +240,41 @@ static int alloc_trace_bufs(unsigned int pages)
     }
 
     /*
-     * Initialize buffers for all of the cpus.
+     * Map the buffers for all of the cpus.  The pages need not be
+     * physically contiguous, but a contiguous mapping means records never
+     * have to be split across pages.
      */
     for_each_online_cpu(cpu)
     {
         struct t_buf *buf;
 
-        spin_lock_init(&per_cpu(t_lock, cpu));
-
         offset = t_info->mfn_offset[cpu];
 
+        for ( i = 0; i < pages; i++ )
+            mfns[i] = _mfn(t_info_mfn_list[offset + i]);
+
+        buf = vmap(mfns, pages);
+        if ( !buf )
+        {
+            printk(XENLOG_INFO "xentrace: failed to map buffer for cpu %d\n",
+                   cpu);
+            goto out_dealloc;
+        }
+
         /* Initialize the buffer metadata */
-        per_cpu(t_bufs, cpu) = buf = mfn_to_virt(t_info_mfn_list[offset]);
-        buf->cons = buf->prod = 0;
+        per_cpu(t_bufs, cpu) = buf;
+        per_cpu(t_data, cpu) = (unsigned char *)(buf + 1);
+        per_cpu(t_head, cpu) = buf->cons = buf->prod = 0;
 
         printk(XENLOG_INFO "xentrace: p%d mfn %x offset %u\n",
                    cpu, t_info_mfn_list[offset], offset);
+    }
+
+    /* Now share the trace pages */
+    for_each_online_cpu(cpu)
+    {
+        offset = t_info->mfn_offset[cpu];
 
-        /* Now share the trace pages */
         for ( i = 0; i < pages; i++ )
             share_xen_page_with_privileged_guests(
                 mfn_to_page(_mfn(t_info_mfn_list[offset + i])), SHARE_rw);
@@ -255,7 +289,10 @@ static int alloc_trace_bufs(unsigned int pages)
     t_buf_highwater = data_size >> 1; /* 50% high water */
     opt_tbuf_size = pages;
 
-    printk("xentrace: initialised\n");
+    xfree(mfns);
+
+    printk("xentrace: initialised%s\n",
+           tb_overwrite ? " (overwrite mode)" : "");
     smp_wmb(); /* above must be visible before tb_init_done flag set */
     tb_init_done = 1;
 
@@ -264,6 +301,13 @@ static int alloc_trace_bufs(unsigned int pages)
 out_dealloc:
     for_each_online_cpu(cpu)
     {
+        if ( per_cpu(t_bufs, cpu) )
+        {
+            vunmap(per_cpu(t_bufs, cpu));
+            per_cpu(t_bufs, cpu) = NULL;
+            per_cpu(t_data, cpu) = NULL;
+        }
+
         offset = t_info->mfn_offset[cpu];
         if ( !offset )
             continue;
@@ -279,6 +323,7 @@ out_dealloc:
     free_xenheap_pages(t_info, get_order_from_pages(t_info_pages));
     t_info = NULL;
 out_fail:
+    xfree(mfns);
     printk(XENLOG_WARNING "xentrace: allocation failed! Tracing disabled.\n");
     return -ENOMEM;
 }
@@ -333,6 +378,30 @@ int trace_will_trace_event(u32 event)
     return 1;
 }
 
+/*
+ * Notification is performed in a softirq to avoid deadlocks with contexts
+ * which __trace_var() may be called from (e.g., scheduler critical regions,
+ * or NMI handlers, where not even a tasklet may be scheduled).
+ */
+static void trace_softirq(void)
+{
+    const struct t_buf *buf = this_cpu(t_bufs);
+
+    if ( this_cpu(t_bogus) )
+    {
+        this_cpu(t_bogus) = false;
+        printk(XENLOG_WARNING
+               "trc#%u: bogus prod (%08x) and/or cons (%08x), tracing disabled\n",
+               smp_processor_id(), buf->prod, buf->cons);
+    }
+
+    if ( this_cpu(t_notify) )
+    {
+        this_cpu(t_notify) = false;
+        send_global_virq(VIRQ_TBUF);
+    }
+}
+
 /**
  * init_trace_bufs - performs initialization of the per-cpu trace buffers.
  *
@@ -343,7 +412,7 @@ int trace_will_trace_event(u32 event)
 void __init init_trace_bufs(void)
 {
     cpumask_setall(&tb_cpu_mask);
-    register_cpu_notifier(&cpu_nfb);
+    open_softirq(TRACE_SOFTIRQ, trace_softirq);
 
     if ( opt_tbuf_size )
     {
@@ -380,6 +449,8 @@ int tb_control(struct xen_sysctl_tbuf_op *tbc)
         tbc->evt_mask   = tb_event_mask;
         tbc->buffer_mfn = t_info ? virt_to_mfn(t_info) : 0;
         tbc->size = t_info_pages * PAGE_SIZE;
+        tbc->mode = tb_overwrite ? XEN_SYSCTL_TBUF_MODE_overwrite
+                                 : XEN_SYSCTL_TBUF_MODE_drop;
         break;
     case XEN_SYSCTL_TBUFOP_set_cpu_mask:
     {
@@ -415,19 +486,30 @@ int tb_control(struct xen_sysctl_tbuf_op *tbc)
         int i;
 
         tb_init_done = 0;
-        smp_wmb();
+        smp_mb();
         /* Clear any lost-record info so we don't get phantom lost records next time we
-         * start tracing.  Grab the lock to make sure we're not racing anyone.  After this
-         * hypercall returns, no more records should be placed into the buffers. */
+         * start tracing.  Wait for writers which saw tracing enabled to finish.  After
+         * this hypercall returns, no more records should be placed into the buffers. */
         for_each_online_cpu(i)
         {
-            unsigned long flags;
-            spin_lock_irqsave(&per_cpu(t_lock, i), flags);
-            per_cpu(lost_records, i)=0;
-            spin_unlock_irqrestore(&per_cpu(t_lock, i), flags);
+            while ( atomic_read(&per_cpu(t_writers, i)) )
+                cpu_relax();
+            atomic_set(&per_cpu(lost_records, i), 0);
         }
     }
         break;
+    case XEN_SYSCTL_TBUFOP_set_mode:
+        switch ( tbc->mode )
+        {
+        case XEN_SYSCTL_TBUF_MODE_drop:
+        case XEN_SYSCTL_TBUF_MODE_overwrite:
+            tb_overwrite = tbc->mode == XEN_SYSCTL_TBUF_MODE_overwrite;
+            break;
+        default:
+            rc = -EINVAL;
+            break;
+        }
+        break;
     default:
         rc = -EINVAL;
         break;
@@ -454,221 +536,226 @@ static inline bool_t bogus(u32 prod, u32 cons)
          unlikely(cons & 3) || unlikely(cons >= 2 * data_size) )
     {
         tb_init_done = 0;
-        printk(XENLOG_WARNING "trc#%u: bogus prod (%08x) and/or cons (%08x)\n",
-               smp_processor_id(), prod, cons);
+        this_cpu(t_bogus) = true;
+        raise_softirq(TRACE_SOFTIRQ);
         return 1;
     }
     return 0;
 }
 
-static inline u32 calc_unconsumed_bytes(const struct t_buf *buf)
+/* Bytes between cons and pos, which are offsets modulo 2*data_size. */
+static inline u32 ring_used(u32 pos, u32 cons)
 {
-    u32 prod = buf->prod, cons = buf->cons;
-    s32 x;
-
-    barrier(); /* must read buf->prod and buf->cons only once */
-    if ( bogus(prod, cons) )
-        return data_size;
+    s32 x = pos - cons;
 
-    x = prod - cons;
     if ( x < 0 )
         x += 2*data_size;
 
-    ASSERT(x >= 0);
-    ASSERT(x <= data_size);
-
     return x;
 }
 
-static inline u32 calc_bytes_to_wrap(const struct t_buf *buf)
+static inline u32 ring_add(u32 pos, u32 bytes)
+{
+    pos += bytes;
+    if ( pos >= 2*data_size )
+        pos -= 2*data_size;
+
+    return pos;
+}
+
+static inline struct t_rec *ring_rec(unsigned char *data, u32 pos)
+{
+    return (struct t_rec *)(data + (pos >= data_size ? pos - data_size : pos));
+}
+
+static inline u32 calc_unconsumed_bytes(const struct t_buf *buf)
 {
     u32 prod = buf->prod, cons = buf->cons;
-    s32 x;
+    u32 x;
 
     barrier(); /* must read buf->prod and buf->cons only once */
     if ( bogus(prod, cons) )
-        return 0;
+        return data_size;
 
-    x = data_size - prod;
-    if ( x <= 0 )
-        x += data_size;
+    x = ring_used(prod, cons);
 
-    ASSERT(x > 0);
     ASSERT(x <= data_size);
 
     return x;
 }
 
-static inline u32 calc_bytes_avail(const struct t_buf *buf)
+static void write_record(unsigned char *data, u32 pos, u32 event,
+                         unsigned int extra, bool_t cycles,
+                         const void *extra_data)
 {
-    return data_size - calc_unconsumed_bytes(buf);
+    struct t_rec *rec = ring_rec(data, pos);
+    uint32_t *dst;
+
+    rec->event = event;
+    rec->extra_u32 = extra / sizeof(u32);
+    dst = rec->u.nocycles.extra_u32;
+    if ( (rec->cycles_included = cycles) != 0 )
+    {
+        u64 tsc = (u64)get_cycles();
+        rec->u.cycles.cycles_lo = (uint32_t)tsc;
+        rec->u.cycles.cycles_hi = (uint32_t)(tsc >> 32);
+        dst = rec->u.cycles.extra_u32;
+    }
+
+    if ( extra_data && extra )
+        memcpy(dst, extra_data, extra);
 }
 
-static unsigned char *next_record(const struct t_buf *buf, uint32_t *next,
-                                 unsigned char **next_page,
-                                 uint32_t *offset_in_page)
+/* Pad from pos to the end of the buffer, which is size bytes away. */
+static void write_wrap_record(unsigned char *data, u32 pos, unsigned int size)
 {
-    u32 x = buf->prod, cons = buf->cons;
-    uint16_t per_cpu_mfn_offset;
-    uint32_t per_cpu_mfn_nr;
-    uint32_t *mfn_list;
-    uint32_t mfn;
-    unsigned char *this_page;
+    unsigned int extra_space = size - sizeof(u32);
+    bool_t cycles = 0;
 
-    barrier(); /* must read buf->prod and buf->cons only once */
-    *next = x;
-    if ( !tb_init_done || bogus(x, cons) )
-        return NULL;
-
-    if ( x >= data_size )
-        x -= data_size;
-
-    ASSERT(x < data_size);
-
-    /* add leading header to get total offset of next record */
-    x += sizeof(struct t_buf);
-    *offset_in_page = x & ~PAGE_MASK;
-
-    /* offset into array of mfns */
-    per_cpu_mfn_nr = x >> PAGE_SHIFT;
-    per_cpu_mfn_offset = t_info->mfn_offset[smp_processor_id()];
-    mfn_list = (uint32_t *)t_info;
-    mfn = mfn_list[per_cpu_mfn_offset + per_cpu_mfn_nr];
-    this_page = mfn_to_virt(mfn);
-    if (per_cpu_mfn_nr + 1 >= opt_tbuf_size)
-    {
-        /* reached end of buffer? */
-        *next_page = NULL;
-    }
-    else
+    /* We may need to add cycles to take up enough space... */
+    if ( (extra_space/sizeof(u32)) > TRACE_EXTRA_MAX )
     {
-        mfn = mfn_list[per_cpu_mfn_offset + per_cpu_mfn_nr + 1];
-        *next_page = mfn_to_virt(mfn);
+        cycles = 1;
+        extra_space -= sizeof(u64);
     }
-    return this_page;
+    ASSERT((extra_space/sizeof(u32)) <= TRACE_EXTRA_MAX);
+
+    write_record(data, pos, TRC_TRACE_WRAP_BUFFER, extra_space, cycles, NULL);
 }
 
-static inline void __insert_record(struct t_buf *buf,
-                                   unsigned long event,
-                                   unsigned int extra,
-                                   bool_t cycles,
-                                   unsigned int rec_size,
-                                   const void *extra_data)
+/*
+ * Overwrite mode: advance cons past the oldest records until at least
+ * bytes are free.  Only committed records (before prod) may be discarded.
+ * Returns false if that is not enough, or if cons moved under our feet, in
+ * which case the caller re-evaluates.  The consumer moves cons with
+ * cmpxchg() too, after copying the records out, so it never goes backwards
+ * and a copy which raced with us is detected and dropped by the consumer.
+ */
+static bool discard_records(struct t_buf *buf, unsigned char *data,
+                            u32 bytes)
 {
-    struct t_rec split_rec, *rec;
-    uint32_t *dst;
-    unsigned char *this_page, *next_page;
-    unsigned int extra_word = extra / sizeof(u32);
-    unsigned int local_rec_size = calc_rec_size(cycles, extra);
-    uint32_t next;
-    uint32_t offset;
-    uint32_t remaining;
-
-    BUG_ON(local_rec_size != rec_size);
-    BUG_ON(extra & 3);
-
-    this_page = next_record(buf, &next, &next_page, &offset);
-    if ( !this_page )
-        return;
+    u32 cons = read_atomic(&buf->cons), prod = read_atomic(&buf->prod);
+    u32 pos = cons, freed = 0;
 
-    remaining = PAGE_SIZE - offset;
+    if ( bogus(prod, cons) )
+        return false;
 
-    if ( unlikely(rec_size > remaining) )
+    while ( freed < bytes )
     {
-        if ( next_page == NULL )
-        {
-            /* access beyond end of buffer */
-            printk(XENLOG_WARNING
-                   "%s: size=%08x prod=%08x cons=%08x rec=%u remaining=%u\n",
-                   __func__, data_size, next, buf->cons, rec_size, remaining);
-            return;
-        }
-        rec = &split_rec;
-    } else {
-        rec = (struct t_rec*)(this_page + offset);
+        const struct t_rec *rec = ring_rec(data, pos);
+        unsigned int size;
+
+        if ( pos == prod )
+            return false;
+
+        size = calc_rec_size(rec->cycles_included,
+                             rec->extra_u32 * sizeof(u32));
+        pos = ring_add(pos, size);
+        freed += size;
     }
 
-    rec->event = event;
-    rec->extra_u32 = extra_word;
-    dst = rec->u.nocycles.extra_u32;
-    if ( (rec->cycles_included = cycles) != 0 )
-    {
-        u64 tsc = (u64)get_cycles();
-        rec->u.cycles.cycles_lo = (uint32_t)tsc;
-        rec->u.cycles.cycles_hi = (uint32_t)(tsc >> 32);
-        dst = rec->u.cycles.extra_u32;
-    } 
+    return cmpxchg(&buf->cons, cons, pos) == cons;
+}
 
-    if ( extra_data && extra )
-        memcpy(dst, extra_data, extra);
+/*
+ * Reserve rec_size bytes, padding to the end of the buffer first if the
+ * record would not fit before the wrap.  Returns the offset of the record,
+ * or -1 if there is no room.
+ */
+static s64 reserve_record(struct t_buf *buf, unsigned char *data,
+                          unsigned int rec_size)
+{
+    uint32_t *headp = &this_cpu(t_head);
+    u32 head, cons, next, to_wrap, pad, used;
 
-    if ( unlikely(rec_size > remaining) )
+    for ( ; ; )
     {
-        memcpy(this_page + offset, rec, remaining);
-        memcpy(next_page, (char *)rec + remaining, rec_size - remaining);
+        head = read_atomic(headp);
+        cons = read_atomic(&buf->cons);
+        if ( bogus(head, cons) )
+            return -1;
+
+        to_wrap = data_size - (head >= data_size ? head - data_size : head);
+        pad = rec_size > to_wrap ? to_wrap : 0;
+        used = ring_used(head, cons);
+
+        if ( used + pad + rec_size > data_size )
+        {
+            if ( tb_overwrite &&
+                 discard_records(buf, data,
+                                 used + pad + rec_size - data_size) )
+                continue;
+            if ( !tb_overwrite || read_atomic(&buf->cons) == cons )
+                return -1;
+            continue;
+        }
+
+        next = ring_add(head, pad + rec_size);
+        if ( cmpxchg(headp, head, next) == head )
+            break;
     }
 
-    smp_wmb();
+    atomic_inc(&this_cpu(t_reserved));
 
-    next += rec_size;
-    if ( next >= 2*data_size )
-        next -= 2*data_size;
-    ASSERT(next < 2*data_size);
-    buf->prod = next;
+    if ( pad )
+        write_wrap_record(data, head, pad);
+
+    return ring_add(head, pad);
 }
 
-static inline void insert_wrap_record(struct t_buf *buf,
-                                      unsigned int size)
+/*
+ * Make this CPU's reserved records visible to the consumer, if we are the
+ * outermost writer.  See the comment at t_head.
+ */
+static void commit_records(struct t_buf *buf)
 {
-    u32 space_left = calc_bytes_to_wrap(buf);
-    unsigned int extra_space = space_left - sizeof(u32);
-    bool_t cycles = 0;
-
-    BUG_ON(space_left > size);
+    atomic_t *writers = &this_cpu(t_writers);
+    atomic_t *reserved = &this_cpu(t_reserved);
+    int seen;
 
-    /* We may need to add cycles to take up enough space... */
-    if ( (extra_space/sizeof(u32)) > TRACE_EXTRA_MAX )
+ again:
+    seen = atomic_read(reserved);
+    if ( atomic_read(writers) == 1 )
     {
-        cycles = 1;
-        extra_space -= sizeof(u64);
-        ASSERT((extra_space/sizeof(u32)) <= TRACE_EXTRA_MAX);
+        smp_wmb(); /* Records must be visible before prod. */
+        write_atomic(&buf->prod, read_atomic(&this_cpu(t_head)));
     }
+    atomic_dec(writers);
 
-    __insert_record(buf, TRC_TRACE_WRAP_BUFFER, extra_space, cycles,
-                    space_left, NULL);
+    if ( unlikely(atomic_read(reserved) != seen) && !atomic_read(writers) )
+    {
+        atomic_inc(writers);
+        goto again;
+    }
 }
 
 #define LOST_REC_SIZE (4 + 8 + 16) /* header + tsc + sizeof(struct ed) */
 
-static inline void insert_lost_records(struct t_buf *buf)
+static bool insert_lost_records(struct t_buf *buf, unsigned char *data,
+                                unsigned int lost)
 {
     struct __packed {
         u32 lost_records;
         u16 did, vid;
         u64 first_tsc;
     } ed;
+    s64 pos = reserve_record(buf, data, LOST_REC_SIZE);
+
+    if ( pos < 0 )
+        return false;
 
     ed.vid = current->vcpu_id;
     ed.did = current->domain->domain_id;
-    ed.lost_records = this_cpu(lost_records);
+    ed.lost_records = lost;
     ed.first_tsc = this_cpu(lost_records_first_tsc);
 
-    this_cpu(lost_records) = 0;
+    atomic_sub(lost, &this_cpu(lost_records));
 
-    __insert_record(buf, TRC_LOST_RECORDS, sizeof(ed), 1 /* cycles */,
-                    LOST_REC_SIZE, &ed);
-}
+    write_record(data, pos, TRC_LOST_RECORDS, sizeof(ed), 1 /* cycles */,
+                 &ed);
 
-/*
- * Notification is performed in qtasklet to avoid deadlocks with contexts
- * which __trace_var() may be called from (e.g., scheduler critical regions).
- */
-static void trace_notify_dom0(void *unused)
-{
-    send_global_virq(VIRQ_TBUF);
+    return true;
 }
-static DECLARE_SOFTIRQ_TASKLET(trace_notify_dom0_tasklet,
-                               trace_notify_dom0, NULL);
 
 /**
  * __trace_var - Enters a trace tuple into the trace buffer for the current CPU.
@@ -677,17 +764,18 @@ static DECLARE_SOFTIRQ_TASKLET(trace_notify_dom0_tasklet,
  * @extra: size of additional trace data in bytes
  * @extra_data: pointer to additional trace data
  *
- * Logs a trace record into the appropriate buffer.
+ * Logs a trace record into the appropriate buffer.  Takes no locks, so may
+ * be called from any context, including NMI.
  */
 void __trace_var(u32 event, bool_t cycles, unsigned int extra,
                  const void *extra_data)
 {
     struct t_buf *buf;
-    unsigned long flags;
-    u32 bytes_to_tail, bytes_to_wrap;
-    unsigned int rec_size, total_size;
+    unsigned char *data;
+    unsigned int rec_size, lost;
     unsigned int extra_word;
     bool_t started_below_highwater;
+    s64 pos;
 
     if( !tb_init_done )
         return;
@@ -718,103 +806,53 @@ void __trace_var(u32 event, bool_t cycles, unsigned int extra,
     if ( !cpumask_test_cpu(smp_processor_id(), &tb_cpu_mask) )
         return;
 
-    /* Read tb_init_done /before/ t_bufs. */
-    smp_rmb();
+    atomic_inc(&this_cpu(t_writers));
 
-    spin_lock_irqsave(&this_cpu(t_lock), flags);
+    /* Read tb_init_done /before/ t_bufs, and recheck it after t_writers. */
+    smp_mb();
 
     buf = this_cpu(t_bufs);
+    data = this_cpu(t_data);
 
-    if ( unlikely(!buf) )
+    if ( unlikely(!buf) || unlikely(!tb_init_done) )
     {
-        /* Make gcc happy */
-        started_below_highwater = 0;
-        goto unlock;
+        atomic_dec(&this_cpu(t_writers));
+        return;
     }
 
     started_below_highwater = (calc_unconsumed_bytes(buf) < t_buf_highwater);
 
     /* Calculate the record size */
     rec_size = calc_rec_size(cycles, extra);
- 
-    /* How many bytes are available in the buffer? */
-    bytes_to_tail = calc_bytes_avail(buf);
-    
-    /* How many bytes until the next wrap-around? */
-    bytes_to_wrap = calc_bytes_to_wrap(buf);
-    
-    /* 
-     * Calculate expected total size to commit this record by
-     * doing a dry-run.
-     */
-    total_size = 0;
 
-    /* First, check to see if we need to include a lost_record.
-     */
-    if ( this_cpu(lost_records) )
-    {
-        if ( LOST_REC_SIZE > bytes_to_wrap )
-        {
-            total_size += bytes_to_wrap;
-            bytes_to_wrap = data_size;
-        } 
-        total_size += LOST_REC_SIZE;
-        bytes_to_wrap -= LOST_REC_SIZE;
-
-        /* LOST_REC might line up perfectly with the buffer wrap */
-        if ( bytes_to_wrap == 0 )
-            bytes_to_wrap = data_size;
-    }
-
-    if ( rec_size > bytes_to_wrap )
-    {
-        total_size += bytes_to_wrap;
-    } 
-    total_size += rec_size;
+    /* First, check to see if we need to include a lost_record. */
+    lost = atomic_read(&this_cpu(lost_records));
+    if ( unlikely(lost) && !insert_lost_records(buf, data, lost) )
+        goto lost;
 
-    /* Do we have enough space for everything? */
-    if ( total_size > bytes_to_tail )
-    {
-        if ( ++this_cpu(lost_records) == 1 )
-            this_cpu(lost_records_first_tsc)=(u64)get_cycles();
-        started_below_highwater = 0;
-        goto unlock;
-    }
-
-    /*
-     * Now, actually write information 
-     */
-    bytes_to_wrap = calc_bytes_to_wrap(buf);
-
-    if ( this_cpu(lost_records) )
-    {
-        if ( LOST_REC_SIZE > bytes_to_wrap )
-        {
-            insert_wrap_record(buf, LOST_REC_SIZE);
-            bytes_to_wrap = data_size;
-        } 
-        insert_lost_records(buf);
-        bytes_to_wrap -= LOST_REC_SIZE;
-
-        /* LOST_REC might line up perfectly with the buffer wrap */
-        if ( bytes_to_wrap == 0 )
-            bytes_to_wrap = data_size;
-    }
-
-    if ( rec_size > bytes_to_wrap )
-        insert_wrap_record(buf, rec_size);
+    pos = reserve_record(buf, data, rec_size);
+    if ( pos < 0 )
+        goto lost;
 
     /* Write the original record */
-    __insert_record(buf, event, extra, cycles, rec_size, extra_data);
+    write_record(data, pos, event, extra, cycles, extra_data);
+    goto commit;
+
+ lost:
+    if ( atomic_inc_return(&this_cpu(lost_records)) == 1 )
+        this_cpu(lost_records_first_tsc) = (u64)get_cycles();
+    started_below_highwater = 0;
 
-unlock:
-    spin_unlock_irqrestore(&this_cpu(t_lock), flags);
+ commit:
+    commit_records(buf);
 
     /* Notify trace buffer consumer that we've crossed the high water mark. */
-    if ( likely(buf!=NULL)
-         && started_below_highwater
-         && (calc_unconsumed_bytes(buf) >= t_buf_highwater) )
-        tasklet_schedule(&trace_notify_dom0_tasklet);
+    if ( started_below_highwater &&
+         (calc_unconsumed_bytes(buf) >= t_buf_highwater) )
+    {
+        this_cpu(t_notify) = true;
+        raise_softirq(TRACE_SOFTIRQ);
+    }
 }
 
 void __trace_hypercall(uint32_t event, unsigned long op,
@@ -34,6 +34,7 @@
 #define MAX_SAMPLING_RATE                       (500 * def_sampling_rate)
 #define DEF_SAMPLING_RATE_LATENCY_MULTIPLIER    (1000)
 #define TRANSITION_LATENCY_LIMIT                (10 * 1000 )
+#define NOHZ_SAMPLING_RATE                      (SECONDS(10))
 
 static uint64_t def_sampling_rate;
 static uint64_t usr_sampling_rate;
@@ -179,6 +180,21 @@ static void do_dbs_timer(void *dbs)
     if (!dbs_info->enable)
         return;
 
+    /*
+     * A nohz CPU is kept busy by a guest vCPU of its own, so don't keep
+     * sampling its load: run it at full speed, and only check once in a
+     * while whether it is still nohz.
+     */
+    if (cpu_is_nohz(dbs_info->cpu)) {
+        struct cpufreq_policy *policy = dbs_info->cur_policy;
+
+        if (policy->cur != policy->max)
+            __cpufreq_driver_target(policy, policy->max, CPUFREQ_RELATION_H);
+        set_timer(&per_cpu(dbs_timer, dbs_info->cpu),
+                  NOW() + NOHZ_SAMPLING_RATE);
+        return;
+    }
+
     dbs_check_cpu(dbs_info);
 
     set_timer(&per_cpu(dbs_timer, dbs_info->cpu),
@@ -109,6 +109,9 @@ struct shadow_domain {
 
     /* Shadow hashtable */
     struct page_info **hash_table;
+    unsigned int hash_buckets;  /* size of hash_table */
+    unsigned int hash_entries;  /* shadows currently in the table */
+    unsigned int hash_grow_at;  /* hash_entries to next try growing at */
     bool_t hash_walking;  /* Some function is walking the hash table */
 
     /* Fast MMIO path heuristic */
@@ -150,6 +153,9 @@ struct shadow_vcpu {
         mfn_t smfn[SHADOW_OOS_FIXUPS];
         unsigned long off[SHADOW_OOS_FIXUPS];
     } oos_fixup[SHADOW_OOS_PAGES];
+    /* Slots of the above in use, and unsyncs/evictions since last resize */
+    unsigned int oos_nr;
+    unsigned int oos_adds, oos_evicts;
 
     bool_t pagetable_dying;
 #endif
@@ -174,6 +180,18 @@ struct log_dirty_domain {
     unsigned int   allocs;
     unsigned int   failed_allocs;
 
+    /*
+     * Optional flat bitmaps covering pfns [0, flat_pfns), mappable read-only
+     * by the toolstack: a header page followed by two bitmaps of flat_frames
+     * pages each, all vmap()-ed.  Dirty pfns beyond go to the tree above,
+     * flat_overflow counting them since the last regular CLEAN.
+     */
+    struct xen_domctl_logdirty_bitmap_info *flat;
+    unsigned long  flat_pfns;
+    unsigned int   flat_frames;
+    unsigned int   flat_overflow;
+    bool           flat_used;
+
     /* log-dirty mode stats */
     unsigned int   fault_count;
     unsigned int   dirty_count;
@@ -310,6 +328,9 @@ struct arch_domain
     /* Continuable domain_relinquish_resources(). */
     unsigned int rel_priv;
     struct page_list_head relmem_list;
+    struct relmem_worker *relmem_workers;
+    unsigned int nr_relmem_workers;
+    atomic_t relmem_busy;       /* Workers still running. */
 
     const struct arch_csw {
         void (*from)(struct vcpu *);
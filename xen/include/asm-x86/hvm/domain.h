@@ -23,6 +23,7 @@
 #include <xen/list.h>
 #include <xen/mm.h>
 #include <xen/radix-tree.h>
+#include <xen/tasklet.h>
 
 #include <asm/hvm/io.h>
 #include <asm/hvm/vmx/vmcs.h>
@@ -74,6 +75,19 @@ struct mem_sharing_domain
      * to resume the search.
      */
     unsigned long next_shared_gfn_to_relinquish;
+
+    /* Background scan for zero filled pages, see mem_sharing.c. */
+    struct {
+        struct timer timer;
+        struct tasklet tasklet;     /* Does the scanning, see timer. */
+        bool timer_initialised;
+        unsigned int rate;          /* Pages per second, 0 when stopped. */
+        unsigned long next_gfn;
+        gfn_t gfn;                  /* Zero pages get shared with this one. */
+        uint64_t handle;
+        unsigned int nr_shared;     /* Pages shared with gfn so far. */
+        uint64_t scanned, found, shared, passes;
+    } zero;
 };
 #endif
 
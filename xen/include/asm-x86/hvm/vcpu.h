@@ -208,6 +208,13 @@ struct hvm_vcpu {
     struct x86_event     inject_event;
 
     struct viridian_vcpu *viridian;
+
+    /*
+     * Adaptive halt-polling: current poll window, and when the vCPU last
+     * blocked in HLT (0 if it hasn't since it last ran).
+     */
+    unsigned int        halt_poll_ns;
+    s_time_t            halt_blocked_at;
 };
 
 #endif /* __ASM_X86_HVM_VCPU_H__ */
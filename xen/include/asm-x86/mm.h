@@ -306,8 +306,13 @@ struct page_info
 
 #define PRtype_info "016lx"/* should only be used for printk's */
 
-/* The number of out-of-sync shadows we allow per vcpu (prime, please) */
-#define SHADOW_OOS_PAGES 3
+/*
+ * The number of out-of-sync shadows we allow per vcpu.  Each vcpu starts
+ * with SHADOW_OOS_PAGES_MIN and grows in steps of two up to SHADOW_OOS_PAGES
+ * when it keeps evicting (all sizes prime, please).
+ */
+#define SHADOW_OOS_PAGES_MIN 3
+#define SHADOW_OOS_PAGES 7
 
 /* OOS fixup entries */
 #define SHADOW_OOS_FIXUPS 2
@@ -28,6 +28,7 @@
 
 #include <xen/paging.h>
 #include <xen/mem_access.h>
+#include <xen/tasklet.h>
 #include <asm/mem_sharing.h>
 #include <asm/page.h>    /* for pagetable_t */
 
@@ -224,6 +225,9 @@ struct p2m_domain {
     /* Host p2m: Global log-dirty mode enabled for the domain. */
     bool               global_logdirty;
 
+    /* Host p2m: hardware accessed bits tracked (XEN_DOMCTL_sample_accessed) */
+    bool               accessed_tracking;
+
     /* Host p2m: when this flag is set, don't flush all the nested-p2m 
      * tables on every host-p2m change.  The setter of this flag 
      * is responsible for performing the full flush before releasing the
@@ -256,6 +260,12 @@ struct p2m_domain {
     void               (*enable_hardware_log_dirty)(struct p2m_domain *p2m);
     void               (*disable_hardware_log_dirty)(struct p2m_domain *p2m);
     void               (*flush_hardware_cached_dirty)(struct p2m_domain *p2m);
+    void               (*set_accessed_tracking)(struct p2m_domain *p2m,
+                                                bool enable);
+    unsigned int       (*sample_accessed)(struct p2m_domain *p2m,
+                                          unsigned long gfn,
+                                          unsigned int nr,
+                                          unsigned long *bitmap, bool clear);
     void               (*change_entry_type_global)(struct p2m_domain *p2m,
                                                    p2m_type_t ot,
                                                    p2m_type_t nt);
@@ -305,6 +315,19 @@ struct p2m_domain {
     unsigned long min_remapped_gfn;
     unsigned long max_remapped_gfn;
 
+    /*
+     * Alternate p2m's only: exit and split counters, reported through
+     * HVMOP_altp2m_get_view_stats.  Updated without the p2m lock held, so
+     * concurrent updates from several vCPUs may be lost.
+     */
+    struct {
+        unsigned long faults;
+        unsigned long propagated;
+        unsigned long propagated_super;
+        unsigned long violations;
+        unsigned long splits;
+    } altp2m_stats;
+
 #ifdef CONFIG_HVM
     /* Populate-on-demand variables
      * All variables are protected with the pod lock. We cannot rely on
@@ -321,6 +344,16 @@ struct p2m_domain {
         gfn_t            reclaim_single; /* Last gfn of a scan */
         gfn_t            max_guest;    /* gfn of max guest demand-populate */
 
+        /*
+         * Background reclaim, keeping the cache stocked ahead of demand:
+         * where the scan is at, and how many gfns it went through since it
+         * last found something.
+         */
+        struct tasklet   reclaim_tasklet;
+        gfn_t            reclaim_bg;
+        unsigned long    reclaim_idle;
+        unsigned long    reclaimed_bg;  /* Pages reclaimed in the background */
+
         /*
          * Tracking of the most recently populated PoD pages, for eager
          * reclamation.
@@ -626,6 +659,10 @@ void p2m_change_type_range(struct domain *d,
 int p2m_change_type_one(struct domain *d, unsigned long gfn,
                         p2m_type_t ot, p2m_type_t nt);
 
+/* Compare-exchange the types of a list of p2m entries, e.g. PML logged */
+void p2m_change_type_list(struct domain *d, const uint64_t *gfns,
+                          unsigned int nr, p2m_type_t ot, p2m_type_t nt);
+
 /* Synchronously change the p2m type for a range of gfns */
 int p2m_finish_type_change(struct domain *d,
                            gfn_t first_gfn,
@@ -746,6 +783,15 @@ int p2m_mem_paging_prep(struct domain *d, unsigned long gfn, uint64_t buffer);
 struct vm_event_st;
 void p2m_mem_paging_resume(struct domain *d, struct vm_event_st *rsp);
 
+/* Move a range of a domain's memory to a NUMA node (XEN_DOMCTL_numa_move) */
+struct xen_domctl_numa_move;
+int p2m_numa_move(struct domain *d, struct xen_domctl_numa_move *op);
+
+/* Sample the accessed bits of a domain's p2m (XEN_DOMCTL_sample_accessed) */
+struct xen_domctl_sample_accessed;
+int p2m_sample_accessed(struct domain *d,
+                        struct xen_domctl_sample_accessed *op);
+
 /* 
  * Internal functions, only called by other p2m code
  */
@@ -884,6 +930,15 @@ int p2m_init_altp2m_by_id(struct domain *d, unsigned int idx);
 int p2m_init_next_altp2m(struct domain *d, uint16_t *idx,
                          xenmem_access_t hvmmem_default_access);
 
+/* Create a copy of an alternate p2m, or continue filling one in */
+int p2m_clone_altp2m(struct domain *d, unsigned int src_idx, uint16_t *idx,
+                     uint64_t *next_gfn);
+
+/* Read the exit and split counters of an alternate p2m */
+struct xen_hvm_altp2m_view_stats;
+int p2m_get_altp2m_stats(struct domain *d,
+                         struct xen_hvm_altp2m_view_stats *stats);
+
 /* Make a specific alternate p2m invalid */
 int p2m_destroy_altp2m_by_id(struct domain *d, unsigned int idx);
 
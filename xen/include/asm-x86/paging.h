@@ -169,11 +169,19 @@ void paging_log_dirty_init(struct domain *d, const struct log_dirty_ops *ops);
 void paging_mark_dirty(struct domain *d, mfn_t gmfn);
 /* mark a page as dirty with taking guest pfn as parameter */
 void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn);
+/* mark a batch of pages as dirty, e.g. drained from a PML buffer */
+void paging_mark_pfns_dirty(struct domain *d, const uint64_t *pfns,
+                            unsigned int nr);
 
 /* is this guest page dirty? 
  * This is called from inside paging code, with the paging lock held. */
 int paging_mfn_is_dirty(struct domain *d, mfn_t gmfn);
 
+/* XENMEM_resource_logdirty_bitmap frames, allocated on first use */
+int paging_log_dirty_get_frames(struct domain *d, unsigned int id,
+                                unsigned long frame, unsigned int nr_frames,
+                                xen_pfn_t mfn_list[]);
+
 /*
  * Log-dirty radix tree indexing:
  *   All tree nodes are PAGE_SIZE bytes, mapped on-demand.
@@ -36,6 +36,12 @@ PERFCOUNTER(exception_fixed,        "pre-exception fixed")
 
 PERFCOUNTER(guest_walk,            "guest pagetable walks")
 
+PERFCOUNTER(ept_sync,           "EPT syncs")
+PERFCOUNTER(ept_sync_deferred,  "EPT syncs deferred to p2m unlock")
+PERFCOUNTER(ept_sync_widening,  "EPT syncs skipped, access widened")
+PERFCOUNTER(ept_flush,          "EPT flushes")
+PERFCOUNTER(ept_flush_ipis,     "EPT flush IPIs")
+
 /* Shadow counters */
 PERFCOUNTER(shadow_alloc,          "calls to shadow_alloc")
 PERFCOUNTER(shadow_alloc_tlbflush, "shadow_alloc flushed TLBs")
@@ -76,6 +82,7 @@ PERFCOUNTER(shadow_hash_lookup_miss, "shadow hash misses")
 PERFCOUNTER(shadow_get_shadow_status, "calls to get_shadow_status")
 PERFCOUNTER(shadow_hash_inserts,   "calls to shadow_hash_insert")
 PERFCOUNTER(shadow_hash_deletes,   "calls to shadow_hash_delete")
+PERFCOUNTER(shadow_hash_resizes,   "shadow hash table grown")
 PERFCOUNTER(shadow_writeable,      "shadow removes write access")
 PERFCOUNTER(shadow_writeable_h_1,  "shadow writeable: 32b w2k3")
 PERFCOUNTER(shadow_writeable_h_2,  "shadow writeable: 32pae w2k3")
@@ -111,10 +118,25 @@ PERFCOUNTER(shadow_oos_fixup_evict,"shadow OOS fixup evictions")
 PERFCOUNTER(shadow_unsync,         "shadow OOS unsyncs")
 PERFCOUNTER(shadow_unsync_evict,   "shadow OOS evictions")
 PERFCOUNTER(shadow_resync,         "shadow OOS resyncs")
+PERFCOUNTER(shadow_oos_grow,       "shadow OOS set grown")
+PERFCOUNTER(shadow_oos_shrink,     "shadow OOS set shrunk")
+
+/*
+ * Cost of shadow faults: bucket n counts those of [2^(n+8), 2^(n+9)) cycles,
+ * the first and last buckets also take the faster and slower ones.
+ */
+#define SHADOW_FAULT_CYCLES_SIZE 16
+PERFCOUNTER_ARRAY(shadow_fault_cycles, "shadow_fault cycles (log2 - 8)",
+                  SHADOW_FAULT_CYCLES_SIZE)
 
 PERFCOUNTER(realmode_emulations, "realmode instructions emulated")
 PERFCOUNTER(realmode_exits,      "vmexits from realmode")
 
 PERFCOUNTER(pauseloop_exits, "vmexits from Pause-Loop Detection")
 
+PERFCOUNTER(hvm_halt_poll_ok,     "HVM halt polls ended by an interrupt")
+PERFCOUNTER(hvm_halt_poll_fail,   "HVM halt polls ending in a block")
+PERFCOUNTER(hvm_halt_poll_grow,   "HVM halt poll window grown")
+PERFCOUNTER(hvm_halt_poll_shrink, "HVM halt poll window shrunk")
+
 /*#endif*/ /* __XEN_PERFC_DEFN_H__ */
@@ -38,7 +38,7 @@
 #include "hvm/save.h"
 #include "memory.h"
 
-#define XEN_DOMCTL_INTERFACE_VERSION 0x00000012
+#define XEN_DOMCTL_INTERFACE_VERSION 0x00000013
 
 /*
  * NB. xen_domctl.domain is an IN/OUT parameter for this operation.
@@ -237,6 +237,37 @@ struct xen_domctl_getpageframeinfo3 {
   * writably by the hypervisor in the dirty bitmap.
   */
 #define XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL   (1 << 0)
+ /*
+  * Operate on the flat bitmaps mapped through XENMEM_resource_logdirty_bitmap
+  * instead of copying to @dirty_bitmap, which is ignored.  CLEAN makes the
+  * bitmap holding the pages dirtied so far the harvested one, and starts
+  * logging into the other one, which is cleared first: the caller must be
+  * done with the previously harvested bitmap by then.  PEEK leaves the
+  * bitmaps alone; the pages dirtied so far are in the one not harvested.
+  * @pages is set to the number of pfns covered by the bitmaps.
+  *
+  * Fails with -ENODATA if the bitmaps were never mapped, and with
+  * -EOVERFLOW (without any side effect besides the clearing) if pfns
+  * beyond the bitmaps have been dirtied, e.g. after the guest's memory
+  * map grew.  Regular CLEAN/PEEK calls keep covering all pfns.
+  */
+#define XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED  (1 << 1)
+
+/*
+ * Frame 0 of the XENMEM_resource_logdirty_bitmap resource.  It is followed
+ * by two bitmaps of @nr_frames frames each, bitmap 0 at frame 1 and bitmap 1
+ * at frame 1 + @nr_frames, covering pfns [0, @nr_pfns).  The resource has
+ * to be acquired before log-dirty mode is enabled; the pfn range is set at
+ * that point.
+ */
+struct xen_domctl_logdirty_bitmap_info {
+    uint64_aligned_t nr_pfns;
+    uint32_t nr_frames;
+    /* Bitmap filled until the last XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED CLEAN. */
+    uint32_t harvested;
+    /* Number of XEN_DOMCTL_SHADOW_LOGDIRTY_MAPPED CLEANs done so far. */
+    uint64_aligned_t generation;
+};
 
 struct xen_domctl_shadow_op_stats {
     uint32_t fault_count;
@@ -364,6 +395,13 @@ struct xen_domctl_sched_credit {
 struct xen_domctl_sched_credit2 {
     uint16_t weight;
     uint16_t cap;
+/*
+ * Is this domain in the latency class, i.e., should its vCPUs be allowed to
+ * preempt others as soon as they wake up, borrowing credit if necessary?
+ */
+#define _XEN_DOMCTL_SCHEDCR2_latency 0
+#define XEN_DOMCTL_SCHEDCR2_latency  (1U<<_XEN_DOMCTL_SCHEDCR2_latency)
+    uint32_t flags;
 };
 
 struct xen_domctl_sched_rtds {
@@ -867,12 +905,33 @@ struct xen_domctl_vm_event_op {
 /* XEN_DOMCTL_mem_sharing_op.
  * The CONTROL sub-domctl is used for bringup/teardown. */
 #define XEN_DOMCTL_MEM_SHARING_CONTROL          0
+/*
+ * ZERO_SCAN has Xen look for zero filled pages of the domain in the
+ * background, and share them copy-on-write with one frame.  Sharing must be
+ * enabled for the domain.  rate is the number of guest pages looked at per
+ * second, 0 stopping the scan and XEN_DOMCTL_MEM_SHARING_ZERO_RATE_KEEP
+ * leaving it as is.  The statistics of the scan are returned in any case.
+ */
+#define XEN_DOMCTL_MEM_SHARING_ZERO_SCAN        1
+
+#define XEN_DOMCTL_MEM_SHARING_ZERO_RATE_KEEP   (~0U)
+#define XEN_DOMCTL_MEM_SHARING_ZERO_RATE_MAX    (1U << 18)
+
+struct xen_domctl_mem_sharing_zero_scan {
+    uint32_t rate;              /* IN/OUT: pages per second */
+    uint32_t pad;
+    uint64_aligned_t scanned;   /* OUT: guest pages looked at */
+    uint64_aligned_t zero;      /* OUT: zero filled pages among them */
+    uint64_aligned_t shared;    /* OUT: pages the scan made shared */
+    uint64_aligned_t passes;    /* OUT: complete passes over the p2m */
+};
 
 struct xen_domctl_mem_sharing_op {
     uint8_t op; /* XEN_DOMCTL_MEM_SHARING_* */
 
     union {
         uint8_t enable;                   /* CONTROL */
+        struct xen_domctl_mem_sharing_zero_scan zero_scan; /* ZERO_SCAN */
     } u;
 };
 
@@ -1108,6 +1167,75 @@ struct xen_domctl_psr_alloc {
     uint64_t data;      /* IN/OUT */
 };
 
+/*
+ * XEN_DOMCTL_numa_move
+ *
+ * Replace the frames backing guest frames [gfn, end_gfn) of a translated
+ * domain by frames from NUMA node @node, copying their contents, so that
+ * the memory of a domain can follow its vCPUs to another node.  Frames
+ * already on @node are left alone, as are ones which aren't plain writable
+ * RAM and ones in use other than through the domain's own p2m (grant or
+ * foreign mappings, frames Xen has mapped, ...).  Superpage mappings are
+ * preserved where a superpage can be allocated on @node.  The domain is
+ * paused while its frames are being replaced.
+ *
+ * @gfn is advanced as frames are processed, and the counters are
+ * accumulated (callers zero them), so the operation can be resumed;
+ * it stops early once @max_moved frames (0 = no limit) have been
+ * replaced.  With XEN_DOMCTL_NUMA_MOVE_dry_run nothing is moved, and
+ * @nr_moved counts the frames which would be considered for moving.
+ *
+ * Returns -EOPNOTSUPP for domains using altp2m or with passed through
+ * devices, whose frames may be referenced by other page tables.
+ */
+struct xen_domctl_numa_move {
+#define XEN_DOMCTL_NUMA_MOVE_dry_run  (1U << 0)
+    uint32_t flags;               /* IN: XEN_DOMCTL_NUMA_MOVE_* */
+    uint32_t node;                /* IN: target node */
+    uint64_aligned_t gfn;         /* IN/OUT: next frame to process */
+    uint64_aligned_t end_gfn;     /* IN */
+    uint64_aligned_t max_moved;   /* IN */
+    uint64_aligned_t nr_local;    /* IN/OUT: frames found on @node */
+    uint64_aligned_t nr_moved;    /* IN/OUT: frames moved to @node */
+    uint64_aligned_t nr_busy;     /* IN/OUT: frames which couldn't be */
+};
+
+/*
+ * XEN_DOMCTL_sample_accessed
+ *
+ * Sample which guest frames in [gfn, end_gfn) of an HVM domain were
+ * accessed, from the accessed bits of the hardware assisted p2m, and clear
+ * them unless XEN_DOMCTL_SAMPLE_ACCESSED_peek is given.  Sampling at a
+ * fixed interval yields the set of frames used during it, i.e. the working
+ * set of the guest, at the cost of a p2m walk and a TLB flush per call.
+ *
+ * The first call turns on accessed bit tracking for the domain, until
+ * XEN_DOMCTL_SAMPLE_ACCESSED_stop is given.  Frames are reported as
+ * accessed by the first sample, and also after their mapping changed.
+ *
+ * Bit n of @bitmap is set if frame @gfn + n was accessed, with @gfn a
+ * multiple of 8.  @bitmap may be null when only the counters are wanted.
+ * @gfn is advanced and @bitmap moved on as frames are processed, and the
+ * counters are accumulated (callers zero them), so the operation can be
+ * resumed.
+ *
+ * Returns -EOPNOTSUPP without EPT A/D bit support, and for domains using
+ * altp2m or nested virtualization.  Returns -EBUSY, and turns tracking
+ * off, while the domain is monitored with mem_access: the A/D bits make
+ * guest page table walks count as writes, which would then fault.
+ */
+struct xen_domctl_sample_accessed {
+#define XEN_DOMCTL_SAMPLE_ACCESSED_peek  (1U << 0)
+#define XEN_DOMCTL_SAMPLE_ACCESSED_stop  (1U << 1)
+    uint32_t flags;               /* IN: XEN_DOMCTL_SAMPLE_ACCESSED_* */
+    uint32_t pad;
+    uint64_aligned_t gfn;         /* IN/OUT: next frame to sample */
+    uint64_aligned_t end_gfn;     /* IN */
+    XEN_GUEST_HANDLE_64(uint8) bitmap; /* IN/OUT: accessed frames */
+    uint64_aligned_t nr_ram;      /* IN/OUT: RAM frames sampled */
+    uint64_aligned_t nr_accessed; /* IN/OUT: ... of which were accessed */
+};
+
 /* XEN_DOMCTL_vuart_op */
 struct xen_domctl_vuart_op {
 #define XEN_DOMCTL_VUART_OP_INIT  0
@@ -1210,6 +1338,8 @@ struct xen_domctl {
 #define XEN_DOMCTL_vuart_op                      81
 #define XEN_DOMCTL_get_cpu_policy                82
 #define XEN_DOMCTL_set_cpu_policy                83
+#define XEN_DOMCTL_numa_move                     84
+#define XEN_DOMCTL_sample_accessed               85
 #define XEN_DOMCTL_gdbsx_guestmemio            1000
 #define XEN_DOMCTL_gdbsx_pausevcpu             1001
 #define XEN_DOMCTL_gdbsx_unpausevcpu           1002
@@ -1270,6 +1400,8 @@ struct xen_domctl {
         struct xen_domctl_monitor_op        monitor_op;
         struct xen_domctl_psr_alloc         psr_alloc;
         struct xen_domctl_vuart_op          vuart_op;
+        struct xen_domctl_numa_move         numa_move;
+        struct xen_domctl_sample_accessed   sample_accessed;
         uint8_t                             pad[128];
     } u;
 };
@@ -74,6 +74,7 @@
 #define EVTCHNOP_init_control    11
 #define EVTCHNOP_expand_array    12
 #define EVTCHNOP_set_priority    13
+#define EVTCHNOP_send_multi      14
 /* ` } */
 
 typedef uint32_t evtchn_port_t;
@@ -312,6 +313,23 @@ struct evtchn_set_priority {
 };
 typedef struct evtchn_set_priority evtchn_set_priority_t;
 
+/*
+ * EVTCHNOP_send_multi: As EVTCHNOP_send, for up to EVTCHN_SEND_MULTI_MAX
+ * local ports in one hypercall.
+ * NOTES:
+ *  1. A port which cannot be sent on is skipped and the remaining ports are
+ *     still notified.  The error for the first such port is returned.
+ *  2. Events destined for the same vcpu are queued together, so backends
+ *     should pass ports notifying the same guest next to each other.
+ */
+#define EVTCHN_SEND_MULTI_MAX 256
+struct evtchn_send_multi {
+    /* IN parameters. */
+    uint32_t nr_ports;
+    evtchn_port_t ports[XEN_FLEX_ARRAY_DIM];
+};
+typedef struct evtchn_send_multi evtchn_send_multi_t;
+
 /*
  * ` enum neg_errnoval
  * ` HYPERVISOR_event_channel_op_compat(struct evtchn_op *op)
@@ -313,6 +313,9 @@ typedef uint16_t grant_status_t;
 #define GNTTABOP_swap_grant_ref	      11
 #define GNTTABOP_cache_flush	      12
 #endif /* __XEN_INTERFACE_VERSION__ */
+#if __XEN_INTERFACE_VERSION__ >= 0x00040e00
+#define GNTTABOP_copy_sg              13
+#endif /* __XEN_INTERFACE_VERSION__ */
 /* ` } */
 
 /*
@@ -472,6 +475,48 @@ struct gnttab_copy {
 typedef struct gnttab_copy  gnttab_copy_t;
 DEFINE_XEN_GUEST_HANDLE(gnttab_copy_t);
 
+#if __XEN_INTERFACE_VERSION__ >= 0x00040e00
+/*
+ * GNTTABOP_copy_sg: Scatter-gather variant of GNTTABOP_copy.
+ * The argument array is a sequence of chains, each being a run of segments
+ * terminated by one with GNTCOPY_sg_last set.  Within a chain, segments
+ * with GNTCOPY_sg_dest set describe (in order) the destination buffer and
+ * the others the source buffer.  Both buffers must be of the same total
+ * length; data is copied between them regardless of segment boundaries.
+ * Each segment must lie within a single frame, all source segments of a
+ * chain must refer to the same domain, as must all destination segments.
+ * As for GNTTABOP_copy, only DOMID_SELF may be referenced by frame.
+ * A chain may consist of at most GNTTAB_COPY_SG_MAX_SEGS segments; all
+ * segments of a longer one fail with GNTST_bad_copy_arg.  On return,
+ * <status> of every segment of a chain holds the chain's result.
+ */
+#define GNTTAB_COPY_SG_MAX_SEGS   32
+
+#define _GNTCOPY_sg_gref          (0)
+#define GNTCOPY_sg_gref           (1<<_GNTCOPY_sg_gref)
+#define _GNTCOPY_sg_dest          (1)
+#define GNTCOPY_sg_dest           (1<<_GNTCOPY_sg_dest)
+#define _GNTCOPY_sg_last          (2)
+#define GNTCOPY_sg_last           (1<<_GNTCOPY_sg_last)
+
+struct gnttab_copy_sg {
+    /* IN parameters. */
+    union {
+        grant_ref_t ref;
+        uint64_t    gmfn;
+    } u;
+    domid_t       domid;
+    uint16_t      offset;
+    uint16_t      len;
+    uint16_t      flags;          /* GNTCOPY_sg_* */
+    /* OUT parameters. */
+    int16_t       status;
+    uint16_t      pad[3];
+};
+typedef struct gnttab_copy_sg gnttab_copy_sg_t;
+DEFINE_XEN_GUEST_HANDLE(gnttab_copy_sg_t);
+#endif /* __XEN_INTERFACE_VERSION__ */
+
 /*
  * GNTTABOP_query_size: Query the current and maximum sizes of the shared
  * grant table.
@@ -629,6 +674,21 @@ DEFINE_XEN_GUEST_HANDLE(gnttab_cache_flush_t);
 #define _GNTMAP_can_fail        (5)
 #define GNTMAP_can_fail         (1<<_GNTMAP_can_fail)
 
+ /*
+  * GNTMAP_persistent subflag:
+  *  0 => The mapping is torn down by the matching GNTTABOP_unmap_grant_ref.
+  *  1 => Xen tracks the mapping for re-use.  Further map requests with
+  *       identical <dom>, <ref>, <flags> and <host_addr> return the same
+  *       handle and take a reference on the existing mapping rather than
+  *       establishing a new one.  Unmapping the handle drops a reference;
+  *       only dropping the last one destroys the mapping (and needs a TLB
+  *       flush).  Re-use is refused with GNTST_bad_domain once the granting
+  *       domain is dying.  GNTTABOP_unmap_and_replace fails with
+  *       GNTST_general_error on such a handle.
+  */
+#define _GNTMAP_persistent      (6)
+#define GNTMAP_persistent       (1<<_GNTMAP_persistent)
+
 /*
  * Bits to be placed in guest kernel available PTE bits (architecture
  * dependent; only supported when XENFEAT_gnttab_map_avail_bits is set).
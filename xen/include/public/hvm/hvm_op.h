@@ -318,6 +318,43 @@ struct xen_hvm_altp2m_get_vcpu_p2m_idx {
     uint16_t altp2m_idx;
 };
 
+struct xen_hvm_altp2m_clone_p2m {
+    /* IN: view to copy */
+    uint16_t src_view;
+    /*
+     * OUT: the new view; IN when continuing (opaque != 0).  The view is
+     * destroyed again if the copy fails.
+     */
+    uint16_t view;
+    uint32_t pad;
+    /*
+     * Used for continuation purposes.
+     * Must be set to zero upon initial invocation.
+     */
+    uint64_t opaque;
+};
+typedef struct xen_hvm_altp2m_clone_p2m xen_hvm_altp2m_clone_p2m_t;
+DEFINE_XEN_GUEST_HANDLE(xen_hvm_altp2m_clone_p2m_t);
+
+struct xen_hvm_altp2m_view_stats {
+    /* IN: view */
+    uint16_t view;
+    uint16_t pad1;
+    uint32_t pad2;
+    /* OUT: EPT violation exits taken while running on the view */
+    uint64_t faults;
+    /* OUT: ... resolved by copying the host p2m entry into the view */
+    uint64_t propagated;
+    /* OUT: ... of which copied a superpage */
+    uint64_t propagated_super;
+    /* OUT: ... reported as access violations */
+    uint64_t violations;
+    /* OUT: superpages split to change the access of part of them */
+    uint64_t splits;
+};
+typedef struct xen_hvm_altp2m_view_stats xen_hvm_altp2m_view_stats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_hvm_altp2m_view_stats_t);
+
 struct xen_hvm_altp2m_op {
     uint32_t version;   /* HVMOP_ALTP2M_INTERFACE_VERSION */
     uint32_t cmd;
@@ -350,6 +387,14 @@ struct xen_hvm_altp2m_op {
 #define HVMOP_altp2m_get_p2m_idx          14
 /* Set the "Supress #VE" bit for a range of pages */
 #define HVMOP_altp2m_set_suppress_ve_multi 15
+/*
+ * Create a new view as a copy of an existing one, keeping the page order of
+ * its entries.  The new view may be switched to before the copy completes,
+ * frames not copied yet are then filled from the host p2m as usual.
+ */
+#define HVMOP_altp2m_clone_p2m            16
+/* Get the exit and superpage split counters of a view */
+#define HVMOP_altp2m_get_view_stats       17
     domid_t domain;
     uint16_t pad1;
     uint32_t pad2;
@@ -367,6 +412,8 @@ struct xen_hvm_altp2m_op {
         struct xen_hvm_altp2m_suppress_ve_multi    suppress_ve_multi;
         struct xen_hvm_altp2m_vcpu_disable_notify  disable_notify;
         struct xen_hvm_altp2m_get_vcpu_p2m_idx     get_vcpu_p2m_idx;
+        struct xen_hvm_altp2m_clone_p2m            clone_p2m;
+        struct xen_hvm_altp2m_view_stats           view_stats;
         uint8_t pad[64];
     } u;
 };
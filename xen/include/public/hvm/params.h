@@ -300,6 +300,14 @@
 #define XEN_HVM_MCA_CAP_LMCE   (xen_mk_ullong(1) << 0)
 #define XEN_HVM_MCA_CAP_MASK   XEN_HVM_MCA_CAP_LMCE
 
-#define HVM_NR_PARAMS 39
+/*
+ * Upper bound, in nanoseconds, of the window for which a vCPU executing HLT
+ * busy-waits for an interrupt before actually blocking.  The window adapts
+ * per vCPU between 0 and this value depending on how quickly previous halts
+ * were ended.  0 disables halt-polling.  Values above 1ms are rejected.
+ */
+#define HVM_PARAM_HALT_POLL_NS 39
+
+#define HVM_NR_PARAMS 40
 
 #endif /* __XEN_PUBLIC_HVM_PARAMS_H__ */
@@ -612,6 +612,8 @@ struct xen_mem_acquire_resource {
 
 #define XENMEM_resource_ioreq_server 0
 #define XENMEM_resource_grant_table 1
+#define XENMEM_resource_sched_stats 2
+#define XENMEM_resource_logdirty_bitmap 3
 
     /*
      * IN - a type-specific resource identifier, which must be zero
@@ -642,6 +644,17 @@ struct xen_mem_acquire_resource {
 #define XENMEM_resource_ioreq_server_frame_bufioreq 0
 #define XENMEM_resource_ioreq_server_frame_ioreq(n) (1 + (n))
 
+/*
+ * type == XENMEM_resource_sched_stats: the frames are read-only and, mapped
+ * contiguously, form an array of struct xen_sched_vcpu_stats (see sysctl.h)
+ * indexed by vcpu_id.
+ *
+ * type == XENMEM_resource_logdirty_bitmap: the frames are read-only and laid
+ * out as described with struct xen_domctl_logdirty_bitmap_info (see
+ * domctl.h), which is frame 0.  x86 only.  Fails with -E2BIG if the
+ * guest's memory map is too sparse for the bitmaps to be reasonably sized.
+ */
+
     /*
      * IN/OUT - If the tools domain is PV then, upon return, frame_list
      *          will be populated with the MFNs of the resource.
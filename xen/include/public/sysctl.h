@@ -68,6 +68,7 @@ struct xen_sysctl_tbuf_op {
 #define XEN_SYSCTL_TBUFOP_set_size     3
 #define XEN_SYSCTL_TBUFOP_enable       4
 #define XEN_SYSCTL_TBUFOP_disable      5
+#define XEN_SYSCTL_TBUFOP_set_mode     6
     uint32_t cmd;
     /* IN/OUT variables */
     struct xenctl_bitmap cpu_mask;
@@ -75,6 +76,14 @@ struct xen_sysctl_tbuf_op {
     /* OUT variables */
     uint64_aligned_t buffer_mfn;
     uint32_t size;  /* Also an IN variable! */
+    /*
+     * IN for set_mode, OUT for get_info.  In overwrite mode a full buffer
+     * loses its oldest records rather than new ones, so tracing can be left
+     * running and the buffers read once something of interest has happened.
+     */
+#define XEN_SYSCTL_TBUF_MODE_drop      0
+#define XEN_SYSCTL_TBUF_MODE_overwrite 1
+    uint32_t mode;
 };
 
 /*
@@ -1078,6 +1087,54 @@ typedef struct xen_sysctl_cpu_policy xen_sysctl_cpu_policy_t;
 DEFINE_XEN_GUEST_HANDLE(xen_sysctl_cpu_policy_t);
 #endif
 
+/*
+ * XEN_SYSCTL_sched_vcpu_stats
+ *
+ * Per-vCPU scheduling statistics, kept by the scheduler core for each
+ * scheduling unit.  With a scheduling granularity above 1 all vCPUs of a
+ * unit report the same values; @unit identifies the unit by the id of its
+ * first vCPU.  All times are in nanoseconds.
+ *
+ * @delay accumulates the time the unit was runnable but not running,
+ * broken down by the reason it had to wait.  delay[XEN_SCHED_DELAY_wake]
+ * divided by @wakeups is the average wake-to-run latency.
+ *
+ * The same records, indexed by vcpu_id, make up the frames returned by
+ * XENMEM_acquire_resource for XENMEM_resource_sched_stats.  There @version
+ * is odd while Xen is updating a record: readers must retry until they read
+ * the same even value before and after copying it.  Records in the frames
+ * are refreshed whenever the unit is scheduled in or out.  The sysctl
+ * returns a consistent snapshot with @version set to 0.
+ */
+#define XEN_SCHED_DELAY_wake     0 /* Woken up after blocking. */
+#define XEN_SCHED_DELAY_preempt  1 /* Descheduled while still runnable. */
+#define XEN_SCHED_DELAY_yield    2 /* Voluntarily yielded. */
+#define XEN_SCHED_DELAY_other    3 /* Unpaused, or brought online. */
+#define XEN_SCHED_DELAY_NR       4
+struct xen_sched_vcpu_stats {
+    uint32_t version;
+    uint32_t unit;
+    uint64_aligned_t preemptions;      /* Descheduled while runnable. */
+    uint64_aligned_t migrations;       /* Moved to another resource. */
+    uint64_aligned_t wakeups;          /* Wake-to-run latency samples. */
+    uint64_aligned_t wake_latency_max; /* Worst wake-to-run latency. */
+    uint64_aligned_t delay[XEN_SCHED_DELAY_NR];
+};
+typedef struct xen_sched_vcpu_stats xen_sched_vcpu_stats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sched_vcpu_stats_t);
+
+struct xen_sysctl_sched_vcpu_stats {
+    domid_t domid;                     /* IN */
+    uint16_t pad;                      /* IN: Must be zero. */
+    /*
+     * IN: Number of entries in @stats.
+     * OUT: Number of entries written, or the domain's number of vCPUs if
+     *      @stats is a NULL handle.
+     */
+    uint32_t nr_vcpus;
+    XEN_GUEST_HANDLE_64(xen_sched_vcpu_stats_t) stats; /* OUT */
+};
+
 struct xen_sysctl {
     uint32_t cmd;
 #define XEN_SYSCTL_readconsole                    1
@@ -1108,6 +1165,7 @@ struct xen_sysctl {
 #define XEN_SYSCTL_livepatch_op                  27
 #define XEN_SYSCTL_set_parameter                 28
 #define XEN_SYSCTL_get_cpu_policy                29
+#define XEN_SYSCTL_sched_vcpu_stats              30
     uint32_t interface_version; /* XEN_SYSCTL_INTERFACE_VERSION */
     union {
         struct xen_sysctl_readconsole       readconsole;
@@ -1136,6 +1194,7 @@ struct xen_sysctl {
         struct xen_sysctl_cpu_featureset    cpu_featureset;
         struct xen_sysctl_livepatch_op      livepatch;
         struct xen_sysctl_set_parameter     set_parameter;
+        struct xen_sysctl_sched_vcpu_stats  sched_vcpu_stats;
 #if defined(__i386__) || defined(__x86_64__)
         struct xen_sysctl_cpu_policy        cpu_policy;
 #endif
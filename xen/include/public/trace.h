@@ -117,6 +117,8 @@
 #define TRC_SCHED_SWITCH_INFNEXT (TRC_SCHED_VERBOSE + 15)
 #define TRC_SCHED_SHUTDOWN_CODE  (TRC_SCHED_VERBOSE + 16)
 #define TRC_SCHED_SWITCH_INFCONT (TRC_SCHED_VERBOSE + 17)
+#define TRC_SCHED_RENDEZVOUS     (TRC_SCHED_VERBOSE + 18)
+#define TRC_SCHED_YIELD_TO       (TRC_SCHED_VERBOSE + 19)
 
 #define TRC_DOM0_DOM_ADD         (TRC_DOM0_DOMOPS + 1)
 #define TRC_DOM0_DOM_REM         (TRC_DOM0_DOMOPS + 2)
@@ -312,6 +314,12 @@ struct t_buf {
      * This is done because addition modulo X breaks at 2^32 when X is not a
      * power of 2:
      *     (((2^32 - 1) % X) + 1) % X != (2^32) % X
+     *
+     * In overwrite mode Xen also advances CONS, past the oldest records,
+     * before reusing their space.  Consumers must then copy the records out
+     * first and only afterwards move CONS with a compare-and-exchange from
+     * the value they started from: if that fails, the copy may have been
+     * overwritten and is to be discarded.
      */
     uint32_t cons;   /* Offset of next item to be consumed by control tools. */
     uint32_t prod;   /* Offset of next item to be produced by Xen.           */
@@ -235,6 +235,45 @@ struct vcpu_register_time_memory_area {
 typedef struct vcpu_register_time_memory_area vcpu_register_time_memory_area_t;
 DEFINE_XEN_GUEST_HANDLE(vcpu_register_time_memory_area_t);
 
+/*
+ * Register a memory location in the guest address space for the
+ * vcpu_sched_hints structure, through which the vcpu tells the scheduler
+ * what it is busy waiting for.  The structure must be 4-byte aligned and
+ * not cross a page boundary.  As for VCPUOP_register_vcpu_info, @mfn is a
+ * gfn for translated guests, and this may be called only once per vcpu,
+ * either by the vcpu itself or while it is down.
+ */
+#define VCPUOP_register_sched_hints 14 /* arg == vcpu_register_sched_hints_t */
+struct vcpu_register_sched_hints {
+    uint64_t mfn;    /* mfn of page to place vcpu_sched_hints */
+    uint32_t offset; /* offset within page */
+    uint32_t rsvd;   /* must be zero */
+};
+typedef struct vcpu_register_sched_hints vcpu_register_sched_hints_t;
+DEFINE_XEN_GUEST_HANDLE(vcpu_register_sched_hints_t);
+
+struct vcpu_sched_hints {
+    /*
+     * VCPU_HINT_spinning: the vcpu is busy waiting for a lock held by vcpu
+     * @lock_holder.  SCHEDOP_yield and SCHEDOP_poll issued while this is set
+     * become directed: if @lock_holder has been preempted, the scheduler
+     * lets it run ahead of this vcpu.
+     *
+     * VCPU_HINT_polling: the vcpu is idle and polls
+     * vcpu_info->evtchn_upcall_pending, handling events itself, so Xen need
+     * not interrupt it when it sends it an event.  The flag must be clear
+     * whenever the vcpu blocks or halts, and the guest must recheck
+     * evtchn_upcall_pending after clearing it.
+     */
+#define _VCPU_HINT_spinning 0
+#define VCPU_HINT_spinning  (1U << _VCPU_HINT_spinning)
+#define _VCPU_HINT_polling  1
+#define VCPU_HINT_polling   (1U << _VCPU_HINT_polling)
+    uint32_t flags;
+    uint32_t lock_holder;
+};
+typedef struct vcpu_sched_hints vcpu_sched_hints_t;
+
 #endif /* __XEN_PUBLIC_VCPU_H__ */
 
 /*
@@ -155,6 +155,9 @@ int evtchn_reset(struct domain *d);
 struct evtchn_port_ops {
     void (*init)(struct domain *d, struct evtchn *evtchn);
     void (*set_pending)(struct vcpu *v, struct evtchn *evtchn);
+    /* Optional: set a batch of events pending on the same vcpu. */
+    void (*set_pending_multi)(struct vcpu *v, struct evtchn **evtchns,
+                              unsigned int nr);
     void (*clear_pending)(struct domain *d, struct evtchn *evtchn);
     void (*unmask)(struct domain *d, struct evtchn *evtchn);
     bool (*is_pending)(const struct domain *d, evtchn_port_t port);
@@ -182,6 +185,24 @@ static inline void evtchn_port_set_pending(struct domain *d,
     d->evtchn_port_ops->set_pending(d->vcpu[vcpu_id], evtchn);
 }
 
+static inline void evtchn_port_set_pending_multi(struct domain *d,
+                                                 unsigned int vcpu_id,
+                                                 struct evtchn **evtchns,
+                                                 unsigned int nr)
+{
+    struct vcpu *v = d->vcpu[vcpu_id];
+    unsigned int i;
+
+    if ( d->evtchn_port_ops->set_pending_multi )
+    {
+        d->evtchn_port_ops->set_pending_multi(v, evtchns, nr);
+        return;
+    }
+
+    for ( i = 0; i < nr; i++ )
+        d->evtchn_port_ops->set_pending(v, evtchns[i]);
+}
+
 static inline void evtchn_port_clear_pending(struct domain *d,
                                              struct evtchn *evtchn)
 {
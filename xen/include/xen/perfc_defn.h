@@ -13,15 +13,21 @@ PERFCOUNTER(irqs,                   "#interrupts")
 PERFCOUNTER(ipis,                   "#IPIs")
 
 PERFCOUNTER(rcu_idle_timer,         "RCU: idle_timer")
+PERFCOUNTER(rcu_nohz_offload,       "RCU: nohz callbacks offloaded")
+PERFCOUNTER(rcu_nohz_kick,          "RCU: nohz CPUs kicked")
 
 /* Generic scheduler counters (applicable to all schedulers) */
 PERFCOUNTER(sched_irq,              "sched: timer")
 PERFCOUNTER(sched_run,              "sched: runs through scheduler")
 PERFCOUNTER(sched_ctx,              "sched: context switches")
+PERFCOUNTER(sched_rdv_skip,         "sched: idle rendezvous skipped")
+PERFCOUNTER(sched_rdv_decided,      "sched: idle rendezvous decided")
 PERFCOUNTER(schedule,               "sched: specific scheduler")
 PERFCOUNTER(dom_init,               "sched: dom_init")
 PERFCOUNTER(dom_destroy,            "sched: dom_destroy")
 PERFCOUNTER(vcpu_yield,             "sched: vcpu_yield")
+PERFCOUNTER(vcpu_yield_to,          "sched: vcpu_yield_to lock holder")
+PERFCOUNTER(vcpu_kick_polling,      "sched: event kick of polling vcpu")
 PERFCOUNTER(unit_alloc,             "sched: unit_alloc")
 PERFCOUNTER(unit_insert,            "sched: unit_insert")
 PERFCOUNTER(unit_remove,            "sched: unit_remove")
@@ -73,6 +79,7 @@ PERFCOUNTER(pick_resource,          "csched2: pick_resource")
 PERFCOUNTER(need_fallback_cpu,      "csched2: need_fallback_cpu")
 PERFCOUNTER(migrated,               "csched2: migrated")
 PERFCOUNTER(migrate_resisted,       "csched2: migrate_resisted")
+PERFCOUNTER(migrate_cost_resisted,  "csched2: migrate_cost_resisted")
 PERFCOUNTER(credit_reset,           "csched2: credit_reset")
 PERFCOUNTER(deferred_to_tickled_cpu,"csched2: deferred_to_tickled_cpu")
 PERFCOUNTER(tickled_cpu_overwritten,"csched2: tickled_cpu_overwritten")
@@ -180,4 +180,6 @@ void rcu_barrier(void);
 void rcu_idle_enter(unsigned int cpu);
 void rcu_idle_exit(unsigned int cpu);
 
+void rcu_nohz_enter(unsigned int cpu);
+
 #endif /* __XEN_RCUPDATE_H */
@@ -248,6 +248,9 @@ struct vcpu
     /* Guest-specified relocation of vcpu_info. */
     mfn_t            vcpu_info_mfn;
 
+    /* Guest-registered scheduling hints (VCPUOP_register_sched_hints). */
+    struct vcpu_sched_hints *sched_hints;
+
     struct evtchn_fifo_vcpu *evtchn_fifo;
 
     /* vPCI per-vCPU area, used to store data for long running operations. */
@@ -288,10 +291,21 @@ struct sched_unit {
     s_time_t                next_time;
 
     /* Number of vcpus not yet joined for context switch. */
-    unsigned int            rendezvous_in_cnt;
+    atomic_t                rendezvous_in_cnt;
+    /* Joining vcpus don't wait, as next_task has been decided already. */
+    bool                    rendezvous_decided;
 
     /* Number of vcpus not yet finished with context switch. */
     atomic_t                rendezvous_out_cnt;
+
+    /* Scheduling statistics (XEN_SYSCTL_sched_vcpu_stats). */
+    struct xen_sched_vcpu_stats stats;
+    /* Time the unit became runnable without running (0: not waiting). */
+    s_time_t                runnable_since;
+    /* Why the unit is waiting (XEN_SCHED_DELAY_*). */
+    unsigned int            runnable_cause;
+    /* Unit yielded since it was last scheduled. */
+    bool                    yielded;
 };
 
 #define for_each_sched_unit(d, u)                                         \
@@ -349,6 +363,9 @@ struct domain
     void            *sched_priv;    /* scheduler-specific data */
     struct sched_unit *sched_unit_list;
     struct cpupool  *cpupool;
+    /* Copy of the units' statistics, mappable via XENMEM_acquire_resource. */
+    struct xen_sched_vcpu_stats *sched_stats;
+    unsigned int     sched_stats_order;
 
     struct domain   *next_in_list;
     struct domain   *next_in_hashbucket;
@@ -363,6 +380,8 @@ struct domain
     unsigned int     max_evtchn_port; /* max permitted port number */
     unsigned int     valid_evtchns;   /* number of allocated event channels */
     spinlock_t       event_lock;
+    /* Read by evtchn_send(); written when tearing down sendable bindings. */
+    percpu_rwlock_t  evtchn_send_lock;
     const struct evtchn_port_ops *evtchn_port_ops;
     struct evtchn_fifo_domain *evtchn_fifo;
 
@@ -683,6 +702,10 @@ int  sched_init_domain(struct domain *d, int poolid);
 void sched_destroy_domain(struct domain *d);
 long sched_adjust(struct domain *, struct xen_domctl_scheduler_op *);
 long sched_adjust_global(struct xen_sysctl_scheduler_op *);
+int  sched_vcpu_stats(struct xen_sysctl_sched_vcpu_stats *);
+int  sched_stats_get_frames(struct domain *d, unsigned int id,
+                            unsigned long frame, unsigned int nr_frames,
+                            xen_pfn_t mfn_list[]);
 int  sched_id(void);
 void vcpu_wake(struct vcpu *v);
 long vcpu_yield(void);
@@ -835,6 +858,18 @@ static inline bool vcpu_runnable(const struct vcpu *v)
              atomic_read(&v->domain->pause_count));
 }
 
+/*
+ * Is @v running and polling for events by itself (VCPU_HINT_polling)?  If
+ * so, there's no need to interrupt it to make it notice a new one.
+ */
+static inline bool vcpu_polling_events(const struct vcpu *v)
+{
+    const struct vcpu_sched_hints *hints = ACCESS_ONCE(v->sched_hints);
+
+    return hints && v->is_running &&
+           (ACCESS_ONCE(hints->flags) & VCPU_HINT_polling);
+}
+
 static inline bool is_vcpu_dirty_cpu(unsigned int cpu)
 {
     BUILD_BUG_ON(NR_CPUS >= VCPU_CPU_CLEAN);
@@ -911,6 +946,16 @@ static inline bool sched_has_urgent_vcpu(void)
     return atomic_read(&this_cpu(sched_urgent_count));
 }
 
+/*
+ * pCPUs dedicated to a single guest vCPU by the null scheduler (see
+ * "sched-null-nohz"), on which Xen keeps periodic work of its own away.
+ */
+extern cpumask_t sched_nohz_cpus;
+static inline bool cpu_is_nohz(unsigned int cpu)
+{
+    return cpumask_test_cpu(cpu, &sched_nohz_cpus);
+}
+
 void vcpu_set_periodic_timer(struct vcpu *v, s_time_t value);
 void sched_setup_dom0_vcpus(struct domain *d);
 int vcpu_temporary_affinity(struct vcpu *v, unsigned int cpu, uint8_t reason);
@@ -9,6 +9,7 @@ enum {
     NEW_TLBFLUSH_CLOCK_PERIOD_SOFTIRQ,
     RCU_SOFTIRQ,
     TASKLET_SOFTIRQ,
+    TRACE_SOFTIRQ,
     NR_COMMON_SOFTIRQS
 };
 
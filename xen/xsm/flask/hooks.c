@@ -744,6 +744,13 @@ static int flask_domctl(struct domain *d, int cmd)
     case XEN_DOMCTL_get_cpu_policy:
         return current_has_perm(d, SECCLASS_DOMAIN2, DOMAIN2__GET_CPU_POLICY);
 
+    case XEN_DOMCTL_numa_move:
+        return current_has_perm(d, SECCLASS_DOMAIN2, DOMAIN2__NUMA_MOVE);
+
+    case XEN_DOMCTL_sample_accessed:
+        return current_has_perm(d, SECCLASS_DOMAIN2,
+                                DOMAIN2__SAMPLE_ACCESSED);
+
     default:
         return avc_unknown_permission("domctl", cmd);
     }
@@ -758,6 +765,7 @@ static int flask_sysctl(int cmd)
     case XEN_SYSCTL_getdomaininfolist:
     case XEN_SYSCTL_page_offline_op:
     case XEN_SYSCTL_scheduler_op:
+    case XEN_SYSCTL_sched_vcpu_stats:
 #ifdef CONFIG_X86
     case XEN_SYSCTL_cpu_hotplug:
 #endif